@@ -0,0 +1,1002 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Throughput and Latency Benchmark
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+// Measures CPCd through libcpc, against the echo and source endpoints of the
+// virtual secondary:
+//  - throughput : frames written to the echo endpoints, a few in flight per
+//                 client, and counted when they come back
+//  - latency    : one frame at a time on the echo endpoints, round-trip
+//                 percentiles
+//  - source     : frames sent by the source endpoint, host receive throughput
+//  - open_close : open and close cycles of an echo endpoint
+//  - reset      : time from a reset of the secondary until an echo endpoint
+//                 answers again. The secondary is reset with SIGUSR1, so this
+//                 needs cpc_virtual_secondary and --secondary-pid.
+//
+// Every client is a process with its own library handle and its own echo
+// endpoint: client i uses the endpoint echo + i. The throughput and latency runs are repeated for
+// every combination of payload size and client count. The endpoints are opened
+// with a transmit window of 1, the only one cpc_open_endpoint() accepts. The
+// results are written as JSON, encryption is not a parameter of the benchmark
+// but a property of the running CPCd, it is queried and stored in the report.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sl_cpc.h"
+
+#define MAX_LIST_LENGTH        16
+#define PIPELINE_DEPTH         4     // Frames in flight per client in the throughput test
+#define READ_TIMEOUT_MS        5000
+#define PROBE_TIMEOUT_MS       100   // Frames in flight during a reset may be lost
+#define RESET_POLL_MS          10
+#define RESET_TIMEOUT_S        30
+#define SOURCE_HEADER_SIZE     4     // The source endpoint writes the frame index first
+
+typedef struct {
+  unsigned long values[MAX_LIST_LENGTH];
+  size_t count;
+} list_t;
+
+typedef struct {
+  const char *instance_name;
+  bool tests[5];
+  uint8_t echo_endpoint;
+  uint8_t source_endpoint;
+  list_t sizes;
+  list_t clients;
+  unsigned long duration_ms;
+  unsigned long iterations;
+  unsigned long cycles;
+  pid_t secondary_pid;
+  unsigned long resets;
+  const char *label;
+  const char *output;
+} bench_config_t;
+
+enum {
+  TEST_THROUGHPUT,
+  TEST_LATENCY,
+  TEST_SOURCE,
+  TEST_OPEN_CLOSE,
+  TEST_RESET
+};
+
+static const char *test_names[] = { "throughput", "latency", "source", "open_close", "reset" };
+
+typedef struct {
+  // Set before the thread starts
+  int test;
+  uint8_t endpoint_id;
+  size_t payload_size;
+  pthread_barrier_t *barrier;
+  uint64_t *samples;            // iterations entries for the latency test
+
+  // Results
+  int error;
+  const char *error_step;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  uint64_t frames;
+  uint64_t bytes;
+} client_t;
+
+static bench_config_t config;
+static FILE *report;
+static bool first_result = true;
+
+static uint64_t now_ns(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --instance NAME        instance of CPCd (cpcd_0)\n"
+          "  --tests LIST           among throughput,latency,source,open_close,reset\n"
+          "                         (all but reset)\n"
+          "  --echo EP              first echo endpoint, client i uses EP + i (90)\n"
+          "  --source EP            source endpoint (92)\n"
+          "  --sizes LIST           payload sizes (16,256,1024,4087)\n"
+          "  --clients LIST         concurrent clients (1)\n"
+          "  --duration-ms MS       duration of each throughput run (2000)\n"
+          "  --iterations N         round trips of each latency run, frames of each\n"
+          "                         source run (1000)\n"
+          "  --cycles N             open and close cycles (100)\n"
+          "  --secondary-pid PID    cpc_virtual_secondary to reset with SIGUSR1\n"
+          "  --resets N             resets of the reset test (5)\n"
+          "  --label TEXT           stored in the report, to tell the runs apart\n"
+          "  --output FILE          write the report to FILE instead of stdout\n",
+          name);
+  exit(EXIT_FAILURE);
+}
+
+static unsigned long parse_number(const char *name, const char *value, unsigned long min, unsigned long max)
+{
+  char *end;
+  unsigned long number = strtoul(value, &end, 0);
+
+  if (*value == '\0' || *end != '\0' || number < min || number > max) {
+    fprintf(stderr, "invalid value for %s: %s\n", name, value);
+    exit(EXIT_FAILURE);
+  }
+
+  return number;
+}
+
+static void parse_list(const char *name, const char *value, list_t *list, unsigned long min, unsigned long max)
+{
+  char *copy = strdup(value);
+  char *save = NULL;
+
+  if (copy == NULL) {
+    perror("strdup");
+    exit(EXIT_FAILURE);
+  }
+
+  list->count = 0;
+  for (char *item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+    if (list->count == MAX_LIST_LENGTH) {
+      fprintf(stderr, "too many values for %s\n", name);
+      exit(EXIT_FAILURE);
+    }
+    list->values[list->count++] = parse_number(name, item, min, max);
+  }
+
+  if (list->count == 0) {
+    fprintf(stderr, "invalid value for %s: %s\n", name, value);
+    exit(EXIT_FAILURE);
+  }
+
+  free(copy);
+}
+
+static void parse_tests(const char *value)
+{
+  char *copy = strdup(value);
+  char *save = NULL;
+
+  if (copy == NULL) {
+    perror("strdup");
+    exit(EXIT_FAILURE);
+  }
+
+  memset(config.tests, 0, sizeof(config.tests));
+  for (char *item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+    size_t test;
+
+    for (test = 0; test < sizeof(test_names) / sizeof(test_names[0]); test++) {
+      if (strcmp(item, test_names[test]) == 0) {
+        config.tests[test] = true;
+        break;
+      }
+    }
+
+    if (test == sizeof(test_names) / sizeof(test_names[0])) {
+      fprintf(stderr, "unknown test: %s\n", item);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  free(copy);
+}
+
+static void parse_arguments(int argc, char *argv[])
+{
+  static const struct option options[] = {
+    { "instance", required_argument, NULL, 'i' },
+    { "tests", required_argument, NULL, 't' },
+    { "echo", required_argument, NULL, 'E' },
+    { "source", required_argument, NULL, 'O' },
+    { "sizes", required_argument, NULL, 's' },
+    { "clients", required_argument, NULL, 'c' },
+    { "duration-ms", required_argument, NULL, 'd' },
+    { "iterations", required_argument, NULL, 'n' },
+    { "cycles", required_argument, NULL, 'y' },
+    { "secondary-pid", required_argument, NULL, 'p' },
+    { "resets", required_argument, NULL, 'r' },
+    { "label", required_argument, NULL, 'l' },
+    { "output", required_argument, NULL, 'o' },
+    { "help", no_argument, NULL, 'h' },
+    { 0, 0, 0, 0 }
+  };
+  int opt;
+
+  config.instance_name = "cpcd_0";
+  parse_tests("throughput,latency,source,open_close");
+  config.echo_endpoint = SL_CPC_ENDPOINT_USER_ID_0;
+  config.source_endpoint = SL_CPC_ENDPOINT_USER_ID_0 + 2;
+  parse_list("--sizes", "16,256,1024,4087", &config.sizes, 1, SL_CPC_READ_MINIMUM_SIZE);
+  parse_list("--clients", "1", &config.clients, 1, 1);
+  config.duration_ms = 2000;
+  config.iterations = 1000;
+  config.cycles = 100;
+  config.resets = 5;
+
+  while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (opt) {
+      case 'i':
+        config.instance_name = optarg;
+        break;
+      case 't':
+        parse_tests(optarg);
+        break;
+      case 'E':
+        config.echo_endpoint = (uint8_t)parse_number("--echo", optarg, SL_CPC_ENDPOINT_USER_ID_0, UINT8_MAX);
+        break;
+      case 'O':
+        config.source_endpoint = (uint8_t)parse_number("--source", optarg, SL_CPC_ENDPOINT_USER_ID_0, UINT8_MAX);
+        break;
+      case 's':
+        parse_list("--sizes", optarg, &config.sizes, 1, SL_CPC_READ_MINIMUM_SIZE);
+        break;
+      case 'c':
+        parse_list("--clients", optarg, &config.clients, 1, SL_CPC_ENDPOINT_COUNT);
+        break;
+      case 'd':
+        config.duration_ms = parse_number("--duration-ms", optarg, 1, 3600000);
+        break;
+      case 'n':
+        config.iterations = parse_number("--iterations", optarg, 1, 100000000);
+        break;
+      case 'y':
+        config.cycles = parse_number("--cycles", optarg, 1, 100000000);
+        break;
+      case 'p':
+        config.secondary_pid = (pid_t)parse_number("--secondary-pid", optarg, 1, INT32_MAX);
+        break;
+      case 'r':
+        config.resets = parse_number("--resets", optarg, 1, 1000);
+        break;
+      case 'l':
+        config.label = optarg;
+        break;
+      case 'o':
+        config.output = optarg;
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        break;
+    }
+  }
+
+  if (optind != argc) {
+    usage(argv[0]);
+  }
+
+  for (size_t i = 0; i < config.clients.count; i++) {
+    if (config.echo_endpoint + config.clients.values[i] - 1 > UINT8_MAX) {
+      fprintf(stderr, "%lu clients do not fit after echo endpoint %u\n", config.clients.values[i], config.echo_endpoint);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Report
+
+static void report_string(const char *string)
+{
+  fputc('"', report);
+  for (const char *c = string; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fprintf(report, "\\%c", *c);
+    } else if ((unsigned char)*c < 0x20) {
+      fprintf(report, "\\u%04x", (unsigned char)*c);
+    } else {
+      fputc(*c, report);
+    }
+  }
+  fputc('"', report);
+}
+
+static void report_begin_result(int test)
+{
+  fprintf(report, "%s\n    { \"test\": \"%s\"", first_result ? "" : ",", test_names[test]);
+  first_result = false;
+}
+
+static void report_end_result(void)
+{
+  fprintf(report, " }");
+  fflush(report);
+}
+
+static void report_error(const char *step, int error)
+{
+  fprintf(report, ", \"error\": ");
+  report_string(step);
+  fprintf(report, ", \"errno\": ");
+  report_string(strerror(-error));
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static double percentile_us(const uint64_t *sorted, size_t count, double percentile)
+{
+  size_t rank = (size_t)(percentile * (double)count + 0.999999);
+
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  return (double)sorted[rank - 1] / 1000.0;
+}
+
+static void report_distribution(uint64_t *samples, size_t count)
+{
+  uint64_t total = 0;
+
+  qsort(samples, count, sizeof(samples[0]), compare_u64);
+  for (size_t i = 0; i < count; i++) {
+    total += samples[i];
+  }
+
+  fprintf(report,
+          ", \"samples\": %zu, \"mean_us\": %.1f, \"min_us\": %.1f, \"p50_us\": %.1f"
+          ", \"p99_us\": %.1f, \"p999_us\": %.1f, \"max_us\": %.1f",
+          count,
+          (double)total / (double)count / 1000.0,
+          (double)samples[0] / 1000.0,
+          percentile_us(samples, count, 0.50),
+          percentile_us(samples, count, 0.99),
+          percentile_us(samples, count, 0.999),
+          (double)samples[count - 1] / 1000.0);
+}
+
+// -----------------------------------------------------------------------------
+// Clients
+
+static void on_reset(void)
+{
+  // The reset test polls the endpoint, the callback only keeps the default
+  // action of SIGUSR1 from killing the benchmark
+}
+
+static int connect_handle(cpc_handle_t *handle)
+{
+  return cpc_init(handle, config.instance_name, false, on_reset);
+}
+
+static int open_echo(cpc_handle_t handle, cpc_endpoint_t *endpoint, uint8_t id, int timeout_ms)
+{
+  cpc_timeval_t timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+  int ret;
+
+  ret = cpc_open_endpoint(handle, endpoint, id, 1);
+  if (ret < 0) {
+    return ret;
+  }
+
+  ret = cpc_set_endpoint_read_timeout(*endpoint, timeout);
+  if (ret < 0) {
+    cpc_close_endpoint(endpoint);
+  }
+
+  return ret;
+}
+
+#define CLIENT_FAIL(client, step, ret) \
+  do {                                 \
+    (client)->error = (int)(ret);      \
+    (client)->error_step = (step);     \
+    goto cleanup;                      \
+  } while (0)
+
+/*
+ * Keep PIPELINE_DEPTH frames in flight until the duration elapsed, then wait
+ * for the frames still in flight.
+ */
+static void run_throughput(client_t *client, cpc_endpoint_t endpoint, uint8_t *tx, uint8_t *rx)
+{
+  uint64_t deadline;
+  unsigned in_flight = 0;
+
+  client->start_ns = now_ns();
+  deadline = client->start_ns + config.duration_ms * 1000000u;
+
+  for (;;) {
+    ssize_t ret;
+
+    while (in_flight < PIPELINE_DEPTH && now_ns() < deadline) {
+      ret = cpc_write_endpoint(endpoint, tx, client->payload_size, 0);
+      if (ret < 0) {
+        client->error = (int)ret;
+        client->error_step = "cpc_write_endpoint";
+        return;
+      }
+      in_flight++;
+    }
+
+    if (in_flight == 0) {
+      break;
+    }
+
+    ret = cpc_read_endpoint(endpoint, rx, SL_CPC_READ_MINIMUM_SIZE, 0);
+    if (ret < 0) {
+      client->error = (int)ret;
+      client->error_step = "cpc_read_endpoint";
+      return;
+    }
+    in_flight--;
+    client->frames++;
+    client->bytes += (uint64_t)ret;
+  }
+
+  client->end_ns = now_ns();
+}
+
+static void run_latency(client_t *client, cpc_endpoint_t endpoint, uint8_t *tx, uint8_t *rx)
+{
+  client->start_ns = now_ns();
+
+  for (unsigned long i = 0; i < config.iterations; i++) {
+    uint64_t start = now_ns();
+    ssize_t ret;
+
+    ret = cpc_write_endpoint(endpoint, tx, client->payload_size, 0);
+    if (ret < 0) {
+      client->error = (int)ret;
+      client->error_step = "cpc_write_endpoint";
+      return;
+    }
+
+    ret = cpc_read_endpoint(endpoint, rx, SL_CPC_READ_MINIMUM_SIZE, 0);
+    if (ret < 0) {
+      client->error = (int)ret;
+      client->error_step = "cpc_read_endpoint";
+      return;
+    }
+    if ((size_t)ret != client->payload_size) {
+      client->error = -EPROTO;
+      client->error_step = "echo size";
+      return;
+    }
+
+    client->samples[i] = now_ns() - start;
+    client->frames++;
+    client->bytes += (uint64_t)ret;
+  }
+
+  client->end_ns = now_ns();
+}
+
+static void client_process(client_t *client)
+{
+  cpc_handle_t handle = { 0 };
+  cpc_endpoint_t endpoint = { 0 };
+  bool handle_ready = false;
+  bool endpoint_ready = false;
+  uint8_t *tx = calloc(1, SL_CPC_READ_MINIMUM_SIZE);
+  uint8_t *rx = calloc(1, SL_CPC_READ_MINIMUM_SIZE);
+  int ret;
+
+  if (tx == NULL || rx == NULL) {
+    CLIENT_FAIL(client, "calloc", -ENOMEM);
+  }
+
+  for (size_t i = 0; i < client->payload_size; i++) {
+    tx[i] = (uint8_t)i;
+  }
+
+  ret = connect_handle(&handle);
+  if (ret < 0) {
+    CLIENT_FAIL(client, "cpc_init", ret);
+  }
+  handle_ready = true;
+
+  ret = open_echo(handle, &endpoint, client->endpoint_id, READ_TIMEOUT_MS);
+  if (ret < 0) {
+    CLIENT_FAIL(client, "cpc_open_endpoint", ret);
+  }
+  endpoint_ready = true;
+
+  cleanup:
+  // Every client must reach the barrier, even the ones that failed
+  pthread_barrier_wait(client->barrier);
+
+  if (client->error == 0) {
+    if (client->test == TEST_THROUGHPUT) {
+      run_throughput(client, endpoint, tx, rx);
+    } else {
+      run_latency(client, endpoint, tx, rx);
+    }
+  }
+
+  if (endpoint_ready) {
+    cpc_close_endpoint(&endpoint);
+  }
+  if (handle_ready) {
+    cpc_deinit(&handle);
+  }
+  free(tx);
+  free(rx);
+}
+
+static void run_clients(int test, size_t payload_size, size_t client_count)
+{
+  size_t sample_count = test == TEST_LATENCY ? client_count * config.iterations : 0;
+  size_t shared_size = sizeof(pthread_barrier_t) + client_count * sizeof(client_t) + sample_count * sizeof(uint64_t);
+  pthread_barrierattr_t barrier_attr;
+  pthread_barrier_t *barrier;
+  client_t *clients;
+  uint64_t *samples;
+  client_t total = { 0 };
+  void *shared;
+
+  // CPCd accepts one library handle per process, every client is a process
+  shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    perror("mmap");
+    exit(EXIT_FAILURE);
+  }
+  barrier = shared;
+  clients = (client_t *)&barrier[1];
+  samples = sample_count > 0 ? (uint64_t *)&clients[client_count] : NULL;
+
+  pthread_barrierattr_init(&barrier_attr);
+  pthread_barrierattr_setpshared(&barrier_attr, PTHREAD_PROCESS_SHARED);
+  pthread_barrier_init(barrier, &barrier_attr, (unsigned)client_count);
+  pthread_barrierattr_destroy(&barrier_attr);
+
+  fflush(report);
+
+  for (size_t i = 0; i < client_count; i++) {
+    pid_t pid;
+
+    clients[i].test = test;
+    clients[i].endpoint_id = (uint8_t)(config.echo_endpoint + i);
+    clients[i].payload_size = payload_size;
+    clients[i].barrier = barrier;
+    clients[i].samples = samples != NULL ? &samples[i * config.iterations] : NULL;
+
+    pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+      client_process(&clients[i]);
+      _exit(EXIT_SUCCESS);
+    }
+  }
+
+  for (size_t i = 0; i < client_count; i++) {
+    int status;
+
+    if (wait(&status) < 0) {
+      perror("wait");
+      exit(EXIT_FAILURE);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+      total.error = -ECHILD;
+      total.error_step = "client process";
+    }
+  }
+
+  total.start_ns = UINT64_MAX;
+  for (size_t i = 0; i < client_count; i++) {
+    if (clients[i].error != 0 && total.error == 0) {
+      total.error = clients[i].error;
+      total.error_step = clients[i].error_step;
+    }
+    total.frames += clients[i].frames;
+    total.bytes += clients[i].bytes;
+    if (clients[i].start_ns < total.start_ns) {
+      total.start_ns = clients[i].start_ns;
+    }
+    if (clients[i].end_ns > total.end_ns) {
+      total.end_ns = clients[i].end_ns;
+    }
+  }
+
+  pthread_barrier_destroy(barrier);
+
+  report_begin_result(test);
+  fprintf(report, ", \"payload_size\": %zu, \"clients\": %zu", payload_size, client_count);
+  if (total.error != 0) {
+    report_error(total.error_step, total.error);
+  } else {
+    double duration_s = (double)(total.end_ns - total.start_ns) / 1e9;
+
+    fprintf(report,
+            ", \"frames\": %" PRIu64 ", \"bytes\": %" PRIu64 ", \"duration_s\": %.3f"
+            ", \"frames_per_s\": %.1f, \"bytes_per_s\": %.1f",
+            total.frames, total.bytes, duration_s,
+            (double)total.frames / duration_s, (double)total.bytes / duration_s);
+    if (test == TEST_LATENCY) {
+      report_distribution(samples, client_count * config.iterations);
+    }
+  }
+  report_end_result();
+
+  munmap(shared, shared_size);
+}
+
+// -----------------------------------------------------------------------------
+// Single client tests
+
+static void run_source(size_t payload_size)
+{
+  cpc_handle_t handle = { 0 };
+  cpc_endpoint_t endpoint = { 0 };
+  uint8_t request[6];
+  uint8_t *rx = malloc(SL_CPC_READ_MINIMUM_SIZE);
+  uint64_t start = 0;
+  uint64_t end = 0;
+  uint64_t bytes = 0;
+  unsigned long frames = 0;
+  const char *step = NULL;
+  int ret;
+
+  report_begin_result(TEST_SOURCE);
+  fprintf(report, ", \"payload_size\": %zu", payload_size);
+
+  if (rx == NULL) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  if (payload_size < SOURCE_HEADER_SIZE) {
+    // The source writes the frame index in every frame
+    payload_size = SOURCE_HEADER_SIZE;
+  }
+
+  ret = connect_handle(&handle);
+  if (ret < 0) {
+    step = "cpc_init";
+    goto done;
+  }
+
+  ret = open_echo(handle, &endpoint, config.source_endpoint, READ_TIMEOUT_MS);
+  if (ret < 0) {
+    step = "cpc_open_endpoint";
+    goto deinit;
+  }
+
+  request[0] = (uint8_t)config.iterations;
+  request[1] = (uint8_t)(config.iterations >> 8);
+  request[2] = (uint8_t)(config.iterations >> 16);
+  request[3] = (uint8_t)(config.iterations >> 24);
+  request[4] = (uint8_t)payload_size;
+  request[5] = (uint8_t)(payload_size >> 8);
+
+  start = now_ns();
+  ret = (int)cpc_write_endpoint(endpoint, request, sizeof(request), 0);
+  if (ret < 0) {
+    step = "cpc_write_endpoint";
+    goto close;
+  }
+
+  while (frames < config.iterations) {
+    ssize_t count = cpc_read_endpoint(endpoint, rx, SL_CPC_READ_MINIMUM_SIZE, 0);
+
+    if (count < 0) {
+      ret = (int)count;
+      step = "cpc_read_endpoint";
+      goto close;
+    }
+
+    frames++;
+    bytes += (uint64_t)count;
+  }
+  end = now_ns();
+
+  close:
+  cpc_close_endpoint(&endpoint);
+  deinit:
+  cpc_deinit(&handle);
+  done:
+  if (step != NULL) {
+    report_error(step, ret);
+  } else {
+    double duration_s = (double)(end - start) / 1e9;
+
+    fprintf(report,
+            ", \"frames\": %lu, \"bytes\": %" PRIu64 ", \"duration_s\": %.3f"
+            ", \"frames_per_s\": %.1f, \"bytes_per_s\": %.1f",
+            frames, bytes, duration_s, (double)frames / duration_s, (double)bytes / duration_s);
+  }
+  report_end_result();
+  free(rx);
+}
+
+static void run_open_close(void)
+{
+  cpc_handle_t handle = { 0 };
+  uint64_t *samples = calloc(config.cycles, sizeof(uint64_t));
+  uint64_t start;
+  uint64_t total = 0;
+  const char *step = NULL;
+  int ret;
+
+  if (samples == NULL) {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+
+  report_begin_result(TEST_OPEN_CLOSE);
+
+  ret = connect_handle(&handle);
+  if (ret < 0) {
+    step = "cpc_init";
+    goto done;
+  }
+
+  total = now_ns();
+  for (unsigned long i = 0; i < config.cycles; i++) {
+    cpc_endpoint_t endpoint;
+
+    start = now_ns();
+    ret = cpc_open_endpoint(handle, &endpoint, config.echo_endpoint, 1);
+    if (ret < 0) {
+      step = "cpc_open_endpoint";
+      break;
+    }
+
+    ret = cpc_close_endpoint(&endpoint);
+    if (ret < 0) {
+      step = "cpc_close_endpoint";
+      break;
+    }
+    samples[i] = now_ns() - start;
+  }
+  total = now_ns() - total;
+
+  cpc_deinit(&handle);
+
+  done:
+  if (step != NULL) {
+    report_error(step, ret);
+  } else {
+    fprintf(report, ", \"cycles\": %lu, \"cycles_per_s\": %.1f", config.cycles, (double)config.cycles / ((double)total / 1e9));
+    report_distribution(samples, config.cycles);
+  }
+  report_end_result();
+  free(samples);
+}
+
+/*
+ * One round trip on the echo endpoint, reconnecting to CPCd and reopening the
+ * endpoint when the reset broke them. CPCd may be restarting, so every step
+ * may fail for a while.
+ */
+static bool probe_echo(cpc_handle_t *handle, bool *handle_ready, cpc_endpoint_t *endpoint, bool *endpoint_ready)
+{
+  static uint8_t buffer[SL_CPC_READ_MINIMUM_SIZE];
+  ssize_t ret;
+
+  if (!*handle_ready) {
+    if (connect_handle(handle) < 0) {
+      return false;
+    }
+    *handle_ready = true;
+  }
+
+  if (!*endpoint_ready) {
+    if (open_echo(*handle, endpoint, config.echo_endpoint, PROBE_TIMEOUT_MS) < 0) {
+      // The daemon may have gone away with the handle
+      cpc_deinit(handle);
+      *handle_ready = false;
+      return false;
+    }
+    *endpoint_ready = true;
+  }
+
+  ret = cpc_write_endpoint(*endpoint, "ping", 4, 0);
+  if (ret >= 0) {
+    ret = cpc_read_endpoint(*endpoint, buffer, sizeof(buffer), 0);
+  }
+  if (ret == 4) {
+    return true;
+  }
+
+  if (ret != -EAGAIN && ret != -ETIMEDOUT) {
+    cpc_close_endpoint(endpoint);
+    *endpoint_ready = false;
+    cpc_deinit(handle);
+    *handle_ready = false;
+  }
+
+  return false;
+}
+
+static void run_reset(void)
+{
+  cpc_handle_t handle = { 0 };
+  cpc_endpoint_t endpoint = { 0 };
+  bool handle_ready = false;
+  bool endpoint_ready = false;
+  uint64_t *samples = calloc(config.resets, sizeof(uint64_t));
+  const char *step = NULL;
+  int ret = 0;
+
+  if (samples == NULL) {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+
+  report_begin_result(TEST_RESET);
+
+  if (config.secondary_pid == 0) {
+    ret = -EINVAL;
+    step = "the reset test needs --secondary-pid";
+    goto done;
+  }
+
+  if (!probe_echo(&handle, &handle_ready, &endpoint, &endpoint_ready)) {
+    ret = -EIO;
+    step = "echo before the reset";
+    goto cleanup;
+  }
+
+  for (unsigned long i = 0; i < config.resets; i++) {
+    uint64_t start = now_ns();
+
+    if (kill(config.secondary_pid, SIGUSR1) != 0) {
+      ret = -errno;
+      step = "kill";
+      goto cleanup;
+    }
+
+    while (!probe_echo(&handle, &handle_ready, &endpoint, &endpoint_ready)) {
+      if (now_ns() - start > RESET_TIMEOUT_S * 1000000000ull) {
+        ret = -ETIMEDOUT;
+        step = "echo after the reset";
+        goto cleanup;
+      }
+      usleep(RESET_POLL_MS * 1000);
+    }
+
+    samples[i] = now_ns() - start;
+  }
+
+  cleanup:
+  if (endpoint_ready) {
+    cpc_close_endpoint(&endpoint);
+  }
+  if (handle_ready) {
+    cpc_deinit(&handle);
+  }
+  done:
+  if (step != NULL) {
+    report_error(step, ret);
+  } else {
+    report_distribution(samples, config.resets);
+  }
+  report_end_result();
+  free(samples);
+}
+
+// -----------------------------------------------------------------------------
+
+static void report_environment(void)
+{
+  cpc_handle_t handle = { 0 };
+  cpc_endpoint_t endpoint = { 0 };
+  const char *secondary_app_version;
+  bool encrypted = false;
+  int ret;
+
+  fprintf(report, "{\n  \"library_version\": ");
+  report_string(cpc_get_library_version());
+
+  fprintf(report, ",\n  \"label\": ");
+  report_string(config.label != NULL ? config.label : "");
+
+  ret = connect_handle(&handle);
+  if (ret < 0) {
+    fprintf(stderr, "cannot connect to CPCd instance %s: %s\n", config.instance_name, strerror(-ret));
+    exit(EXIT_FAILURE);
+  }
+
+  // The library returns a copy of the version, owned by the caller
+  secondary_app_version = cpc_get_secondary_app_version(handle);
+  fprintf(report, ",\n  \"secondary_app_version\": ");
+  report_string(secondary_app_version != NULL ? secondary_app_version : "");
+  free((void *)secondary_app_version);
+
+  // The encryption applies to every user endpoint alike
+  if (cpc_open_endpoint(handle, &endpoint, config.echo_endpoint, 1) >= 0) {
+    cpc_get_endpoint_encryption_state(endpoint, &encrypted);
+    cpc_close_endpoint(&endpoint);
+  }
+  fprintf(report, ",\n  \"encrypted\": %s", encrypted ? "true" : "false");
+
+  cpc_deinit(&handle);
+
+  fprintf(report, ",\n  \"results\": [");
+}
+
+int main(int argc, char *argv[])
+{
+  parse_arguments(argc, argv);
+
+  if (config.output != NULL) {
+    report = fopen(config.output, "w");
+    if (report == NULL) {
+      perror("fopen");
+      return EXIT_FAILURE;
+    }
+  } else {
+    report = stdout;
+  }
+
+  report_environment();
+
+  for (int test = TEST_THROUGHPUT; test <= TEST_LATENCY; test++) {
+    if (!config.tests[test]) {
+      continue;
+    }
+
+    for (size_t s = 0; s < config.sizes.count; s++) {
+      for (size_t c = 0; c < config.clients.count; c++) {
+        run_clients(test, config.sizes.values[s], config.clients.values[c]);
+      }
+    }
+  }
+
+  if (config.tests[TEST_SOURCE]) {
+    for (size_t s = 0; s < config.sizes.count; s++) {
+      run_source(config.sizes.values[s]);
+    }
+  }
+
+  if (config.tests[TEST_OPEN_CLOSE]) {
+    run_open_close();
+  }
+
+  if (config.tests[TEST_RESET]) {
+    run_reset();
+  }
+
+  fprintf(report, "\n  ]\n}\n");
+
+  if (report != stdout) {
+    fclose(report);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,585 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Multi-Threaded Endpoint Stress
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+// Stresses one echo endpoint of the virtual secondary from several threads of
+// a single process, sharing one library handle and one endpoint:
+//  - throughput : every thread writes a frame and reads an echo back, until
+//                 the duration elapsed. The frames per second against the
+//                 thread count show how the data path scales without locks.
+//  - close      : the threads exchange frames, then all of them block reading
+//                 the endpoint and cpc_close_endpoint() is called from the
+//                 main thread. Every read must be interrupted with an error,
+//                 the time taken by the close is reported.
+//
+// The threads of the close test are only let block once all of them are
+// asleep in cpc_read_endpoint(): the endpoint is freed when the close returns,
+// a call started afterwards would use it, libcpc leaves that to the caller.
+// The results are written as JSON.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sl_cpc.h"
+
+#define MAX_THREADS            64
+#define MAX_LIST_LENGTH        16
+#define READ_TIMEOUT_MS        5000
+#define EXCHANGE_MS            20    // Traffic before each close of the close test
+#define PARK_POLL_US           100
+#define OPEN_RETRY_MS          10
+
+typedef struct {
+  unsigned long values[MAX_LIST_LENGTH];
+  size_t count;
+} list_t;
+
+typedef struct {
+  const char *instance_name;
+  uint8_t echo_endpoint;
+  list_t threads;
+  size_t payload_size;
+  unsigned long duration_ms;
+  unsigned long closes;
+  const char *output;
+} stress_config_t;
+
+typedef struct {
+  pthread_t thread;
+  pid_t tid;
+  cpc_endpoint_t endpoint;
+  pthread_barrier_t *barrier;
+  pthread_barrier_t *park_barrier;
+
+  // Results
+  int error;
+  const char *error_step;
+  uint64_t frames;
+  bool parked;                  // Left with the read to be interrupted by the close
+  bool failed;                  // Stopped on an error, does not park
+  ssize_t parked_ret;           // Return of the read interrupted by the close
+} worker_t;
+
+static stress_config_t config;
+static FILE *report;
+static bool first_result = true;
+
+static cpc_handle_t handle;
+static bool stop;
+
+static uint64_t now_ns(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --instance NAME        instance of CPCd (cpcd_0)\n"
+          "  --echo EP              echo endpoint shared by the threads (90)\n"
+          "  --threads LIST         thread counts (1,2,4,8)\n"
+          "  --size BYTES           payload size (16)\n"
+          "  --duration-ms MS       duration of each throughput run (2000)\n"
+          "  --closes N             closes under load per thread count (20)\n"
+          "  --output FILE          JSON report (stdout)\n",
+          name);
+  exit(EXIT_FAILURE);
+}
+
+static unsigned long parse_number(const char *name, const char *value, unsigned long min, unsigned long max)
+{
+  char *end;
+  unsigned long number = strtoul(value, &end, 0);
+
+  if (*value == '\0' || *end != '\0' || number < min || number > max) {
+    fprintf(stderr, "invalid value for %s: %s\n", name, value);
+    exit(EXIT_FAILURE);
+  }
+
+  return number;
+}
+
+static void parse_list(const char *name, const char *value, list_t *list, unsigned long min, unsigned long max)
+{
+  char *copy = strdup(value);
+  char *save = NULL;
+
+  if (copy == NULL) {
+    perror("strdup");
+    exit(EXIT_FAILURE);
+  }
+
+  list->count = 0;
+  for (char *item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+    if (list->count == MAX_LIST_LENGTH) {
+      fprintf(stderr, "too many values for %s\n", name);
+      exit(EXIT_FAILURE);
+    }
+    list->values[list->count++] = parse_number(name, item, min, max);
+  }
+
+  if (list->count == 0) {
+    fprintf(stderr, "invalid value for %s: %s\n", name, value);
+    exit(EXIT_FAILURE);
+  }
+
+  free(copy);
+}
+
+static void parse_arguments(int argc, char *argv[])
+{
+  static const struct option options[] = {
+    { "instance", required_argument, NULL, 'i' },
+    { "echo", required_argument, NULL, 'E' },
+    { "threads", required_argument, NULL, 't' },
+    { "size", required_argument, NULL, 's' },
+    { "duration-ms", required_argument, NULL, 'd' },
+    { "closes", required_argument, NULL, 'c' },
+    { "output", required_argument, NULL, 'o' },
+    { "help", no_argument, NULL, 'h' },
+    { 0, 0, 0, 0 }
+  };
+  int opt;
+
+  config.instance_name = "cpcd_0";
+  config.echo_endpoint = SL_CPC_ENDPOINT_USER_ID_0;
+  parse_list("--threads", "1,2,4,8", &config.threads, 1, MAX_THREADS);
+  config.payload_size = 16;
+  config.duration_ms = 2000;
+  config.closes = 20;
+
+  while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (opt) {
+      case 'i':
+        config.instance_name = optarg;
+        break;
+      case 'E':
+        config.echo_endpoint = (uint8_t)parse_number("--echo", optarg, SL_CPC_ENDPOINT_USER_ID_0, UINT8_MAX);
+        break;
+      case 't':
+        parse_list("--threads", optarg, &config.threads, 1, MAX_THREADS);
+        break;
+      case 's':
+        config.payload_size = parse_number("--size", optarg, 1, SL_CPC_READ_MINIMUM_SIZE);
+        break;
+      case 'd':
+        config.duration_ms = parse_number("--duration-ms", optarg, 1, 3600000);
+        break;
+      case 'c':
+        config.closes = parse_number("--closes", optarg, 1, 100000);
+        break;
+      case 'o':
+        config.output = optarg;
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        break;
+    }
+  }
+
+  if (optind != argc) {
+    usage(argv[0]);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Report
+
+static void report_begin_result(const char *test, size_t thread_count)
+{
+  fprintf(report, "%s\n    { \"test\": \"%s\", \"threads\": %zu", first_result ? "" : ",", test, thread_count);
+  first_result = false;
+}
+
+static void report_end_result(void)
+{
+  fprintf(report, " }");
+  fflush(report);
+}
+
+static void report_error(const char *step, int error)
+{
+  fprintf(report, ", \"error\": \"%s\", \"errno\": \"%s\"", step, strerror(-error));
+}
+
+// -----------------------------------------------------------------------------
+// Workers
+
+static void on_reset(void)
+{
+  // Keeps the default action of SIGUSR1 from killing the benchmark
+}
+
+static int open_echo(cpc_endpoint_t *endpoint)
+{
+  cpc_timeval_t timeout = { READ_TIMEOUT_MS / 1000, (READ_TIMEOUT_MS % 1000) * 1000 };
+  int ret;
+
+  // The secondary may still be closing the endpoint of the previous run
+  for (unsigned long waited_ms = 0;; waited_ms += OPEN_RETRY_MS) {
+    ret = cpc_open_endpoint(handle, endpoint, config.echo_endpoint, 1);
+    if (ret != -EAGAIN || waited_ms >= READ_TIMEOUT_MS) {
+      break;
+    }
+    usleep(OPEN_RETRY_MS * 1000);
+  }
+  if (ret < 0) {
+    return ret;
+  }
+
+  ret = cpc_set_endpoint_read_timeout(*endpoint, timeout);
+  if (ret < 0) {
+    cpc_close_endpoint(endpoint);
+  }
+
+  return ret;
+}
+
+/*
+ * One frame out, one echo back. The threads share the endpoint, the echo read
+ * may be the one of another thread, every thread still reads as many frames
+ * as it writes so none is left once they all stopped.
+ */
+static bool exchange(worker_t *worker, uint8_t *tx, uint8_t *rx)
+{
+  ssize_t ret;
+
+  ret = cpc_write_endpoint(worker->endpoint, tx, config.payload_size, 0);
+  if (ret < 0) {
+    worker->error = (int)ret;
+    worker->error_step = "cpc_write_endpoint";
+    return false;
+  }
+
+  ret = cpc_read_endpoint(worker->endpoint, rx, SL_CPC_READ_MINIMUM_SIZE, 0);
+  if (ret < 0) {
+    worker->error = (int)ret;
+    worker->error_step = "cpc_read_endpoint";
+    return false;
+  }
+  if ((size_t)ret != config.payload_size) {
+    worker->error = -EPROTO;
+    worker->error_step = "echo size";
+    return false;
+  }
+
+  worker->frames++;
+  return true;
+}
+
+static void *worker_thread(void *arg)
+{
+  worker_t *worker = arg;
+  uint8_t *tx = calloc(1, SL_CPC_READ_MINIMUM_SIZE);
+  uint8_t *rx = calloc(1, SL_CPC_READ_MINIMUM_SIZE);
+
+  worker->tid = (pid_t)syscall(SYS_gettid);
+
+  pthread_barrier_wait(worker->barrier);
+
+  if (tx == NULL || rx == NULL) {
+    worker->error = -ENOMEM;
+    worker->error_step = "calloc";
+  } else {
+    while (!__atomic_load_n(&stop, __ATOMIC_SEQ_CST) && exchange(worker, tx, rx)) {
+    }
+  }
+
+  free(tx);
+  free(rx);
+
+  return NULL;
+}
+
+static void *parking_thread(void *arg)
+{
+  worker_t *worker = arg;
+
+  worker_thread(worker);
+
+  // A thread parked early would read the echo of a thread still exchanging,
+  // the endpoint is only idle once every thread is done
+  pthread_barrier_wait(worker->park_barrier);
+
+  // Block on the idle endpoint until the close interrupts the read
+  if (worker->error == 0) {
+    uint8_t rx[SL_CPC_READ_MINIMUM_SIZE];
+
+    __atomic_store_n(&worker->parked, true, __ATOMIC_SEQ_CST);
+    worker->parked_ret = cpc_read_endpoint(worker->endpoint, rx, sizeof(rx), 0);
+  } else {
+    __atomic_store_n(&worker->failed, true, __ATOMIC_SEQ_CST);
+  }
+
+  return NULL;
+}
+
+static void start_workers(worker_t *workers, size_t count, pthread_barrier_t *barrier, void *(*routine)(void *))
+{
+  pthread_barrier_init(barrier, NULL, (unsigned)count + 1);
+
+  for (size_t i = 0; i < count; i++) {
+    workers[i].barrier = barrier;
+    if (pthread_create(&workers[i].thread, NULL, routine, &workers[i]) != 0) {
+      perror("pthread_create");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+static void join_workers(worker_t *workers, size_t count, pthread_barrier_t *barrier)
+{
+  for (size_t i = 0; i < count; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  pthread_barrier_destroy(barrier);
+}
+
+/*
+ * A thread counted as parked has nothing left to do but its read, once the
+ * kernel reports it sleeping it is blocked in recv() under the reference of
+ * the endpoint.
+ */
+static bool thread_sleeping(pid_t tid)
+{
+  char path[64];
+  char stat[256];
+  char *state;
+  size_t length;
+  FILE *file;
+
+  snprintf(path, sizeof(path), "/proc/self/task/%d/stat", (int)tid);
+  file = fopen(path, "r");
+  if (file == NULL) {
+    return false;
+  }
+  length = fread(stat, 1, sizeof(stat) - 1, file);
+  fclose(file);
+  stat[length] = '\0';
+
+  // The state follows the command name, which may hold spaces and parentheses
+  state = strrchr(stat, ')');
+
+  return state != NULL && state[1] == ' ' && state[2] == 'S';
+}
+
+static void run_throughput(size_t thread_count)
+{
+  worker_t workers[MAX_THREADS] = { 0 };
+  pthread_barrier_t barrier;
+  cpc_endpoint_t endpoint;
+  uint64_t frames = 0;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  int error = 0;
+  const char *error_step = NULL;
+  int ret;
+
+  ret = open_echo(&endpoint);
+  if (ret < 0) {
+    report_begin_result("throughput", thread_count);
+    report_error("cpc_open_endpoint", ret);
+    report_end_result();
+    return;
+  }
+
+  __atomic_store_n(&stop, false, __ATOMIC_SEQ_CST);
+  for (size_t i = 0; i < thread_count; i++) {
+    workers[i].endpoint = endpoint;
+  }
+  start_workers(workers, thread_count, &barrier, worker_thread);
+
+  pthread_barrier_wait(&barrier);
+  start_ns = now_ns();
+  usleep((useconds_t)(config.duration_ms * 1000));
+  __atomic_store_n(&stop, true, __ATOMIC_SEQ_CST);
+
+  join_workers(workers, thread_count, &barrier);
+  end_ns = now_ns();
+
+  cpc_close_endpoint(&endpoint);
+
+  for (size_t i = 0; i < thread_count; i++) {
+    frames += workers[i].frames;
+    if (workers[i].error != 0 && error == 0) {
+      error = workers[i].error;
+      error_step = workers[i].error_step;
+    }
+  }
+
+  report_begin_result("throughput", thread_count);
+  if (error != 0) {
+    report_error(error_step, error);
+  } else {
+    double duration_s = (double)(end_ns - start_ns) / 1e9;
+
+    fprintf(report, ", \"frames\": %llu, \"duration_s\": %.3f, \"frames_per_s\": %.1f",
+            (unsigned long long)frames, duration_s, (double)frames / duration_s);
+  }
+  report_end_result();
+}
+
+static void run_close(size_t thread_count)
+{
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+  unsigned long closes = 0;
+  int error = 0;
+  const char *error_step = NULL;
+
+  for (unsigned long cycle = 0; cycle < config.closes && error == 0; cycle++) {
+    worker_t workers[MAX_THREADS] = { 0 };
+    pthread_barrier_t barrier;
+    pthread_barrier_t park_barrier;
+    cpc_endpoint_t endpoint;
+    uint64_t start_ns;
+    uint64_t close_ns;
+    bool all_parked;
+    int ret;
+
+    ret = open_echo(&endpoint);
+    if (ret < 0) {
+      error = ret;
+      error_step = "cpc_open_endpoint";
+      break;
+    }
+
+    __atomic_store_n(&stop, false, __ATOMIC_SEQ_CST);
+    pthread_barrier_init(&park_barrier, NULL, (unsigned)thread_count);
+    for (size_t i = 0; i < thread_count; i++) {
+      workers[i].endpoint = endpoint;
+      workers[i].park_barrier = &park_barrier;
+    }
+    start_workers(workers, thread_count, &barrier, parking_thread);
+
+    pthread_barrier_wait(&barrier);
+    usleep(EXCHANGE_MS * 1000);
+    __atomic_store_n(&stop, true, __ATOMIC_SEQ_CST);
+
+    // A thread that failed does not park, it is reported below
+    do {
+      usleep(PARK_POLL_US);
+      all_parked = true;
+      for (size_t i = 0; i < thread_count; i++) {
+        if (!__atomic_load_n(&workers[i].failed, __ATOMIC_SEQ_CST)
+            && (!__atomic_load_n(&workers[i].parked, __ATOMIC_SEQ_CST) || !thread_sleeping(workers[i].tid))) {
+          all_parked = false;
+        }
+      }
+    } while (!all_parked);
+
+    start_ns = now_ns();
+    ret = cpc_close_endpoint(&endpoint);
+    close_ns = now_ns() - start_ns;
+
+    join_workers(workers, thread_count, &barrier);
+    pthread_barrier_destroy(&park_barrier);
+
+    if (ret < 0) {
+      error = ret;
+      error_step = "cpc_close_endpoint";
+    }
+    for (size_t i = 0; i < thread_count && error == 0; i++) {
+      if (workers[i].error != 0) {
+        error = workers[i].error;
+        error_step = workers[i].error_step;
+      } else if (workers[i].parked_ret >= 0) {
+        error = -EPROTO;
+        error_step = "read not interrupted by the close";
+      }
+    }
+
+    total_ns += close_ns;
+    if (close_ns > max_ns) {
+      max_ns = close_ns;
+    }
+    closes++;
+  }
+
+  report_begin_result("close", thread_count);
+  if (error != 0) {
+    report_error(error_step, error);
+  } else {
+    fprintf(report, ", \"closes\": %lu, \"mean_close_us\": %.1f, \"max_close_us\": %.1f",
+            closes, (double)total_ns / (double)closes / 1000.0, (double)max_ns / 1000.0);
+  }
+  report_end_result();
+}
+
+int main(int argc, char *argv[])
+{
+  int ret;
+
+  parse_arguments(argc, argv);
+
+  if (config.output != NULL) {
+    report = fopen(config.output, "w");
+    if (report == NULL) {
+      perror("fopen");
+      return EXIT_FAILURE;
+    }
+  } else {
+    report = stdout;
+  }
+
+  // One library handle per process, every thread shares it
+  ret = cpc_init(&handle, config.instance_name, false, on_reset);
+  if (ret < 0) {
+    fprintf(stderr, "cannot connect to CPCd instance %s: %s\n", config.instance_name, strerror(-ret));
+    return EXIT_FAILURE;
+  }
+
+  fprintf(report, "{\n  \"library_version\": \"%s\"", cpc_get_library_version());
+  fprintf(report, ",\n  \"payload_size\": %zu", config.payload_size);
+  fprintf(report, ",\n  \"results\": [");
+
+  for (size_t i = 0; i < config.threads.count; i++) {
+    run_throughput(config.threads.values[i]);
+  }
+
+  for (size_t i = 0; i < config.threads.count; i++) {
+    run_close(config.threads.values[i]);
+  }
+
+  fprintf(report, "\n  ]\n}\n");
+
+  cpc_deinit(&handle);
+
+  if (report != stdout) {
+    fclose(report);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - GPIO Toggle Benchmark
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+// Measures the latency of the GPIO accesses done by the SPI driver for every
+// frame: writing an output line (chip select) and reading an input line (IRQ).
+// One executable is built per GPIO backend, they take the same arguments so
+// the backends can be compared on the same pins.
+//
+// usage: gpio_bench_<backend> <output chip> <output pin> [input chip] [input pin] [iterations]
+//
+// The output pin is toggled, nothing must be connected to it that could be
+// disturbed. When no input pin is given, the output pin is not read back.
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "misc/gpio.h"
+#include "misc/logging.h"
+
+// The GPIO backends only need these two from the logging module
+void signal_crash(void)
+{
+  abort();
+}
+
+void trace(const bool force_stdout, const char* string, ...)
+{
+  va_list args;
+
+  (void)force_stdout;
+
+  va_start(args, string);
+  vfprintf(stderr, string, args);
+  va_end(args);
+}
+
+static uint64_t now_ns(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static void report(const char *operation, unsigned long iterations, uint64_t elapsed_ns)
+{
+  printf("%-6s %-8s %10lu ops %10.1f ns/op\n",
+         GPIO_BENCH_BACKEND, operation, iterations, (double)elapsed_ns / (double)iterations);
+}
+
+int main(int argc, char *argv[])
+{
+  gpio_t output;
+  gpio_t input;
+  unsigned long iterations;
+  bool has_input;
+  uint64_t start;
+
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <output chip> <output pin> [input chip] [input pin] [iterations]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  has_input = (argc >= 5);
+  iterations = (argc >= 6) ? strtoul(argv[5], NULL, 0) : 100000;
+  if (iterations == 0) {
+    fprintf(stderr, "iterations must not be 0\n");
+    return EXIT_FAILURE;
+  }
+
+  gpio_init(&output, argv[1], (unsigned int)strtoul(argv[2], NULL, 0), HIGH, NO_EDGE);
+  if (has_input) {
+    gpio_init(&input, argv[3], (unsigned int)strtoul(argv[4], NULL, 0), IN, NO_EDGE);
+  }
+
+  // One toggle is the assertion and the release of the chip select
+  start = now_ns();
+  for (unsigned long i = 0; i < iterations; i++) {
+    gpio_write(&output, 0);
+    gpio_write(&output, 1);
+  }
+  report("toggle", iterations, now_ns() - start);
+
+  if (has_input) {
+    start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++) {
+      gpio_read(&input);
+    }
+    report("read", iterations, now_ns() - start);
+
+    gpio_deinit(&input);
+  }
+
+  gpio_deinit(&output);
+
+  return EXIT_SUCCESS;
+}
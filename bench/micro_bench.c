@@ -0,0 +1,588 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Primitives Microbenchmark
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+// Measures the primitives on the data path of CPCd, in process, without a
+// daemon or a secondary: the checksums, the HDLC header helpers, the AES-GCM
+// operation of the security layer, the lists, the traces and the UART
+// deframer.
+//
+// usage: micro_bench [filter]
+//
+// Only the benchmarks whose name contains the filter are run. Every benchmark
+// is calibrated to run for at least BENCH_MIN_RUN_NS, the best of BENCH_RUNS
+// runs is reported, in ns per operation and, for the operations on data, in
+// bytes per second.
+
+#define _GNU_SOURCE
+
+#include <glob.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "misc/config.h"
+#include "misc/logging.h"
+#include "misc/sl_slist.h"
+#include "server_core/core/crc.h"
+#include "server_core/core/hdlc.h"
+#include "server_core/epoll/epoll.h"
+#include "driver/uart_deframer.h"
+
+#if defined(ENABLE_ENCRYPTION)
+#include <mbedtls/gcm.h>
+#endif
+
+#define BENCH_MIN_RUN_NS   20000000ull
+#define BENCH_RUNS         5
+#define HEADER_VARIANTS    64            // Distinct headers, so that the parsing is not hoisted out of the loop
+#define SLIST_MAX_NODES    256
+#define DEFRAMER_STREAM_SIZE (64 * 1024)
+#define DEFRAMER_CHUNK_SIZE  256         // Bytes returned by one read of the uart
+#define GCM_TAG_SIZE       8             // As in the security layer
+#define GCM_KEY_SIZE       32
+
+// The modules under test expect these from the daemon
+config_t config;
+core_debug_counters_t primary_core_debug_counters;
+core_debug_counters_t secondary_core_debug_counters;
+
+void signal_crash(void)
+{
+  abort();
+}
+
+void epoll_register(epoll_private_data_t *private_data)
+{
+  (void)private_data;
+}
+
+typedef void (*bench_func_t)(void *context, uint64_t iterations);
+
+// Written by every benchmark, so that the compiler keeps the work
+static volatile uint32_t bench_sink;
+
+static const char *bench_filter;
+
+static uint8_t data_buffer[UART_DEFRAMER_MAX_FRAME_SIZE];
+
+static uint64_t now_ns(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/*
+ * Run 'func' with 'context'. 'size' is the number of bytes handled by one
+ * operation, 0 when the operation is not on data.
+ */
+static void bench_run(const char *name, size_t size, bench_func_t func, void *context)
+{
+  uint64_t iterations = 1;
+  uint64_t elapsed;
+  double best_ns = 0.0;
+
+  if (bench_filter != NULL && strstr(name, bench_filter) == NULL) {
+    return;
+  }
+
+  // Find an iteration count that runs long enough to be timed
+  for (;;) {
+    uint64_t start = now_ns();
+
+    func(context, iterations);
+    elapsed = now_ns() - start;
+
+    if (elapsed >= BENCH_MIN_RUN_NS) {
+      break;
+    }
+
+    iterations = elapsed == 0 ? iterations * 100 : iterations * 2;
+  }
+
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    uint64_t start = now_ns();
+    double ns_per_op;
+
+    func(context, iterations);
+    ns_per_op = (double)(now_ns() - start) / (double)iterations;
+
+    if (run == 0 || ns_per_op < best_ns) {
+      best_ns = ns_per_op;
+    }
+  }
+
+  if (size != 0) {
+    printf("%-28s %6zu %12.1f ns/op %10.1f MB/s\n", name, size, best_ns, (double)size * 1e3 / best_ns);
+  } else {
+    printf("%-28s %6s %12.1f ns/op\n", name, "-", best_ns);
+  }
+  fflush(stdout);
+}
+
+// -----------------------------------------------------------------------------
+// Checksums and HDLC
+
+static void bench_crc(void *context, uint64_t iterations)
+{
+  uint16_t size = (uint16_t)(uintptr_t)context;
+  uint32_t sum = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    sum += sli_cpc_get_crc_sw(data_buffer, size);
+  }
+
+  bench_sink = sum;
+}
+
+static void bench_crc_validate(void *context, uint64_t iterations)
+{
+  uint16_t size = (uint16_t)(uintptr_t)context;
+  uint16_t crc = sli_cpc_get_crc_sw(data_buffer, size);
+  uint32_t sum = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    sum += sli_cpc_validate_crc_sw(data_buffer, size, crc);
+  }
+
+  bench_sink = sum;
+}
+
+static uint8_t headers[HEADER_VARIANTS][SLI_CPC_HDLC_HEADER_RAW_SIZE];
+
+static void bench_hdlc_parse_header(void *context, uint64_t iterations)
+{
+  uint32_t sum = 0;
+
+  (void)context;
+
+  // What the core reads from every received header
+  for (uint64_t i = 0; i < iterations; i++) {
+    const uint8_t *header = headers[i % HEADER_VARIANTS];
+    uint8_t control = hdlc_get_control(header);
+
+    sum += hdlc_get_flag(header);
+    sum += hdlc_get_address(header);
+    sum += hdlc_get_length(header);
+    sum += hdlc_get_hcs(header);
+    sum += hdlc_get_frame_type(control);
+    sum += hdlc_get_seq(control);
+    sum += hdlc_get_ack(control);
+    sum += hdlc_is_poll_final(control);
+  }
+
+  bench_sink = sum;
+}
+
+static void bench_hdlc_create_header(void *context, uint64_t iterations)
+{
+  bool compute_crc = context != NULL;
+  uint8_t header[SLI_CPC_HDLC_HEADER_RAW_SIZE];
+  uint32_t sum = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    hdlc_create_header(header,
+                       (uint8_t)i,
+                       (uint16_t)(i & 0xFFF),
+                       hdlc_create_control_data((uint8_t)(i & 7), (uint8_t)((i >> 3) & 7), false),
+                       compute_crc);
+    sum += header[SLI_CPC_HDLC_HEADER_RAW_SIZE - 1];
+  }
+
+  bench_sink = sum;
+}
+
+// -----------------------------------------------------------------------------
+// Security
+
+#if defined(ENABLE_ENCRYPTION)
+/*
+ * The security layer authenticates the header and encrypts the payload with
+ * AES-256-GCM, an 8-byte tag and a 12-byte nonce. The session is not set up
+ * here: the cost of security_encrypt() and security_decrypt() is this
+ * operation, the nonce update around it is a few stores.
+ */
+typedef struct {
+  mbedtls_gcm_context gcm;
+  size_t size;
+  uint8_t nonce[12];
+  uint8_t header[SLI_CPC_HDLC_HEADER_RAW_SIZE];
+  uint8_t tag[GCM_TAG_SIZE];
+  uint8_t ciphertext[UART_DEFRAMER_MAX_FRAME_SIZE];
+  uint8_t plaintext[UART_DEFRAMER_MAX_FRAME_SIZE];
+} gcm_context_t;
+
+static gcm_context_t gcm;
+
+static void gcm_setup(size_t size)
+{
+  static const uint8_t key[GCM_KEY_SIZE] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF };
+  int ret;
+
+  mbedtls_gcm_init(&gcm.gcm);
+  ret = mbedtls_gcm_setkey(&gcm.gcm, MBEDTLS_CIPHER_ID_AES, key, GCM_KEY_SIZE * 8);
+  FATAL_ON(ret != 0);
+
+  gcm.size = size;
+  hdlc_create_header(gcm.header, SL_CPC_ENDPOINT_USER_ID_0, (uint16_t)(size + GCM_TAG_SIZE + 2), 0, true);
+
+  // The reference frame for the decryption
+  ret = mbedtls_gcm_crypt_and_tag(&gcm.gcm, MBEDTLS_GCM_ENCRYPT, size,
+                                  gcm.nonce, sizeof(gcm.nonce),
+                                  gcm.header, sizeof(gcm.header),
+                                  data_buffer, gcm.ciphertext,
+                                  GCM_TAG_SIZE, gcm.tag);
+  FATAL_ON(ret != 0);
+}
+
+static void bench_gcm_encrypt(void *context, uint64_t iterations)
+{
+  uint8_t tag[GCM_TAG_SIZE];
+
+  (void)context;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    // The frame counter is part of the nonce, it changes with every frame
+    gcm.nonce[8] = (uint8_t)i;
+    mbedtls_gcm_crypt_and_tag(&gcm.gcm, MBEDTLS_GCM_ENCRYPT, gcm.size,
+                              gcm.nonce, sizeof(gcm.nonce),
+                              gcm.header, sizeof(gcm.header),
+                              data_buffer, gcm.plaintext,
+                              GCM_TAG_SIZE, tag);
+  }
+  gcm.nonce[8] = 0;
+
+  bench_sink = tag[0];
+}
+
+static void bench_gcm_decrypt(void *context, uint64_t iterations)
+{
+  uint32_t failures = 0;
+
+  (void)context;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    failures += mbedtls_gcm_auth_decrypt(&gcm.gcm, gcm.size,
+                                         gcm.nonce, sizeof(gcm.nonce),
+                                         gcm.header, sizeof(gcm.header),
+                                         gcm.tag, GCM_TAG_SIZE,
+                                         gcm.ciphertext, gcm.plaintext) != 0;
+  }
+
+  FATAL_ON(failures != 0);
+  bench_sink = gcm.plaintext[0];
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Lists
+
+typedef struct {
+  sl_slist_node_t node;
+  uint32_t value;
+} list_item_t;
+
+static list_item_t list_items[SLIST_MAX_NODES];
+
+static void bench_slist_push_pop(void *context, uint64_t iterations)
+{
+  size_t length = (size_t)(uintptr_t)context;
+  sl_slist_node_t *head;
+  uint64_t done = 0;
+
+  sl_slist_init(&head);
+
+  // One operation is the push and the pop of one node
+  while (done < iterations) {
+    for (size_t i = 0; i < length; i++) {
+      sl_slist_push(&head, &list_items[i].node);
+    }
+    for (size_t i = 0; i < length; i++) {
+      bench_sink = ((list_item_t *)(void *)sl_slist_pop(&head))->value;
+    }
+    done += length;
+  }
+}
+
+static void bench_slist_push_back(void *context, uint64_t iterations)
+{
+  size_t length = (size_t)(uintptr_t)context;
+  sl_slist_node_t *head;
+  uint64_t done = 0;
+
+  // One operation is the push of one node at the back of a list growing to 'length'
+  while (done < iterations) {
+    sl_slist_init(&head);
+    for (size_t i = 0; i < length; i++) {
+      sl_slist_push_back(&head, &list_items[i].node);
+    }
+    done += length;
+  }
+
+  bench_sink = sl_slist_len(&head);
+}
+
+static void bench_slist_len(void *context, uint64_t iterations)
+{
+  size_t length = (size_t)(uintptr_t)context;
+  sl_slist_node_t *head;
+  uint32_t sum = 0;
+
+  sl_slist_init(&head);
+  for (size_t i = 0; i < length; i++) {
+    sl_slist_push(&head, &list_items[i].node);
+  }
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    sum += sl_slist_len(&head);
+  }
+
+  bench_sink = sum;
+}
+
+// -----------------------------------------------------------------------------
+// Traces
+
+static void bench_trace(void *context, uint64_t iterations)
+{
+  (void)context;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    TRACE_CORE("Endpoint #%d: received %u bytes, seq %u", SL_CPC_ENDPOINT_USER_ID_0, (unsigned)(i & 0xFFF), (unsigned)(i & 7));
+  }
+}
+
+static void bench_trace_frame(void *context, uint64_t iterations)
+{
+  size_t size = (size_t)(uintptr_t)context;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    TRACE_FRAME("Core : received frame : ", data_buffer, size);
+  }
+}
+
+/*
+ * The file logger is the one used in production, its thread writes the traces
+ * to a temporary folder on a tmpfs. The folder is removed at the end. The
+ * traces are produced faster than the thread writes them, the logger reports
+ * the ones it drops and these are part of the measure, as they would be in
+ * CPCd under load.
+ */
+static void run_trace_benchmarks(void)
+{
+  static const size_t frame_sizes[] = { 16, 256 };
+  char folder[] = "/dev/shm/micro_bench.XXXXXX";
+  char pattern[sizeof(folder) + 8];
+  glob_t files;
+
+  if (bench_filter != NULL && strstr("trace trace_disabled trace_frame", bench_filter) == NULL) {
+    return;
+  }
+
+  bench_run("trace_disabled", 0, bench_trace, NULL);
+
+  if (mkdtemp(folder) == NULL) {
+    perror("mkdtemp");
+    return;
+  }
+
+  config.traces_folder = folder;
+  config.file_tracing = true;
+  config.enable_frame_trace = true;
+  init_file_logging();
+
+  bench_run("trace", 0, bench_trace, NULL);
+  for (size_t i = 0; i < sizeof(frame_sizes) / sizeof(frame_sizes[0]); i++) {
+    bench_run("trace_frame", frame_sizes[i], bench_trace_frame, (void *)(uintptr_t)frame_sizes[i]);
+  }
+
+  logging_kill();
+  config.file_tracing = false;
+  config.enable_frame_trace = false;
+
+  snprintf(pattern, sizeof(pattern), "%s/*", folder);
+  if (glob(pattern, 0, NULL, &files) == 0) {
+    for (size_t i = 0; i < files.gl_pathc; i++) {
+      unlink(files.gl_pathv[i]);
+    }
+    globfree(&files);
+  }
+  rmdir(folder);
+}
+
+// -----------------------------------------------------------------------------
+// UART deframer
+
+typedef struct {
+  uint8_t stream[DEFRAMER_STREAM_SIZE];
+  size_t stream_size;                 // Whole frames only, the stream is replayed in loop
+  size_t position;
+  uint64_t frames;
+} deframer_context_t;
+
+static deframer_context_t deframer;
+
+static void deframer_on_frame(const struct iovec *iov, int iov_count, const struct timespec *header_timestamp)
+{
+  (void)header_timestamp;
+
+  bench_sink = ((const uint8_t *)iov[iov_count - 1].iov_base)[0];
+  deframer.frames++;
+}
+
+/*
+ * Fill the stream with frames of 'payload_size' bytes, or with noise that has
+ * flags but no valid header when 'payload_size' is 0.
+ */
+static void deframer_setup(size_t payload_size)
+{
+  size_t frame_size = SLI_CPC_HDLC_HEADER_RAW_SIZE + payload_size + 2;
+
+  deframer.stream_size = 0;
+  deframer.position = 0;
+  deframer.frames = 0;
+
+  if (payload_size == 0) {
+    uint32_t state = 0x12345678;
+
+    for (size_t i = 0; i < DEFRAMER_STREAM_SIZE; i++) {
+      state = state * 1103515245u + 12345u;
+      deframer.stream[i] = (i % 64 == 0) ? SLI_CPC_HDLC_FLAG_VAL : (uint8_t)(state >> 16);
+    }
+    deframer.stream_size = DEFRAMER_STREAM_SIZE;
+  } else {
+    while (deframer.stream_size + frame_size <= DEFRAMER_STREAM_SIZE) {
+      uint8_t *frame = &deframer.stream[deframer.stream_size];
+
+      hdlc_create_header(frame, SL_CPC_ENDPOINT_USER_ID_0, (uint16_t)(payload_size + 2),
+                         hdlc_create_control_data(0, 0, false), true);
+      memcpy(&frame[SLI_CPC_HDLC_HEADER_RAW_SIZE], data_buffer, payload_size);
+      memset(&frame[SLI_CPC_HDLC_HEADER_RAW_SIZE + payload_size], 0, 2);
+      deframer.stream_size += frame_size;
+    }
+  }
+
+  uart_deframer_init(deframer_on_frame);
+}
+
+/*
+ * Feed the stream to the deframer in reads of DEFRAMER_CHUNK_SIZE bytes, copied
+ * to the ring as readv() does. One operation is one frame delimited, or one read
+ * for the noise.
+ */
+static void bench_uart_deframer(void *context, uint64_t iterations)
+{
+  bool noise = context != NULL;
+  struct timespec timestamp = { 0 };
+  uint64_t done = 0;
+
+  deframer.frames = 0;
+
+  while (done < iterations) {
+    struct iovec iov[2];
+    size_t length = DEFRAMER_CHUNK_SIZE;
+
+    uart_deframer_get_free_space(iov);
+
+    if (length > iov[0].iov_len) {
+      length = iov[0].iov_len;
+    }
+    if (length > deframer.stream_size - deframer.position) {
+      length = deframer.stream_size - deframer.position;
+    }
+
+    memcpy(iov[0].iov_base, &deframer.stream[deframer.position], length);
+    deframer.position = (deframer.position + length) % deframer.stream_size;
+
+    uart_deframer_commit(length, &timestamp);
+
+    done = noise ? done + 1 : deframer.frames;
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+  static const uint16_t crc_sizes[] = { 7, 64, 256, 1024, 4096 };
+  static const size_t payload_sizes[] = { 16, 256, 1024, 4087 };
+  static const size_t list_lengths[] = { 16, SLIST_MAX_NODES };
+
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [filter]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  bench_filter = argc == 2 ? argv[1] : NULL;
+
+  // The traces are off until the trace benchmarks, as in CPCd without tracing
+  logging_init();
+
+  for (size_t i = 0; i < sizeof(data_buffer); i++) {
+    data_buffer[i] = (uint8_t)(i * 31u + 7u);
+  }
+
+  for (size_t i = 0; i < HEADER_VARIANTS; i++) {
+    hdlc_create_header(headers[i], (uint8_t)i, (uint16_t)(i * 61u),
+                       hdlc_create_control_data((uint8_t)(i & 7), (uint8_t)((i >> 3) & 7), (i & 1) != 0), true);
+  }
+
+  for (size_t i = 0; i < SLIST_MAX_NODES; i++) {
+    list_items[i].value = (uint32_t)i;
+  }
+
+  for (size_t i = 0; i < sizeof(crc_sizes) / sizeof(crc_sizes[0]); i++) {
+    bench_run("sli_cpc_get_crc_sw", crc_sizes[i], bench_crc, (void *)(uintptr_t)crc_sizes[i]);
+  }
+  for (size_t i = 0; i < sizeof(crc_sizes) / sizeof(crc_sizes[0]); i++) {
+    bench_run("sli_cpc_validate_crc_sw", crc_sizes[i], bench_crc_validate, (void *)(uintptr_t)crc_sizes[i]);
+  }
+
+  bench_run("hdlc_parse_header", SLI_CPC_HDLC_HEADER_RAW_SIZE, bench_hdlc_parse_header, NULL);
+  bench_run("hdlc_create_header", SLI_CPC_HDLC_HEADER_RAW_SIZE, bench_hdlc_create_header, (void *)1);
+  bench_run("hdlc_create_header_no_crc", SLI_CPC_HDLC_HEADER_RAW_SIZE, bench_hdlc_create_header, NULL);
+
+#if defined(ENABLE_ENCRYPTION)
+  for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++) {
+    gcm_setup(payload_sizes[i]);
+    bench_run("gcm_encrypt", payload_sizes[i], bench_gcm_encrypt, NULL);
+    bench_run("gcm_decrypt", payload_sizes[i], bench_gcm_decrypt, NULL);
+    mbedtls_gcm_free(&gcm.gcm);
+  }
+#endif
+
+  for (size_t i = 0; i < sizeof(list_lengths) / sizeof(list_lengths[0]); i++) {
+    bench_run("sl_slist_push_pop", list_lengths[i], bench_slist_push_pop, (void *)(uintptr_t)list_lengths[i]);
+    bench_run("sl_slist_push_back", list_lengths[i], bench_slist_push_back, (void *)(uintptr_t)list_lengths[i]);
+    bench_run("sl_slist_len", list_lengths[i], bench_slist_len, (void *)(uintptr_t)list_lengths[i]);
+  }
+
+  for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++) {
+    deframer_setup(payload_sizes[i]);
+    bench_run("uart_deframer", SLI_CPC_HDLC_HEADER_RAW_SIZE + payload_sizes[i] + 2, bench_uart_deframer, NULL);
+  }
+  deframer_setup(0);
+  bench_run("uart_deframer_resync", DEFRAMER_CHUNK_SIZE, bench_uart_deframer, (void *)1);
+
+  run_trace_benchmarks();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,396 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Virtual Secondary over a PTY
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+// Runs the virtual secondary behind a pseudo-terminal. CPCd is started with
+// bus_type: UART and uart_device_file set to the path printed on startup (or
+// to the --link symlink), so the real UART driver is exercised.
+//
+// SIGUSR1 simulates an unexpected reset of the secondary.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "server_core/core/crc.h"
+#include "server_core/core/hdlc.h"
+
+#include "virtual_secondary.h"
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+static int fd_master = -1;
+
+// Bytes received from the host, not yet delimited into frames
+static uint8_t rx_buffer[2 * VIRTUAL_SECONDARY_MAX_FRAME_SIZE];
+static size_t rx_count;
+
+// Bytes for the host the PTY did not accept yet
+static uint8_t tx_buffer[OUTPUT_BUFFER_SIZE];
+static size_t tx_count;
+
+static volatile sig_atomic_t reset_requested;
+static volatile sig_atomic_t exit_requested;
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --link PATH              create a symlink to the PTY at PATH\n"
+          "  --baudrate BPS           bus speed reported to CPCd (115200)\n"
+          "  --hardflow               report UART flow control in the capabilities\n"
+          "  --link-rate BPS          rate of the link, 10 bits per byte, 0 for no limit (baudrate)\n"
+          "  --latency-us US          propagation delay in each direction (0)\n"
+          "  --bit-error-rate P       probability for each bit to be flipped (0)\n"
+          "  --processing-delay-us US time spent by the secondary on each frame (0)\n"
+          "  --retransmit-ms MS       retransmit timeout of the secondary (100)\n"
+          "  --tx-window N            frames sent before waiting for an ack, 1 to 7 (1)\n"
+          "  --rx-capability N        largest payload the host may send (%u)\n"
+          "  --echo EP                first echo endpoint, 0 to disable (%u)\n"
+          "  --echo-count N           consecutive echo endpoints (1)\n"
+          "  --sink EP                sink endpoint, 0 to disable (%u)\n"
+          "  --source EP              source endpoint, 0 to disable (%u)\n"
+          "  --verbose                trace the protocol on stderr\n",
+          name,
+          SL_CPC_READ_MINIMUM_SIZE,
+          SL_CPC_ENDPOINT_USER_ID_0,
+          SL_CPC_ENDPOINT_USER_ID_0 + 1,
+          SL_CPC_ENDPOINT_USER_ID_0 + 2);
+  exit(EXIT_FAILURE);
+}
+
+static unsigned long parse_number(const char *name, const char *value, unsigned long max)
+{
+  char *end;
+  unsigned long number = strtoul(value, &end, 0);
+
+  if (*value == '\0' || *end != '\0' || number > max) {
+    fprintf(stderr, "invalid value for %s: %s\n", name, value);
+    exit(EXIT_FAILURE);
+  }
+
+  return number;
+}
+
+static void parse_arguments(int argc, char *argv[], virtual_secondary_config_t *config, const char **link_path)
+{
+  static const struct option options[] = {
+    { "link", required_argument, NULL, 'l' },
+    { "baudrate", required_argument, NULL, 'b' },
+    { "hardflow", no_argument, NULL, 'f' },
+    { "link-rate", required_argument, NULL, 'r' },
+    { "latency-us", required_argument, NULL, 'L' },
+    { "bit-error-rate", required_argument, NULL, 'e' },
+    { "processing-delay-us", required_argument, NULL, 'p' },
+    { "retransmit-ms", required_argument, NULL, 't' },
+    { "tx-window", required_argument, NULL, 'w' },
+    { "rx-capability", required_argument, NULL, 'c' },
+    { "echo", required_argument, NULL, 'E' },
+    { "echo-count", required_argument, NULL, 'n' },
+    { "sink", required_argument, NULL, 'S' },
+    { "source", required_argument, NULL, 'O' },
+    { "verbose", no_argument, NULL, 'v' },
+    { "help", no_argument, NULL, 'h' },
+    { 0, 0, 0, 0 }
+  };
+  bool link_rate_set = false;
+  int opt;
+
+  while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (opt) {
+      case 'l':
+        *link_path = optarg;
+        break;
+      case 'b':
+        config->bus_speed = (uint32_t)parse_number("--baudrate", optarg, UINT32_MAX);
+        break;
+      case 'f':
+        config->uart_hardflow = true;
+        break;
+      case 'r':
+        config->link_rate = (uint32_t)parse_number("--link-rate", optarg, UINT32_MAX);
+        link_rate_set = true;
+        break;
+      case 'L':
+        config->latency_us = (uint32_t)parse_number("--latency-us", optarg, UINT32_MAX);
+        break;
+      case 'e':
+      {
+        char *end;
+        config->bit_error_rate = strtod(optarg, &end);
+        if (*end != '\0' || config->bit_error_rate < 0.0 || config->bit_error_rate > 1.0) {
+          fprintf(stderr, "invalid value for --bit-error-rate: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      }
+      case 'p':
+        config->processing_delay_us = (uint32_t)parse_number("--processing-delay-us", optarg, UINT32_MAX);
+        break;
+      case 't':
+        config->retransmit_timeout_ms = (uint32_t)parse_number("--retransmit-ms", optarg, UINT32_MAX);
+        break;
+      case 'w':
+        config->tx_window = (uint8_t)parse_number("--tx-window", optarg, 7);
+        break;
+      case 'c':
+        config->rx_capability = (uint16_t)parse_number("--rx-capability", optarg, SL_CPC_READ_MINIMUM_SIZE);
+        break;
+      case 'E':
+        config->echo_endpoint = (uint8_t)parse_number("--echo", optarg, UINT8_MAX);
+        break;
+      case 'n':
+        config->echo_count = (uint8_t)parse_number("--echo-count", optarg, UINT8_MAX);
+        break;
+      case 'S':
+        config->sink_endpoint = (uint8_t)parse_number("--sink", optarg, UINT8_MAX);
+        break;
+      case 'O':
+        config->source_endpoint = (uint8_t)parse_number("--source", optarg, UINT8_MAX);
+        break;
+      case 'v':
+        config->verbose = true;
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        break;
+    }
+  }
+
+  if (optind != argc) {
+    usage(argv[0]);
+  }
+
+  if (!link_rate_set) {
+    config->link_rate = config->bus_speed;
+  }
+}
+
+static void on_signal(int signal)
+{
+  if (signal == SIGUSR1) {
+    reset_requested = 1;
+  } else {
+    exit_requested = 1;
+  }
+}
+
+static void flush_output(void)
+{
+  while (tx_count > 0) {
+    ssize_t written = write(fd_master, tx_buffer, tx_count);
+
+    if (written < 0) {
+      if (errno != EAGAIN && errno != EIO) {
+        perror("write");
+        exit(EXIT_FAILURE);
+      }
+      // EIO: nobody has the PTY open, the bytes wait for the next host
+      return;
+    }
+
+    tx_count -= (size_t)written;
+    memmove(tx_buffer, &tx_buffer[written], tx_count);
+  }
+}
+
+static void output_frame(const uint8_t *frame, size_t length)
+{
+  if (length > sizeof(tx_buffer) - tx_count) {
+    // The host does not read, the frame is lost as it would be on a real bus
+    return;
+  }
+
+  memcpy(&tx_buffer[tx_count], frame, length);
+  tx_count += length;
+
+  flush_output();
+}
+
+/*
+ * Delimit the frames in the received bytes, same as the UART driver of CPCd:
+ * look for a flag followed by a valid header, then wait for the payload.
+ */
+static void delimit_frames(void)
+{
+  size_t offset = 0;
+
+  while (rx_count - offset >= SLI_CPC_HDLC_HEADER_RAW_SIZE) {
+    const uint8_t *header = &rx_buffer[offset];
+    size_t frame_length;
+
+    if (hdlc_get_flag(header) != SLI_CPC_HDLC_FLAG_VAL
+        || !sli_cpc_validate_crc_sw(header, SLI_CPC_HDLC_HEADER_SIZE, hdlc_get_hcs(header))
+        || hdlc_get_length(header) > VIRTUAL_SECONDARY_MAX_PAYLOAD_SIZE + SLI_CPC_HDLC_FCS_SIZE) {
+      offset++;
+      continue;
+    }
+
+    frame_length = SLI_CPC_HDLC_HEADER_RAW_SIZE + hdlc_get_length(header);
+    if (rx_count - offset < frame_length) {
+      break;
+    }
+
+    virtual_secondary_receive(header, frame_length);
+    offset += frame_length;
+  }
+
+  rx_count -= offset;
+  memmove(rx_buffer, &rx_buffer[offset], rx_count);
+}
+
+static void read_input(void)
+{
+  ssize_t count = read(fd_master, &rx_buffer[rx_count], sizeof(rx_buffer) - rx_count);
+
+  if (count < 0) {
+    if (errno == EAGAIN || errno == EIO) {
+      // EIO: the host closed the PTY, wait for it to come back
+      return;
+    }
+    perror("read");
+    exit(EXIT_FAILURE);
+  }
+
+  rx_count += (size_t)count;
+  delimit_frames();
+}
+
+static int open_pty(const char *link_path)
+{
+  struct termios tty;
+  const char *slave_name;
+  int fd_slave;
+
+  fd_master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd_master < 0 || grantpt(fd_master) != 0 || unlockpt(fd_master) != 0) {
+    perror("posix_openpt");
+    exit(EXIT_FAILURE);
+  }
+
+  slave_name = ptsname(fd_master);
+  if (slave_name == NULL) {
+    perror("ptsname");
+    exit(EXIT_FAILURE);
+  }
+
+  // Keep the slave open, so that the master does not report EIO while CPCd restarts
+  fd_slave = open(slave_name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (fd_slave < 0) {
+    perror("open");
+    exit(EXIT_FAILURE);
+  }
+
+  if (tcgetattr(fd_slave, &tty) == 0) {
+    cfmakeraw(&tty);
+    tcsetattr(fd_slave, TCSANOW, &tty);
+  }
+
+  if (link_path != NULL) {
+    unlink(link_path);
+    if (symlink(slave_name, link_path) != 0) {
+      perror("symlink");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  printf("%s\n", link_path != NULL ? link_path : slave_name);
+  fflush(stdout);
+
+  return fd_slave;
+}
+
+int main(int argc, char *argv[])
+{
+  virtual_secondary_config_t config;
+  const char *link_path = NULL;
+  struct sigaction action;
+  int fd_slave;
+
+  virtual_secondary_default_config(&config);
+  parse_arguments(argc, argv, &config, &link_path);
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = on_signal;
+  sigaction(SIGUSR1, &action, NULL);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  fd_slave = open_pty(link_path);
+
+  virtual_secondary_init(&config, output_frame);
+
+  while (!exit_requested) {
+    struct pollfd fds = { .fd = fd_master, .events = POLLIN };
+    struct timespec timeout;
+    struct timespec *timeout_ptr = NULL;
+    uint64_t deadline = virtual_secondary_next_deadline();
+    int ret;
+
+    if (tx_count > 0) {
+      fds.events |= POLLOUT;
+    }
+
+    if (deadline != 0) {
+      uint64_t now = virtual_secondary_now();
+      uint64_t wait = deadline > now ? deadline - now : 0;
+
+      timeout.tv_sec = (time_t)(wait / 1000000000ULL);
+      timeout.tv_nsec = (long)(wait % 1000000000ULL);
+      timeout_ptr = &timeout;
+    }
+
+    ret = ppoll(&fds, 1, timeout_ptr, NULL);
+    if (ret < 0 && errno != EINTR) {
+      perror("ppoll");
+      exit(EXIT_FAILURE);
+    }
+
+    if (reset_requested) {
+      reset_requested = 0;
+      virtual_secondary_reset();
+    }
+
+    if (ret > 0 && (fds.revents & POLLIN)) {
+      read_input();
+    }
+
+    if (ret > 0 && (fds.revents & POLLOUT)) {
+      flush_output();
+    }
+
+    virtual_secondary_process(virtual_secondary_now());
+  }
+
+  if (link_path != NULL) {
+    unlink(link_path);
+  }
+
+  close(fd_slave);
+  close(fd_master);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,1040 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Virtual Secondary
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "version.h"
+#include "sl_cpc.h"
+#include "misc/endianess.h"
+#include "server_core/core/crc.h"
+#include "server_core/core/hdlc.h"
+#include "server_core/system_endpoint/system.h"
+
+#include "virtual_secondary.h"
+
+#define SYSTEM_CMD_HEADER_SIZE     4U
+#define PROPERTY_ID_SIZE           4U
+#define DEFAULT_SOURCE_FRAME_SIZE  64U
+#define BITS_PER_BYTE_ON_LINK      10U // 8N1, as on a UART
+
+#define TRACE(...)                          \
+  do {                                      \
+    if (vs_config.verbose) {                \
+      fprintf(stderr, "[vsec] " __VA_ARGS__); \
+      fprintf(stderr, "\n");                \
+    }                                       \
+  } while (0)
+
+typedef enum {
+  ROLE_NONE,
+  ROLE_SYSTEM,
+  ROLE_ECHO,
+  ROLE_SINK,
+  ROLE_SOURCE
+} endpoint_role_t;
+
+typedef struct pending_frame {
+  struct pending_frame *next;
+  uint8_t seq;
+  bool poll_final;
+  uint16_t length;
+  uint8_t payload[];
+} pending_frame_t;
+
+typedef struct {
+  pending_frame_t *head;
+  pending_frame_t **tail;
+  size_t count;
+} frame_queue_t;
+
+typedef struct {
+  endpoint_role_t role;
+  uint8_t id;
+  uint8_t seq;                   // Sequence number of the next new frame
+  uint8_t ack;                   // Sequence number expected from the host
+  bool ack_pending;
+  uint64_t acked_tx_complete;    // Tx complete time of the host frame being acknowledged, 0 when none
+  frame_queue_t tx_queue;        // Not sent yet
+  frame_queue_t unacked;         // Sent, waiting for an acknowledgement
+  uint64_t retransmit_deadline;
+  uint32_t source_remaining;
+  uint16_t source_size;
+  uint32_t source_index;
+} endpoint_t;
+
+typedef struct link_frame {
+  struct link_frame *next;
+  uint64_t due;
+  size_t length;
+  uint8_t data[];
+} link_frame_t;
+
+typedef struct {
+  link_frame_t *head;
+  link_frame_t **tail;
+  uint64_t busy_until;           // End of the serialization of the last frame
+} link_t;
+
+static virtual_secondary_config_t vs_config;
+static virtual_secondary_output_t vs_output;
+static virtual_secondary_rtt_t vs_rtt;
+
+static endpoint_t endpoints[SL_CPC_ENDPOINT_COUNT];
+
+static link_t to_secondary;
+static link_t to_host;
+static uint64_t processing_done;  // 0 when the head of to_secondary is not being processed
+static uint64_t processed_tx_complete;  // Tx complete time of the frame being processed
+
+// Reported in PROP_CORE_DEBUG_COUNTERS for the --print-stats of CPCd, the
+// counters of core_debug_counters_t that the secondary does not keep are 0
+static struct {
+  uint32_t rxd_frame;
+  uint32_t rxd_valid_iframe;
+  uint32_t rxd_valid_uframe;
+  uint32_t rxd_valid_sframe;
+  uint32_t txd_reject_destination_unreachable;
+  uint32_t retxd_data_frame;
+  uint32_t invalid_header_checksum;
+  uint32_t invalid_payload_checksum;
+} counters;
+static uint64_t cpu_busy_until;
+
+static uint32_t reboot_mode = REBOOT_APPLICATION;
+static bool reboot_pending;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+static uint64_t bits_until_error;
+
+static void *vs_alloc(size_t size)
+{
+  void *ptr = calloc(1, size);
+
+  if (ptr == NULL) {
+    fprintf(stderr, "virtual secondary: out of memory\n");
+    abort();
+  }
+
+  return ptr;
+}
+
+uint64_t virtual_secondary_now(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// -----------------------------------------------------------------------------
+// Link model
+
+static double random_uniform(void)
+{
+  // xorshift64*, the quality is plenty for error injection
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+
+  return (double)((rng_state * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+/*
+ * The distance between two bit errors follows a geometric distribution, draw it
+ * instead of a random number per bit.
+ */
+static uint64_t draw_bits_until_error(void)
+{
+  double u = random_uniform();
+
+  if (vs_config.bit_error_rate >= 1.0) {
+    return 0;
+  }
+
+  if (u <= 0.0) {
+    u = 1e-300;
+  }
+
+  return (uint64_t)(log(u) / log1p(-vs_config.bit_error_rate));
+}
+
+static void link_corrupt(uint8_t *data, size_t length)
+{
+  uint64_t bits = (uint64_t)length * 8;
+  uint64_t position = 0;
+
+  if (vs_config.bit_error_rate <= 0.0) {
+    return;
+  }
+
+  while (bits_until_error < bits - position) {
+    position += bits_until_error;
+    data[position / 8] ^= (uint8_t)(1U << (position % 8));
+    position++;
+    bits_until_error = draw_bits_until_error();
+  }
+
+  bits_until_error -= bits - position;
+}
+
+static void link_init(link_t *link)
+{
+  link->head = NULL;
+  link->tail = &link->head;
+  link->busy_until = 0;
+}
+
+static void link_clear(link_t *link)
+{
+  while (link->head != NULL) {
+    link_frame_t *frame = link->head;
+    link->head = frame->next;
+    free(frame);
+  }
+
+  link_init(link);
+}
+
+static uint64_t link_push(link_t *link, const uint8_t *data, size_t length)
+{
+  link_frame_t *frame = vs_alloc(sizeof(link_frame_t) + length);
+  uint64_t now = virtual_secondary_now();
+  uint64_t start = link->busy_until > now ? link->busy_until : now;
+
+  memcpy(frame->data, data, length);
+  frame->length = length;
+
+  if (vs_config.link_rate != 0) {
+    start += (uint64_t)length * BITS_PER_BYTE_ON_LINK * 1000000000ULL / vs_config.link_rate;
+  }
+
+  link->busy_until = start;
+  frame->due = start + (uint64_t)vs_config.latency_us * 1000;
+
+  link_corrupt(frame->data, frame->length);
+
+  *link->tail = frame;
+  link->tail = &frame->next;
+
+  return start;
+}
+
+static link_frame_t *link_pop(link_t *link)
+{
+  link_frame_t *frame = link->head;
+
+  link->head = frame->next;
+  if (link->head == NULL) {
+    link->tail = &link->head;
+  }
+
+  return frame;
+}
+
+// -----------------------------------------------------------------------------
+// Frames sent to the host
+
+/*
+ * Returns the time the frame reaches the host.
+ */
+static uint64_t send_raw(uint8_t address, uint8_t control, const void *payload, uint16_t payload_length)
+{
+  uint8_t frame[VIRTUAL_SECONDARY_MAX_FRAME_SIZE];
+  size_t length = SLI_CPC_HDLC_HEADER_RAW_SIZE;
+
+  if (payload_length == 0) {
+    hdlc_create_header(frame, address, 0, control, true);
+  } else {
+    uint16_t fcs = cpu_to_le16(sli_cpc_get_crc_sw(payload, payload_length));
+
+    hdlc_create_header(frame, address, (uint16_t)(payload_length + SLI_CPC_HDLC_FCS_SIZE), control, true);
+    memcpy(&frame[length], payload, payload_length);
+    length += payload_length;
+    memcpy(&frame[length], &fcs, sizeof(fcs));
+    length += sizeof(fcs);
+  }
+
+  return link_push(&to_host, frame, length) + (uint64_t)vs_config.latency_us * 1000;
+}
+
+/*
+ * The acknowledgement of the last information frame of the host is on its
+ * way, report the round trip time the link gives it.
+ */
+static void report_rtt(endpoint_t *endpoint, uint64_t ack_arrival)
+{
+  if (endpoint->acked_tx_complete != 0 && vs_rtt != NULL) {
+    vs_rtt(endpoint->id, ack_arrival - endpoint->acked_tx_complete);
+  }
+  endpoint->acked_tx_complete = 0;
+}
+
+static void send_supervisory(endpoint_t *endpoint, uint8_t function, uint8_t ack, uint8_t reason)
+{
+  uint8_t control = hdlc_create_control_supervisory(ack, function);
+
+  if (function == SLI_CPC_HDLC_REJECT_SUPERVISORY_FUNCTION) {
+    TRACE("ep#%u: reject, reason %u", endpoint->id, reason);
+    send_raw(endpoint->id, control, &reason, sizeof(reason));
+  } else {
+    report_rtt(endpoint, send_raw(endpoint->id, control, NULL, 0));
+  }
+
+  endpoint->ack_pending = false;
+}
+
+static void send_unnumbered(uint8_t address, uint8_t type, const void *payload, uint16_t payload_length)
+{
+  send_raw(address, hdlc_create_control_unumbered(type), payload, payload_length);
+}
+
+static void send_information(endpoint_t *endpoint, const pending_frame_t *frame)
+{
+  uint8_t control = hdlc_create_control_data(frame->seq, endpoint->ack, frame->poll_final);
+
+  report_rtt(endpoint, send_raw(endpoint->id, control, frame->payload, frame->length));
+  endpoint->ack_pending = false;
+}
+
+// -----------------------------------------------------------------------------
+// Endpoints
+
+static void queue_init(frame_queue_t *queue)
+{
+  queue->head = NULL;
+  queue->tail = &queue->head;
+  queue->count = 0;
+}
+
+static void queue_push(frame_queue_t *queue, pending_frame_t *frame)
+{
+  frame->next = NULL;
+  *queue->tail = frame;
+  queue->tail = &frame->next;
+  queue->count++;
+}
+
+static pending_frame_t *queue_pop(frame_queue_t *queue)
+{
+  pending_frame_t *frame = queue->head;
+
+  if (frame != NULL) {
+    queue->head = frame->next;
+    if (queue->head == NULL) {
+      queue->tail = &queue->head;
+    }
+    queue->count--;
+  }
+
+  return frame;
+}
+
+static void queue_clear(frame_queue_t *queue)
+{
+  pending_frame_t *frame;
+
+  while ((frame = queue_pop(queue)) != NULL) {
+    free(frame);
+  }
+}
+
+static void endpoint_reset(endpoint_t *endpoint)
+{
+  queue_clear(&endpoint->tx_queue);
+  queue_clear(&endpoint->unacked);
+  endpoint->seq = 0;
+  endpoint->ack = 0;
+  endpoint->ack_pending = false;
+  endpoint->acked_tx_complete = 0;
+  endpoint->retransmit_deadline = 0;
+  endpoint->source_remaining = 0;
+  endpoint->source_index = 0;
+}
+
+static void endpoint_queue(endpoint_t *endpoint, const void *payload, uint16_t length, bool poll_final)
+{
+  pending_frame_t *frame = vs_alloc(sizeof(pending_frame_t) + length);
+
+  memcpy(frame->payload, payload, length);
+  frame->length = length;
+  frame->poll_final = poll_final;
+
+  queue_push(&endpoint->tx_queue, frame);
+}
+
+static void endpoint_queue_source_frame(endpoint_t *endpoint)
+{
+  pending_frame_t *frame = vs_alloc(sizeof(pending_frame_t) + endpoint->source_size);
+  uint32_t index = cpu_to_le32(endpoint->source_index);
+
+  for (uint16_t i = 0; i < endpoint->source_size; i++) {
+    frame->payload[i] = (uint8_t)i;
+  }
+  memcpy(frame->payload, &index, endpoint->source_size < sizeof(index) ? endpoint->source_size : sizeof(index));
+  frame->length = endpoint->source_size;
+
+  endpoint->source_index++;
+  endpoint->source_remaining--;
+
+  queue_push(&endpoint->tx_queue, frame);
+}
+
+static void restart_retransmit_timer(endpoint_t *endpoint)
+{
+  if (endpoint->unacked.count == 0) {
+    endpoint->retransmit_deadline = 0;
+  } else {
+    endpoint->retransmit_deadline = virtual_secondary_now()
+                                    + (uint64_t)vs_config.retransmit_timeout_ms * 1000000ULL;
+  }
+}
+
+/*
+ * Send what the window allows. The acknowledgement travels with the first
+ * information frame, an empty supervisory frame is only sent when there is
+ * nothing else to send.
+ */
+static void endpoint_flush(endpoint_t *endpoint)
+{
+  while (endpoint->unacked.count < vs_config.tx_window) {
+    pending_frame_t *frame;
+
+    if (endpoint->tx_queue.head == NULL && endpoint->source_remaining > 0) {
+      endpoint_queue_source_frame(endpoint);
+    }
+
+    frame = queue_pop(&endpoint->tx_queue);
+    if (frame == NULL) {
+      break;
+    }
+
+    frame->seq = endpoint->seq;
+    endpoint->seq = (uint8_t)((endpoint->seq + 1) % 8);
+
+    send_information(endpoint, frame);
+    queue_push(&endpoint->unacked, frame);
+
+    if (endpoint->unacked.count == 1) {
+      restart_retransmit_timer(endpoint);
+    }
+  }
+
+  if (endpoint->ack_pending) {
+    send_supervisory(endpoint, SLI_CPC_HDLC_ACK_SUPERVISORY_FUNCTION, endpoint->ack, 0);
+  }
+}
+
+static void endpoint_retransmit(endpoint_t *endpoint)
+{
+  TRACE("ep#%u: retransmitting %zu frame(s)", endpoint->id, endpoint->unacked.count);
+  counters.retxd_data_frame += (uint32_t)endpoint->unacked.count;
+
+  for (pending_frame_t *frame = endpoint->unacked.head; frame != NULL; frame = frame->next) {
+    send_information(endpoint, frame);
+  }
+
+  restart_retransmit_timer(endpoint);
+}
+
+static void endpoint_process_ack(endpoint_t *endpoint, uint8_t ack)
+{
+  uint8_t acked;
+
+  if (endpoint->unacked.head == NULL) {
+    return;
+  }
+
+  acked = (uint8_t)((ack - endpoint->unacked.head->seq + 8) % 8);
+  if (acked == 0 || acked > endpoint->unacked.count) {
+    return;
+  }
+
+  while (acked-- > 0) {
+    free(queue_pop(&endpoint->unacked));
+  }
+
+  restart_retransmit_timer(endpoint);
+}
+
+// -----------------------------------------------------------------------------
+// System endpoint
+
+static size_t put_u32(uint8_t *buffer, uint32_t value)
+{
+  value = cpu_to_le32(value);
+  memcpy(buffer, &value, sizeof(value));
+
+  return sizeof(value);
+}
+
+static uint32_t get_u32(const uint8_t *buffer)
+{
+  uint32_t value;
+
+  memcpy(&value, buffer, sizeof(value));
+
+  return le32_to_cpu(value);
+}
+
+static void system_reply(uint8_t command_id, uint8_t command_seq, const uint8_t *payload, uint16_t length, bool is_uframe)
+{
+  uint8_t reply[SYSTEM_CMD_HEADER_SIZE + VIRTUAL_SECONDARY_MAX_PAYLOAD_SIZE];
+  uint16_t length_le = cpu_to_le16(length);
+
+  reply[0] = command_id;
+  reply[1] = command_seq;
+  memcpy(&reply[2], &length_le, sizeof(length_le));
+  memcpy(&reply[SYSTEM_CMD_HEADER_SIZE], payload, length);
+
+  if (is_uframe) {
+    send_unnumbered(SL_CPC_ENDPOINT_SYSTEM,
+                    SLI_CPC_HDLC_CONTROL_UNNUMBERED_TYPE_POLL_FINAL,
+                    reply,
+                    (uint16_t)(SYSTEM_CMD_HEADER_SIZE + length));
+  } else {
+    endpoint_queue(&endpoints[SL_CPC_ENDPOINT_SYSTEM], reply, (uint16_t)(SYSTEM_CMD_HEADER_SIZE + length), true);
+  }
+}
+
+static cpc_endpoint_state_t endpoint_state(uint8_t id)
+{
+  return endpoints[id].role == ROLE_NONE ? SL_CPC_STATE_CLOSED : SL_CPC_STATE_OPEN;
+}
+
+/*
+ * Write the value of a property after its id, returns the size of the id and
+ * value. An unknown property is answered with PROP_LAST_STATUS.
+ */
+static uint16_t property_get(uint32_t property_id, uint8_t *out)
+{
+  size_t length = PROPERTY_ID_SIZE;
+
+  switch (property_id) {
+    case PROP_LAST_STATUS:
+      length += put_u32(&out[length], STATUS_OK);
+      break;
+
+    case PROP_PROTOCOL_VERSION:
+      out[length++] = PROTOCOL_VERSION;
+      break;
+
+    case PROP_CAPABILITIES:
+      length += put_u32(&out[length], vs_config.uart_hardflow ? CPC_CAPABILITIES_UART_FLOW_CONTROL_MASK : 0);
+      break;
+
+    case PROP_SECONDARY_CPC_VERSION:
+      length += put_u32(&out[length], PROJECT_VER_MAJOR);
+      length += put_u32(&out[length], PROJECT_VER_MINOR);
+      length += put_u32(&out[length], PROJECT_VER_PATCH);
+      break;
+
+    case PROP_SECONDARY_APP_VERSION:
+      memcpy(&out[length], PROJECT_VER, sizeof(PROJECT_VER));
+      length += sizeof(PROJECT_VER);
+      break;
+
+    case PROP_RX_CAPABILITY:
+    {
+      uint16_t rx_capability = cpu_to_le16(vs_config.rx_capability);
+      memcpy(&out[length], &rx_capability, sizeof(rx_capability));
+      length += sizeof(rx_capability);
+      break;
+    }
+
+    case PROP_BUS_SPEED_VALUE:
+      length += put_u32(&out[length], vs_config.bus_speed);
+      break;
+
+    case PROP_BOOTLOADER_REBOOT_MODE:
+      length += put_u32(&out[length], reboot_mode);
+      break;
+
+    case PROP_CORE_DEBUG_COUNTERS:
+      length += put_u32(&out[length], 0);   // endpoint_opened
+      length += put_u32(&out[length], 0);   // endpoint_closed
+      length += put_u32(&out[length], counters.rxd_frame);
+      length += put_u32(&out[length], counters.rxd_valid_iframe);
+      length += put_u32(&out[length], counters.rxd_valid_uframe);
+      length += put_u32(&out[length], counters.rxd_valid_sframe);
+      length += put_u32(&out[length], 0);   // rxd_data_frame_dropped
+      length += put_u32(&out[length], counters.txd_reject_destination_unreachable);
+      length += put_u32(&out[length], 0);   // txd_reject_error_fault
+      length += put_u32(&out[length], 0);   // txd_completed
+      length += put_u32(&out[length], counters.retxd_data_frame);
+      length += put_u32(&out[length], 0);   // driver_error
+      length += put_u32(&out[length], 0);   // driver_packet_dropped
+      length += put_u32(&out[length], counters.invalid_header_checksum);
+      length += put_u32(&out[length], counters.invalid_payload_checksum);
+      break;
+
+    case PROP_ENDPOINT_STATES:
+      for (size_t i = 0; i < SL_CPC_ENDPOINT_COUNT; i += 2) {
+        out[length++] = (uint8_t)(endpoint_state((uint8_t)i) | (endpoint_state((uint8_t)(i + 1)) << 4));
+      }
+      break;
+
+    default:
+      if (property_id >= PROP_ENDPOINT_STATE_0 && property_id <= PROP_ENDPOINT_STATE_255) {
+        out[length++] = (uint8_t)endpoint_state(PROPERTY_ID_TO_EP_ID(property_id));
+      } else if (property_id >= PROP_ENDPOINT_ENCRYPTION && property_id <= EP_ID_TO_PROPERTY_ENCRYPTION(255)) {
+        out[length++] = false;
+      } else {
+        TRACE("property 0x%x not found", property_id);
+        put_u32(out, PROP_LAST_STATUS);
+        length += put_u32(&out[length], STATUS_PROP_NOT_FOUND);
+        return (uint16_t)length;
+      }
+      break;
+  }
+
+  put_u32(out, property_id);
+
+  return (uint16_t)length;
+}
+
+static uint16_t property_set(uint32_t property_id, const uint8_t *value, size_t value_length, uint8_t *out)
+{
+  if (property_id == PROP_BOOTLOADER_REBOOT_MODE && value_length == sizeof(uint32_t)) {
+    reboot_mode = get_u32(value);
+  } else if (property_id >= PROP_ENDPOINT_STATE_1 && property_id <= PROP_ENDPOINT_STATE_255 && value_length >= 1) {
+    // The host closed the endpoint. The application opens it again right away
+    uint8_t id = PROPERTY_ID_TO_EP_ID(property_id);
+
+    TRACE("ep#%u: closed by the host", id);
+    endpoint_reset(&endpoints[id]);
+  }
+
+  return property_get(property_id, out);
+}
+
+static void reboot(void)
+{
+  uint8_t payload[PROPERTY_ID_SIZE + sizeof(uint32_t)];
+
+  TRACE("rebooting");
+
+  for (size_t i = 0; i < SL_CPC_ENDPOINT_COUNT; i++) {
+    endpoint_reset(&endpoints[i]);
+  }
+
+  put_u32(payload, PROP_LAST_STATUS);
+  put_u32(&payload[PROPERTY_ID_SIZE], STATUS_RESET_SOFTWARE);
+
+  {
+    uint8_t status[SYSTEM_CMD_HEADER_SIZE + sizeof(payload)];
+    uint16_t length_le = cpu_to_le16(sizeof(payload));
+
+    status[0] = CMD_SYSTEM_PROP_VALUE_IS;
+    status[1] = 0;
+    memcpy(&status[2], &length_le, sizeof(length_le));
+    memcpy(&status[SYSTEM_CMD_HEADER_SIZE], payload, sizeof(payload));
+
+    send_unnumbered(SL_CPC_ENDPOINT_SYSTEM, SLI_CPC_HDLC_CONTROL_UNNUMBERED_TYPE_INFORMATION, status, sizeof(status));
+  }
+}
+
+static void system_process_command(const uint8_t *data, size_t length, bool is_uframe)
+{
+  uint8_t value[VIRTUAL_SECONDARY_MAX_PAYLOAD_SIZE - SYSTEM_CMD_HEADER_SIZE];
+  uint8_t command_id;
+  uint8_t command_seq;
+  uint16_t command_length;
+
+  if (length < SYSTEM_CMD_HEADER_SIZE) {
+    return;
+  }
+
+  command_id = data[0];
+  command_seq = data[1];
+  memcpy(&command_length, &data[2], sizeof(command_length));
+  command_length = le16_to_cpu(command_length);
+
+  if (SYSTEM_CMD_HEADER_SIZE + (size_t)command_length > length) {
+    TRACE("truncated system command");
+    return;
+  }
+
+  data += SYSTEM_CMD_HEADER_SIZE;
+
+  switch (command_id) {
+    case CMD_SYSTEM_NOOP:
+      system_reply(CMD_SYSTEM_NOOP, command_seq, NULL, 0, is_uframe);
+      break;
+
+    case CMD_SYSTEM_RESET:
+    {
+      uint8_t status[sizeof(uint32_t)];
+
+      put_u32(status, STATUS_OK);
+      system_reply(CMD_SYSTEM_RESET, command_seq, status, sizeof(status), is_uframe);
+      reboot_pending = true;
+      break;
+    }
+
+    case CMD_SYSTEM_PROP_VALUE_GET:
+      if (command_length >= PROPERTY_ID_SIZE) {
+        uint16_t value_length = property_get(get_u32(data), value);
+        system_reply(CMD_SYSTEM_PROP_VALUE_IS, command_seq, value, value_length, is_uframe);
+      }
+      break;
+
+    case CMD_SYSTEM_PROP_VALUE_SET:
+      if (command_length >= PROPERTY_ID_SIZE) {
+        uint16_t value_length = property_set(get_u32(data),
+                                             &data[PROPERTY_ID_SIZE],
+                                             command_length - PROPERTY_ID_SIZE,
+                                             value);
+        system_reply(CMD_SYSTEM_PROP_VALUE_IS, command_seq, value, value_length, is_uframe);
+      }
+      break;
+
+    default:
+      TRACE("unknown system command %u", command_id);
+      break;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Frames received from the host
+
+static void deliver(endpoint_t *endpoint, const uint8_t *payload, uint16_t length)
+{
+  switch (endpoint->role) {
+    case ROLE_SYSTEM:
+      system_process_command(payload, length, false);
+      break;
+
+    case ROLE_ECHO:
+      endpoint_queue(endpoint, payload, length, false);
+      break;
+
+    case ROLE_SOURCE:
+      if (length >= sizeof(uint32_t)) {
+        uint16_t size = DEFAULT_SOURCE_FRAME_SIZE;
+
+        if (length >= sizeof(uint32_t) + sizeof(uint16_t)) {
+          memcpy(&size, &payload[sizeof(uint32_t)], sizeof(size));
+          size = le16_to_cpu(size);
+        }
+
+        endpoint->source_remaining = get_u32(payload);
+        endpoint->source_size = size == 0 ? 1 : (size > SL_CPC_READ_MINIMUM_SIZE ? SL_CPC_READ_MINIMUM_SIZE : size);
+        endpoint->source_index = 0;
+      }
+      break;
+
+    case ROLE_SINK:
+    case ROLE_NONE:
+    default:
+      break;
+  }
+}
+
+static void process_information_frame(endpoint_t *endpoint, uint8_t control, const uint8_t *payload, uint16_t length)
+{
+  uint8_t seq = hdlc_get_seq(control);
+
+  endpoint_process_ack(endpoint, hdlc_get_ack(control));
+
+  endpoint->acked_tx_complete = processed_tx_complete;
+
+  if (seq == endpoint->ack) {
+    endpoint->ack = (uint8_t)((endpoint->ack + 1) % 8);
+    endpoint->ack_pending = true;
+    deliver(endpoint, payload, length);
+  } else {
+    // Duplicate or out of sequence, repeat the acknowledgement and let the host go back
+    endpoint->ack_pending = true;
+  }
+
+  endpoint_flush(endpoint);
+}
+
+static void process_supervisory_frame(endpoint_t *endpoint, uint8_t control, const uint8_t *payload, uint16_t length)
+{
+  endpoint_process_ack(endpoint, hdlc_get_ack(control));
+
+  if (hdlc_get_supervisory_function(control) == SLI_CPC_HDLC_REJECT_SUPERVISORY_FUNCTION && length >= 1) {
+    TRACE("ep#%u: rejected by the host, reason %u", endpoint->id, payload[0]);
+
+    switch (payload[0]) {
+      case HDLC_REJECT_CHECKSUM_MISMATCH:
+        endpoint_retransmit(endpoint);
+        break;
+      case HDLC_REJECT_UNREACHABLE_ENDPOINT:
+        endpoint_reset(endpoint);
+        break;
+      default:
+        break;
+    }
+  }
+
+  endpoint_flush(endpoint);
+}
+
+static void process_unnumbered_frame(endpoint_t *endpoint, uint8_t control, const uint8_t *payload, uint16_t length)
+{
+  if (endpoint->role != ROLE_SYSTEM) {
+    return;
+  }
+
+  switch (hdlc_get_unumbered_type(control)) {
+    case SLI_CPC_HDLC_CONTROL_UNNUMBERED_TYPE_RESET_SEQ:
+      TRACE("sequence numbers reset");
+      endpoint_reset(endpoint);
+      send_unnumbered(SL_CPC_ENDPOINT_SYSTEM, SLI_CPC_HDLC_CONTROL_UNNUMBERED_TYPE_ACKNOWLEDGE, NULL, 0);
+      break;
+
+    case SLI_CPC_HDLC_CONTROL_UNNUMBERED_TYPE_POLL_FINAL:
+      system_process_command(payload, length, true);
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void process_frame(const uint8_t *frame, size_t frame_length)
+{
+  const uint8_t *payload = &frame[SLI_CPC_HDLC_HEADER_RAW_SIZE];
+  uint16_t payload_length = 0;
+  uint16_t length;
+  uint8_t control;
+  uint8_t type;
+  endpoint_t *endpoint;
+
+  counters.rxd_frame++;
+
+  if (frame_length < SLI_CPC_HDLC_HEADER_RAW_SIZE
+      || hdlc_get_flag(frame) != SLI_CPC_HDLC_FLAG_VAL
+      || !sli_cpc_validate_crc_sw(frame, SLI_CPC_HDLC_HEADER_SIZE, hdlc_get_hcs(frame))) {
+    TRACE("invalid header, frame dropped");
+    counters.invalid_header_checksum++;
+    return;
+  }
+
+  length = hdlc_get_length(frame);
+  control = hdlc_get_control(frame);
+  type = hdlc_get_frame_type(control);
+  endpoint = &endpoints[hdlc_get_address(frame)];
+
+  if (SLI_CPC_HDLC_HEADER_RAW_SIZE + (size_t)length != frame_length || length == 1) {
+    TRACE("invalid length, frame dropped");
+    return;
+  }
+
+  if (endpoint->role == ROLE_NONE) {
+    if (type != SLI_CPC_HDLC_FRAME_TYPE_SUPERVISORY) {
+      send_supervisory(endpoint, SLI_CPC_HDLC_REJECT_SUPERVISORY_FUNCTION, 0, HDLC_REJECT_UNREACHABLE_ENDPOINT);
+      counters.txd_reject_destination_unreachable++;
+    }
+    return;
+  }
+
+  if (length >= SLI_CPC_HDLC_FCS_SIZE) {
+    payload_length = (uint16_t)(length - SLI_CPC_HDLC_FCS_SIZE);
+
+    if (!sli_cpc_validate_crc_sw(payload, payload_length, hdlc_get_fcs(payload, payload_length))) {
+      TRACE("ep#%u: invalid payload checksum", endpoint->id);
+      counters.invalid_payload_checksum++;
+      if (type == SLI_CPC_HDLC_FRAME_TYPE_INFORMATION) {
+        send_supervisory(endpoint, SLI_CPC_HDLC_REJECT_SUPERVISORY_FUNCTION, endpoint->ack, HDLC_REJECT_CHECKSUM_MISMATCH);
+      }
+      return;
+    }
+  }
+
+  switch (type) {
+    case SLI_CPC_HDLC_FRAME_TYPE_INFORMATION:
+      counters.rxd_valid_iframe++;
+      process_information_frame(endpoint, control, payload, payload_length);
+      break;
+    case SLI_CPC_HDLC_FRAME_TYPE_SUPERVISORY:
+      counters.rxd_valid_sframe++;
+      process_supervisory_frame(endpoint, control, payload, payload_length);
+      break;
+    case SLI_CPC_HDLC_FRAME_TYPE_UNNUMBERED:
+      counters.rxd_valid_uframe++;
+      process_unnumbered_frame(endpoint, control, payload, payload_length);
+      break;
+    default:
+      break;
+  }
+
+  if (reboot_pending) {
+    reboot_pending = false;
+    reboot();
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Public interface
+
+void virtual_secondary_default_config(virtual_secondary_config_t *config)
+{
+  memset(config, 0, sizeof(*config));
+
+  config->retransmit_timeout_ms = 100;
+  config->bus_speed = 115200;
+  config->rx_capability = SL_CPC_READ_MINIMUM_SIZE;
+  config->tx_window = 1;
+  config->echo_endpoint = SL_CPC_ENDPOINT_USER_ID_0;
+  config->echo_count = 1;
+  config->sink_endpoint = SL_CPC_ENDPOINT_USER_ID_0 + 1;
+  config->source_endpoint = SL_CPC_ENDPOINT_USER_ID_0 + 2;
+}
+
+void virtual_secondary_init(const virtual_secondary_config_t *config, virtual_secondary_output_t output)
+{
+  vs_config = *config;
+  vs_output = output;
+
+  if (vs_config.tx_window == 0 || vs_config.tx_window > 7) {
+    vs_config.tx_window = 1;
+  }
+
+  for (size_t i = 0; i < SL_CPC_ENDPOINT_COUNT; i++) {
+    endpoints[i].role = ROLE_NONE;
+    endpoints[i].id = (uint8_t)i;
+    queue_init(&endpoints[i].tx_queue);
+    queue_init(&endpoints[i].unacked);
+    endpoint_reset(&endpoints[i]);
+  }
+
+  endpoints[SL_CPC_ENDPOINT_SYSTEM].role = ROLE_SYSTEM;
+  if (vs_config.echo_endpoint != 0) {
+    for (size_t i = 0; i < vs_config.echo_count && vs_config.echo_endpoint + i < SL_CPC_ENDPOINT_COUNT; i++) {
+      endpoints[vs_config.echo_endpoint + i].role = ROLE_ECHO;
+    }
+  }
+  if (vs_config.sink_endpoint != 0) {
+    endpoints[vs_config.sink_endpoint].role = ROLE_SINK;
+  }
+  if (vs_config.source_endpoint != 0) {
+    endpoints[vs_config.source_endpoint].role = ROLE_SOURCE;
+  }
+
+  link_clear(&to_secondary);
+  link_clear(&to_host);
+  processing_done = 0;
+  cpu_busy_until = 0;
+  reboot_pending = false;
+  memset(&counters, 0, sizeof(counters));
+
+  rng_state ^= virtual_secondary_now();
+  bits_until_error = draw_bits_until_error();
+}
+
+void virtual_secondary_set_rtt_callback(virtual_secondary_rtt_t callback)
+{
+  vs_rtt = callback;
+}
+
+uint64_t virtual_secondary_receive(const uint8_t *frame, size_t length)
+{
+  return link_push(&to_secondary, frame, length);
+}
+
+void virtual_secondary_process(uint64_t now)
+{
+  // Frames sent by the secondary reach the host
+  while (to_host.head != NULL && to_host.head->due <= now) {
+    link_frame_t *frame = link_pop(&to_host);
+    vs_output(frame->data, frame->length);
+    free(frame);
+  }
+
+  // Frames sent by the host reach the secondary, which handles them one at a time
+  while (to_secondary.head != NULL && to_secondary.head->due <= now) {
+    if (processing_done == 0) {
+      uint64_t start = to_secondary.head->due > cpu_busy_until ? to_secondary.head->due : cpu_busy_until;
+      processing_done = start + (uint64_t)vs_config.processing_delay_us * 1000;
+    }
+
+    if (processing_done > now) {
+      break;
+    }
+
+    cpu_busy_until = processing_done;
+    processing_done = 0;
+
+    {
+      link_frame_t *frame = link_pop(&to_secondary);
+      processed_tx_complete = frame->due - (uint64_t)vs_config.latency_us * 1000;
+      process_frame(frame->data, frame->length);
+      free(frame);
+    }
+  }
+
+  for (size_t i = 0; i < SL_CPC_ENDPOINT_COUNT; i++) {
+    endpoint_t *endpoint = &endpoints[i];
+
+    if (endpoint->retransmit_deadline != 0 && endpoint->retransmit_deadline <= now) {
+      endpoint_retransmit(endpoint);
+    }
+  }
+
+  // Frames queued above with no delay on the link go out right away
+  while (to_host.head != NULL && to_host.head->due <= now) {
+    link_frame_t *frame = link_pop(&to_host);
+    vs_output(frame->data, frame->length);
+    free(frame);
+  }
+}
+
+uint64_t virtual_secondary_next_deadline(void)
+{
+  uint64_t deadline = 0;
+
+#define KEEP_EARLIEST(t)                                 \
+  do {                                                   \
+    if ((t) != 0 && (deadline == 0 || (t) < deadline)) { \
+      deadline = (t);                                    \
+    }                                                    \
+  } while (0)
+
+  if (to_host.head != NULL) {
+    KEEP_EARLIEST(to_host.head->due);
+  }
+
+  if (to_secondary.head != NULL) {
+    KEEP_EARLIEST(processing_done != 0 ? processing_done : to_secondary.head->due);
+  }
+
+  for (size_t i = 0; i < SL_CPC_ENDPOINT_COUNT; i++) {
+    KEEP_EARLIEST(endpoints[i].retransmit_deadline);
+  }
+
+#undef KEEP_EARLIEST
+
+  return deadline;
+}
+
+void virtual_secondary_reset(void)
+{
+  TRACE("simulated reset");
+
+  processing_done = 0;
+  link_clear(&to_secondary);
+
+  reboot();
+}
@@ -0,0 +1,111 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Virtual Secondary
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef VIRTUAL_SECONDARY_H
+#define VIRTUAL_SECONDARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The virtual secondary implements the secondary side of the protocol: the
+ * HDLC framing and acknowledgements, the system endpoint (reset sequence,
+ * properties, endpoint close) and a few application endpoints:
+ *  - echo   : every frame received is sent back, on one or more consecutive
+ *             endpoints
+ *  - sink   : every frame received is dropped
+ *  - source : a frame holding a little-endian uint32 count and an optional
+ *             uint16 size makes the endpoint send count frames of size bytes
+ *
+ * It is independent of the transport: complete frames are fed with
+ * virtual_secondary_receive() and handed back through the output callback.
+ * The link between the two sides is modeled here, so that every transport
+ * gets the same rate, latency and bit errors. Nothing is thread-safe, all the
+ * functions must be called from the same thread.
+ */
+
+#define VIRTUAL_SECONDARY_MAX_PAYLOAD_SIZE 4096
+#define VIRTUAL_SECONDARY_MAX_FRAME_SIZE   (7 + VIRTUAL_SECONDARY_MAX_PAYLOAD_SIZE + 2)
+
+typedef struct {
+  uint32_t link_rate;             // Bits per second in each direction, 0 for no limit
+  uint32_t latency_us;            // Propagation delay added to every frame
+  double bit_error_rate;          // Probability for each bit on the link to be flipped
+  uint32_t processing_delay_us;   // Time the secondary spends on each received frame
+  uint32_t retransmit_timeout_ms; // Time before the unacknowledged frames are sent again
+  uint32_t bus_speed;             // Reported in PROP_BUS_SPEED_VALUE
+  bool uart_hardflow;             // Reported in PROP_CAPABILITIES
+  uint16_t rx_capability;         // Reported in PROP_RX_CAPABILITY
+  uint8_t tx_window;              // Frames sent before waiting for an acknowledgement
+  uint8_t echo_endpoint;          // First echo endpoint, 0 to disable
+  uint8_t echo_count;             // Consecutive echo endpoints, sink and source take precedence
+  uint8_t sink_endpoint;          // 0 to disable
+  uint8_t source_endpoint;        // 0 to disable
+  bool verbose;
+} virtual_secondary_config_t;
+
+typedef void (*virtual_secondary_output_t)(const uint8_t *frame, size_t length);
+
+/*
+ * Fill the configuration with the defaults: no link impairment, no processing
+ * delay, one echo on endpoint 90, sink on 91 and source on 92.
+ */
+void virtual_secondary_default_config(virtual_secondary_config_t *config);
+
+void virtual_secondary_init(const virtual_secondary_config_t *config, virtual_secondary_output_t output);
+
+/*
+ * Called when the acknowledgement of an information frame of the host is sent,
+ * with the round trip time of the frame on the modeled link: from its tx
+ * complete time until the frame carrying the acknowledgement reaches the host.
+ * This is the ground truth for the round trip time measured by the host.
+ */
+typedef void (*virtual_secondary_rtt_t)(uint8_t endpoint, uint64_t rtt_ns);
+
+void virtual_secondary_set_rtt_callback(virtual_secondary_rtt_t callback);
+
+/*
+ * Monotonic time in nanoseconds, the time base of the functions below.
+ */
+uint64_t virtual_secondary_now(void);
+
+/*
+ * A frame sent by the host, as put on the bus. It reaches the secondary once
+ * it went through the link model. Returns the time its last bit leaves the
+ * host, the tx complete time of the frame.
+ */
+uint64_t virtual_secondary_receive(const uint8_t *frame, size_t length);
+
+/*
+ * Run everything that is due: frames crossing the link, frames processed by
+ * the secondary, retransmissions and source endpoint traffic.
+ */
+void virtual_secondary_process(uint64_t now);
+
+/*
+ * Time of the next event, 0 when nothing is scheduled.
+ */
+uint64_t virtual_secondary_next_deadline(void);
+
+/*
+ * Simulate an unexpected reset of the secondary: every endpoint loses its
+ * state and the reset reason is sent to the host.
+ */
+void virtual_secondary_reset(void);
+
+#endif //VIRTUAL_SECONDARY_H
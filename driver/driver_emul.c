@@ -32,6 +32,7 @@
 #include "misc/logging.h"
 #include "misc/utils.h"
 #include "driver/driver_emul.h"
+#include "driver/driver_transport.h"
 #include "server_core/core/hdlc.h"
 #include "server_core/core/core.h"
 #include "misc/sl_slist.h"
@@ -41,7 +42,6 @@
 #include "security/security.h"
 
 static int fd_socket_drv;
-static int fd_notification_socket_drv;
 static pthread_t drv_thread;
 static sl_slist_node_t *sli_rx_pending_list_head;
 static cpc_endpoint_state_t ep_states[SL_CPC_ENDPOINT_MAX_COUNT];
@@ -58,17 +58,12 @@ static void* driver_thread_func(void* param);
 
 pthread_t driver_emul_init(int* fd_core, int *fd_notify_core)
 {
-  int fd_sockets[2];
-  int fd_notify_sockets[2];
   uint32_t i;
 
   sl_slist_init(&sli_rx_pending_list_head);
 
-  if (0 != socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd_sockets)) {
-    FATAL("Create driver socket pair : %m");
-  }
-
-  fd_socket_drv  = fd_sockets[0];
+  /* Frames are pushed to the core from the test thread as well, the rings only support one producer */
+  driver_transport_init(true, &fd_socket_drv, fd_core, fd_notify_core);
 
   /* create driver thread */
   if (pthread_create(&drv_thread, NULL, driver_thread_func, NULL)) {
@@ -79,15 +74,6 @@ pthread_t driver_emul_init(int* fd_core, int *fd_notify_core)
     ep_states[i] = SL_CPC_STATE_OPEN;
   }
 
-  *fd_core = fd_sockets[1];
-
-  if (0 != socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd_notify_sockets)) {
-    FATAL("Create driver notification socket pair : %m");
-  }
-
-  fd_notification_socket_drv  = fd_notify_sockets[0];
-  *fd_notify_core = fd_notify_sockets[1];
-
   return drv_thread;
 }
 
@@ -190,7 +176,7 @@ void sli_cpc_drv_emul_submit_pkt_for_rx(void *header_buf, void *payload_buf, uin
     memcpy(&buffer[SLI_CPC_HDLC_HEADER_RAW_SIZE], payload_buf, payload_buf_len);
   }
 
-  (void)send(fd_socket_drv, buffer, payload_buf_len + tag_len + SLI_CPC_HDLC_HEADER_RAW_SIZE, 0);
+  driver_transport_write_rx(buffer, payload_buf_len + tag_len + SLI_CPC_HDLC_HEADER_RAW_SIZE);
 
   free(buffer);
 }
@@ -305,15 +291,14 @@ static void* driver_thread_func(void* param)
     }
     if (FD_ISSET(fd_socket_drv, &rfds)) {
       memset(temp_buffer, 0, 2048);
-      ret =  recv(fd_socket_drv, temp_buffer, 2048, 0);
+      ret = driver_transport_read_tx(temp_buffer, 2048);
       FATAL_ON(ret < 2);
       TRACE_DRIVER_RXD_FRAME((const void*)temp_buffer, (size_t)ret);
 
       // Notify core of TX completion
       struct timespec tx_complete_timestamp;
       clock_gettime(CLOCK_MONOTONIC, &tx_complete_timestamp);
-      ssize_t write_retval = write(fd_notification_socket_drv, &tx_complete_timestamp, sizeof(tx_complete_timestamp));
-      FATAL_SYSCALL_ON(write_retval != sizeof(tx_complete_timestamp));
+      driver_transport_write_tx_complete(&tx_complete_timestamp);
 
       usleep(1000); // Add a delay to emulate the time it takes for the secondary to process the packet
 
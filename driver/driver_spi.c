@@ -24,7 +24,9 @@
 #include <sys/epoll.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/spi/spidev.h>
@@ -32,16 +34,23 @@
 
 #include "server_core/core/crc.h"
 #include "server_core/core/hdlc.h"
+#include "misc/config.h"
 #include "misc/logging.h"
-#include "misc/sleep.h"
 #include "driver/driver_spi.h"
 #include "driver/driver_kill.h"
+#include "driver/driver_transport.h"
 
 #define MAX_EPOLL_EVENTS 5
-#define IRQ_LINE_TIMEOUT  10
+#define IRQ_LINE_TIMEOUT_MS  10
+
+/* Timings of the secondaries that do not report CPC_CAPABILITIES_SPI_FAST_TIMING_MASK */
+#define LEGACY_CS_SETUP_US         1000
+#define LEGACY_INTER_FRAME_GAP_US  1000
+
+/* Shorter waits are spun on rather than slept, nanosleep overshoots them by tens of microseconds */
+#define SPIN_THRESHOLD_US 100
 
 static int fd_core;
-static int fd_core_notify;
 static int fd_epoll;
 static pthread_t drv_thread;
 
@@ -52,17 +61,47 @@ static struct spi_ioc_transfer spi_tranfer;
 static uint8_t rx_spi_buffer[4096];
 static uint8_t tx_spi_buffer[4096];
 
+#define SPI_MAX_PAYLOAD_SIZE (sizeof(rx_spi_buffer) - SLI_CPC_HDLC_HEADER_RAW_SIZE)
+
+/*
+ * Size of the payload clocked in along with the header, the size of the last
+ * received payload. Only used with secondaries reporting the fast timing
+ * capability, which pad the end of their frames with idle bytes.
+ */
+static uint32_t speculative_payload_size = 0;
+
+/* Set by the core thread when the secondary reports CPC_CAPABILITIES_SPI_FULL_DUPLEX_MASK */
+static bool full_duplex_enabled = false;
+
+/* Delay between the assertion of the chip select and the first clock */
+static unsigned int cs_setup_us = LEGACY_CS_SETUP_US;
+/* Minimum delay between the end of a transaction and the start of the next one */
+static unsigned int inter_frame_gap_us = LEGACY_INTER_FRAME_GAP_US;
+/* Set by the core thread, applied by the driver thread between two transactions */
+static bool fast_timing_enabled = false;
+static bool fast_timing_applied = false;
+/* Earliest time the next transaction can start */
+static struct timespec next_transaction_time;
+
 typedef void (*driver_epoll_callback_t)(void);
 
 static void cs_assert(void);
 static void cs_deassert(void);
 
+static void spi_transaction_begin(void);
+static void spi_transaction_end(void);
+static bool wait_irq_line_high(int timeout_ms);
+static void spi_discard_invalid_frame(void);
+static void notify_tx_complete(void);
+
 static bool validate_header(uint8_t *header);
 static int get_data_size(uint8_t *header);
 
 static void driver_spi_process_irq(void);
+static void driver_spi_receive_frame(void);
 static void driver_spi_clear_and_process_irq(void);
 static void driver_spi_process_core(void);
+static void driver_spi_process_full_duplex(void);
 static void* driver_thread_func(void* param);
 
 static void driver_spi_open(const char *device,
@@ -79,8 +118,7 @@ static void driver_spi_open(const char *device,
 static void driver_spi_cleanup(void)
 {
   close(spi_dev.spi_dev_descriptor);
-  close(fd_core);
-  close(fd_core_notify);
+  driver_transport_close_driver();
   close(fd_epoll);
 
   gpio_deinit(&spi_dev.cs_gpio);
@@ -105,8 +143,6 @@ pthread_t driver_spi_init(int *fd_to_core,
                           const char *wake_gpio_chip,
                           unsigned int wake_gpio_pin)
 {
-  int fd_sockets[2];
-  int fd_sockets_notify[2];
   ssize_t ret;
 
   driver_spi_open(device,
@@ -120,17 +156,7 @@ pthread_t driver_spi_init(int *fd_to_core,
                   wake_gpio_chip,
                   wake_gpio_pin);
 
-  ret = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd_sockets);
-  FATAL_SYSCALL_ON(ret < 0);
-
-  fd_core  = fd_sockets[0];
-  *fd_to_core = fd_sockets[1];
-
-  ret = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd_sockets_notify);
-  FATAL_SYSCALL_ON(ret < 0);
-
-  fd_core_notify  = fd_sockets_notify[0];
-  *fd_notify_core = fd_sockets_notify[1];
+  driver_transport_init(config.driver_use_socketpair, &fd_core, fd_to_core, fd_notify_core);
 
   /* Setup epoll */
   {
@@ -222,6 +248,9 @@ static void* driver_thread_func(void* param)
         callback();
       }
     }
+
+    /* The secondary may have asserted its IRQ again while the previous frame was being handled */
+    driver_spi_process_irq();
   } //while(1)
 
   gpio_deinit(&spi_dev.cs_gpio);
@@ -276,6 +305,155 @@ static void cs_deassert(void)
   FATAL_SYSCALL_ON(ret < 0);
 }
 
+void driver_spi_enable_fast_timing(void)
+{
+  __atomic_store_n(&fast_timing_enabled, true, __ATOMIC_RELEASE);
+}
+
+void driver_spi_enable_full_duplex(void)
+{
+  __atomic_store_n(&full_duplex_enabled, true, __ATOMIC_RELEASE);
+}
+
+static bool is_full_duplex(void)
+{
+  return __atomic_load_n(&full_duplex_enabled, __ATOMIC_ACQUIRE);
+}
+
+static void timespec_add_us(struct timespec *timespec, unsigned int us)
+{
+  timespec->tv_nsec += (long)us * 1000;
+  timespec->tv_sec += timespec->tv_nsec / 1000000000;
+  timespec->tv_nsec %= 1000000000;
+}
+
+static int64_t timespec_diff_ns(const struct timespec *end, const struct timespec *start)
+{
+  return (int64_t)(end->tv_sec - start->tv_sec) * 1000000000 + (end->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * Wait until the deadline with microsecond accuracy: sleep while it is far,
+ * spin once it is close.
+ */
+static void delay_until(const struct timespec *deadline)
+{
+  struct timespec now;
+  int64_t remaining_ns;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  remaining_ns = timespec_diff_ns(deadline, &now);
+
+  if (remaining_ns > SPIN_THRESHOLD_US * 1000) {
+    struct timespec wake_up = now;
+
+    timespec_add_us(&wake_up, (unsigned int)(remaining_ns / 1000 - SPIN_THRESHOLD_US));
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_up, NULL) == EINTR) {
+    }
+  }
+
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while (timespec_diff_ns(deadline, &now) > 0);
+}
+
+static void spi_transaction_begin(void)
+{
+  struct timespec cs_setup_deadline;
+
+  if (!fast_timing_applied && __atomic_load_n(&fast_timing_enabled, __ATOMIC_ACQUIRE)) {
+    fast_timing_applied = true;
+    cs_setup_us = config.spi_cs_setup_us;
+    inter_frame_gap_us = config.spi_inter_frame_gap_us;
+    TRACE_DRIVER("Fast timing : %u us chip select setup, %u us inter-frame gap", cs_setup_us, inter_frame_gap_us);
+  }
+
+  /* Leave the secondary the time to get ready for the next transaction */
+  delay_until(&next_transaction_time);
+
+  cs_assert();
+
+  clock_gettime(CLOCK_MONOTONIC, &cs_setup_deadline);
+  timespec_add_us(&cs_setup_deadline, cs_setup_us);
+  delay_until(&cs_setup_deadline);
+}
+
+static void spi_transaction_end(void)
+{
+  cs_deassert();
+
+  clock_gettime(CLOCK_MONOTONIC, &next_transaction_time);
+  timespec_add_us(&next_transaction_time, inter_frame_gap_us);
+}
+
+/*
+ * Clock in the frame of the secondary one byte at a time until it releases
+ * its IRQ line, after a header that could not be decoded.
+ */
+static void spi_discard_invalid_frame(void)
+{
+  struct spi_ioc_transfer transfer = spi_tranfer;
+  int error_timeout = 4096;
+  int ret;
+
+  TRACE_FRAME("Driver : Invalid header contain: ", rx_spi_buffer, (size_t)SLI_CPC_HDLC_HEADER_RAW_SIZE);
+  TRACE_DRIVER("Invalid header");
+
+  transfer.tx_buf = 0;
+  transfer.len = 1u;
+
+  while ((gpio_read(&spi_dev.irq_gpio) == 0u)
+         && (error_timeout > 0)) {
+    ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(1), &transfer);
+    FATAL_ON(ret != 1);
+    error_timeout--;
+  }
+}
+
+static void notify_tx_complete(void)
+{
+  struct timespec tx_complete_timestamp;
+  clock_gettime(CLOCK_MONOTONIC, &tx_complete_timestamp);
+
+  /* Push write notification to core */
+  driver_transport_write_tx_complete(&tx_complete_timestamp);
+}
+
+/*
+ * Wait for the secondary to release its IRQ line. The thread sleeps until the
+ * rising edge is reported, which is why the line is requested on both edges.
+ */
+static bool wait_irq_line_high(int timeout_ms)
+{
+  struct pollfd irq_poll = { .fd = gpio_get_fd(&spi_dev.irq_gpio), .events = GPIO_EPOLL_EVENT };
+  struct timespec deadline;
+  struct timespec now;
+  int ret;
+
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  timespec_add_us(&deadline, (unsigned int)timeout_ms * 1000);
+
+  while (gpio_read(&spi_dev.irq_gpio) == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t remaining_ns = timespec_diff_ns(&deadline, &now);
+    if (remaining_ns <= 0) {
+      return false;
+    }
+
+    ret = poll(&irq_poll, 1, (int)(remaining_ns / 1000000) + 1);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    FATAL_SYSCALL_ON(ret < 0);
+
+    if (ret > 0) {
+      gpio_clear_irq(&spi_dev.irq_gpio);
+    }
+  }
+
+  return true;
+}
+
 static void driver_spi_open(const char *device,
                             unsigned int mode,
                             unsigned int bit_per_word,
@@ -320,8 +498,8 @@ static void driver_spi_open(const char *device,
   FATAL_ON(gpio_init(&spi_dev.cs_gpio, cs_gpio_chip, cs_gpio_pin, OUT, NO_EDGE) < 0);
   FATAL_ON(gpio_write(&spi_dev.cs_gpio, 1u) < 0);
 
-  // Setup IRQ gpio
-  FATAL_ON(gpio_init(&spi_dev.irq_gpio, irq_gpio_chip, irq_gpio_pin, IN, FALLING) < 0);
+  // Setup IRQ gpio, the rising edge wakes up the driver when the secondary releases the line
+  FATAL_ON(gpio_init(&spi_dev.irq_gpio, irq_gpio_chip, irq_gpio_pin, IN, BOTH) < 0);
 
   // Setup WAKE gpio
   FATAL_ON(gpio_init(&spi_dev.wake_gpio, wake_gpio_chip, wake_gpio_pin, OUT, NO_EDGE) < 0);
@@ -330,81 +508,92 @@ static void driver_spi_open(const char *device,
 
 static void driver_spi_process_irq(void)
 {
-  int ret = 0;
-  int payload_size = 0;
-  size_t write_size = 0;
-  uint8_t rx_buffer[4096];
-  ssize_t write_retval;
-  int timeout = IRQ_LINE_TIMEOUT;
-  int error_timeout = 4096;
+  if (is_full_duplex()) {
+    driver_spi_process_full_duplex();
+    return;
+  }
 
   if (gpio_read(&spi_dev.irq_gpio) == 0) {
-    cs_assert();
-    sleep_ms(1);
+    spi_transaction_begin();
 
     if (gpio_read(&spi_dev.irq_gpio) != 0u) {
-      cs_deassert();
+      spi_transaction_end();
       return;
     }
 
-    spi_tranfer.len = SLI_CPC_HDLC_HEADER_RAW_SIZE;
-
-    ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(1), &spi_tranfer);
-    FATAL_ON(ret != SLI_CPC_HDLC_HEADER_RAW_SIZE);
-
-    memcpy(rx_buffer, (uint8_t*)(long)spi_tranfer.rx_buf, SLI_CPC_HDLC_HEADER_RAW_SIZE);
-
-    payload_size = get_data_size((uint8_t *)(long)spi_tranfer.rx_buf);
-    if (payload_size == -1) {
-      spi_tranfer.len = 1u;
-
-      while ((gpio_read(&spi_dev.irq_gpio) == 0u)
-             && (error_timeout > 0)) {
-        ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(1), &spi_tranfer);
-        FATAL_ON(ret != 1);
-        error_timeout--;
-      }
+    driver_spi_receive_frame();
+  }
+}
 
-      cs_deassert();
+/*
+ * Receive the frame of the secondary, its IRQ line is asserted. The transaction was
+ * begun by the caller and is ended here.
+ */
+static void driver_spi_receive_frame(void)
+{
+  int ret = 0;
+  int payload_size = 0;
+  uint32_t received_payload_size;
+  size_t write_size = 0;
+  struct spi_ioc_transfer transfers[2];
 
-      sleep_ms(1);
+  /*
+   * The frame is received straight into rx_spi_buffer, which is then written to the core.
+   * Nothing is transmitted during a receive transaction (tx_buf = 0 clocks out zeros).
+   */
+  transfers[0] = spi_tranfer;
+  transfers[0].tx_buf = 0;
+  transfers[0].rx_buf = (unsigned long)rx_spi_buffer;
+  transfers[0].len = SLI_CPC_HDLC_HEADER_RAW_SIZE;
+
+  if (speculative_payload_size > 0) {
+    /* Clock in the header and the expected payload with a single ioctl */
+    transfers[1] = transfers[0];
+    transfers[1].rx_buf = (unsigned long)&rx_spi_buffer[SLI_CPC_HDLC_HEADER_RAW_SIZE];
+    transfers[1].len = speculative_payload_size;
+
+    ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(2), transfers);
+    FATAL_ON(ret != (int)(SLI_CPC_HDLC_HEADER_RAW_SIZE + speculative_payload_size));
+    received_payload_size = speculative_payload_size;
+  } else {
+    ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(1), transfers);
+    FATAL_ON(ret != SLI_CPC_HDLC_HEADER_RAW_SIZE);
+    received_payload_size = 0;
+  }
 
-      TRACE_FRAME("Driver : Invalid header contain: ", rx_buffer, (size_t)SLI_CPC_HDLC_HEADER_RAW_SIZE);
-      TRACE_DRIVER("Invalid header");
+  payload_size = get_data_size(rx_spi_buffer);
+  if (payload_size == -1 || payload_size > (int)SPI_MAX_PAYLOAD_SIZE) {
+    spi_discard_invalid_frame();
+    spi_transaction_end();
+    return;
+  }
 
-      return;
-    }
+  if ((uint32_t)payload_size > received_payload_size) {
+    /* The speculation fell short, clock in the rest of the payload */
+    transfers[0].rx_buf = (unsigned long)&rx_spi_buffer[SLI_CPC_HDLC_HEADER_RAW_SIZE + received_payload_size];
+    transfers[0].len = (uint32_t)payload_size - received_payload_size;
 
-    if (payload_size > 0) {
-      spi_tranfer.len = (uint32_t)payload_size;
-      ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(1), &spi_tranfer);
-      FATAL_ON(ret != payload_size);
-      memcpy(&rx_buffer[SLI_CPC_HDLC_HEADER_RAW_SIZE], (uint8_t*)(long)spi_tranfer.rx_buf, (uint32_t)payload_size);
-      write_size = (uint32_t)payload_size + SLI_CPC_HDLC_HEADER_RAW_SIZE;
-    } else if (payload_size == 0) {
-      write_size = SLI_CPC_HDLC_HEADER_RAW_SIZE;
-    }
+    ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(1), transfers);
+    FATAL_ON(ret != (int)transfers[0].len);
+  }
 
-    // Wait for NCP to response
-    while ((gpio_read(&spi_dev.irq_gpio) != 1)
-           && timeout > 0) {
-      sleep_us(100);
-      timeout--;
-    }
+  /* The bytes clocked in past the end of the frame are only padding, they are trimmed */
+  write_size = (uint32_t)payload_size + SLI_CPC_HDLC_HEADER_RAW_SIZE;
 
-    if (timeout == 0) {
-      FATAL("Secondary IRQ line is busy !!!!");
-    }
+  if (fast_timing_applied) {
+    speculative_payload_size = (uint32_t)payload_size;
+  }
 
-    cs_deassert();
+  // Wait for NCP to response
+  if (!wait_irq_line_high(IRQ_LINE_TIMEOUT_MS)) {
+    FATAL("Secondary IRQ line is busy !!!!");
+  }
 
-    write_retval = write(fd_core, rx_buffer, write_size);
-    FATAL_SYSCALL_ON(write_retval < 0);
+  spi_transaction_end();
 
-    sleep_ms(1);
+  driver_transport_write_rx(rx_spi_buffer, write_size);
 
-    TRACE_FRAME("Driver : flushed frame to core : ", rx_buffer, (size_t)write_retval);
-  }
+  TRACE_FRAME("Driver : flushed frame to core : ", rx_spi_buffer, write_size);
 }
 
 static void driver_spi_clear_and_process_irq(void)
@@ -416,38 +605,146 @@ static void driver_spi_clear_and_process_irq(void)
 
 static void driver_spi_process_core(void)
 {
-  uint8_t buffer[4096];
   ssize_t read_retval;
+  size_t tx_size;
   int ret;
 
-  cs_assert();
-
-  sleep_ms(1);
+  if (is_full_duplex()) {
+    driver_spi_process_full_duplex();
+    return;
+  }
 
-  if (gpio_read(&spi_dev.irq_gpio) == 0) {
+  /*
+   * Take the frame before touching the bus. The ring doorbell can be readable after
+   * the ring was drained, the empty read clears it without a chip select pulse.
+   */
+  read_retval = driver_transport_read_tx(tx_spi_buffer, sizeof(tx_spi_buffer));
+  if (read_retval == -EAGAIN) {
     return;
   }
+  FATAL_ON(read_retval < 0);
+  tx_size = (size_t)read_retval;
+
+  while (1) {
+    /* The secondary has a frame to send, receive it first. The frame from the core waits in tx_spi_buffer */
+    if (gpio_read(&spi_dev.irq_gpio) == 0) {
+      driver_spi_process_irq();
+      continue;
+    }
+
+    spi_transaction_begin();
 
-  read_retval = read(fd_core, buffer, sizeof(buffer));
-  FATAL_SYSCALL_ON(read_retval < 0);
+    /* Asserted during the chip select setup, chip select stays asserted into the receive */
+    if (gpio_read(&spi_dev.irq_gpio) == 0) {
+      driver_spi_receive_frame();
+      continue;
+    }
 
-  memcpy((uint8_t*)(long)spi_tranfer.tx_buf, buffer, (uint32_t)read_retval);
+    break;
+  }
 
-  spi_tranfer.len = (uint32_t)read_retval;
+  spi_tranfer.len = (uint32_t)tx_size;
 
   ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(1), &spi_tranfer);
   FATAL_SYSCALL_ON(ret < 0);
 
-  cs_deassert();
+  spi_transaction_end();
 
-  struct timespec tx_complete_timestamp;
-  clock_gettime(CLOCK_MONOTONIC, &tx_complete_timestamp);
+  notify_tx_complete();
 
-  /* Push write notification to core */
-  ssize_t write_retval = write(fd_core_notify, &tx_complete_timestamp, sizeof(tx_complete_timestamp));
-  FATAL_SYSCALL_ON(write_retval != sizeof(tx_complete_timestamp));
+  TRACE_FRAME("Driver : flushed frame to SPI : ", tx_spi_buffer, tx_size);
+}
+
+/*
+ * Full-duplex transaction: the frame pending on the core socket, if any, is
+ * clocked out while the frame of the secondary, if its IRQ is asserted, is
+ * clocked in. Both sides exchange their header first, the rest of the
+ * transaction is as long as the longest of the two payloads and the shorter
+ * side is padded with zeros.
+ */
+static void driver_spi_process_full_duplex(void)
+{
+  struct spi_ioc_transfer transfer = spi_tranfer;
+  ssize_t tx_size;
+  bool rx_pending;
+  int rx_payload_size = -1;
+  uint32_t tx_payload_size = 0;
+  uint32_t exchange_size;
+  int ret;
+
+  /* Nothing to exchange, the bus is left alone. An empty read clears the ring doorbell */
+  tx_size = driver_transport_read_tx(tx_spi_buffer, sizeof(tx_spi_buffer));
+  if (tx_size == -EAGAIN) {
+    tx_size = 0;
+  }
+  FATAL_ON(tx_size < 0);
+  BUG_ON(tx_size > 0 && tx_size < (ssize_t)SLI_CPC_HDLC_HEADER_RAW_SIZE);
+  rx_pending = (gpio_read(&spi_dev.irq_gpio) == 0);
+
+  if (tx_size == 0 && !rx_pending) {
+    return;
+  }
+
+  spi_transaction_begin();
+
+  /* The secondary may have asserted its IRQ during the chip select setup */
+  rx_pending = rx_pending || (gpio_read(&spi_dev.irq_gpio) == 0);
+
+  /* Headers of both sides, zeros are clocked out when the host has nothing to send */
+  transfer.tx_buf = tx_size > 0 ? (unsigned long)tx_spi_buffer : 0;
+  transfer.rx_buf = (unsigned long)rx_spi_buffer;
+  transfer.len = SLI_CPC_HDLC_HEADER_RAW_SIZE;
 
-  sleep_ms(1);
+  ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(1), &transfer);
+  FATAL_ON(ret != SLI_CPC_HDLC_HEADER_RAW_SIZE);
 
-  TRACE_FRAME("Driver : flushed frame to SPI : ", buffer, (size_t)read_retval);
+  if (tx_size > 0) {
+    tx_payload_size = (uint32_t)tx_size - SLI_CPC_HDLC_HEADER_RAW_SIZE;
+  }
+
+  if (rx_pending) {
+    rx_payload_size = get_data_size(rx_spi_buffer);
+    if (rx_payload_size > (int)SPI_MAX_PAYLOAD_SIZE) {
+      rx_payload_size = -1;
+    }
+  }
+
+  exchange_size = tx_payload_size;
+  if (rx_payload_size > 0 && (uint32_t)rx_payload_size > exchange_size) {
+    exchange_size = (uint32_t)rx_payload_size;
+    /* Pad the end of the host frame, the buffer may hold a longer frame sent before */
+    if (tx_size > 0) {
+      memset(&tx_spi_buffer[tx_size], 0, exchange_size - tx_payload_size);
+    }
+  }
+
+  if (exchange_size > 0) {
+    transfer.tx_buf = tx_size > 0 ? (unsigned long)&tx_spi_buffer[SLI_CPC_HDLC_HEADER_RAW_SIZE] : 0;
+    transfer.rx_buf = (unsigned long)&rx_spi_buffer[SLI_CPC_HDLC_HEADER_RAW_SIZE];
+    transfer.len = exchange_size;
+
+    ret = ioctl(spi_dev.spi_dev_descriptor, SPI_IOC_MESSAGE(1), &transfer);
+    FATAL_ON(ret != (int)exchange_size);
+  }
+
+  if (rx_pending) {
+    if (rx_payload_size == -1) {
+      spi_discard_invalid_frame();
+    } else if (!wait_irq_line_high(IRQ_LINE_TIMEOUT_MS)) {
+      FATAL("Secondary IRQ line is busy !!!!");
+    }
+  }
+
+  spi_transaction_end();
+
+  if (tx_size > 0) {
+    notify_tx_complete();
+    TRACE_FRAME("Driver : flushed frame to SPI : ", tx_spi_buffer, (size_t)tx_size);
+  }
+
+  if (rx_payload_size >= 0) {
+    driver_transport_write_rx(rx_spi_buffer, (size_t)rx_payload_size + SLI_CPC_HDLC_HEADER_RAW_SIZE);
+
+    TRACE_FRAME("Driver : flushed frame to core : ", rx_spi_buffer, (size_t)rx_payload_size + SLI_CPC_HDLC_HEADER_RAW_SIZE);
+  }
 }
@@ -48,4 +48,17 @@ pthread_t driver_spi_init(int *fd_to_core,
                           unsigned int irq_gpio_pin,
                           const char *wake_gpio_chip,
                           unsigned int wake_gpio_pin);
+
+/*
+ * Switch from the conservative timings of older secondaries to the configured
+ * spi_cs_setup_us and spi_inter_frame_gap_us. Called when the secondary reports
+ * it supports them, can be called from any thread.
+ */
+void driver_spi_enable_fast_timing(void);
+
+/*
+ * Exchange frames in both directions within the same transaction. Called when
+ * the secondary reports it supports it, can be called from any thread.
+ */
+void driver_spi_enable_full_duplex(void);
 #endif//DRIVER_SPI_H
@@ -0,0 +1,213 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Driver to Core Transport
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "driver/driver_transport.h"
+#include "misc/logging.h"
+#include "misc/spsc_ring.h"
+
+/* Large enough for the socket buffers of the socketpairs they replace */
+#define FRAME_RING_SIZE        (256u * 1024u)
+#define TX_COMPLETE_RING_SIZE  (16u * 1024u)
+
+static bool use_socketpair;
+
+static spsc_ring_t rx_ring;
+static spsc_ring_t tx_ring;
+static spsc_ring_t tx_complete_ring;
+
+/* Socketpair mode, the driver end and the core end of each stream */
+static int driver_fd = -1;
+static int driver_notify_fd = -1;
+static int core_fd = -1;
+static int core_notify_fd = -1;
+
+void driver_transport_init(bool socketpair_mode, int *driver_tx_fd, int *core_rx_fd, int *core_tx_complete_fd)
+{
+  int fd_sockets[2];
+  int fd_sockets_notify[2];
+  int ret;
+
+  use_socketpair = socketpair_mode;
+
+  if (use_socketpair) {
+    ret = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd_sockets);
+    FATAL_SYSCALL_ON(ret < 0);
+
+    driver_fd = fd_sockets[0];
+    core_fd = fd_sockets[1];
+
+    ret = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd_sockets_notify);
+    FATAL_SYSCALL_ON(ret < 0);
+
+    driver_notify_fd = fd_sockets_notify[0];
+    core_notify_fd = fd_sockets_notify[1];
+
+    *driver_tx_fd = driver_fd;
+    *core_rx_fd = core_fd;
+    *core_tx_complete_fd = core_notify_fd;
+  } else {
+    spsc_ring_init(&rx_ring, FRAME_RING_SIZE);
+    spsc_ring_init(&tx_ring, FRAME_RING_SIZE);
+    spsc_ring_init(&tx_complete_ring, TX_COMPLETE_RING_SIZE);
+
+    *driver_tx_fd = spsc_ring_get_fd(&tx_ring);
+    *core_rx_fd = spsc_ring_get_fd(&rx_ring);
+    *core_tx_complete_fd = spsc_ring_get_fd(&tx_complete_ring);
+  }
+}
+
+void driver_transport_close_driver(void)
+{
+  if (use_socketpair) {
+    close(driver_fd);
+    close(driver_notify_fd);
+  } else {
+    // The core still reads the records left, then sees the rings closed
+    spsc_ring_close(&rx_ring);
+    spsc_ring_close(&tx_ring);
+    spsc_ring_close(&tx_complete_ring);
+  }
+}
+
+int driver_transport_close_core_fd(int fd)
+{
+  // The eventfds of the rings may still be rung by the driver, they are never closed
+  if (!use_socketpair) {
+    return 0;
+  }
+
+  return close(fd);
+}
+
+ssize_t driver_transport_read_tx(void *buffer, size_t size)
+{
+  ssize_t ret;
+
+  if (!use_socketpair) {
+    return spsc_ring_pop(&tx_ring, buffer, size);
+  }
+
+  ret = recv(driver_fd, buffer, size, MSG_DONTWAIT);
+  if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return -EAGAIN;
+  }
+  FATAL_SYSCALL_ON(ret < 0);
+
+  return ret;
+}
+
+void driver_transport_write_rx(const void *frame, size_t length)
+{
+  struct iovec iov = { .iov_base = (void *)frame, .iov_len = length };
+
+  driver_transport_writev_rx(&iov, 1);
+}
+
+void driver_transport_writev_rx(const struct iovec *iov, int iovcnt)
+{
+  ssize_t ret;
+
+  if (!use_socketpair) {
+    // Nobody reads the frames of a closed driver
+    (void)spsc_ring_pushv(&rx_ring, iov, iovcnt);
+    return;
+  }
+
+  ret = writev(driver_fd, iov, iovcnt);
+  FATAL_SYSCALL_ON(ret < 0);
+}
+
+void driver_transport_write_tx_complete(const struct timespec *timestamp)
+{
+  ssize_t ret;
+
+  if (!use_socketpair) {
+    (void)spsc_ring_push(&tx_complete_ring, timestamp, sizeof(*timestamp));
+    return;
+  }
+
+  ret = write(driver_notify_fd, timestamp, sizeof(*timestamp));
+  FATAL_SYSCALL_ON(ret != sizeof(*timestamp));
+}
+
+static ssize_t core_recv(int fd, void *buffer, size_t size, int flags)
+{
+  ssize_t ret = recv(fd, buffer, size, flags | MSG_DONTWAIT);
+
+  if (ret == 0 || (ret < 0 && errno == ECONNRESET)) {
+    return -ECONNRESET;
+  }
+  if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return -EAGAIN;
+  }
+  FATAL_SYSCALL_ON(ret < 0);
+
+  return ret;
+}
+
+ssize_t driver_transport_peek_rx_size(void)
+{
+  const void *frame;
+
+  if (!use_socketpair) {
+    return spsc_ring_peek(&rx_ring, &frame);
+  }
+
+  return core_recv(core_fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
+}
+
+ssize_t driver_transport_read_rx(void *buffer, size_t size)
+{
+  if (!use_socketpair) {
+    return spsc_ring_pop(&rx_ring, buffer, size);
+  }
+
+  return core_recv(core_fd, buffer, size, 0);
+}
+
+ssize_t driver_transport_write_tx(const void *frame, size_t length)
+{
+  ssize_t ret;
+
+  if (!use_socketpair) {
+    ret = spsc_ring_push(&tx_ring, frame, length);
+    return ret < 0 ? ret : (ssize_t)length;
+  }
+
+  ret = send(core_fd, frame, length, 0);
+  if (ret < 0 && errno == ECONNRESET) {
+    return -ECONNRESET;
+  }
+  FATAL_SYSCALL_ON(ret < 0);
+
+  return ret;
+}
+
+ssize_t driver_transport_read_tx_complete(struct timespec *timestamp)
+{
+  if (!use_socketpair) {
+    return spsc_ring_pop(&tx_complete_ring, timestamp, sizeof(*timestamp));
+  }
+
+  return core_recv(core_notify_fd, timestamp, sizeof(*timestamp), 0);
+}
@@ -0,0 +1,87 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Driver to Core Transport
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef DRIVER_TRANSPORT_H
+#define DRIVER_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * The driver and the core exchange three streams of messages:
+ *  - rx : frames received on the bus, from the driver to the core
+ *  - tx : frames to send on the bus, from the core to the driver
+ *  - tx complete : timestamps of the frames sent, from the driver to the core
+ *
+ * By default each stream is a lock-free ring in the process memory, the reader
+ * polls an eventfd that becomes readable when the ring goes non-empty. With
+ * config.driver_use_socketpair, each stream is a SOCK_SEQPACKET socketpair
+ * instead, as it used to be, which makes the frames visible to strace.
+ *
+ * The functions below hide the difference. The file descriptors are the ones
+ * to poll for EPOLLIN in both modes, they can be readable without a message
+ * pending.
+ */
+
+/*
+ * Create the streams. Called once by the driver init, before its threads are
+ * started, with config.driver_use_socketpair or true for drivers that write to
+ * a stream from more than one thread. Returns the file descriptors for the
+ * driver (tx) and for the core (rx and tx complete).
+ */
+void driver_transport_init(bool socketpair_mode, int *driver_tx_fd, int *core_rx_fd, int *core_tx_complete_fd);
+
+/*
+ * Close the driver end of the streams, the core sees them closed.
+ */
+void driver_transport_close_driver(void);
+
+/*
+ * Close a file descriptor of the core end, once the core saw the stream closed.
+ * Returns the result of close(), the ring eventfds are left open.
+ */
+int driver_transport_close_core_fd(int fd);
+
+/*
+ * Driver side.
+ * Read a frame to send, returns its length, -EAGAIN when none is pending or 0
+ * if the core closed the stream.
+ */
+ssize_t driver_transport_read_tx(void *buffer, size_t size);
+
+void driver_transport_write_rx(const void *frame, size_t length);
+
+void driver_transport_writev_rx(const struct iovec *iov, int iovcnt);
+
+void driver_transport_write_tx_complete(const struct timespec *timestamp);
+
+/*
+ * Core side. These return -ECONNRESET once the driver closed the stream, and
+ * -EAGAIN when no message is pending.
+ */
+ssize_t driver_transport_peek_rx_size(void);
+
+ssize_t driver_transport_read_rx(void *buffer, size_t size);
+
+ssize_t driver_transport_write_tx(const void *frame, size_t length);
+
+ssize_t driver_transport_read_tx_complete(struct timespec *timestamp);
+
+#endif //DRIVER_TRANSPORT_H
@@ -25,11 +25,13 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/ioctl.h>
 #include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/timerfd.h>
 #include <signal.h>
+#include <time.h>
 #include <linux/serial.h>
 
 #include "misc/config.h"
@@ -41,18 +43,46 @@
 #include "server_core/core/hdlc.h"
 #include "server_core/core/crc.h"
 #include "driver/driver_kill.h"
+#include "driver/driver_transport.h"
+#include "driver/uart_deframer.h"
 
 #define UART_BUFFER_SIZE 4096 + SLI_CPC_HDLC_HEADER_RAW_SIZE
 #define MAX_EPOLL_EVENTS 1
 
+/* Maximum number of frames waiting for their tx complete notification */
+#define UART_TX_COMPLETE_MAX_PENDING 64
+
+/* Bucket i of the rx deframe latency histogram counts the frames pushed to the core less than
+ * 2^i us after the read that completed their header */
+#define UART_RX_DEFRAME_LATENCY_BUCKETS 16
+
 static int fd_uart;
 static int fd_core;
-static int fd_core_notify;
 static int fd_stop_drv;
 static unsigned int device_baudrate = 0;
 static pthread_t rx_drv_thread;
 static pthread_t tx_drv_thread;
 static pthread_t cleanup_thread;
+static pthread_t tx_complete_thread;
+static int fd_tx_complete_request;
+static int fd_tx_complete_process;
+
+/* How the tx complete thread detects that the frames left the uart */
+static enum {
+  TX_COMPLETE_LSR,      /* Poll the transmitter empty bit of the line status register */
+  TX_COMPLETE_TCDRAIN,  /* Wait in tcdrain() */
+  TX_COMPLETE_ESTIMATE  /* Fallback, the completion is estimated from the baudrate */
+} tx_complete_mode;
+
+/* Measured minus estimated tx complete time of the frames, in microseconds */
+static struct {
+  uint32_t count;
+  int64_t sum_us;
+  int64_t min_us;
+  int64_t max_us;
+} tx_complete_error;
+
+static uint32_t rx_deframe_latency_histogram[UART_RX_DEFRAME_LATENCY_BUCKETS + 1];
 
 static void* receive_driver_thread_func(void* param);
 
@@ -60,37 +90,22 @@ static void* transmit_driver_thread_func(void* param);
 
 static void driver_uart_process_uart(void);
 
+static void driver_uart_push_frame(const struct iovec *iov, int iov_count, const struct timespec *header_timestamp);
+
 static void driver_uart_process_core(void);
 
+static void driver_uart_busy_poll(void);
+
+static void* tx_complete_thread_func(void* param);
+
 typedef struct notify_private_data{
   int timer_file_descriptor;
 }notify_private_data_t;
 
-/*
- * @return The number of bytes appended to the buffer
- */
-static size_t read_and_append_uart_received_data(uint8_t *buffer, size_t buffer_head, size_t buffer_size);
-
-/*
- * Call this function in loop over the buffer to delimit and push the frames to the core
- *
- * @return Whether or not this call has delimited a pushed a frame, in other words,
- *         shall this function be called again in a loop
- */
-static bool delimit_and_push_frames_to_core(uint8_t *buffer, size_t *buffer_head);
-
-/*
- * Insures the start of the buffer is aligned with the start of a valid checksum
- * and re-synch in case the buffer starts with garbage.
- */
-static bool header_re_synch(uint8_t *buffer, size_t *buffer_head);
-
 static void* driver_uart_cleanup(void *param);
 
 pthread_t driver_uart_init(int *fd_to_core, int *fd_notify_core, const char *device, unsigned int baudrate, bool hardflow)
 {
-  int fd_sockets[2];
-  int fd_sockets_notify[2];
   ssize_t ret;
 
   fd_uart = driver_uart_open(device, baudrate, hardflow);
@@ -99,17 +114,9 @@ pthread_t driver_uart_init(int *fd_to_core, int *fd_notify_core, const char *dev
 
   tcflush(fd_uart, TCIOFLUSH);
 
-  ret = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd_sockets);
-  FATAL_SYSCALL_ON(ret < 0);
-
-  fd_core  = fd_sockets[0];
-  *fd_to_core = fd_sockets[1];
+  driver_transport_init(config.driver_use_socketpair, &fd_core, fd_to_core, fd_notify_core);
 
-  ret = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd_sockets_notify);
-  FATAL_SYSCALL_ON(ret < 0);
-
-  fd_core_notify  = fd_sockets_notify[0];
-  *fd_notify_core = fd_sockets_notify[1];
+  uart_deframer_init(driver_uart_push_frame);
 
   /*
    * Create stop driver event, this file descriptor will be used by
@@ -125,6 +132,35 @@ pthread_t driver_uart_init(int *fd_to_core, int *fd_notify_core, const char *dev
   ret = pthread_create(&rx_drv_thread, NULL, receive_driver_thread_func, NULL);
   FATAL_ON(ret != 0);
 
+  if (config.uart_accurate_tx_complete) {
+    int fd_tx_complete[2];
+
+    ret = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fd_tx_complete);
+    FATAL_SYSCALL_ON(ret < 0);
+
+    fd_tx_complete_request = fd_tx_complete[0];
+    fd_tx_complete_process = fd_tx_complete[1];
+
+    /* Prefer the line status register when the serial driver exposes it */
+    {
+      unsigned int lsr;
+
+      if (ioctl(fd_uart, TIOCSERGETLSR, &lsr) == 0) {
+        tx_complete_mode = TX_COMPLETE_LSR;
+        TRACE_DRIVER("tx complete detected with the line status register");
+      } else {
+        tx_complete_mode = TX_COMPLETE_TCDRAIN;
+        TRACE_DRIVER("tx complete detected with tcdrain()");
+      }
+    }
+
+    ret = pthread_create(&tx_complete_thread, NULL, tx_complete_thread_func, NULL);
+    FATAL_ON(ret != 0);
+
+    ret = pthread_setname_np(tx_complete_thread, "tx_cmpl_thread");
+    FATAL_ON(ret != 0);
+  }
+
   /* create cleanup thread */
   ret = pthread_create(&cleanup_thread, NULL, driver_uart_cleanup, NULL);
   FATAL_ON(ret != 0);
@@ -150,6 +186,51 @@ void driver_uart_print_overruns(void)
   TRACE_DRIVER("Overruns %d,%d", counters.overrun, counters.buf_overrun);
 }
 
+void driver_uart_print_rx_deframe_latency(void)
+{
+  size_t i;
+
+  TRACE_DRIVER("Frame rx deframe latency histogram (header read to push to the core):");
+  for (i = 0; i != UART_RX_DEFRAME_LATENCY_BUCKETS; i++) {
+    TRACE_DRIVER("< %u us : %u", 1U << i, rx_deframe_latency_histogram[i]);
+  }
+  TRACE_DRIVER(">= %u us : %u", 1U << UART_RX_DEFRAME_LATENCY_BUCKETS, rx_deframe_latency_histogram[UART_RX_DEFRAME_LATENCY_BUCKETS]);
+}
+
+void driver_uart_print_tx_complete_error(void)
+{
+  if (!config.uart_accurate_tx_complete || tx_complete_error.count == 0) {
+    return;
+  }
+
+  TRACE_DRIVER("Tx complete estimate error (measured - estimated) over %u frames : avg %lld us, min %lld us, max %lld us",
+               tx_complete_error.count,
+               (long long)(tx_complete_error.sum_us / tx_complete_error.count),
+               (long long)tx_complete_error.min_us,
+               (long long)tx_complete_error.max_us);
+}
+
+static int64_t timespec_diff_ns(const struct timespec *end, const struct timespec *start)
+{
+  return (int64_t)(end->tv_sec - start->tv_sec) * 1000000000 + (end->tv_nsec - start->tv_nsec);
+}
+
+static void driver_uart_record_rx_deframe_latency(const struct timespec *header_timestamp)
+{
+  struct timespec now;
+  int64_t latency_us;
+  size_t bucket = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  latency_us = timespec_diff_ns(&now, header_timestamp) / 1000;
+
+  while (bucket != UART_RX_DEFRAME_LATENCY_BUCKETS && latency_us >= ((int64_t)1 << bucket)) {
+    bucket++;
+  }
+
+  rx_deframe_latency_histogram[bucket]++;
+}
+
 static void* driver_uart_cleanup(void *param)
 {
   (void) param;
@@ -158,11 +239,18 @@ static void* driver_uart_cleanup(void *param)
   pthread_join(tx_drv_thread, NULL);
   pthread_join(rx_drv_thread, NULL);
 
+  if (config.uart_accurate_tx_complete) {
+    /* Discard what is left to transmit so that tcdrain() returns */
+    tcflush(fd_uart, TCOFLUSH);
+    pthread_join(tx_complete_thread, NULL);
+    close(fd_tx_complete_request);
+    close(fd_tx_complete_process);
+  }
+
   TRACE_DRIVER("Uart driver threads cancelled");
 
   close(fd_uart);
-  close(fd_core);
-  close(fd_core_notify);
+  driver_transport_close_driver();
   close(fd_stop_drv);
 
   pthread_exit(NULL);
@@ -222,6 +310,9 @@ static void* receive_driver_thread_func(void* param)
 
         if (current_event_fd == fd_uart) {
           driver_uart_process_uart();
+          if (config.uart_busy_poll_us != 0) {
+            driver_uart_busy_poll();
+          }
         } else if (current_event_fd == fd_stop_drv) {
           exit_thread = true;
         }
@@ -299,6 +390,30 @@ static void* transmit_driver_thread_func(void* param)
   return 0;
 }
 
+/*
+ * Ask the serial driver to push received bytes to the tty right away instead of
+ * batching them. USB bridges like the FTDI ones lower their latency timer from
+ * 16 ms to 1 ms. Not every driver supports it, the uart still works without it.
+ */
+static void driver_uart_set_low_latency(int fd, const char *device)
+{
+  struct serial_struct serial;
+
+  if (ioctl(fd, TIOCGSERIAL, &serial) < 0) {
+    WARN("%s does not support TIOCGSERIAL, low latency mode not set : %m", device);
+    return;
+  }
+
+  serial.flags = (int)((unsigned int)serial.flags | ASYNC_LOW_LATENCY);
+
+  if (ioctl(fd, TIOCSSERIAL, &serial) < 0) {
+    WARN("Failed to set %s in low latency mode : %m", device);
+    return;
+  }
+
+  TRACE_DRIVER("%s set in low latency mode", device);
+}
+
 int driver_uart_open(const char *device, unsigned int baudrate, bool hardflow)
 {
   static const struct {
@@ -353,6 +468,10 @@ int driver_uart_open(const char *device, unsigned int baudrate, bool hardflow)
 
   FATAL_SYSCALL_ON(tcsetattr(fd, TCSANOW, &tty) < 0);
 
+  if (config.uart_low_latency) {
+    driver_uart_set_low_latency(fd, device);
+  }
+
   /* Flush the content of the UART in case there was stale data */
   {
     /* There was once a bug in the kernel requiring a delay before flushing the uart.
@@ -399,179 +518,55 @@ void driver_uart_assert_rts(bool assert)
   FATAL_SYSCALL_ON(ret < 0);
 }
 
+/* Read the uart straight into the free space of the deframer ring */
 static void driver_uart_process_uart(void)
 {
-  static uint8_t buffer[UART_BUFFER_SIZE];
-  static size_t buffer_head = 0;
-  static enum {EXPECTING_HEADER, EXPECTING_PAYLOAD} state = EXPECTING_HEADER;
-
-  /* Put the read data at the tip of the buffer head and increment it. */
-  buffer_head += read_and_append_uart_received_data(buffer, buffer_head, sizeof(buffer));
-
-  while (1) {
-    switch (state) {
-      case EXPECTING_HEADER:
-        /* Synchronize the start of 'buffer' with the start of a valid header with valid checksum. */
-        if (header_re_synch(buffer, &buffer_head)) {
-          /* We are synchronized on a valid header, start delimiting the data that follows into a frame. */
-          state = EXPECTING_PAYLOAD;
-        } else {
-          /* We went through all the data contained in 'buffer' and haven't synchronized on a header.
-           * Go back to waiting for more data. */
-          return;
-        }
-        break;
-
-      case EXPECTING_PAYLOAD:
-        if (delimit_and_push_frames_to_core(buffer, &buffer_head)) {
-          /* A frame has been delimited and pushed to the core, go back to synchronizing on the next header */
-          state = EXPECTING_HEADER;
-        } else {
-          /* Not yet enough data, go back to waiting. */
-          return;
-        }
-        break;
-
-      default:
-
-        BUG("Illegal switch, Case : %d", state);
-        break;
-    }
-  }
-}
-
-/* Append UART new data to the frame delimiter processing buffer */
-static size_t read_and_append_uart_received_data(uint8_t *buffer, size_t buffer_head, size_t buffer_size)
-{
-  uint8_t temp_buffer[UART_BUFFER_SIZE];
-
-  BUG_ON(buffer_head >= buffer_size);
+  struct iovec iov[2];
+  struct timespec timestamp;
+  int iov_count;
+  ssize_t read_retval;
 
-  /* Make sure we don't read more data than the supplied buffer can handle */
-  const size_t available_space = buffer_size - buffer_head - 1;
+  iov_count = uart_deframer_get_free_space(iov);
 
-  /* Read the uart data into the temp buffer */
-  ssize_t read_retval = read(fd_uart, temp_buffer, available_space);
+  read_retval = readv(fd_uart, iov, iov_count);
   FATAL_ON(read_retval < 0);
 
-  /* copy the data in the main buffer */
-  memcpy(&buffer[buffer_head], temp_buffer, (size_t)read_retval);
-
-  return (size_t)read_retval;
+  clock_gettime(CLOCK_MONOTONIC, &timestamp);
+  uart_deframer_commit((size_t)read_retval, &timestamp);
 }
 
-static bool validate_header(uint8_t *header_start)
+/* Push a delimited frame to the core, straight from the deframer ring */
+static void driver_uart_push_frame(const struct iovec *iov, int iov_count, const struct timespec *header_timestamp)
 {
-  uint16_t hcs;
-
-  if (header_start[SLI_CPC_HDLC_FLAG_POS] != SLI_CPC_HDLC_FLAG_VAL) {
-    return false;
-  }
-
-  hcs = hdlc_get_hcs(header_start);
+  driver_transport_writev_rx(iov, iov_count);
 
-  if (!sli_cpc_validate_crc_sw(header_start, SLI_CPC_HDLC_HEADER_SIZE, hcs)) {
-    TRACE_DRIVER_INVALID_HEADER_CHECKSUM();
-    return false;
-  }
-
-  return true;
-}
-
-static bool header_re_synch(uint8_t *buffer, size_t *buffer_head)
-{
-  if (*buffer_head < SLI_CPC_HDLC_HEADER_RAW_SIZE) {
-    /* There's not enough data for a header, nothing to re-synch */
-    return false;
-  }
-
-  /* If we think of a header like a sliding window of width SLI_CPC_HDLC_HEADER_RAW_SIZE,
-   * then we can slide it 'num_header_combination' times over the data. */
-  const size_t num_header_combination = *buffer_head - SLI_CPC_HDLC_HEADER_RAW_SIZE + 1;
-
-  TRACE_DRIVER("re-sync : Will test %i header combination", num_header_combination);
-
-  size_t i;
-
-  for (i = 0; i != num_header_combination; i++) {
-    if (validate_header(&buffer[i])) {
-      if (i == 0) {
-        /* The start of the buffer is aligned with a good header, don't do anything */
-        TRACE_DRIVER("re-sync : The start of the buffer is aligned with a good header");
-      } else {
-        /* We had 'i' number of bad bytes until we struck a good header, move back the data
-         * to the beginning of the buffer */
-        memmove(&buffer[0], &buffer[i], *buffer_head - i);
-
-        /* We crushed 'i' bytes at the start of the buffer */
-        *buffer_head -= i;
-        TRACE_DRIVER("re-sync : had '%u' number of bad bytes until we struck a good header", i);
-      }
-      return true;
-    } else {
-      /* The header is not valid, continue until it is */
-    }
-  }
-
-  /* If we land here, no header at all was found. Keep the last 'SLI_CPC_HDLC_HEADER_RAW_SIZE - 1' bytes and
-   * bring them back at the start of the buffer so that the next appended byte could complete that potential header */
-  {
-    memmove(&buffer[0], &buffer[num_header_combination], SLI_CPC_HDLC_HEADER_RAW_SIZE - 1);
-
-    *buffer_head = SLI_CPC_HDLC_HEADER_RAW_SIZE - 1;
-  }
-
-  return false;
+  driver_uart_record_rx_deframe_latency(header_timestamp);
 }
 
 /*
- * In this function, it is assumed that the start of the buffer 'buffer' is aligned with the
- * start of a header because each time this function delimits a frame, it moves back the
- * remaining data back to the start of the buffer. Except when things go wrong, the start
- * if the remaining data will be the start of a next header.
+ * Keep reading the uart for uart_busy_poll_us after the last received data before going
+ * back to sleep in epoll, so that the next frame of a burst is read without a wakeup.
  */
-static bool delimit_and_push_frames_to_core(uint8_t *buffer, size_t *buffer_head)
+static void driver_uart_busy_poll(void)
 {
-  uint16_t payload_len; /* The length of the payload, as retrieved from the header (including the checksum) */
-  size_t frame_size; /* The whole size of the frame */
-
-  /* if not enough bytes even for a header */
-  if (*buffer_head < SLI_CPC_HDLC_HEADER_RAW_SIZE) {
-    return false;
-  }
-
-  payload_len = hdlc_get_length(buffer);
-
-  frame_size = payload_len + SLI_CPC_HDLC_HEADER_RAW_SIZE;
-
-  /* Check if we have enough data for a full frame*/
-  if (frame_size > *buffer_head) {
-    return false;
-  }
-
-  /* Push to core */
-  {
-    TRACE_FRAME("Driver : Frame delimiter : push delimited frame to core : ", buffer, frame_size);
-
-    ssize_t write_retval = write(fd_core, buffer, frame_size);
-    FATAL_SYSCALL_ON(write_retval < 0);
-
-    /* Error if write is not complete */
-    FATAL_ON((size_t)write_retval != frame_size);
-  }
+  struct timespec now;
+  struct timespec last_activity;
+  int available;
+  int ret;
 
-  /* Move the remaining data back to the start of the buffer. */
-  {
-    const size_t remaining_bytes = *buffer_head - frame_size;
+  clock_gettime(CLOCK_MONOTONIC, &last_activity);
 
-    memmove(buffer, &buffer[frame_size], remaining_bytes);
+  do {
+    ret = ioctl(fd_uart, FIONREAD, &available);
+    FATAL_SYSCALL_ON(ret < 0);
 
-    /* Adjust the buffer_head now that we have modified the buffer's content */
-    *buffer_head = remaining_bytes;
-  }
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-  /* A complete frame has been delimited. A second round of parsing can be done. */
-  return true;
+    if (available > 0) {
+      driver_uart_process_uart();
+      last_activity = now;
+    }
+  } while (timespec_diff_ns(&now, &last_activity) < (int64_t)config.uart_busy_poll_us * 1000);
 }
 
 static long driver_get_time_to_drain_ns(uint32_t bytes_left)
@@ -593,9 +588,13 @@ static void driver_uart_process_core(void)
   ssize_t read_retval;
 
   {
-    read_retval = read(fd_core, buffer, sizeof(buffer));
+    read_retval = driver_transport_read_tx(buffer, sizeof(buffer));
 
-    FATAL_SYSCALL_ON(read_retval < 0);
+    /* The ring doorbell can be readable after the ring was drained */
+    if (read_retval == -EAGAIN) {
+      return;
+    }
+    FATAL_ON(read_retval < 0);
   }
 
   {
@@ -620,7 +619,163 @@ static void driver_uart_process_core(void)
   tx_complete_timestamp.tv_nsec += driver_get_time_to_drain_ns((uint32_t)length);
   tx_complete_timestamp.tv_nsec %= 1000000000;
 
+  if (config.uart_accurate_tx_complete) {
+    /* Let the tx complete thread notify the core once the frame actually left, the estimate is kept to measure its error */
+    ssize_t write_retval = write(fd_tx_complete_request, &tx_complete_timestamp, sizeof(tx_complete_timestamp));
+    FATAL_SYSCALL_ON(write_retval != sizeof(tx_complete_timestamp));
+    return;
+  }
+
   /* Push write notification to core */
-  ssize_t write_retval = write(fd_core_notify, &tx_complete_timestamp, sizeof(tx_complete_timestamp));
-  FATAL_SYSCALL_ON(write_retval != sizeof(tx_complete_timestamp));
+  driver_transport_write_tx_complete(&tx_complete_timestamp);
+}
+
+/*
+ * Wait until the uart has transmitted everything that was written to it.
+ *
+ * @return false if the serial driver does not support the current mode
+ */
+static bool driver_uart_wait_tx_empty(void)
+{
+  unsigned int lsr;
+  int length;
+
+  switch (tx_complete_mode) {
+    case TX_COMPLETE_LSR:
+      while (1) {
+        if (ioctl(fd_uart, TIOCSERGETLSR, &lsr) < 0) {
+          return false;
+        }
+
+        if (lsr & TIOCSER_TEMT) {
+          return true;
+        }
+
+        /* Sleep for the time the bytes left in the driver take to go out, at least one byte */
+        if (ioctl(fd_uart, TIOCOUTQ, &length) < 0 || length < 1) {
+          length = 1;
+        }
+        sleep_us((uint32_t)(driver_get_time_to_drain_ns((uint32_t)length) / 1000) + 1);
+      }
+
+    case TX_COMPLETE_TCDRAIN:
+      while (tcdrain(fd_uart) < 0) {
+        if (errno != EINTR) {
+          return false;
+        }
+      }
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+static void driver_uart_record_tx_complete_error(const struct timespec *measured, const struct timespec *estimated)
+{
+  int64_t error_us = timespec_diff_ns(measured, estimated) / 1000;
+
+  if (tx_complete_error.count == 0 || error_us < tx_complete_error.min_us) {
+    tx_complete_error.min_us = error_us;
+  }
+  if (tx_complete_error.count == 0 || error_us > tx_complete_error.max_us) {
+    tx_complete_error.max_us = error_us;
+  }
+  tx_complete_error.sum_us += error_us;
+  tx_complete_error.count++;
+}
+
+/*
+ * Notify the core of the completion of the frames written by the transmit thread. Every
+ * frame written before the uart went empty is complete: they are notified together, and
+ * the estimate of the last one is compared to the measured time.
+ */
+static void driver_uart_process_tx_complete(void)
+{
+  struct timespec estimated_timestamps[UART_TX_COMPLETE_MAX_PENDING];
+  struct timespec tx_complete_timestamp;
+  size_t frame_count = 0;
+  size_t i;
+
+  while (frame_count != UART_TX_COMPLETE_MAX_PENDING) {
+    ssize_t read_retval = recv(fd_tx_complete_process, &estimated_timestamps[frame_count], sizeof(struct timespec), MSG_DONTWAIT);
+    if (read_retval < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    FATAL_SYSCALL_ON(read_retval != sizeof(struct timespec));
+    frame_count++;
+  }
+
+  if (frame_count == 0) {
+    return;
+  }
+
+  if (tx_complete_mode == TX_COMPLETE_LSR && !driver_uart_wait_tx_empty()) {
+    WARN("Reading the line status register failed, falling back to tcdrain()");
+    tx_complete_mode = TX_COMPLETE_TCDRAIN;
+  }
+
+  if (tx_complete_mode == TX_COMPLETE_TCDRAIN && !driver_uart_wait_tx_empty()) {
+    WARN("tcdrain() failed : %m, falling back to the estimated tx complete time");
+    tx_complete_mode = TX_COMPLETE_ESTIMATE;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &tx_complete_timestamp);
+
+  if (tx_complete_mode != TX_COMPLETE_ESTIMATE) {
+    driver_uart_record_tx_complete_error(&tx_complete_timestamp, &estimated_timestamps[frame_count - 1]);
+  }
+
+  for (i = 0; i != frame_count; i++) {
+    const struct timespec *timestamp = tx_complete_mode == TX_COMPLETE_ESTIMATE ? &estimated_timestamps[i] : &tx_complete_timestamp;
+
+    driver_transport_write_tx_complete(timestamp);
+  }
+}
+
+static void* tx_complete_thread_func(void* param)
+{
+  struct epoll_event events[2] = {};
+  bool exit_thread = false;
+  int fd_epoll;
+  int ret;
+
+  (void) param;
+
+  TRACE_DRIVER("Tx complete thread start");
+
+  fd_epoll = epoll_create1(EPOLL_CLOEXEC);
+  FATAL_SYSCALL_ON(fd_epoll < 0);
+
+  events[0].events = EPOLLIN;
+  events[0].data.fd = fd_tx_complete_process;
+  ret = epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd_tx_complete_process, &events[0]);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  events[1].events = EPOLLIN;
+  events[1].data.fd = fd_stop_drv;
+  ret = epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd_stop_drv, &events[1]);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  while (!exit_thread) {
+    int event_count;
+    int event_i;
+
+    do {
+      event_count = epoll_wait(fd_epoll, events, 2, -1);
+    } while (event_count == -1 && errno == EINTR);
+    FATAL_SYSCALL_ON(event_count == -1);
+
+    for (event_i = 0; event_i != event_count; event_i++) {
+      if (events[event_i].data.fd == fd_tx_complete_process) {
+        driver_uart_process_tx_complete();
+      } else if (events[event_i].data.fd == fd_stop_drv) {
+        exit_thread = true;
+      }
+    }
+  }
+
+  close(fd_epoll);
+
+  return 0;
 }
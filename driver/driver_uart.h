@@ -34,4 +34,17 @@ void driver_uart_assert_rts(bool assert);
 
 void driver_uart_print_overruns(void);
 
+/*
+ * Print the histogram of the time each frame spends in the daemon before its
+ * push to the core, from the read that completed its header. The time the
+ * bytes spent in the kernel or in a USB-serial bridge is not included.
+ */
+void driver_uart_print_rx_deframe_latency(void);
+
+/*
+ * Print how far the estimated tx complete timestamps were from the measured ones,
+ * when uart_accurate_tx_complete is enabled.
+ */
+void driver_uart_print_tx_complete_error(void);
+
 #endif //DRIVER_UART_H
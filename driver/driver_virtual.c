@@ -0,0 +1,270 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol (CPC) - Virtual secondary driver
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+
+#include "misc/config.h"
+#include "misc/logging.h"
+#include "driver/driver_virtual.h"
+#include "driver/driver_kill.h"
+#include "driver/driver_transport.h"
+#include "server_core/core/hdlc.h"
+#include "server_core/core/crc.h"
+#include "bench/virtual_secondary/virtual_secondary.h"
+#include "sl_cpc.h"
+
+static int fd_core;
+static int fd_stop_drv;
+static int fd_timer;
+static pthread_t drv_thread;
+
+/* Round trip time of the last acknowledged frame of each endpoint, written by the driver thread */
+static uint64_t link_rtt_ns[SL_CPC_ENDPOINT_COUNT];
+
+/* Measured minus link round trip time, in microseconds. Only used by the core thread */
+typedef struct {
+  uint32_t count;
+  int64_t sum_us;
+  int64_t min_us;
+  int64_t max_us;
+} rtt_error_t;
+
+static rtt_error_t rtt_sample_error;
+static rtt_error_t smoothed_rtt_error;
+
+static void driver_virtual_output(const uint8_t *frame, size_t length);
+static void driver_virtual_record_link_rtt(uint8_t endpoint_id, uint64_t rtt_ns);
+static void* driver_thread_func(void* param);
+
+pthread_t driver_virtual_init(int *fd_to_core, int *fd_notify_core)
+{
+  virtual_secondary_config_t secondary_config;
+  int ret;
+
+  virtual_secondary_default_config(&secondary_config);
+  secondary_config.link_rate = config.virtual_link_rate;
+  secondary_config.bus_speed = config.virtual_link_rate;
+  secondary_config.latency_us = config.virtual_latency_us;
+  secondary_config.bit_error_rate = config.virtual_bit_error_rate;
+  secondary_config.processing_delay_us = config.virtual_processing_delay_us;
+  secondary_config.echo_endpoint = (uint8_t)config.virtual_echo_endpoint;
+  secondary_config.echo_count = (uint8_t)config.virtual_echo_count;
+  secondary_config.sink_endpoint = (uint8_t)(config.virtual_echo_endpoint + config.virtual_echo_count);
+  secondary_config.source_endpoint = (uint8_t)(config.virtual_echo_endpoint + config.virtual_echo_count + 1);
+
+  driver_transport_init(config.driver_use_socketpair, &fd_core, fd_to_core, fd_notify_core);
+
+  fd_stop_drv = driver_kill_init();
+
+  fd_timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  FATAL_SYSCALL_ON(fd_timer < 0);
+
+  /* The secondary only runs in the driver thread from now on */
+  virtual_secondary_init(&secondary_config, driver_virtual_output);
+  virtual_secondary_set_rtt_callback(driver_virtual_record_link_rtt);
+
+  ret = pthread_create(&drv_thread, NULL, driver_thread_func, NULL);
+  FATAL_ON(ret != 0);
+
+  ret = pthread_setname_np(drv_thread, "drv_thread");
+  FATAL_ON(ret != 0);
+
+  TRACE_DRIVER("Virtual secondary driver initialized");
+
+  return drv_thread;
+}
+
+static void driver_virtual_record_link_rtt(uint8_t endpoint_id, uint64_t rtt_ns)
+{
+  /* Stored before the acknowledgement reaches the core, which reads it when processing it */
+  __atomic_store_n(&link_rtt_ns[endpoint_id], rtt_ns, __ATOMIC_RELEASE);
+}
+
+static void rtt_error_add(rtt_error_t *error, int64_t error_us)
+{
+  if (error->count == 0 || error_us < error->min_us) {
+    error->min_us = error_us;
+  }
+  if (error->count == 0 || error_us > error->max_us) {
+    error->max_us = error_us;
+  }
+  error->sum_us += error_us;
+  error->count++;
+}
+
+void driver_virtual_record_rtt(uint8_t endpoint_id, long rtt_ms, long smoothed_rtt_ms)
+{
+  int64_t link_rtt_us = (int64_t)(__atomic_load_n(&link_rtt_ns[endpoint_id], __ATOMIC_ACQUIRE) / 1000);
+
+  if (link_rtt_us == 0) {
+    return;
+  }
+
+  rtt_error_add(&rtt_sample_error, (int64_t)rtt_ms * 1000 - link_rtt_us);
+  rtt_error_add(&smoothed_rtt_error, (int64_t)smoothed_rtt_ms * 1000 - link_rtt_us);
+}
+
+static void rtt_error_print(const char *name, const rtt_error_t *error)
+{
+  TRACE_DRIVER("%s error (measured - link) over %u frames : avg %lld us, min %lld us, max %lld us",
+               name,
+               error->count,
+               (long long)(error->sum_us / error->count),
+               (long long)error->min_us,
+               (long long)error->max_us);
+}
+
+void driver_virtual_print_rtt_error(void)
+{
+  if (rtt_sample_error.count == 0) {
+    return;
+  }
+
+  rtt_error_print("RTT sample", &rtt_sample_error);
+  rtt_error_print("Smoothed RTT", &smoothed_rtt_error);
+}
+
+/*
+ * Frames from the secondary. The corrupted headers are dropped here as the
+ * UART driver would while looking for the next valid header.
+ */
+static void driver_virtual_output(const uint8_t *frame, size_t length)
+{
+  if (hdlc_get_flag(frame) != SLI_CPC_HDLC_FLAG_VAL
+      || !sli_cpc_validate_crc_sw(frame, SLI_CPC_HDLC_HEADER_SIZE, hdlc_get_hcs(frame))
+      || SLI_CPC_HDLC_HEADER_RAW_SIZE + (size_t)hdlc_get_length(frame) != length) {
+    TRACE_DRIVER("Dropped a frame with an invalid header");
+    return;
+  }
+
+  driver_transport_write_rx(frame, length);
+}
+
+static bool driver_virtual_process_core(void)
+{
+  uint8_t frame[VIRTUAL_SECONDARY_MAX_FRAME_SIZE];
+
+  while (1) {
+    ssize_t length = driver_transport_read_tx(frame, sizeof(frame));
+    struct timespec tx_complete;
+    uint64_t tx_complete_ns;
+
+    if (length == -EAGAIN) {
+      return true;
+    }
+
+    if (length == 0) {
+      return false;
+    }
+
+    FATAL_ON(length < 0);
+
+    tx_complete_ns = virtual_secondary_receive(frame, (size_t)length);
+    tx_complete.tv_sec = (time_t)(tx_complete_ns / 1000000000ULL);
+    tx_complete.tv_nsec = (long)(tx_complete_ns % 1000000000ULL);
+
+    driver_transport_write_tx_complete(&tx_complete);
+  }
+}
+
+static void driver_virtual_arm_timer(void)
+{
+  uint64_t deadline = virtual_secondary_next_deadline();
+  struct itimerspec timeout = { 0 };
+  int ret;
+
+  /* An all-zero it_value disarms the timer */
+  if (deadline != 0) {
+    timeout.it_value.tv_sec = (time_t)(deadline / 1000000000ULL);
+    timeout.it_value.tv_nsec = (long)(deadline % 1000000000ULL);
+  }
+
+  ret = timerfd_settime(fd_timer, TFD_TIMER_ABSTIME, &timeout, NULL);
+  FATAL_SYSCALL_ON(ret < 0);
+}
+
+static void* driver_thread_func(void* param)
+{
+  struct epoll_event events[3] = {};
+  bool exit_thread = false;
+  int fd_epoll;
+  int ret;
+
+  (void) param;
+
+  fd_epoll = epoll_create1(EPOLL_CLOEXEC);
+  FATAL_SYSCALL_ON(fd_epoll < 0);
+
+  events[0].events = EPOLLIN;
+  events[0].data.fd = fd_core;
+  ret = epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd_core, &events[0]);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  events[1].events = EPOLLIN;
+  events[1].data.fd = fd_stop_drv;
+  ret = epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd_stop_drv, &events[1]);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  events[2].events = EPOLLIN;
+  events[2].data.fd = fd_timer;
+  ret = epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd_timer, &events[2]);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  while (!exit_thread) {
+    int event_count;
+
+    do {
+      event_count = epoll_wait(fd_epoll, events, 3, -1);
+    } while (event_count == -1 && errno == EINTR);
+    FATAL_SYSCALL_ON(event_count == -1);
+
+    for (int i = 0; i < event_count; i++) {
+      int current_event_fd = events[i].data.fd;
+
+      if (current_event_fd == fd_core) {
+        if (!driver_virtual_process_core()) {
+          exit_thread = true;
+        }
+      } else if (current_event_fd == fd_timer) {
+        uint64_t expiration;
+        ssize_t retval = read(fd_timer, &expiration, sizeof(expiration));
+        FATAL_SYSCALL_ON(retval < 0 && errno != EAGAIN);
+      } else if (current_event_fd == fd_stop_drv) {
+        exit_thread = true;
+      }
+    }
+
+    virtual_secondary_process(virtual_secondary_now());
+    driver_virtual_arm_timer();
+  }
+
+  close(fd_epoll);
+  close(fd_timer);
+  driver_transport_close_driver();
+  close(fd_stop_drv);
+
+  TRACE_DRIVER("Virtual secondary driver thread exited");
+
+  return NULL;
+}
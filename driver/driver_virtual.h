@@ -0,0 +1,41 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol (CPC) - Virtual secondary driver
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef DRIVER_VIRTUAL_H
+#define DRIVER_VIRTUAL_H
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+
+/*
+ * Initialize the virtual secondary driver. The secondary runs in the driver
+ * thread and exchanges frames with the core directly, the link is modeled
+ * after the virtual_* config values.
+ */
+pthread_t driver_virtual_init(int *fd_to_core, int *fd_notify_core);
+
+/*
+ * Compare a round trip time measured by the core on an endpoint, and the
+ * smoothed round trip time updated with it, to the round trip time the link
+ * model gave the same frame. Called from the core thread.
+ */
+void driver_virtual_record_rtt(uint8_t endpoint_id, long rtt_ms, long smoothed_rtt_ms);
+
+void driver_virtual_print_rtt_error(void);
+
+#endif //DRIVER_VIRTUAL_H
@@ -0,0 +1,295 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - UART Deframer
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "misc/logging.h"
+#include "driver/uart_deframer.h"
+#include "server_core/core/crc.h"
+
+/* Size of the receive ring, a power of two larger than the largest frame */
+#define RX_RING_SIZE 16384U
+#define RX_RING_MASK (RX_RING_SIZE - 1)
+
+/*
+ * The head and tail are free running indexes, the frames are delivered from
+ * where they were received.
+ */
+static uint8_t rx_ring[RX_RING_SIZE];
+static size_t rx_ring_head = 0; /* Index of the next byte received */
+static size_t rx_ring_tail = 0; /* Index of the first byte not yet delimited */
+
+static enum {EXPECTING_HEADER, EXPECTING_PAYLOAD} state = EXPECTING_HEADER;
+
+static struct timespec rx_read_timestamp; /* When the last bytes were received */
+static struct timespec rx_frame_timestamp; /* When the header of the frame being delimited was received */
+
+static uart_deframer_on_frame_t frame_callback;
+
+/*
+ * Call this function in loop over the ring to delimit and deliver the frames
+ *
+ * @return Whether or not this call has delimited a frame, in other words,
+ *         shall this function be called again in a loop
+ */
+static bool delimit_frame(void);
+
+/*
+ * Insures the tail of the ring is aligned with the start of a valid checksum
+ * and re-synch in case the ring starts with garbage.
+ */
+static bool header_re_synch(void);
+
+void uart_deframer_init(uart_deframer_on_frame_t on_frame)
+{
+  frame_callback = on_frame;
+  rx_ring_head = 0;
+  rx_ring_tail = 0;
+  state = EXPECTING_HEADER;
+}
+
+static inline size_t rx_ring_count(void)
+{
+  return rx_ring_head - rx_ring_tail;
+}
+
+/*
+ * Describe 'length' bytes of the ring starting at 'index' with one iovec, or two
+ * when they wrap around the end of the ring.
+ *
+ * @return The number of iovecs used
+ */
+static int rx_ring_iov(size_t index, size_t length, struct iovec iov[2])
+{
+  size_t offset = index & RX_RING_MASK;
+  size_t first_length = RX_RING_SIZE - offset;
+
+  if (length <= first_length) {
+    iov[0].iov_base = &rx_ring[offset];
+    iov[0].iov_len = length;
+    return 1;
+  }
+
+  iov[0].iov_base = &rx_ring[offset];
+  iov[0].iov_len = first_length;
+  iov[1].iov_base = &rx_ring[0];
+  iov[1].iov_len = length - first_length;
+  return 2;
+}
+
+/*
+ * Get a header located at 'index' in the ring. Only a header wrapping around the
+ * end of the ring is copied, to 'scratch'.
+ */
+static const uint8_t *rx_ring_header(size_t index, uint8_t scratch[SLI_CPC_HDLC_HEADER_RAW_SIZE])
+{
+  struct iovec iov[2];
+
+  if (rx_ring_iov(index, SLI_CPC_HDLC_HEADER_RAW_SIZE, iov) == 1) {
+    return iov[0].iov_base;
+  }
+
+  memcpy(scratch, iov[0].iov_base, iov[0].iov_len);
+  memcpy(&scratch[iov[0].iov_len], iov[1].iov_base, iov[1].iov_len);
+
+  return scratch;
+}
+
+int uart_deframer_get_free_space(struct iovec iov[2])
+{
+  const size_t available_space = RX_RING_SIZE - rx_ring_count();
+
+  /* A frame never fills the ring, there is always room for new data */
+  BUG_ON(available_space == 0);
+
+  return rx_ring_iov(rx_ring_head, available_space, iov);
+}
+
+void uart_deframer_commit(size_t length, const struct timespec *timestamp)
+{
+  BUG_ON(length > RX_RING_SIZE - rx_ring_count());
+
+  rx_ring_head += length;
+  rx_read_timestamp = *timestamp;
+
+  while (1) {
+    switch (state) {
+      case EXPECTING_HEADER:
+        /* Synchronize the tail of the ring with the start of a valid header with valid checksum. */
+        if (header_re_synch()) {
+          /* We are synchronized on a valid header, start delimiting the data that follows into a frame. */
+          state = EXPECTING_PAYLOAD;
+          rx_frame_timestamp = rx_read_timestamp;
+        } else {
+          /* We went through all the data contained in the ring and haven't synchronized on a header.
+           * Go back to waiting for more data. */
+          return;
+        }
+        break;
+
+      case EXPECTING_PAYLOAD:
+        if (delimit_frame()) {
+          /* A frame has been delivered, go back to synchronizing on the next header */
+          state = EXPECTING_HEADER;
+        } else {
+          /* Not yet enough data, go back to waiting. */
+          return;
+        }
+        break;
+
+      default:
+
+        BUG("Illegal switch, Case : %d", state);
+        break;
+    }
+  }
+}
+
+static bool validate_header(const uint8_t *header_start)
+{
+  uint16_t hcs;
+
+  if (header_start[SLI_CPC_HDLC_FLAG_POS] != SLI_CPC_HDLC_FLAG_VAL) {
+    return false;
+  }
+
+  hcs = hdlc_get_hcs(header_start);
+
+  if (!sli_cpc_validate_crc_sw(header_start, SLI_CPC_HDLC_HEADER_SIZE, hcs)) {
+    TRACE_DRIVER_INVALID_HEADER_CHECKSUM();
+    return false;
+  }
+
+  return true;
+}
+
+/*
+ * Only a flag byte can start a header: find the next one with memchr, vectorized
+ * by the C library, over the one or two contiguous parts of the ring.
+ *
+ * @return The number of bytes before the flag, 'length' when there is none
+ */
+static size_t rx_ring_find_flag(size_t index, size_t length)
+{
+  struct iovec iov[2];
+  int iov_count;
+  int i;
+  size_t offset = 0;
+
+  iov_count = rx_ring_iov(index, length, iov);
+
+  for (i = 0; i != iov_count; i++) {
+    const uint8_t *flag = memchr(iov[i].iov_base, SLI_CPC_HDLC_FLAG_VAL, iov[i].iov_len);
+
+    if (flag != NULL) {
+      return offset + (size_t)(flag - (const uint8_t *)iov[i].iov_base);
+    }
+
+    offset += iov[i].iov_len;
+  }
+
+  return length;
+}
+
+static bool header_re_synch(void)
+{
+  /* Bytes discarded since the last good header, kept across calls to report whole re-synchs */
+  static size_t bytes_discarded = 0;
+  uint8_t scratch[SLI_CPC_HDLC_HEADER_RAW_SIZE];
+  size_t skipped;
+
+  while (rx_ring_count() >= SLI_CPC_HDLC_HEADER_RAW_SIZE) {
+    /* Drop the garbage up to the next flag byte, the checksum is only computed on candidate headers */
+    skipped = rx_ring_find_flag(rx_ring_tail, rx_ring_count());
+    rx_ring_tail += skipped;
+    bytes_discarded += skipped;
+    EVENT_COUNTER_ADD(driver_resync_bytes_discarded, (uint32_t)skipped);
+
+    if (rx_ring_count() < SLI_CPC_HDLC_HEADER_RAW_SIZE) {
+      /* Keep the flag and what follows so that the next appended bytes could complete that potential header */
+      break;
+    }
+
+    if (validate_header(rx_ring_header(rx_ring_tail, scratch))) {
+      if (bytes_discarded != 0) {
+        TRACE_DRIVER_RESYNC(bytes_discarded);
+        bytes_discarded = 0;
+      }
+      return true;
+    }
+
+    /* The header is not valid, drop its flag and look for the next one */
+    rx_ring_tail++;
+    bytes_discarded++;
+    EVENT_COUNTER_INC(driver_resync_bytes_discarded);
+  }
+
+  return false;
+}
+
+/*
+ * In this function, it is assumed that the tail of the ring is aligned with the
+ * start of a header because each time this function delimits a frame, it moves the
+ * tail past it. Except when things go wrong, the tail will be the start of a next header.
+ */
+static bool delimit_frame(void)
+{
+  uint8_t scratch[SLI_CPC_HDLC_HEADER_RAW_SIZE];
+  struct iovec iov[2];
+  int iov_count;
+  uint16_t payload_len; /* The length of the payload, as retrieved from the header (including the checksum) */
+  size_t frame_size; /* The whole size of the frame */
+
+  /* if not enough bytes even for a header */
+  if (rx_ring_count() < SLI_CPC_HDLC_HEADER_RAW_SIZE) {
+    return false;
+  }
+
+  payload_len = hdlc_get_length(rx_ring_header(rx_ring_tail, scratch));
+
+  frame_size = payload_len + SLI_CPC_HDLC_HEADER_RAW_SIZE;
+
+  /* A length the ring cannot hold comes from a corrupted header, drop its flag and re-synch */
+  if (frame_size > UART_DEFRAMER_MAX_FRAME_SIZE) {
+    TRACE_DRIVER("Frame delimiter : invalid frame length %u, re-synch", payload_len);
+    rx_ring_tail++;
+    return true;
+  }
+
+  /* Check if we have enough data for a full frame*/
+  if (frame_size > rx_ring_count()) {
+    return false;
+  }
+
+  /* Deliver the frame straight from the ring */
+  iov_count = rx_ring_iov(rx_ring_tail, frame_size, iov);
+
+  TRACE_FRAME("Driver : Frame delimiter : push delimited frame to core : ", iov[0].iov_base, iov[0].iov_len);
+  if (iov_count == 2) {
+    TRACE_FRAME("Driver : Frame delimiter : push delimited frame to core (wrapped) : ", iov[1].iov_base, iov[1].iov_len);
+  }
+
+  frame_callback(iov, iov_count, &rx_frame_timestamp);
+
+  /* The frame is consumed, the next header starts right after it. */
+  rx_ring_tail += frame_size;
+
+  /* A complete frame has been delimited. A second round of parsing can be done. */
+  return true;
+}
@@ -0,0 +1,63 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - UART Deframer
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef UART_DEFRAMER_H
+#define UART_DEFRAMER_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/uio.h>
+
+#include "server_core/core/hdlc.h"
+
+/*
+ * Delimits the frames in the bytes received from the uart. The bytes are
+ * written by the caller straight into a ring and the frames are handed out from
+ * where they were received, in one or two parts when they wrap around the end
+ * of the ring. The data is never moved.
+ *
+ * The deframer does no I/O, so that it can be driven by the uart driver as well
+ * as by a benchmark. Nothing is thread-safe, all the functions must be called
+ * from the same thread.
+ */
+
+/* The largest frame: a header and the largest payload with its checksum */
+#define UART_DEFRAMER_MAX_FRAME_SIZE (4096 + SLI_CPC_HDLC_HEADER_RAW_SIZE)
+
+/*
+ * Called for each frame delimited, with the timestamp of the data that completed
+ * its header. The frame is only valid during the call.
+ */
+typedef void (*uart_deframer_on_frame_t)(const struct iovec *iov, int iov_count, const struct timespec *header_timestamp);
+
+void uart_deframer_init(uart_deframer_on_frame_t on_frame);
+
+/*
+ * Describe the free space of the ring, where the next bytes received must be
+ * written. A frame never fills the ring, there is always some space.
+ *
+ * @return The number of iovecs used, 1 or 2
+ */
+int uart_deframer_get_free_space(struct iovec iov[2]);
+
+/*
+ * Append 'length' bytes written in the free space, received at 'timestamp', and
+ * deliver the frames they complete.
+ */
+void uart_deframer_commit(size_t length, const struct timespec *timestamp);
+
+#endif //UART_DEFRAMER_H
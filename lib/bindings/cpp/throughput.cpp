@@ -0,0 +1,303 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - C++ Throughput Sample
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+// Sends frames to an endpoint whose secondary application echoes them back and
+// reports the throughput. The buffers are allocated before the transfer starts:
+// the number of heap allocations done during the transfer is reported as well
+// and is expected to stay at 0.
+//
+// With glibc, the allocation functions of the C library are interposed here:
+// the allocations of libcpc and of the C library are counted, as well as those
+// of operator new, which allocates with malloc. Elsewhere, only the global
+// operator new is replaced and the allocations of the C code are not counted.
+//
+// usage: cpc_cpp_throughput [instance] [endpoint id] [frame count] [frame size]
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "sl_cpc.hpp"
+
+static std::atomic<size_t> heap_allocations;
+
+static void count_allocation()
+{
+  heap_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+#ifdef __GLIBC__
+
+// The glibc allocator, under the names it exports besides the interposed ones
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+extern "C" void *__libc_valloc(size_t size);
+extern "C" void *__libc_pvalloc(size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+  count_allocation();
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  count_allocation();
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  count_allocation();
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size)
+{
+  count_allocation();
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size)
+{
+  count_allocation();
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+
+  count_allocation();
+  void *allocated = __libc_memalign(alignment, size);
+  if (allocated == nullptr) {
+    return ENOMEM;
+  }
+
+  *ptr = allocated;
+  return 0;
+}
+
+extern "C" void *valloc(size_t size)
+{
+  count_allocation();
+  return __libc_valloc(size);
+}
+
+extern "C" void *pvalloc(size_t size)
+{
+  count_allocation();
+  return __libc_pvalloc(size);
+}
+
+#else
+
+static void *counted_new(size_t size, size_t alignment)
+{
+  void *ptr;
+
+  count_allocation();
+
+  if (size == 0) {
+    size = 1;
+  }
+
+  if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    ptr = std::malloc(size);
+  } else {
+    // aligned_alloc() wants a size multiple of the alignment
+    ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+  }
+
+  return ptr;
+}
+
+static void *throwing_new(size_t size, size_t alignment)
+{
+  if (void *ptr = counted_new(size, alignment)) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+void *operator new(size_t size)
+{
+  return throwing_new(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new[](size_t size)
+{
+  return throwing_new(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+  return throwing_new(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+  return throwing_new(size, static_cast<size_t>(alignment));
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_new(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_new(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+  return counted_new(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+  return counted_new(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+  std::free(ptr);
+}
+
+#endif
+
+int main(int argc, char *argv[])
+{
+  const char *instance_name = argc > 1 ? argv[1] : nullptr;
+  uint8_t endpoint_id = static_cast<uint8_t>(argc > 2 ? std::atoi(argv[2]) : SL_CPC_ENDPOINT_USER_ID_0);
+  size_t frame_count = argc > 3 ? std::strtoul(argv[3], nullptr, 0) : 10000;
+  size_t frame_size = argc > 4 ? std::strtoul(argv[4], nullptr, 0) : 64;
+  constexpr size_t batch_size = 32;
+
+  try {
+    cpc::Handle handle(instance_name);
+    cpc::Endpoint endpoint = handle.open_endpoint(endpoint_id);
+
+    if (frame_size == 0 || frame_size > endpoint.max_write_size()) {
+      std::fprintf(stderr, "frame size must be between 1 and %zu\n", endpoint.max_write_size());
+      return EXIT_FAILURE;
+    }
+
+    std::vector<std::byte> tx_frame(frame_size, std::byte{ 0x5a });
+    cpc::FrameBatch rx_batch(batch_size);
+    size_t frames_sent = 0;
+    size_t frames_received = 0;
+    size_t bytes_received = 0;
+
+    size_t allocations_before = heap_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+
+    while (frames_received < frame_count) {
+      // Keep at most one batch in flight, the echo comes back in the same order
+      while (frames_sent < frame_count && frames_sent - frames_received < batch_size) {
+        endpoint.write(tx_frame);
+        frames_sent++;
+      }
+
+      endpoint.read(rx_batch);
+      for (const cpc::FrameBatch::Frame &frame : rx_batch) {
+        bytes_received += frame.data.size();
+      }
+      frames_received += rx_batch.size();
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    size_t allocations = heap_allocations.load() - allocations_before;
+
+    std::printf("%zu frames of %zu bytes in %.3f s\n", frames_received, frame_size, elapsed.count());
+    std::printf("%.0f frames/s, %.3f Mbit/s\n",
+                static_cast<double>(frames_received) / elapsed.count(),
+                static_cast<double>(bytes_received) * 8 / elapsed.count() / 1e6);
+    std::printf("heap allocations during the transfer: %zu\n", allocations);
+  } catch (const cpc::Error &error) {
+    std::fprintf(stderr, "%s: %s\n", error.what(), error.code().message().c_str());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+//! Round trips on the command endpoint of the test secondary, which answers
+//! every frame. Compares the blocking reads, with and without a fresh `Vec`
+//! per frame, to the asynchronous endpoint.
+//!
+//! `cargo bench --features async`, the number of round trips can be set with
+//! `RUST_LIBCPC_BENCH_ITERATIONS`.
+
+use std::time::{Duration, Instant};
+
+use bytes::BytesMut;
+use libcpc::async_endpoint::AsyncEndpoint;
+use libcpc::sl_cpc;
+
+const FRAME: &[u8] = b"TEST\0";
+
+const READ_FLAG_NONE: sl_cpc::cpc_endpoint_read_flags_t =
+    sl_cpc::cpc_endpoint_read_flags_t_enum::CPC_ENDPOINT_READ_FLAG_NONE
+        as sl_cpc::cpc_endpoint_read_flags_t;
+const WRITE_FLAG_NONE: sl_cpc::cpc_endpoint_write_flags_t =
+    sl_cpc::cpc_endpoint_write_flags_t_enum::CPC_ENDPOINT_WRITE_FLAG_NONE
+        as sl_cpc::cpc_endpoint_write_flags_t;
+
+fn report(name: &str, iterations: usize, elapsed: Duration) {
+    println!(
+        "{name:<28} {iterations} round trips in {:>8.3} ms, {:>10.0} round trips/s",
+        elapsed.as_secs_f64() * 1000.0,
+        iterations as f64 / elapsed.as_secs_f64()
+    );
+}
+
+fn bench_blocking_vec(endpoint: &libcpc::cpc_endpoint, iterations: usize) {
+    let frame = FRAME.to_vec();
+    let start = Instant::now();
+
+    for _ in 0..iterations {
+        libcpc::write_endpoint(endpoint, &frame, WRITE_FLAG_NONE).unwrap();
+        libcpc::read_endpoint(endpoint, READ_FLAG_NONE).unwrap();
+    }
+
+    report("blocking, Vec per read", iterations, start.elapsed());
+}
+
+fn bench_blocking_into(endpoint: &libcpc::cpc_endpoint, iterations: usize) {
+    let frame = FRAME.to_vec();
+    let mut buffer = libcpc::cpc_buffer();
+    let start = Instant::now();
+
+    for _ in 0..iterations {
+        libcpc::write_endpoint(endpoint, &frame, WRITE_FLAG_NONE).unwrap();
+        libcpc::read_endpoint_into(endpoint, &mut buffer, READ_FLAG_NONE).unwrap();
+    }
+
+    report("blocking, caller buffer", iterations, start.elapsed());
+}
+
+async fn bench_async(endpoint: &AsyncEndpoint, iterations: usize) {
+    let mut buffer = BytesMut::with_capacity(libcpc::async_endpoint::FRAME_CAPACITY);
+    let start = Instant::now();
+
+    for _ in 0..iterations {
+        endpoint.write_frame(FRAME).await.unwrap();
+        endpoint.read_frame(&mut buffer).await.unwrap();
+        buffer.clear();
+    }
+
+    report("async, BytesMut", iterations, start.elapsed());
+}
+
+fn main() {
+    let instance_name =
+        std::env::var("RUST_LIBCPC_CPCD_INSTANCE").unwrap_or_else(|_| "cpcd_0".to_string());
+    let iterations = std::env::var("RUST_LIBCPC_BENCH_ITERATIONS")
+        .ok()
+        .and_then(|iterations| iterations.parse().ok())
+        .unwrap_or(1000);
+    let endpoint_id = sl_cpc::sl_cpc_user_endpoint_id_t_enum::SL_CPC_ENDPOINT_USER_ID_0
+        as sl_cpc::sl_cpc_user_endpoint_id_t;
+
+    let cpc_handle = libcpc::init(&instance_name, false, None).unwrap();
+
+    let mut endpoint = libcpc::open_endpoint(&cpc_handle, endpoint_id, 1).unwrap();
+    bench_blocking_vec(&endpoint, iterations);
+    bench_blocking_into(&endpoint, iterations);
+    libcpc::close_endpoint(&mut endpoint).unwrap();
+
+    let runtime = tokio::runtime::Builder::new_current_thread()
+        .enable_io()
+        .build()
+        .unwrap();
+
+    runtime.block_on(async {
+        let endpoint = libcpc::open_endpoint(&cpc_handle, endpoint_id, 1).unwrap();
+        let endpoint = AsyncEndpoint::new(endpoint).unwrap();
+        bench_async(&endpoint, iterations).await;
+    });
+}
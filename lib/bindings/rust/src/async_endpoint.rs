@@ -0,0 +1,330 @@
+//! Asynchronous endpoints driven by the tokio reactor.
+//!
+//! The socket of the endpoint is registered with tokio through `AsyncFd`, every
+//! libcpc call is made non-blocking and the task is parked until the socket is
+//! ready again. Frames are read into caller-provided `BytesMut` buffers. A
+//! batched read receives several frames with a single system call into an
+//! arena owned by the endpoint, then packs them into one buffer from which
+//! they are split.
+
+use std::io;
+use std::pin::Pin;
+use std::sync::Mutex;
+use std::task::{ready, Context, Poll};
+
+use bytes::{BufMut, Bytes, BytesMut};
+use futures_core::Stream;
+use futures_sink::Sink;
+use tokio::io::unix::AsyncFd;
+
+use crate::{cpc_endpoint, sl_cpc};
+
+const READ_NON_BLOCKING: sl_cpc::cpc_endpoint_read_flags_t =
+    sl_cpc::cpc_endpoint_read_flags_t_enum::CPC_ENDPOINT_READ_FLAG_NON_BLOCKING
+        as sl_cpc::cpc_endpoint_read_flags_t;
+const WRITE_NON_BLOCKING: sl_cpc::cpc_endpoint_write_flags_t =
+    sl_cpc::cpc_endpoint_write_flags_t_enum::CPC_ENDPOINT_WRITE_FLAG_NON_BLOCKING
+        as sl_cpc::cpc_endpoint_write_flags_t;
+
+/// Size reserved in the buffer for each frame, the largest frame libcpc can return
+pub const FRAME_CAPACITY: usize = sl_cpc::SL_CPC_READ_MINIMUM_SIZE as usize;
+
+fn to_io_error(err: isize) -> io::Error {
+    io::Error::from_raw_os_error(-err as i32)
+}
+
+/// Endpoint registered with the tokio reactor.
+///
+/// It is also a `Stream` of received frames and a `Sink` of frames to send, the
+/// stream allocates a new buffer only when the previous frames were all handed
+/// out. The endpoint is closed when dropped.
+pub struct AsyncEndpoint {
+    inner: Option<AsyncFd<cpc_endpoint>>,
+    read_buffer: BytesMut,
+    // Slots of the batched reads, zeroed once when it grows and reused
+    batch_arena: Mutex<Vec<u8>>,
+    pending_write: Option<Bytes>,
+}
+
+impl AsyncEndpoint {
+    /// Register an open endpoint with the reactor of the current tokio runtime.
+    pub fn new(endpoint: cpc_endpoint) -> io::Result<Self> {
+        Ok(AsyncEndpoint {
+            inner: Some(AsyncFd::new(endpoint)?),
+            read_buffer: BytesMut::new(),
+            batch_arena: Mutex::new(Vec::new()),
+            pending_write: None,
+        })
+    }
+
+    fn inner(&self) -> &AsyncFd<cpc_endpoint> {
+        self.inner.as_ref().unwrap()
+    }
+
+    fn try_read_frame(endpoint: &cpc_endpoint, buffer: &mut BytesMut) -> io::Result<usize> {
+        buffer.reserve(FRAME_CAPACITY);
+
+        let spare = buffer.chunk_mut();
+        let bytes_read = unsafe {
+            sl_cpc::cpc_read_endpoint(
+                endpoint.endpoint,
+                spare.as_mut_ptr() as *mut std::ffi::c_void,
+                spare.len().try_into().unwrap(),
+                READ_NON_BLOCKING,
+            )
+        } as isize;
+
+        if bytes_read < 0 {
+            return Err(to_io_error(bytes_read));
+        }
+
+        // Safety: libcpc initialized bytes_read bytes of the spare capacity
+        unsafe { buffer.advance_mut(bytes_read as usize) };
+
+        Ok(bytes_read as usize)
+    }
+
+    fn try_read_frames(
+        endpoint: &cpc_endpoint,
+        arena: &mut Vec<u8>,
+        buffer: &mut BytesMut,
+        max_frames: usize,
+        frame_capacity: usize,
+    ) -> io::Result<Vec<BytesMut>> {
+        let arena_size = max_frames * frame_capacity;
+        let mut messages = vec![
+            sl_cpc::cpc_read_message_t {
+                data: std::ptr::null_mut(),
+                length: 0,
+                truncated: false,
+            };
+            max_frames
+        ];
+
+        // Only the growth of the arena is zeroed, not every slot of every batch
+        if arena.len() < arena_size {
+            arena.resize(arena_size, 0);
+        }
+
+        let frame_count = unsafe {
+            sl_cpc::cpc_read_endpoint_batch(
+                endpoint.endpoint,
+                arena.as_mut_ptr() as *mut std::ffi::c_void,
+                arena_size.try_into().unwrap(),
+                messages.as_mut_ptr(),
+                max_frames.try_into().unwrap(),
+                std::ptr::null(),
+                READ_NON_BLOCKING,
+            )
+        } as isize;
+
+        if frame_count < 0 {
+            return Err(to_io_error(frame_count));
+        }
+
+        // The end of a truncated frame is lost in the socket, the batch can't be trusted
+        let messages = &messages[..frame_count as usize];
+        if messages.iter().any(|message| message.truncated) {
+            return Err(io::Error::new(
+                io::ErrorKind::InvalidData,
+                format!("frame larger than the {} bytes of its slot", frame_capacity),
+            ));
+        }
+
+        // Every frame sits at the start of its slot, only the frames are copied,
+        // packed after the content of the buffer
+        let total: usize = messages.iter().map(|message| message.length as usize).sum();
+        let mut packed = buffer.split_off(buffer.len());
+        packed.reserve(total);
+
+        let mut frames = Vec::with_capacity(messages.len());
+        for (i, message) in messages.iter().enumerate() {
+            let slot = i * frame_capacity;
+
+            packed.extend_from_slice(&arena[slot..slot + message.length as usize]);
+            frames.push(packed.split_to(message.length as usize));
+        }
+
+        buffer.unsplit(packed);
+
+        Ok(frames)
+    }
+
+    fn try_write_frame(endpoint: &cpc_endpoint, data: &[u8]) -> io::Result<usize> {
+        let bytes_written = unsafe {
+            sl_cpc::cpc_write_endpoint(
+                endpoint.endpoint,
+                data.as_ptr() as *const std::ffi::c_void,
+                data.len().try_into().unwrap(),
+                WRITE_NON_BLOCKING,
+            )
+        } as isize;
+
+        if bytes_written < 0 {
+            Err(to_io_error(bytes_written))
+        } else {
+            Ok(bytes_written as usize)
+        }
+    }
+
+    /// Poll for one frame, appended to the buffer.
+    pub fn poll_read_frame(
+        &self,
+        cx: &mut Context<'_>,
+        buffer: &mut BytesMut,
+    ) -> Poll<io::Result<usize>> {
+        loop {
+            let mut guard = ready!(self.inner().poll_read_ready(cx))?;
+
+            match guard.try_io(|inner| Self::try_read_frame(inner.get_ref(), buffer)) {
+                Ok(result) => return Poll::Ready(result),
+                Err(_would_block) => continue,
+            }
+        }
+    }
+
+    /// Read one frame, appended to the buffer. Returns the size of the frame.
+    pub async fn read_frame(&self, buffer: &mut BytesMut) -> io::Result<usize> {
+        loop {
+            let mut guard = self.inner().readable().await?;
+
+            match guard.try_io(|inner| Self::try_read_frame(inner.get_ref(), buffer)) {
+                Ok(result) => return result,
+                Err(_would_block) => continue,
+            }
+        }
+    }
+
+    /// Wait for at least one frame, then read all the pending frames up to
+    /// `max_frames` with a single system call. The frames are packed at the end
+    /// of the buffer and split off it.
+    ///
+    /// Each frame gets a slot of `FRAME_CAPACITY` bytes in an arena kept by the
+    /// endpoint, only the received bytes are copied out of it.
+    /// `read_frames_with_capacity` uses smaller slots, which keeps the arena
+    /// small when the frames are known to be short.
+    pub async fn read_frames(
+        &self,
+        buffer: &mut BytesMut,
+        max_frames: usize,
+    ) -> io::Result<Vec<BytesMut>> {
+        self.read_frames_with_capacity(buffer, max_frames, FRAME_CAPACITY)
+            .await
+    }
+
+    /// Same as `read_frames`, with slots of `frame_capacity` bytes. A frame
+    /// larger than its slot is truncated by the socket: the call then fails
+    /// with `InvalidData` and the frames of the batch are lost.
+    pub async fn read_frames_with_capacity(
+        &self,
+        buffer: &mut BytesMut,
+        max_frames: usize,
+        frame_capacity: usize,
+    ) -> io::Result<Vec<BytesMut>> {
+        assert!(frame_capacity > 0 && frame_capacity <= FRAME_CAPACITY);
+
+        loop {
+            let mut guard = self.inner().readable().await?;
+
+            match guard.try_io(|inner| {
+                let mut arena = self.batch_arena.lock().unwrap();
+                Self::try_read_frames(
+                    inner.get_ref(),
+                    &mut arena,
+                    buffer,
+                    max_frames,
+                    frame_capacity,
+                )
+            }) {
+                Ok(result) => return result,
+                Err(_would_block) => continue,
+            }
+        }
+    }
+
+    /// Poll to write one frame.
+    pub fn poll_write_frame(&self, cx: &mut Context<'_>, data: &[u8]) -> Poll<io::Result<usize>> {
+        loop {
+            let mut guard = ready!(self.inner().poll_write_ready(cx))?;
+
+            match guard.try_io(|inner| Self::try_write_frame(inner.get_ref(), data)) {
+                Ok(result) => return Poll::Ready(result),
+                Err(_would_block) => continue,
+            }
+        }
+    }
+
+    /// Write one frame. Returns the size of the frame.
+    pub async fn write_frame(&self, data: &[u8]) -> io::Result<usize> {
+        loop {
+            let mut guard = self.inner().writable().await?;
+
+            match guard.try_io(|inner| Self::try_write_frame(inner.get_ref(), data)) {
+                Ok(result) => return result,
+                Err(_would_block) => continue,
+            }
+        }
+    }
+
+    /// Get back the endpoint, unregistered from the reactor.
+    pub fn into_inner(mut self) -> cpc_endpoint {
+        self.inner.take().unwrap().into_inner()
+    }
+}
+
+impl Stream for AsyncEndpoint {
+    type Item = io::Result<Bytes>;
+
+    fn poll_next(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Option<Self::Item>> {
+        let this = self.get_mut();
+        let mut read_buffer = std::mem::take(&mut this.read_buffer);
+
+        let result = this.poll_read_frame(cx, &mut read_buffer);
+        this.read_buffer = read_buffer;
+
+        match ready!(result) {
+            Ok(size) => Poll::Ready(Some(Ok(this.read_buffer.split_to(size).freeze()))),
+            // The daemon closing the endpoint ends the stream
+            Err(err) if err.kind() == io::ErrorKind::ConnectionReset => Poll::Ready(None),
+            Err(err) => Poll::Ready(Some(Err(err))),
+        }
+    }
+}
+
+impl Sink<Bytes> for AsyncEndpoint {
+    type Error = io::Error;
+
+    fn poll_ready(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<io::Result<()>> {
+        self.poll_flush(cx)
+    }
+
+    fn start_send(self: Pin<&mut Self>, frame: Bytes) -> io::Result<()> {
+        self.get_mut().pending_write = Some(frame);
+        Ok(())
+    }
+
+    fn poll_flush(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<io::Result<()>> {
+        let this = self.get_mut();
+
+        if let Some(frame) = &this.pending_write {
+            ready!(this.poll_write_frame(cx, frame))?;
+            this.pending_write = None;
+        }
+
+        Poll::Ready(Ok(()))
+    }
+
+    fn poll_close(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<io::Result<()>> {
+        self.poll_flush(cx)
+    }
+}
+
+impl Drop for AsyncEndpoint {
+    fn drop(&mut self) {
+        // Unregister from the reactor before the socket is closed
+        if let Some(inner) = self.inner.take() {
+            let mut endpoint = inner.into_inner();
+            let _ = crate::close_endpoint(&mut endpoint);
+        }
+    }
+}
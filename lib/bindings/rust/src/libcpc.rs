@@ -5,6 +5,9 @@
 
 pub mod sl_cpc;
 
+#[cfg(feature = "async")]
+pub mod async_endpoint;
+
 #[derive(Debug, Copy, Clone)]
 pub struct cpc_handle {
     pub cpc: sl_cpc::cpc_handle_t,
@@ -17,6 +20,13 @@ pub struct cpc_endpoint {
     pub fd: std::os::unix::io::RawFd,
 }
 unsafe impl Send for cpc_endpoint {}
+unsafe impl Sync for cpc_endpoint {}
+
+impl std::os::unix::io::AsRawFd for cpc_endpoint {
+    fn as_raw_fd(&self) -> std::os::unix::io::RawFd {
+        self.fd
+    }
+}
 
 #[derive(Debug, Copy, Clone)]
 pub struct cpc_endpoint_event {
@@ -147,6 +157,27 @@ pub fn read_endpoint(
     }
 }
 
+pub fn read_endpoint_into(
+    endpoint: &cpc_endpoint,
+    buffer: &mut [u8],
+    flags: sl_cpc::cpc_endpoint_read_flags_t,
+) -> Result<usize, isize> {
+    let bytes_read = unsafe {
+        sl_cpc::cpc_read_endpoint(
+            endpoint.endpoint,
+            buffer.as_mut_ptr() as *mut std::ffi::c_void,
+            buffer.len().try_into().unwrap(),
+            flags,
+        )
+    };
+
+    if bytes_read < 0 {
+        Err(bytes_read)
+    } else {
+        Ok(bytes_read as usize)
+    }
+}
+
 pub fn get_endpoint_state(
     cpc: &cpc_handle,
     id: u8,
@@ -449,3 +449,44 @@ fn test_cpc_cmd_endpoint_event_blocking() {
     );
     common::cpc_deinit_internal(&mut cpc_handle);
 }
+
+#[cfg(feature = "async")]
+#[tokio::test(flavor = "current_thread")]
+#[serial_test::serial]
+async fn test_cpc_cmd_endpoint_async_write_read() {
+    let mut cpc_handle = common::cpc_init();
+    let cmd_endpoint_id = libcpc::sl_cpc::sl_cpc_user_endpoint_id_t_enum::SL_CPC_ENDPOINT_USER_ID_0
+        as libcpc::sl_cpc::sl_cpc_user_endpoint_id_t;
+    let (cmd_endpoint, mut cmd_endpoint_ev) =
+        common::cpc_open_endpoint(&cpc_handle, cmd_endpoint_id);
+
+    let async_endpoint = match libcpc::async_endpoint::AsyncEndpoint::new(cmd_endpoint) {
+        Ok(async_endpoint) => async_endpoint,
+        Err(err) => panic!("{err}"),
+    };
+
+    let test_string = "TEST\0";
+    match async_endpoint.write_frame(test_string.as_bytes()).await {
+        Ok(bytes_written) => assert_eq!(test_string.len(), bytes_written),
+        Err(err) => assert!(false, "{err}"),
+    }
+
+    let ack_string = "ACK\0";
+    let mut buffer = bytes::BytesMut::new();
+    match async_endpoint.read_frame(&mut buffer).await {
+        Ok(bytes_read) => {
+            assert_eq!(ack_string.len(), bytes_read);
+            assert_eq!(std::str::from_utf8(&buffer).unwrap(), ack_string)
+        }
+        Err(err) => assert!(false, "{err}"),
+    }
+
+    let mut cmd_endpoint = async_endpoint.into_inner();
+    common::cpc_close_endpoint(
+        &cpc_handle,
+        &mut cmd_endpoint,
+        &mut cmd_endpoint_ev,
+        cmd_endpoint_id,
+    );
+    common::cpc_deinit_internal(&mut cpc_handle);
+}
@@ -15,6 +15,8 @@
  *
  ******************************************************************************/
 
+#define _GNU_SOURCE
+
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -28,12 +30,17 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <time.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include "sl_cpc.h"
 #include "version.h"
@@ -51,6 +58,7 @@
 
 typedef struct {
   int ctrl_sock_fd;
+  int reset_eventfd;
   pthread_mutex_t ctrl_sock_fd_lock;
   size_t max_write_size;
   char *secondary_app_version;
@@ -64,6 +72,8 @@ typedef struct {
   int server_sock_fd;
   int sock_fd;
   pthread_mutex_t sock_fd_lock;
+  uint32_t io_refcount;
+  bool closing;
   sli_cpc_handle_t *lib_handle;
 } sli_cpc_endpoint_t;
 
@@ -74,6 +84,36 @@ typedef struct {
   sli_cpc_handle_t *lib_handle;
 } sli_cpc_endpoint_event_handle_t;
 
+typedef enum {
+  SLI_CPC_REACTOR_SOURCE_ENDPOINT,
+  SLI_CPC_REACTOR_SOURCE_ENDPOINT_EVENT,
+  SLI_CPC_REACTOR_SOURCE_RESET
+} sli_cpc_reactor_source_type_t;
+
+typedef struct sli_cpc_reactor_source {
+  struct sli_cpc_reactor_source *next;
+  sli_cpc_reactor_source_type_t type;
+  int fd;
+  uint32_t events;
+  bool removed;
+  void *object;
+  union {
+    struct {
+      cpc_reactor_rx_callback_t on_rx;
+      cpc_reactor_writable_callback_t on_writable;
+    } endpoint;
+    cpc_reactor_event_callback_t on_event;
+    cpc_reactor_reset_callback_t on_reset;
+  } callbacks;
+  void *user_data;
+} sli_cpc_reactor_source_t;
+
+typedef struct {
+  int epoll_fd;
+  bool dispatching;
+  sli_cpc_reactor_source_t *sources;
+} sli_cpc_reactor_t;
+
 static void lib_trace(sli_cpc_handle_t* lib_handle, FILE *__restrict __stream, const char* string, ...)
 {
   char time_string[25];
@@ -168,9 +208,10 @@ static void lib_trace(sli_cpc_handle_t* lib_handle, FILE *__restrict __stream, c
 
 #define DEFAULT_ENDPOINT_SOCKET_SIZE SL_CPC_READ_MINIMUM_SIZE
 
-static cpc_reset_callback_t saved_reset_callback;
+// Batches up to this size keep their message headers on the stack
+#define BATCH_STACK_MESSAGES 32
 
-int cpc_deinit(cpc_handle_t *handle);
+static cpc_reset_callback_t saved_reset_callback;
 
 static int cpc_query_exchange(sli_cpc_handle_t *lib_handle, int fd, cpcd_exchange_type_t type, uint8_t ep_id,
                               void *payload, size_t payload_sz)
@@ -382,6 +423,77 @@ static int get_secondary_app_version(sli_cpc_handle_t *lib_handle)
   RETURN_CPC_RET;
 }
 
+/***************************************************************************//**
+ * Hand an eventfd over to the daemon, which signals it when the secondary resets.
+ * The SIGUSR1 notification is only kept when the application registered a reset
+ * callback.
+ ******************************************************************************/
+static int set_reset_eventfd(sli_cpc_handle_t *lib_handle, bool signal_requested)
+{
+  INIT_CPC_RET(int);
+  int tmp_ret = 0;
+  bool registered = false;
+  ssize_t bytes_written = 0;
+  const size_t reset_eventfd_query_len = sizeof(cpcd_exchange_buffer_t) + sizeof(bool);
+  uint8_t buf[reset_eventfd_query_len];
+  cpcd_exchange_buffer_t* reset_eventfd_query = (cpcd_exchange_buffer_t*)buf;
+  union {
+    struct cmsghdr align;
+    uint8_t buf[CMSG_SPACE(sizeof(int))];
+  } control = { 0 };
+  struct iovec iov = { .iov_base = buf, .iov_len = reset_eventfd_query_len };
+  struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf, .msg_controllen = sizeof(control.buf) };
+  struct cmsghdr *cmsg;
+
+  lib_handle->reset_eventfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (lib_handle->reset_eventfd < 0) {
+    TRACE_LIB_ERRNO(lib_handle, "eventfd() failed");
+    SET_CPC_RET(-errno);
+    RETURN_CPC_RET;
+  }
+
+  reset_eventfd_query->type = EXCHANGE_SET_RESET_EVENTFD_QUERY;
+  reset_eventfd_query->endpoint_number = 0;
+  memcpy(reset_eventfd_query->payload, &signal_requested, sizeof(bool));
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &lib_handle->reset_eventfd, sizeof(int));
+
+  bytes_written = sendmsg(lib_handle->ctrl_sock_fd, &msg, 0);
+  if (bytes_written < (ssize_t)reset_eventfd_query_len) {
+    TRACE_LIB_ERRNO(lib_handle, "sendmsg(%d) failed", lib_handle->ctrl_sock_fd);
+    SET_CPC_RET(-errno);
+    goto close_reset_eventfd;
+  }
+
+  tmp_ret = cpc_query_receive(lib_handle, lib_handle->ctrl_sock_fd, &registered, sizeof(bool));
+  if (tmp_ret != 0) {
+    TRACE_LIB_ERROR(lib_handle, tmp_ret, "failed to exchange set reset eventfd query");
+    SET_CPC_RET(tmp_ret);
+    goto close_reset_eventfd;
+  }
+
+  if (!registered) {
+    // The daemon could not check the descriptor, in a chroot for instance. Resets are
+    // still notified with SIGUSR1 when signal_requested, there is no reset fd.
+    TRACE_LIB(lib_handle, "daemon did not accept the reset eventfd, resets are only signaled");
+    goto close_reset_eventfd;
+  }
+
+  TRACE_LIB(lib_handle, "reset eventfd %d registered with daemon", lib_handle->reset_eventfd);
+
+  RETURN_CPC_RET;
+
+  close_reset_eventfd:
+  close(lib_handle->reset_eventfd);
+  lib_handle->reset_eventfd = -1;
+
+  RETURN_CPC_RET;
+}
+
 static int set_pid(sli_cpc_handle_t *lib_handle)
 {
   INIT_CPC_RET(int);
@@ -488,6 +600,7 @@ int cpc_init(cpc_handle_t *handle, const char *instance_name, bool enable_tracin
 
   /* Save the parameters internally for possible further re-init */
   lib_handle->enable_tracing = enable_tracing;
+  lib_handle->reset_eventfd = -1;
   saved_reset_callback = reset_callback;
 
   if (instance_name == NULL) {
@@ -578,7 +691,13 @@ int cpc_init(cpc_handle_t *handle, const char *instance_name, bool enable_tracin
     goto close_ctrl_sock_fd;
   }
 
-  // Check if reset callback is define
+  tmp_ret = set_reset_eventfd(lib_handle, reset_callback != NULL);
+  if (tmp_ret < 0) {
+    SET_CPC_RET(tmp_ret);
+    goto close_ctrl_sock_fd;
+  }
+
+  // Check if reset callback is define, the signal is kept for compatibility
   if (reset_callback != NULL) {
     signal(SIGUSR1, SIGUSR1_handler);
   }
@@ -622,6 +741,10 @@ int cpc_init(cpc_handle_t *handle, const char *instance_name, bool enable_tracin
   free(lib_handle->secondary_app_version);
 
   close_ctrl_sock_fd:
+  if (lib_handle->reset_eventfd >= 0) {
+    close(lib_handle->reset_eventfd);
+  }
+
   if (close(lib_handle->ctrl_sock_fd) < 0) {
     TRACE_LIB_ERRNO(lib_handle, "close(%d) failed", lib_handle->ctrl_sock_fd);
     SET_CPC_RET(-errno);
@@ -656,6 +779,10 @@ int cpc_deinit(cpc_handle_t *handle)
     TRACE_LIB_ERRNO(lib_handle, "close(%d) failed", lib_handle->ctrl_sock_fd);
   }
 
+  if (lib_handle->reset_eventfd >= 0 && close(lib_handle->reset_eventfd) < 0) {
+    TRACE_LIB_ERRNO(lib_handle, "close(%d) failed", lib_handle->reset_eventfd);
+  }
+
   tmp_ret = pthread_mutex_destroy(&lib_handle->ctrl_sock_fd_lock);
   if (tmp_ret != 0) {
     TRACE_LIB_ERROR(lib_handle, -tmp_ret, "pthread_mutex_destroy(%p) failed, free up resources anyway", &lib_handle->ctrl_sock_fd_lock);
@@ -748,6 +875,51 @@ int cpc_restart(cpc_handle_t *handle)
   RETURN_CPC_RET;
 }
 
+/***************************************************************************//**
+ * Take a reference on an endpoint for the duration of a data path call.
+ * No lock is taken: SOCK_SEQPACKET send and receive are atomic per message,
+ * the reference only keeps cpc_close_endpoint() from releasing the socket
+ * while the call is in flight.
+ ******************************************************************************/
+static bool endpoint_acquire(sli_cpc_endpoint_t *ep)
+{
+  __atomic_add_fetch(&ep->io_refcount, 1, __ATOMIC_SEQ_CST);
+
+  // Pairs with the store in endpoint_drain(), either one sees the other
+  if (__atomic_load_n(&ep->closing, __ATOMIC_SEQ_CST)) {
+    __atomic_sub_fetch(&ep->io_refcount, 1, __ATOMIC_SEQ_CST);
+    return false;
+  }
+
+  return true;
+}
+
+static void endpoint_release(sli_cpc_endpoint_t *ep)
+{
+  __atomic_sub_fetch(&ep->io_refcount, 1, __ATOMIC_SEQ_CST);
+}
+
+/***************************************************************************//**
+ * Refuse new data path calls on an endpoint and wait for the ones in flight.
+ * Blocked calls are woken up by shutting the socket down, they return an error.
+ ******************************************************************************/
+static void endpoint_drain(sli_cpc_endpoint_t *ep)
+{
+  __atomic_store_n(&ep->closing, true, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(&ep->io_refcount, __ATOMIC_SEQ_CST) == 0) {
+    return;
+  }
+
+  if (shutdown(ep->sock_fd, SHUT_RDWR) < 0) {
+    TRACE_LIB_ERRNO(ep->lib_handle, "shutdown(%d) failed", ep->sock_fd);
+  }
+
+  while (__atomic_load_n(&ep->io_refcount, __ATOMIC_SEQ_CST) != 0) {
+    sched_yield();
+  }
+}
+
 /***************************************************************************//**
  * Connect to the socket corresponding to the provided endpoint ID.
  * The function will also allocate the memory for the endpoint structure and assign
@@ -922,6 +1094,9 @@ int cpc_close_endpoint(cpc_endpoint_t *endpoint)
 
   lib_handle = ep->lib_handle;
 
+  // Reads and writes from other threads must be done before the socket goes away
+  endpoint_drain(ep);
+
   tmp_ret = pthread_mutex_lock(&lib_handle->ctrl_sock_fd_lock);
   if (tmp_ret != 0) {
     TRACE_LIB_ERROR(lib_handle, -tmp_ret, "pthread_mutex_lock(%p) failed", &lib_handle->ctrl_sock_fd_lock);
@@ -996,6 +1171,11 @@ ssize_t cpc_read_endpoint(cpc_endpoint_t endpoint, void *buffer, size_t count, c
 
   ep = (sli_cpc_endpoint_t *)endpoint.ptr;
 
+  if (!endpoint_acquire(ep)) {
+    SET_CPC_RET(-EBADF);
+    RETURN_CPC_RET;
+  }
+
   TRACE_LIB(ep->lib_handle, "reading from EP #%d", ep->id);
 
   if (flags & CPC_ENDPOINT_READ_FLAG_NON_BLOCKING) {
@@ -1019,6 +1199,184 @@ ssize_t cpc_read_endpoint(cpc_endpoint_t endpoint, void *buffer, size_t count, c
     TRACE_LIB(ep->lib_handle, "read from EP #%d", ep->id);
   }
 
+  endpoint_release(ep);
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Read all the messages available on an endpoint, up to a maximum.
+ ******************************************************************************/
+ssize_t cpc_read_endpoint_batch(cpc_endpoint_t endpoint, void *arena, size_t arena_size,
+                                cpc_read_message_t *messages, size_t max_messages,
+                                const cpc_timeval_t *timeout, cpc_endpoint_read_flags_t flags)
+{
+  INIT_CPC_RET(ssize_t);
+  int sock_flags = MSG_WAITFORONE;
+  int messages_read = 0;
+  size_t slot_size = 0;
+  sli_cpc_endpoint_t *ep = NULL;
+  struct mmsghdr stack_msgs[BATCH_STACK_MESSAGES];
+  struct iovec stack_iovs[BATCH_STACK_MESSAGES];
+  struct mmsghdr *msgs = NULL;
+  struct iovec *iovs = NULL;
+
+  if (endpoint.ptr == NULL || arena == NULL || messages == NULL || max_messages == 0 || max_messages > UINT_MAX) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  if (timeout != NULL && (timeout->seconds < 0 || timeout->microseconds < 0)) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  slot_size = arena_size / max_messages;
+  if (slot_size == 0) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  ep = (sli_cpc_endpoint_t *)endpoint.ptr;
+
+  if (!endpoint_acquire(ep)) {
+    SET_CPC_RET(-EBADF);
+    RETURN_CPC_RET;
+  }
+
+  if (max_messages <= BATCH_STACK_MESSAGES) {
+    memset(stack_msgs, 0, max_messages * sizeof(struct mmsghdr));
+    msgs = stack_msgs;
+    iovs = stack_iovs;
+  } else {
+    msgs = zalloc(max_messages * (sizeof(struct mmsghdr) + sizeof(struct iovec)));
+    if (msgs == NULL) {
+      TRACE_LIB_ERROR(ep->lib_handle, -ENOMEM, "alloc(%d) failed", max_messages * (sizeof(struct mmsghdr) + sizeof(struct iovec)));
+      SET_CPC_RET(-ENOMEM);
+      goto release_endpoint;
+    }
+    iovs = (struct iovec *)&msgs[max_messages];
+  }
+
+  for (size_t i = 0; i < max_messages; i++) {
+    iovs[i].iov_base = (uint8_t *)arena + i * slot_size;
+    iovs[i].iov_len = slot_size;
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  TRACE_LIB(ep->lib_handle, "reading up to %d messages from EP #%d", max_messages, ep->id);
+
+  if (flags & CPC_ENDPOINT_READ_FLAG_NON_BLOCKING) {
+    sock_flags = MSG_DONTWAIT;
+  } else if (timeout != NULL) {
+    struct pollfd fds = { .fd = ep->sock_fd, .events = POLLIN };
+    int timeout_ms = timeout->seconds * 1000 + timeout->microseconds / 1000;
+    int ret;
+
+    do {
+      ret = poll(&fds, 1, timeout_ms);
+    } while (ret == -1 && errno == EINTR);
+
+    if (ret == -1) {
+      TRACE_LIB_ERRNO(ep->lib_handle, "poll(%d) failed", ep->sock_fd);
+      SET_CPC_RET(-errno);
+      goto free_msgs;
+    } else if (ret == 0) {
+      SET_CPC_RET(-EAGAIN);
+      goto free_msgs;
+    }
+
+    /* The first message is there, don't wait for the others */
+    sock_flags = MSG_DONTWAIT;
+  }
+
+  messages_read = recvmmsg(ep->sock_fd, msgs, (unsigned int)max_messages, sock_flags, NULL);
+  if (messages_read < 0) {
+    if (errno != EAGAIN) {
+      TRACE_LIB_ERRNO(ep->lib_handle, "recvmmsg(%d) failed", ep->sock_fd);
+    }
+    SET_CPC_RET(-errno);
+    goto free_msgs;
+  }
+
+  /* A zero-length message means the daemon closed the connection, keep what was read before it */
+  for (int i = 0; i < messages_read; i++) {
+    if (msgs[i].msg_len == 0) {
+      messages_read = i;
+      break;
+    }
+
+    messages[i].data = iovs[i].iov_base;
+    messages[i].length = msgs[i].msg_len;
+    messages[i].truncated = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+
+    if (messages[i].truncated) {
+      TRACE_LIB_ERROR(ep->lib_handle, -EMSGSIZE, "message #%d truncated to %d bytes", i, slot_size);
+    }
+  }
+
+  if (messages_read == 0) {
+    TRACE_LIB_ERROR(ep->lib_handle, -ECONNRESET, "recvmmsg(%d) failed", ep->sock_fd);
+    SET_CPC_RET(-ECONNRESET);
+  } else {
+    SET_CPC_RET(messages_read);
+    TRACE_LIB(ep->lib_handle, "read %d messages from EP #%d", messages_read, ep->id);
+  }
+
+  free_msgs:
+  if (msgs != stack_msgs) {
+    free(msgs);
+  }
+
+  release_endpoint:
+  endpoint_release(ep);
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Get the size of the next message available on an endpoint.
+ ******************************************************************************/
+ssize_t cpc_get_endpoint_next_frame_size(cpc_endpoint_t endpoint, cpc_endpoint_read_flags_t flags)
+{
+  INIT_CPC_RET(ssize_t);
+  int sock_flags = MSG_PEEK | MSG_TRUNC;
+  ssize_t frame_size = 0;
+  sli_cpc_endpoint_t *ep = NULL;
+
+  if (endpoint.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  ep = (sli_cpc_endpoint_t *)endpoint.ptr;
+
+  if (!endpoint_acquire(ep)) {
+    SET_CPC_RET(-EBADF);
+    RETURN_CPC_RET;
+  }
+
+  if (flags & CPC_ENDPOINT_READ_FLAG_NON_BLOCKING) {
+    sock_flags |= MSG_DONTWAIT;
+  }
+
+  /* With MSG_TRUNC, the full length of the datagram is returned even though nothing is copied */
+  frame_size = recv(ep->sock_fd, NULL, 0, sock_flags);
+  if (frame_size == 0) {
+    TRACE_LIB_ERROR(ep->lib_handle, -ECONNRESET, "recv(%d) failed", ep->sock_fd);
+    SET_CPC_RET(-ECONNRESET);
+  } else if (frame_size < 0) {
+    if (errno != EAGAIN) {
+      TRACE_LIB_ERRNO(ep->lib_handle, "recv(%d) failed", ep->sock_fd);
+    }
+    SET_CPC_RET(-errno);
+  } else {
+    SET_CPC_RET(frame_size);
+  }
+
+  endpoint_release(ep);
+
   RETURN_CPC_RET;
 }
 
@@ -1039,10 +1397,15 @@ ssize_t cpc_write_endpoint(cpc_endpoint_t endpoint, const void *data, size_t dat
 
   ep = (sli_cpc_endpoint_t *)endpoint.ptr;
 
+  if (!endpoint_acquire(ep)) {
+    SET_CPC_RET(-EBADF);
+    RETURN_CPC_RET;
+  }
+
   if (data_length > ep->lib_handle->max_write_size) {
     TRACE_LIB_ERROR(ep->lib_handle, -EINVAL, "payload too large (%d > %d)", data_length, ep->lib_handle->max_write_size);
     SET_CPC_RET(-EINVAL);
-    RETURN_CPC_RET;
+    goto release_endpoint;
   }
 
   TRACE_LIB(ep->lib_handle, "writing to EP #%d", ep->id);
@@ -1055,7 +1418,7 @@ ssize_t cpc_write_endpoint(cpc_endpoint_t endpoint, const void *data, size_t dat
   if (bytes_written == -1) {
     TRACE_LIB_ERRNO(ep->lib_handle, "send(%d) failed", ep->sock_fd);
     SET_CPC_RET(-errno);
-    RETURN_CPC_RET;
+    goto release_endpoint;
   } else {
     SET_CPC_RET(bytes_written);
   }
@@ -1072,95 +1435,319 @@ ssize_t cpc_write_endpoint(cpc_endpoint_t endpoint, const void *data, size_t dat
    */
   assert((size_t)bytes_written == data_length);
 
+  release_endpoint:
+  endpoint_release(ep);
+
   RETURN_CPC_RET;
 }
 
 /***************************************************************************//**
- * Get the state of an endpoint by ID.
+ * Write several messages to an open endpoint.
  ******************************************************************************/
-int cpc_get_endpoint_state(cpc_handle_t handle, uint8_t id, cpc_endpoint_state_t *state)
+ssize_t cpc_write_endpoint_batch(cpc_endpoint_t endpoint, const cpc_write_message_t *messages, size_t message_count, cpc_endpoint_write_flags_t flags)
 {
-  INIT_CPC_RET(int);
-  int tmp_ret = 0;
-  sli_cpc_handle_t *lib_handle = NULL;
+  INIT_CPC_RET(ssize_t);
+  int sock_flags = 0;
+  int messages_written = 0;
+  sli_cpc_endpoint_t *ep = NULL;
+  struct mmsghdr stack_msgs[BATCH_STACK_MESSAGES];
+  struct iovec stack_iovs[BATCH_STACK_MESSAGES];
+  struct mmsghdr *msgs = NULL;
+  struct iovec *iovs = NULL;
 
-  if (state == NULL || handle.ptr == NULL || id == SL_CPC_ENDPOINT_SYSTEM) {
+  if (endpoint.ptr == NULL || messages == NULL || message_count == 0 || message_count > UINT_MAX) {
     SET_CPC_RET(-EINVAL);
     RETURN_CPC_RET;
   }
 
-  lib_handle = (sli_cpc_handle_t *)handle.ptr;
+  ep = (sli_cpc_endpoint_t *)endpoint.ptr;
 
-  tmp_ret = pthread_mutex_lock(&lib_handle->ctrl_sock_fd_lock);
-  if (tmp_ret != 0) {
-    TRACE_LIB_ERROR(lib_handle, -tmp_ret, "pthread_mutex_lock(%p) failed", &lib_handle->ctrl_sock_fd_lock);
-    SET_CPC_RET(-tmp_ret);
+  if (!endpoint_acquire(ep)) {
+    SET_CPC_RET(-EBADF);
     RETURN_CPC_RET;
   }
 
-  TRACE_LIB(lib_handle, "get state EP #%d", id);
+  for (size_t i = 0; i < message_count; i++) {
+    if (messages[i].data == NULL || messages[i].length == 0) {
+      SET_CPC_RET(-EINVAL);
+      goto release_endpoint;
+    }
 
-  tmp_ret = cpc_query_exchange(lib_handle, lib_handle->ctrl_sock_fd,
-                               EXCHANGE_ENDPOINT_STATUS_QUERY, id,
-                               (void*)state, sizeof(cpc_endpoint_state_t));
+    if (messages[i].length > ep->lib_handle->max_write_size) {
+      TRACE_LIB_ERROR(ep->lib_handle, -EINVAL, "payload #%d too large (%d > %d)", i, messages[i].length, ep->lib_handle->max_write_size);
+      SET_CPC_RET(-EINVAL);
+      goto release_endpoint;
+    }
+  }
 
-  tmp_ret = pthread_mutex_unlock(&lib_handle->ctrl_sock_fd_lock);
-  if (tmp_ret != 0) {
-    TRACE_LIB_ERROR(lib_handle, -tmp_ret, "pthread_mutex_unlock(%p) failed", &lib_handle->ctrl_sock_fd_lock);
-    SET_CPC_RET(-tmp_ret);
-    RETURN_CPC_RET;
+  if (message_count <= BATCH_STACK_MESSAGES) {
+    memset(stack_msgs, 0, message_count * sizeof(struct mmsghdr));
+    msgs = stack_msgs;
+    iovs = stack_iovs;
+  } else {
+    msgs = zalloc(message_count * (sizeof(struct mmsghdr) + sizeof(struct iovec)));
+    if (msgs == NULL) {
+      TRACE_LIB_ERROR(ep->lib_handle, -ENOMEM, "alloc(%d) failed", message_count * (sizeof(struct mmsghdr) + sizeof(struct iovec)));
+      SET_CPC_RET(-ENOMEM);
+      goto release_endpoint;
+    }
+    iovs = (struct iovec *)&msgs[message_count];
+  }
+
+  for (size_t i = 0; i < message_count; i++) {
+    iovs[i].iov_base = (void *)messages[i].data;
+    iovs[i].iov_len = messages[i].length;
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  TRACE_LIB(ep->lib_handle, "writing %d messages to EP #%d", message_count, ep->id);
+
+  if (flags & CPC_ENDPOINT_WRITE_FLAG_NON_BLOCKING) {
+    sock_flags |= MSG_DONTWAIT;
+  }
+
+  messages_written = sendmmsg(ep->sock_fd, msgs, (unsigned int)message_count, sock_flags);
+  if (messages_written == -1) {
+    TRACE_LIB_ERRNO(ep->lib_handle, "sendmmsg(%d) failed", ep->sock_fd);
+    SET_CPC_RET(-errno);
+  } else {
+    SET_CPC_RET(messages_written);
+    TRACE_LIB(ep->lib_handle, "wrote %d messages to EP #%d", messages_written, ep->id);
+
+    /* Same as cpc_write_endpoint, SOCK_SEQPACKET sockets never do partial writes */
+    for (int i = 0; i < messages_written; i++) {
+      assert(msgs[i].msg_len == messages[i].length);
+    }
   }
 
+  if (msgs != stack_msgs) {
+    free(msgs);
+  }
+
+  release_endpoint:
+  endpoint_release(ep);
+
   RETURN_CPC_RET;
 }
 
 /***************************************************************************//**
- * Configure an endpoint with a specified option.
+ * Write one message assembled from several buffers to an open endpoint.
  ******************************************************************************/
-int cpc_set_endpoint_option(cpc_endpoint_t endpoint, cpc_option_t option, const void *optval, size_t optlen)
+ssize_t cpc_write_endpoint_iov(cpc_endpoint_t endpoint, const struct iovec *iov, int iovcnt, cpc_endpoint_write_flags_t flags)
 {
-  INIT_CPC_RET(int);
-  int tmp_ret = 0;
+  INIT_CPC_RET(ssize_t);
+  int sock_flags = 0;
+  size_t data_length = 0;
+  ssize_t bytes_written = 0;
   sli_cpc_endpoint_t *ep = NULL;
+  struct msghdr msg = { 0 };
 
-  if (option == CPC_OPTION_NONE || endpoint.ptr == NULL || optval == NULL) {
+  if (endpoint.ptr == NULL || iov == NULL || iovcnt <= 0 || iovcnt > IOV_MAX) {
     SET_CPC_RET(-EINVAL);
     RETURN_CPC_RET;
   }
 
   ep = (sli_cpc_endpoint_t *)endpoint.ptr;
 
-  if (option == CPC_OPTION_RX_TIMEOUT) {
-    cpc_timeval_t *useropt = (cpc_timeval_t*)optval;
-    struct timeval sockopt;
+  if (!endpoint_acquire(ep)) {
+    SET_CPC_RET(-EBADF);
+    RETURN_CPC_RET;
+  }
 
-    if (optlen != sizeof(cpc_timeval_t)) {
-      TRACE_LIB_ERROR(ep->lib_handle, -EINVAL, "optval must be of type cpc_timeval_t");
+  for (int i = 0; i < iovcnt; i++) {
+    if (iov[i].iov_base == NULL && iov[i].iov_len != 0) {
       SET_CPC_RET(-EINVAL);
-      RETURN_CPC_RET;
+      goto release_endpoint;
     }
+    data_length += iov[i].iov_len;
+  }
 
-    sockopt.tv_sec  = useropt->seconds;
-    sockopt.tv_usec = useropt->microseconds;
+  if (data_length == 0) {
+    SET_CPC_RET(-EINVAL);
+    goto release_endpoint;
+  }
 
-    tmp_ret = setsockopt(ep->sock_fd, SOL_SOCKET, SO_RCVTIMEO, &sockopt, (socklen_t)sizeof(sockopt));
-    if (tmp_ret < 0) {
-      TRACE_LIB_ERRNO(ep->lib_handle, "setsockopt(%d) failed", ep->sock_fd);
-      SET_CPC_RET(-errno);
-      RETURN_CPC_RET;
-    }
-  } else if (option == CPC_OPTION_TX_TIMEOUT) {
-    cpc_timeval_t *useropt = (cpc_timeval_t*)optval;
-    struct timeval sockopt;
+  if (data_length > ep->lib_handle->max_write_size) {
+    TRACE_LIB_ERROR(ep->lib_handle, -EINVAL, "payload too large (%d > %d)", data_length, ep->lib_handle->max_write_size);
+    SET_CPC_RET(-EINVAL);
+    goto release_endpoint;
+  }
 
-    if (optlen != sizeof(cpc_timeval_t)) {
-      TRACE_LIB_ERROR(ep->lib_handle, -EINVAL, "optval must be of type cpc_timeval_t");
-      SET_CPC_RET(-EINVAL);
-      RETURN_CPC_RET;
-    }
+  TRACE_LIB(ep->lib_handle, "writing %d segments to EP #%d", iovcnt, ep->id);
 
-    sockopt.tv_sec  = useropt->seconds;
-    sockopt.tv_usec = useropt->microseconds;
+  if (flags & CPC_ENDPOINT_WRITE_FLAG_NON_BLOCKING) {
+    sock_flags |= MSG_DONTWAIT;
+  }
+
+  msg.msg_iov = (struct iovec *)iov;
+  msg.msg_iovlen = (size_t)iovcnt;
+
+  bytes_written = sendmsg(ep->sock_fd, &msg, sock_flags);
+  if (bytes_written == -1) {
+    TRACE_LIB_ERRNO(ep->lib_handle, "sendmsg(%d) failed", ep->sock_fd);
+    SET_CPC_RET(-errno);
+    goto release_endpoint;
+  } else {
+    SET_CPC_RET(bytes_written);
+  }
+
+  TRACE_LIB(ep->lib_handle, "wrote to EP #%d", ep->id);
+
+  /* Same as cpc_write_endpoint, SOCK_SEQPACKET sockets never do partial writes */
+  assert((size_t)bytes_written == data_length);
+
+  release_endpoint:
+  endpoint_release(ep);
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Get the state of an endpoint by ID.
+ ******************************************************************************/
+int cpc_get_endpoint_state(cpc_handle_t handle, uint8_t id, cpc_endpoint_state_t *state)
+{
+  INIT_CPC_RET(int);
+  int tmp_ret = 0;
+  sli_cpc_handle_t *lib_handle = NULL;
+
+  if (state == NULL || handle.ptr == NULL || id == SL_CPC_ENDPOINT_SYSTEM) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_handle = (sli_cpc_handle_t *)handle.ptr;
+
+  tmp_ret = pthread_mutex_lock(&lib_handle->ctrl_sock_fd_lock);
+  if (tmp_ret != 0) {
+    TRACE_LIB_ERROR(lib_handle, -tmp_ret, "pthread_mutex_lock(%p) failed", &lib_handle->ctrl_sock_fd_lock);
+    SET_CPC_RET(-tmp_ret);
+    RETURN_CPC_RET;
+  }
+
+  TRACE_LIB(lib_handle, "get state EP #%d", id);
+
+  tmp_ret = cpc_query_exchange(lib_handle, lib_handle->ctrl_sock_fd,
+                               EXCHANGE_ENDPOINT_STATUS_QUERY, id,
+                               (void*)state, sizeof(cpc_endpoint_state_t));
+
+  tmp_ret = pthread_mutex_unlock(&lib_handle->ctrl_sock_fd_lock);
+  if (tmp_ret != 0) {
+    TRACE_LIB_ERROR(lib_handle, -tmp_ret, "pthread_mutex_unlock(%p) failed", &lib_handle->ctrl_sock_fd_lock);
+    SET_CPC_RET(-tmp_ret);
+    RETURN_CPC_RET;
+  }
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Get the state of every endpoint with a single query.
+ ******************************************************************************/
+int cpc_get_all_endpoint_states(cpc_handle_t handle, cpc_endpoint_state_info_t *states, size_t count)
+{
+  INIT_CPC_RET(int);
+  int tmp_ret = 0;
+  int query_ret = 0;
+  sli_cpc_handle_t *lib_handle = NULL;
+  cpc_endpoint_state_info_t *all_states = NULL;
+  const size_t all_states_sz = SL_CPC_ENDPOINT_COUNT * sizeof(cpc_endpoint_state_info_t);
+
+  if (states == NULL || count == 0 || handle.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_handle = (sli_cpc_handle_t *)handle.ptr;
+
+  all_states = zalloc(all_states_sz);
+  if (all_states == NULL) {
+    TRACE_LIB_ERROR(lib_handle, -ENOMEM, "alloc(%d) failed", all_states_sz);
+    SET_CPC_RET(-ENOMEM);
+    RETURN_CPC_RET;
+  }
+
+  tmp_ret = pthread_mutex_lock(&lib_handle->ctrl_sock_fd_lock);
+  if (tmp_ret != 0) {
+    TRACE_LIB_ERROR(lib_handle, -tmp_ret, "pthread_mutex_lock(%p) failed", &lib_handle->ctrl_sock_fd_lock);
+    SET_CPC_RET(-tmp_ret);
+    goto free_states;
+  }
+
+  TRACE_LIB(lib_handle, "get state of all endpoints");
+
+  query_ret = cpc_query_exchange(lib_handle, lib_handle->ctrl_sock_fd,
+                                 EXCHANGE_ALL_ENDPOINT_STATES_QUERY, 0,
+                                 (void*)all_states, all_states_sz);
+
+  tmp_ret = pthread_mutex_unlock(&lib_handle->ctrl_sock_fd_lock);
+  if (tmp_ret != 0) {
+    TRACE_LIB_ERROR(lib_handle, -tmp_ret, "pthread_mutex_unlock(%p) failed", &lib_handle->ctrl_sock_fd_lock);
+    SET_CPC_RET(-tmp_ret);
+    goto free_states;
+  }
+
+  if (query_ret != 0) {
+    SET_CPC_RET(query_ret);
+    goto free_states;
+  }
+
+  memcpy(states, all_states, (count < SL_CPC_ENDPOINT_COUNT ? count : SL_CPC_ENDPOINT_COUNT) * sizeof(cpc_endpoint_state_info_t));
+
+  free_states:
+  free(all_states);
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Configure an endpoint with a specified option.
+ ******************************************************************************/
+int cpc_set_endpoint_option(cpc_endpoint_t endpoint, cpc_option_t option, const void *optval, size_t optlen)
+{
+  INIT_CPC_RET(int);
+  int tmp_ret = 0;
+  sli_cpc_endpoint_t *ep = NULL;
+
+  if (option == CPC_OPTION_NONE || endpoint.ptr == NULL || optval == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  ep = (sli_cpc_endpoint_t *)endpoint.ptr;
+
+  if (option == CPC_OPTION_RX_TIMEOUT) {
+    cpc_timeval_t *useropt = (cpc_timeval_t*)optval;
+    struct timeval sockopt;
+
+    if (optlen != sizeof(cpc_timeval_t)) {
+      TRACE_LIB_ERROR(ep->lib_handle, -EINVAL, "optval must be of type cpc_timeval_t");
+      SET_CPC_RET(-EINVAL);
+      RETURN_CPC_RET;
+    }
+
+    sockopt.tv_sec  = useropt->seconds;
+    sockopt.tv_usec = useropt->microseconds;
+
+    tmp_ret = setsockopt(ep->sock_fd, SOL_SOCKET, SO_RCVTIMEO, &sockopt, (socklen_t)sizeof(sockopt));
+    if (tmp_ret < 0) {
+      TRACE_LIB_ERRNO(ep->lib_handle, "setsockopt(%d) failed", ep->sock_fd);
+      SET_CPC_RET(-errno);
+      RETURN_CPC_RET;
+    }
+  } else if (option == CPC_OPTION_TX_TIMEOUT) {
+    cpc_timeval_t *useropt = (cpc_timeval_t*)optval;
+    struct timeval sockopt;
+
+    if (optlen != sizeof(cpc_timeval_t)) {
+      TRACE_LIB_ERROR(ep->lib_handle, -EINVAL, "optval must be of type cpc_timeval_t");
+      SET_CPC_RET(-EINVAL);
+      RETURN_CPC_RET;
+    }
+
+    sockopt.tv_sec  = useropt->seconds;
+    sockopt.tv_usec = useropt->microseconds;
 
     tmp_ret = setsockopt(ep->sock_fd, SOL_SOCKET, SO_SNDTIMEO, &sockopt, (socklen_t)sizeof(sockopt));
     if (tmp_ret < 0) {
@@ -1985,3 +2572,627 @@ int cpc_get_endpoint_event_blocking_mode(cpc_endpoint_event_handle_t event_handl
 
   RETURN_CPC_RET;
 }
+
+/***************************************************************************//**
+ * Get the file descriptor of an open endpoint.
+ ******************************************************************************/
+int cpc_get_endpoint_fd(cpc_endpoint_t endpoint)
+{
+  INIT_CPC_RET(int);
+  sli_cpc_endpoint_t *ep = NULL;
+
+  if (endpoint.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  ep = (sli_cpc_endpoint_t *)endpoint.ptr;
+
+  SET_CPC_RET(ep->sock_fd);
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Get the file descriptor of an endpoint event handle.
+ ******************************************************************************/
+int cpc_get_endpoint_event_fd(cpc_endpoint_event_handle_t event_handle)
+{
+  INIT_CPC_RET(int);
+  sli_cpc_endpoint_event_handle_t *evt = NULL;
+
+  if (event_handle.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  evt = (sli_cpc_endpoint_event_handle_t *)event_handle.ptr;
+
+  if (evt->sock_fd <= 0) {
+    TRACE_LIB_ERROR(evt->lib_handle, -EINVAL, "evt->sock_fd (%d) is not initialized", evt->sock_fd);
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  SET_CPC_RET(evt->sock_fd);
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Get the file descriptor that becomes readable when the secondary resets.
+ ******************************************************************************/
+int cpc_get_reset_fd(cpc_handle_t handle)
+{
+  INIT_CPC_RET(int);
+
+  if (handle.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  if (((sli_cpc_handle_t *)handle.ptr)->reset_eventfd < 0) {
+    SET_CPC_RET(-ENODEV);
+    RETURN_CPC_RET;
+  }
+
+  SET_CPC_RET(((sli_cpc_handle_t *)handle.ptr)->reset_eventfd);
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Consume the pending reset notifications.
+ ******************************************************************************/
+int cpc_read_reset_event(cpc_handle_t handle)
+{
+  INIT_CPC_RET(int);
+  sli_cpc_handle_t *lib_handle = NULL;
+  uint64_t reset_count = 0;
+  ssize_t bytes_read = 0;
+
+  if (handle.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_handle = (sli_cpc_handle_t *)handle.ptr;
+
+  if (lib_handle->reset_eventfd < 0) {
+    SET_CPC_RET(-ENODEV);
+    RETURN_CPC_RET;
+  }
+
+  bytes_read = read(lib_handle->reset_eventfd, &reset_count, sizeof(reset_count));
+  if (bytes_read < 0) {
+    if (errno != EAGAIN) {
+      TRACE_LIB_ERRNO(lib_handle, "read(%d) failed", lib_handle->reset_eventfd);
+    }
+    SET_CPC_RET(-errno);
+    RETURN_CPC_RET;
+  }
+
+  TRACE_LIB(lib_handle, "secondary reset notified %d time(s)", reset_count);
+
+  SET_CPC_RET(reset_count > INT_MAX ? INT_MAX : (int)reset_count);
+
+  RETURN_CPC_RET;
+}
+
+static sli_cpc_reactor_source_t *reactor_find_source(sli_cpc_reactor_t *reactor, sli_cpc_reactor_source_type_t type, void *object)
+{
+  sli_cpc_reactor_source_t *source;
+
+  for (source = reactor->sources; source != NULL; source = source->next) {
+    if (!source->removed && source->type == type && source->object == object) {
+      return source;
+    }
+  }
+
+  return NULL;
+}
+
+static int reactor_add_source(sli_cpc_reactor_t *reactor, sli_cpc_reactor_source_t *source)
+{
+  struct epoll_event event = { .events = source->events, .data.ptr = source };
+
+  if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, source->fd, &event) == -1) {
+    return -errno;
+  }
+
+  source->next = reactor->sources;
+  reactor->sources = source;
+
+  return 0;
+}
+
+static void reactor_free_removed_sources(sli_cpc_reactor_t *reactor)
+{
+  sli_cpc_reactor_source_t **link = &reactor->sources;
+
+  while (*link != NULL) {
+    sli_cpc_reactor_source_t *source = *link;
+
+    if (source->removed) {
+      *link = source->next;
+      free(source);
+    } else {
+      link = &source->next;
+    }
+  }
+}
+
+static int reactor_remove_source(sli_cpc_reactor_t *reactor, sli_cpc_reactor_source_t *source)
+{
+  INIT_CPC_RET(int);
+
+  // The file descriptor may already have been dropped from the set after an error
+  if (source->events != 0 && epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL) == -1) {
+    SET_CPC_RET(-errno);
+  }
+
+  // Sources are freed once the callbacks of the current poll have been dispatched
+  source->removed = true;
+  if (!reactor->dispatching) {
+    reactor_free_removed_sources(reactor);
+  }
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Stop watching a source without removing it, to avoid spinning on a file
+ * descriptor that stays readable after an error or a hang-up.
+ ******************************************************************************/
+static void reactor_disable_source(sli_cpc_reactor_t *reactor, sli_cpc_reactor_source_t *source)
+{
+  if (source->events != 0) {
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+    source->events = 0;
+  }
+}
+
+/***************************************************************************//**
+ * Create a reactor.
+ ******************************************************************************/
+int cpc_reactor_create(cpc_reactor_t *reactor)
+{
+  INIT_CPC_RET(int);
+  sli_cpc_reactor_t *lib_reactor = NULL;
+
+  if (reactor == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor = zalloc(sizeof(sli_cpc_reactor_t));
+  if (lib_reactor == NULL) {
+    SET_CPC_RET(-ENOMEM);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (lib_reactor->epoll_fd == -1) {
+    SET_CPC_RET(-errno);
+    free(lib_reactor);
+    RETURN_CPC_RET;
+  }
+
+  reactor->ptr = (void *)lib_reactor;
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Destroy a reactor.
+ ******************************************************************************/
+int cpc_reactor_destroy(cpc_reactor_t *reactor)
+{
+  INIT_CPC_RET(int);
+  sli_cpc_reactor_t *lib_reactor = NULL;
+
+  if (reactor == NULL || reactor->ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor = (sli_cpc_reactor_t *)reactor->ptr;
+
+  if (lib_reactor->dispatching) {
+    SET_CPC_RET(-EBUSY);
+    RETURN_CPC_RET;
+  }
+
+  while (lib_reactor->sources != NULL) {
+    sli_cpc_reactor_source_t *source = lib_reactor->sources;
+    lib_reactor->sources = source->next;
+    free(source);
+  }
+
+  if (close(lib_reactor->epoll_fd) == -1) {
+    SET_CPC_RET(-errno);
+  }
+
+  free(lib_reactor);
+  reactor->ptr = NULL;
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Get the file descriptor of a reactor.
+ ******************************************************************************/
+int cpc_reactor_get_fd(cpc_reactor_t reactor)
+{
+  INIT_CPC_RET(int);
+
+  if (reactor.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  SET_CPC_RET(((sli_cpc_reactor_t *)reactor.ptr)->epoll_fd);
+
+  RETURN_CPC_RET;
+}
+
+static void reactor_dispatch(sli_cpc_reactor_t *reactor, sli_cpc_reactor_source_t *source, uint32_t events)
+{
+  switch (source->type) {
+    case SLI_CPC_REACTOR_SOURCE_ENDPOINT:
+    {
+      cpc_endpoint_t endpoint = { .ptr = source->object };
+
+      // A hang-up is reported as readable, the next read returns the error
+      if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && source->callbacks.endpoint.on_rx != NULL) {
+        source->callbacks.endpoint.on_rx(endpoint, source->user_data);
+      } else if (events & (EPOLLHUP | EPOLLERR)) {
+        reactor_disable_source(reactor, source);
+      }
+
+      if ((events & EPOLLOUT) && !source->removed && source->callbacks.endpoint.on_writable != NULL) {
+        source->callbacks.endpoint.on_writable(endpoint, source->user_data);
+      }
+    }
+    break;
+
+    case SLI_CPC_REACTOR_SOURCE_ENDPOINT_EVENT:
+    {
+      cpc_endpoint_event_handle_t event_handle = { .ptr = source->object };
+      sli_cpc_endpoint_event_handle_t *evt = (sli_cpc_endpoint_event_handle_t *)source->object;
+      cpc_event_type_t event_type;
+      int ret;
+
+      ret = cpc_read_endpoint_event(event_handle, &event_type, CPC_ENDPOINT_EVENT_FLAG_NON_BLOCKING);
+      if (ret == 0) {
+        source->callbacks.on_event((uint8_t)evt->endpoint_id, event_type, source->user_data);
+      } else if (ret != -EAGAIN) {
+        TRACE_LIB_ERROR(evt->lib_handle, ret, "failed to read event of EP #%d, no longer watching it", evt->endpoint_id);
+        reactor_disable_source(reactor, source);
+      }
+    }
+    break;
+
+    case SLI_CPC_REACTOR_SOURCE_RESET:
+    {
+      cpc_handle_t handle = { .ptr = source->object };
+
+      if (cpc_read_reset_event(handle) == -EAGAIN) {
+        break;
+      }
+
+      // The handle must be restarted after a reset, report it once
+      reactor_disable_source(reactor, source);
+      source->callbacks.on_reset(handle, source->user_data);
+    }
+    break;
+
+    default:
+      break;
+  }
+}
+
+/***************************************************************************//**
+ * Wait for activity on the reactor sources and dispatch the callbacks.
+ ******************************************************************************/
+int cpc_reactor_poll(cpc_reactor_t reactor, int timeout_ms)
+{
+  INIT_CPC_RET(int);
+  sli_cpc_reactor_t *lib_reactor = NULL;
+  struct epoll_event events[32];
+  int event_count;
+
+  if (reactor.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor = (sli_cpc_reactor_t *)reactor.ptr;
+
+  if (lib_reactor->dispatching) {
+    SET_CPC_RET(-EBUSY);
+    RETURN_CPC_RET;
+  }
+
+  event_count = epoll_wait(lib_reactor->epoll_fd, events, (int)ARRAY_SIZE(events), timeout_ms);
+  if (event_count == -1) {
+    SET_CPC_RET(-errno);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor->dispatching = true;
+
+  for (int i = 0; i < event_count; i++) {
+    sli_cpc_reactor_source_t *source = (sli_cpc_reactor_source_t *)events[i].data.ptr;
+
+    // A previous callback may have removed this source
+    if (!source->removed) {
+      reactor_dispatch(lib_reactor, source, events[i].events);
+    }
+  }
+
+  lib_reactor->dispatching = false;
+  reactor_free_removed_sources(lib_reactor);
+
+  SET_CPC_RET(event_count);
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Add an open endpoint to a reactor.
+ ******************************************************************************/
+int cpc_reactor_add_endpoint(cpc_reactor_t reactor, cpc_endpoint_t endpoint,
+                             cpc_reactor_rx_callback_t on_rx,
+                             cpc_reactor_writable_callback_t on_writable,
+                             void *user_data)
+{
+  INIT_CPC_RET(int);
+  int tmp_ret = 0;
+  sli_cpc_reactor_t *lib_reactor = NULL;
+  sli_cpc_reactor_source_t *source = NULL;
+
+  if (reactor.ptr == NULL || endpoint.ptr == NULL || on_rx == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor = (sli_cpc_reactor_t *)reactor.ptr;
+
+  if (reactor_find_source(lib_reactor, SLI_CPC_REACTOR_SOURCE_ENDPOINT, endpoint.ptr) != NULL) {
+    SET_CPC_RET(-EEXIST);
+    RETURN_CPC_RET;
+  }
+
+  source = zalloc(sizeof(sli_cpc_reactor_source_t));
+  if (source == NULL) {
+    SET_CPC_RET(-ENOMEM);
+    RETURN_CPC_RET;
+  }
+
+  source->type = SLI_CPC_REACTOR_SOURCE_ENDPOINT;
+  source->fd = ((sli_cpc_endpoint_t *)endpoint.ptr)->sock_fd;
+  source->events = EPOLLIN;
+  source->object = endpoint.ptr;
+  source->callbacks.endpoint.on_rx = on_rx;
+  source->callbacks.endpoint.on_writable = on_writable;
+  source->user_data = user_data;
+
+  tmp_ret = reactor_add_source(lib_reactor, source);
+  if (tmp_ret != 0) {
+    free(source);
+    SET_CPC_RET(tmp_ret);
+  }
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Enable or disable the writable callback of an endpoint added to a reactor.
+ ******************************************************************************/
+int cpc_reactor_set_writable_interest(cpc_reactor_t reactor, cpc_endpoint_t endpoint, bool enable)
+{
+  INIT_CPC_RET(int);
+  sli_cpc_reactor_t *lib_reactor = NULL;
+  sli_cpc_reactor_source_t *source = NULL;
+  struct epoll_event event = { 0 };
+
+  if (reactor.ptr == NULL || endpoint.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor = (sli_cpc_reactor_t *)reactor.ptr;
+
+  source = reactor_find_source(lib_reactor, SLI_CPC_REACTOR_SOURCE_ENDPOINT, endpoint.ptr);
+  if (source == NULL) {
+    SET_CPC_RET(-ENOENT);
+    RETURN_CPC_RET;
+  }
+
+  if (source->callbacks.endpoint.on_writable == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  if (source->events == 0) {
+    // The connection was lost, nothing to watch anymore
+    SET_CPC_RET(-ECONNRESET);
+    RETURN_CPC_RET;
+  }
+
+  event.events = enable ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+  event.data.ptr = source;
+
+  if (epoll_ctl(lib_reactor->epoll_fd, EPOLL_CTL_MOD, source->fd, &event) == -1) {
+    SET_CPC_RET(-errno);
+    RETURN_CPC_RET;
+  }
+
+  source->events = event.events;
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Remove an endpoint from a reactor.
+ ******************************************************************************/
+int cpc_reactor_remove_endpoint(cpc_reactor_t reactor, cpc_endpoint_t endpoint)
+{
+  INIT_CPC_RET(int);
+  sli_cpc_reactor_t *lib_reactor = NULL;
+  sli_cpc_reactor_source_t *source = NULL;
+
+  if (reactor.ptr == NULL || endpoint.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor = (sli_cpc_reactor_t *)reactor.ptr;
+
+  source = reactor_find_source(lib_reactor, SLI_CPC_REACTOR_SOURCE_ENDPOINT, endpoint.ptr);
+  if (source == NULL) {
+    SET_CPC_RET(-ENOENT);
+    RETURN_CPC_RET;
+  }
+
+  SET_CPC_RET(reactor_remove_source(lib_reactor, source));
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Add an endpoint event handle to a reactor.
+ ******************************************************************************/
+int cpc_reactor_add_endpoint_event(cpc_reactor_t reactor, cpc_endpoint_event_handle_t event_handle,
+                                   cpc_reactor_event_callback_t on_event, void *user_data)
+{
+  INIT_CPC_RET(int);
+  int tmp_ret = 0;
+  sli_cpc_reactor_t *lib_reactor = NULL;
+  sli_cpc_reactor_source_t *source = NULL;
+
+  if (reactor.ptr == NULL || on_event == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  tmp_ret = cpc_get_endpoint_event_fd(event_handle);
+  if (tmp_ret < 0) {
+    SET_CPC_RET(tmp_ret);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor = (sli_cpc_reactor_t *)reactor.ptr;
+
+  if (reactor_find_source(lib_reactor, SLI_CPC_REACTOR_SOURCE_ENDPOINT_EVENT, event_handle.ptr) != NULL) {
+    SET_CPC_RET(-EEXIST);
+    RETURN_CPC_RET;
+  }
+
+  source = zalloc(sizeof(sli_cpc_reactor_source_t));
+  if (source == NULL) {
+    SET_CPC_RET(-ENOMEM);
+    RETURN_CPC_RET;
+  }
+
+  source->type = SLI_CPC_REACTOR_SOURCE_ENDPOINT_EVENT;
+  source->fd = tmp_ret;
+  source->events = EPOLLIN;
+  source->object = event_handle.ptr;
+  source->callbacks.on_event = on_event;
+  source->user_data = user_data;
+
+  tmp_ret = reactor_add_source(lib_reactor, source);
+  if (tmp_ret != 0) {
+    free(source);
+    SET_CPC_RET(tmp_ret);
+  }
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Remove an endpoint event handle from a reactor.
+ ******************************************************************************/
+int cpc_reactor_remove_endpoint_event(cpc_reactor_t reactor, cpc_endpoint_event_handle_t event_handle)
+{
+  INIT_CPC_RET(int);
+  sli_cpc_reactor_t *lib_reactor = NULL;
+  sli_cpc_reactor_source_t *source = NULL;
+
+  if (reactor.ptr == NULL || event_handle.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor = (sli_cpc_reactor_t *)reactor.ptr;
+
+  source = reactor_find_source(lib_reactor, SLI_CPC_REACTOR_SOURCE_ENDPOINT_EVENT, event_handle.ptr);
+  if (source == NULL) {
+    SET_CPC_RET(-ENOENT);
+    RETURN_CPC_RET;
+  }
+
+  SET_CPC_RET(reactor_remove_source(lib_reactor, source));
+
+  RETURN_CPC_RET;
+}
+
+/***************************************************************************//**
+ * Be notified through a reactor when the secondary resets.
+ ******************************************************************************/
+int cpc_reactor_set_reset_callback(cpc_reactor_t reactor, cpc_handle_t handle,
+                                   cpc_reactor_reset_callback_t on_reset, void *user_data)
+{
+  INIT_CPC_RET(int);
+  int tmp_ret = 0;
+  sli_cpc_reactor_t *lib_reactor = NULL;
+  sli_cpc_reactor_source_t *source = NULL;
+
+  if (reactor.ptr == NULL || handle.ptr == NULL) {
+    SET_CPC_RET(-EINVAL);
+    RETURN_CPC_RET;
+  }
+
+  lib_reactor = (sli_cpc_reactor_t *)reactor.ptr;
+
+  source = reactor_find_source(lib_reactor, SLI_CPC_REACTOR_SOURCE_RESET, handle.ptr);
+  if (source != NULL) {
+    tmp_ret = reactor_remove_source(lib_reactor, source);
+    if (tmp_ret != 0) {
+      SET_CPC_RET(tmp_ret);
+      RETURN_CPC_RET;
+    }
+  }
+
+  if (on_reset == NULL) {
+    RETURN_CPC_RET;
+  }
+
+  if (((sli_cpc_handle_t *)handle.ptr)->reset_eventfd < 0) {
+    SET_CPC_RET(-ENODEV);
+    RETURN_CPC_RET;
+  }
+
+  source = zalloc(sizeof(sli_cpc_reactor_source_t));
+  if (source == NULL) {
+    SET_CPC_RET(-ENOMEM);
+    RETURN_CPC_RET;
+  }
+
+  source->type = SLI_CPC_REACTOR_SOURCE_RESET;
+  source->fd = ((sli_cpc_handle_t *)handle.ptr)->reset_eventfd;
+  source->events = EPOLLIN;
+  source->object = handle.ptr;
+  source->callbacks.on_reset = on_reset;
+  source->user_data = user_data;
+
+  tmp_ret = reactor_add_source(lib_reactor, source);
+  if (tmp_ret != 0) {
+    free(source);
+    SET_CPC_RET(tmp_ret);
+  }
+
+  RETURN_CPC_RET;
+}
@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #if !defined(__linux__)
 #error Wrong platform - this header file is intended for Linux applications that use libcpc
@@ -85,6 +86,20 @@ extern "C"
  * The recommended usage of the reset callback is to set a flag that will then notify
  * your application to call `cpc_restart`.
  *
+ * Instead of a callback, the file descriptor returned by `cpc_get_reset_fd()` can be
+ * watched with select(), poll() or epoll(), or a reset callback can be registered on a
+ * reactor with `cpc_reactor_set_reset_callback()`. Neither runs in a signal context.
+ * The daemon only sends SIGUSR1 to applications that passed a callback to `cpc_init()`.
+ * When the daemon cannot accept the file descriptor, in a chroot or a restricted
+ * container for instance, `cpc_init()` still succeeds: the callback passed to it is the
+ * only notification and `cpc_get_reset_fd()` returns -ENODEV.
+ *
+ * When the daemon is configured with `reset_recovery: true`, it re-establishes the open
+ * endpoints with the secondary itself. No SIGUSR1 is sent, the endpoint sockets stay
+ * connected and every endpoint event socket receives a single
+ * #SL_CPC_EVENT_ENDPOINT_LINK_RESET event once the endpoint is usable again. Frames that
+ * were in flight when the secondary reset are lost.
+ *
  * ## Example
  *  @code{.c}
  *
@@ -162,6 +177,7 @@ extern "C"
  ******************************************************************************/
 
 #define SL_CPC_READ_MINIMUM_SIZE 4087
+#define SL_CPC_ENDPOINT_COUNT    256
 
 /// @brief Enumeration representing the possible endpoint state.
 SL_ENUM(cpc_endpoint_state_t){
@@ -252,6 +268,7 @@ SL_ENUM(cpc_event_type_t){
   SL_CPC_EVENT_ENDPOINT_ERROR_DESTINATION_UNREACHABLE = 4,
   SL_CPC_EVENT_ENDPOINT_ERROR_SECURITY_INCIDENT = 5,
   SL_CPC_EVENT_ENDPOINT_ERROR_FAULT = 6,
+  SL_CPC_EVENT_ENDPOINT_LINK_RESET = 7,    ///< The secondary has reset and the endpoint sequence restarted, the endpoint stays open
 };
 
 /// @brief Struct representing a CPC library handle.
@@ -269,12 +286,38 @@ typedef struct {
   void *ptr; ///< void pointer.
 } cpc_endpoint_event_handle_t;
 
+/// @brief Struct representing a CPC reactor handle.
+typedef struct {
+  void *ptr; ///< void pointer.
+} cpc_reactor_t;
+
 /// @brief Struct for configuring time options of endpoints
 typedef struct {
   int seconds;      ///< Number of seconds
   int microseconds; ///< Number of microseconds
 } cpc_timeval_t;
 
+/// @brief Struct describing one message of a batched write.
+typedef struct {
+  const void *data; ///< Message payload
+  size_t length;    ///< Message length, at most the maximum write size
+} cpc_write_message_t;
+
+/// @brief Struct describing one message of a batched read.
+typedef struct {
+  void *data;     ///< Location of the message in the arena
+  size_t length;  ///< Number of bytes of the message copied to data
+  bool truncated; ///< The message did not fit in its slot of the arena and was truncated
+} cpc_read_message_t;
+
+/// @brief Struct representing the state of an endpoint as seen by the daemon.
+typedef struct {
+  cpc_endpoint_state_t state; ///< Endpoint state
+  bool encrypted;             ///< Endpoint encryption state
+  uint16_t data_connections;  ///< Number of clients that opened the endpoint
+  uint16_t event_connections; ///< Number of clients listening to the endpoint events
+} cpc_endpoint_state_info_t;
+
 /// @brief Struct representing a CPC asynchronous event flag.
 typedef uint8_t cpc_events_flags_t;
 
@@ -291,6 +334,31 @@ typedef void (*cpc_reset_callback_t) (void);
  ******************************************************************************/
 typedef void (*cpc_endpoint_state_callback_t) (uint8_t endpoint_id, cpc_endpoint_state_t endpoint_state);
 
+/***************************************************************************//**
+ * @brief Reactor callback to notify the application that an endpoint has data to read
+ *        or that its connection with the daemon was lost. In the latter case the
+ *        next read returns an error.
+ ******************************************************************************/
+typedef void (*cpc_reactor_rx_callback_t) (cpc_endpoint_t endpoint, void *user_data);
+
+/***************************************************************************//**
+ * @brief Reactor callback to notify the application that an endpoint can be written to
+ ******************************************************************************/
+typedef void (*cpc_reactor_writable_callback_t) (cpc_endpoint_t endpoint, void *user_data);
+
+/***************************************************************************//**
+ * @brief Reactor callback to notify the application of an endpoint event
+ ******************************************************************************/
+typedef void (*cpc_reactor_event_callback_t) (uint8_t endpoint_id, cpc_event_type_t event_type, void *user_data);
+
+/***************************************************************************//**
+ * @brief Reactor callback to notify the application that the secondary has reset.
+ *
+ * @note Unlike #cpc_reset_callback_t, this callback is not called in a signal
+ *       context. cpc_restart() can be called from it.
+ ******************************************************************************/
+typedef void (*cpc_reactor_reset_callback_t) (cpc_handle_t handle, void *user_data);
+
 /***************************************************************************//**
  * @brief Initialize the CPC library.
  *        Upon success the user will get a handle that must be passed to subsequent calls.
@@ -312,6 +380,17 @@ typedef void (*cpc_endpoint_state_callback_t) (uint8_t endpoint_id, cpc_endpoint
  ******************************************************************************/
 int cpc_init(cpc_handle_t *handle, const char *instance_name, bool enable_tracing, cpc_reset_callback_t reset_callback);
 
+/***************************************************************************//**
+ * @brief De-initialize the CPC library and free the resources of the handle.
+ *        The endpoints and event handles must be closed first.
+ *
+ * @param[in,out] handle        CPC library handle, cleared on return
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, 0 is returned.
+ ******************************************************************************/
+int cpc_deinit(cpc_handle_t *handle);
+
 /***************************************************************************//**
  * @brief Restart the CPC library.
  *        The user is notified via the 'reset_callback' when the secondary has restarted.
@@ -348,6 +427,10 @@ int cpc_open_endpoint(cpc_handle_t handle, cpc_endpoint_t *endpoint, uint8_t id,
  *
  * @return On error, a negative value of errno is returned.
  *         On success, 0 is returned.
+ *
+ * @note Reads and writes in progress on other threads are interrupted and return
+ *       an error before the endpoint is released, new ones fail with -EBADF.
+ *       The endpoint handle must not be used once this function has returned.
  ******************************************************************************/
 int cpc_close_endpoint(cpc_endpoint_t *endpoint);
 
@@ -376,6 +459,55 @@ int cpc_close_endpoint(cpc_endpoint_t *endpoint);
  ******************************************************************************/
 ssize_t cpc_read_endpoint(cpc_endpoint_t endpoint, void *buffer, size_t count, cpc_endpoint_read_flags_t flags);
 
+/***************************************************************************//**
+ * @brief Read all the messages available on an endpoint, up to a maximum, with
+ *        a single system call.
+ *
+ *        The arena is split in max_messages slots of equal size, one per message.
+ *        The call blocks until at least one message is available, unless the
+ *        non-blocking flag is set or a timeout is provided.
+ *
+ * @param[in]  endpoint        CPC endpoint handle to read from
+ * @param[in]  arena           The buffer in which the messages are copied
+ * @param[in]  arena_size      The size of the arena, in bytes
+ * @param[out] messages        The messages that were read, in order
+ * @param[in]  max_messages    The maximum number of messages to read
+ * @param[in]  timeout         Optional, the maximum time to wait for the first message.
+ *                             When NULL, the endpoint blocking and timeout options apply.
+ * @param[in]  flags           Optional read flags
+ *
+ * @return On error, a negative value of errno is returned.
+ *         -EAGAIN is returned when no message arrived in time.
+ *         On success, the function returns the number of messages that have been read.
+ *
+ * @note Use cpc_get_endpoint_next_frame_size() to size the slots when frames can be
+ *       larger than arena_size / max_messages, truncated messages are lost.
+ *       Flags are enumerated in #cpc_read_endpoint_flags_t
+ *       - CPC_ENDPOINT_READ_FLAG_NONE
+ *       - CPC_ENDPOINT_READ_FLAG_NON_BLOCKING
+ ******************************************************************************/
+ssize_t cpc_read_endpoint_batch(cpc_endpoint_t endpoint, void *arena, size_t arena_size,
+                                cpc_read_message_t *messages, size_t max_messages,
+                                const cpc_timeval_t *timeout, cpc_endpoint_read_flags_t flags);
+
+/***************************************************************************//**
+ * @brief Get the size of the next message available on an endpoint without
+ *        consuming it.
+ *
+ * @param[in] endpoint         CPC endpoint handle to read from
+ * @param[in] flags            Optional read flags
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, the function returns the size of the next message, in bytes.
+ *
+ * @note Like cpc_read_endpoint(), the call blocks until a message is available
+ *       unless the non-blocking flag is set.
+ *       Flags are enumerated in #cpc_read_endpoint_flags_t
+ *       - CPC_ENDPOINT_READ_FLAG_NONE
+ *       - CPC_ENDPOINT_READ_FLAG_NON_BLOCKING
+ ******************************************************************************/
+ssize_t cpc_get_endpoint_next_frame_size(cpc_endpoint_t endpoint, cpc_endpoint_read_flags_t flags);
+
 /***************************************************************************//**
  * @brief Write data to an open endpoint.
  *
@@ -395,6 +527,46 @@ ssize_t cpc_read_endpoint(cpc_endpoint_t endpoint, void *buffer, size_t count, c
  ******************************************************************************/
 ssize_t cpc_write_endpoint(cpc_endpoint_t endpoint, const void *data, size_t data_length, cpc_endpoint_write_flags_t flags);
 
+/***************************************************************************//**
+ * @brief Write several messages to an open endpoint with a single system call.
+ *
+ * @param[in] endpoint         CPC endpoint handle to write to
+ * @param[in] messages         The messages to write, each one is sent as a separate frame
+ * @param[in] message_count    The number of messages
+ * @param[in] flags            Optional write flags
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, the function returns the number of messages that have been written.
+ *
+ * @note Messages are written in order and each one is written entirely or not at all.
+ *       Fewer messages than requested can be written, for instance when the endpoint
+ *       is non-blocking and the socket is full. The remaining messages must then be
+ *       submitted again.
+ *       Flags are enumerated in #cpc_write_endpoint_flags_t
+ *       - CPC_ENDPOINT_WRITE_FLAG_NONE
+ *       - CPC_ENDPOINT_WRITE_FLAG_NON_BLOCKING
+ ******************************************************************************/
+ssize_t cpc_write_endpoint_batch(cpc_endpoint_t endpoint, const cpc_write_message_t *messages, size_t message_count, cpc_endpoint_write_flags_t flags);
+
+/***************************************************************************//**
+ * @brief Write one message assembled from several buffers to an open endpoint.
+ *
+ * @param[in] endpoint         CPC endpoint handle to write to
+ * @param[in] iov              The buffers that make up the message
+ * @param[in] iovcnt           The number of buffers
+ * @param[in] flags            Optional write flags
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, the function returns the amount of bytes that have been written.
+ *
+ * @note The total length of the buffers must not exceed the maximum write size.
+ *       Like cpc_write_endpoint(), partial writes are impossible.
+ *       Flags are enumerated in #cpc_write_endpoint_flags_t
+ *       - CPC_ENDPOINT_WRITE_FLAG_NONE
+ *       - CPC_ENDPOINT_WRITE_FLAG_NON_BLOCKING
+ ******************************************************************************/
+ssize_t cpc_write_endpoint_iov(cpc_endpoint_t endpoint, const struct iovec *iov, int iovcnt, cpc_endpoint_write_flags_t flags);
+
 /***************************************************************************//**
  * @brief Get the state of an endpoint by ID.
  *
@@ -415,6 +587,21 @@ ssize_t cpc_write_endpoint(cpc_endpoint_t endpoint, const void *data, size_t dat
  ******************************************************************************/
 int cpc_get_endpoint_state(cpc_handle_t handle, uint8_t id, cpc_endpoint_state_t *state);
 
+/***************************************************************************//**
+ * @brief Get the state of every endpoint with a single query to the daemon.
+ *
+ * @param[in]  handle          CPC library handle
+ * @param[out] states          Array indexed by endpoint id
+ * @param[in]  count           Number of entries in states, at most
+ *                             SL_CPC_ENDPOINT_COUNT entries are filled
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, 0 is returned.
+ *
+ * @note The system endpoint (id 0) is always reported as SL_CPC_STATE_OPEN.
+ ******************************************************************************/
+int cpc_get_all_endpoint_states(cpc_handle_t handle, cpc_endpoint_state_info_t *states, size_t count);
+
 /***************************************************************************//**
  * @brief Configure an endpoint with a specified option.
  *
@@ -731,6 +918,199 @@ int cpc_set_endpoint_event_blocking(cpc_endpoint_event_handle_t event_handle, bo
  ******************************************************************************/
 int cpc_get_endpoint_event_blocking_mode(cpc_endpoint_event_handle_t event_handle, bool *is_blocking);
 
+/***************************************************************************//**
+ * @brief Get the file descriptor that becomes readable when the secondary resets.
+ *
+ * @param[in]  handle         CPC library handle
+ *
+ * @return On error, a negative value of errno is returned, -ENODEV when the
+ *         daemon did not accept the file descriptor and resets are only
+ *         notified through the callback passed to cpc_init().
+ *         On success, the file descriptor is returned. It can be watched with
+ *         select(), poll() or epoll() instead of registering a reset callback.
+ *
+ * @note The file descriptor is owned by the library and must not be closed.
+ *       Use cpc_read_reset_event() to consume the notification.
+ ******************************************************************************/
+int cpc_get_reset_fd(cpc_handle_t handle);
+
+/***************************************************************************//**
+ * @brief Consume the pending reset notifications, without blocking.
+ *
+ * @param[in]  handle         CPC library handle
+ *
+ * @return On error, a negative value of errno is returned, -EAGAIN when
+ *         the secondary did not reset, -ENODEV without a reset file descriptor.
+ *         On success, the number of resets since the last call is returned.
+ ******************************************************************************/
+int cpc_read_reset_event(cpc_handle_t handle);
+
+/***************************************************************************//**
+ * @brief Get the file descriptor of an open endpoint.
+ *
+ * @param[in]  endpoint       CPC endpoint handle
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, the file descriptor is returned. It is readable when a
+ *         message is available and can be watched with select(), poll() or epoll().
+ *
+ * @note The file descriptor is owned by the library and must not be closed or read
+ *       from directly.
+ ******************************************************************************/
+int cpc_get_endpoint_fd(cpc_endpoint_t endpoint);
+
+/***************************************************************************//**
+ * @brief Get the file descriptor of an endpoint event handle.
+ *
+ * @param[in]  event_handle   CPC endpoint event handle
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, the file descriptor is returned. It is readable when an
+ *         event is available.
+ *
+ * @note The file descriptor is owned by the library and must not be closed or read
+ *       from directly.
+ ******************************************************************************/
+int cpc_get_endpoint_event_fd(cpc_endpoint_event_handle_t event_handle);
+
+/***************************************************************************//**
+ * @brief Create a reactor, which dispatches the activity of many endpoints to
+ *        callbacks from a single thread.
+ *
+ * @param[out] reactor        CPC reactor handle
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, 0 is returned
+ *
+ * @note A reactor is not thread-safe, all the reactor functions must be called
+ *       from the thread that calls cpc_reactor_poll(), callbacks included.
+ ******************************************************************************/
+int cpc_reactor_create(cpc_reactor_t *reactor);
+
+/***************************************************************************//**
+ * @brief Destroy a reactor. The endpoints and event handles that were added are
+ *        not closed.
+ *
+ * @param[in]  reactor        CPC reactor handle
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, 0 is returned
+ ******************************************************************************/
+int cpc_reactor_destroy(cpc_reactor_t *reactor);
+
+/***************************************************************************//**
+ * @brief Get the file descriptor of a reactor, to integrate it in another event loop.
+ *
+ * @param[in]  reactor        CPC reactor handle
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, the file descriptor is returned. It is readable when
+ *         cpc_reactor_poll() has callbacks to dispatch.
+ ******************************************************************************/
+int cpc_reactor_get_fd(cpc_reactor_t reactor);
+
+/***************************************************************************//**
+ * @brief Wait for activity on the reactor sources and dispatch the callbacks.
+ *
+ * @param[in]  reactor        CPC reactor handle
+ * @param[in]  timeout_ms     Maximum time to wait, in milliseconds. 0 returns
+ *                            immediately and -1 waits indefinitely.
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, the number of sources that were dispatched is returned.
+ ******************************************************************************/
+int cpc_reactor_poll(cpc_reactor_t reactor, int timeout_ms);
+
+/***************************************************************************//**
+ * @brief Add an open endpoint to a reactor.
+ *
+ * @param[in]  reactor        CPC reactor handle
+ * @param[in]  endpoint       CPC endpoint handle
+ * @param[in]  on_rx          Called when the endpoint has data to read
+ * @param[in]  on_writable    Optional, called when the endpoint can be written to,
+ *                            once enabled with cpc_reactor_set_writable_interest()
+ * @param[in]  user_data      Passed back to the callbacks
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, 0 is returned
+ *
+ * @note The endpoint must be removed from the reactor before it is closed.
+ ******************************************************************************/
+int cpc_reactor_add_endpoint(cpc_reactor_t reactor, cpc_endpoint_t endpoint,
+                             cpc_reactor_rx_callback_t on_rx,
+                             cpc_reactor_writable_callback_t on_writable,
+                             void *user_data);
+
+/***************************************************************************//**
+ * @brief Enable or disable the writable callback of an endpoint added to a reactor.
+ *
+ * @param[in]  reactor        CPC reactor handle
+ * @param[in]  endpoint       CPC endpoint handle
+ * @param[in]  enable         Whether the writable callback should be called
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, 0 is returned
+ ******************************************************************************/
+int cpc_reactor_set_writable_interest(cpc_reactor_t reactor, cpc_endpoint_t endpoint, bool enable);
+
+/***************************************************************************//**
+ * @brief Remove an endpoint from a reactor.
+ *
+ * @param[in]  reactor        CPC reactor handle
+ * @param[in]  endpoint       CPC endpoint handle
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, 0 is returned
+ ******************************************************************************/
+int cpc_reactor_remove_endpoint(cpc_reactor_t reactor, cpc_endpoint_t endpoint);
+
+/***************************************************************************//**
+ * @brief Add an endpoint event handle to a reactor. The events are read by the
+ *        reactor and passed to the callback.
+ *
+ * @param[in]  reactor        CPC reactor handle
+ * @param[in]  event_handle   CPC endpoint event handle
+ * @param[in]  on_event       Called for every event received on the endpoint
+ * @param[in]  user_data      Passed back to the callback
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, 0 is returned
+ *
+ * @note The event handle must be removed from the reactor before it is de-initialized.
+ ******************************************************************************/
+int cpc_reactor_add_endpoint_event(cpc_reactor_t reactor, cpc_endpoint_event_handle_t event_handle,
+                                   cpc_reactor_event_callback_t on_event, void *user_data);
+
+/***************************************************************************//**
+ * @brief Remove an endpoint event handle from a reactor.
+ *
+ * @param[in]  reactor        CPC reactor handle
+ * @param[in]  event_handle   CPC endpoint event handle
+ *
+ * @return On error, a negative value of errno is returned.
+ *         On success, 0 is returned
+ ******************************************************************************/
+int cpc_reactor_remove_endpoint_event(cpc_reactor_t reactor, cpc_endpoint_event_handle_t event_handle);
+
+/***************************************************************************//**
+ * @brief Be notified through a reactor when the secondary resets.
+ *
+ * @param[in]  reactor        CPC reactor handle
+ * @param[in]  handle         CPC library handle
+ * @param[in]  on_reset       Called once when the secondary resets, NULL to stop
+ *                            watching for resets
+ * @param[in]  user_data      Passed back to the callback
+ *
+ * @return On error, a negative value of errno is returned, -ENODEV when the
+ *         library has no reset file descriptor, see cpc_get_reset_fd().
+ *         On success, 0 is returned
+ *
+ * @note cpc_restart() gives a new library handle, the callback must be set again
+ *       with it.
+ ******************************************************************************/
+int cpc_reactor_set_reset_callback(cpc_reactor_t reactor, cpc_handle_t handle,
+                                   cpc_reactor_reset_callback_t on_reset, void *user_data);
+
 /** @} (end addtogroup cpc) */
 
 #ifdef __cplusplus
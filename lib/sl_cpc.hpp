@@ -0,0 +1,698 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Library C++ Header
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef SL_CPC_HPP
+#define SL_CPC_HPP
+
+#if __cplusplus < 202002L
+#error This header file requires C++20, use sl_cpc.h from older C++ standards
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "sl_cpc.h"
+
+/***************************************************************************//**
+ * @addtogroup cpc_cpp CPC C++ wrapper
+ * @brief Header-only C++20 wrapper of the CPC library
+ * @details
+ * ## Overview
+ *
+ * The types below own the library objects and release them when they go out of
+ * scope: cpc::Handle calls cpc_deinit(), cpc::Endpoint calls cpc_close_endpoint(),
+ * and so on. They can be moved but not copied.
+ *
+ * Reads and writes take std::span, the data is copied once between the socket
+ * and the caller's buffer. cpc::FrameBatch owns the arena of a batched read, so
+ * the same batch can be reused for every call without any allocation.
+ *
+ * Errors are reported by throwing cpc::Error, a std::system_error carrying the
+ * errno value returned by the library. A non-blocking call that would block is
+ * not an error: it returns 0, or an empty std::optional.
+ *
+ * ## Coroutines
+ *
+ * cpc::Endpoint::async_read() returns an awaitable that is resumed from
+ * cpc::Reactor::poll() once a frame is available:
+ *
+ * @code{.cpp}
+ *    cpc::DetachedTask echo(cpc::Reactor &reactor, cpc::Endpoint &endpoint)
+ *    {
+ *      std::array<std::byte, SL_CPC_READ_MINIMUM_SIZE> buffer;
+ *
+ *      for (;;) {
+ *        size_t size = co_await endpoint.async_read(reactor, buffer);
+ *        endpoint.write(std::span(buffer).first(size));
+ *      }
+ *    }
+ *
+ *    ...
+ *
+ *    echo(reactor, endpoint);
+ *    for (;;) {
+ *      reactor.poll(-1);
+ *    }
+ * @endcode
+ *
+ * Only one read can be awaited at a time on an endpoint, and an endpoint that is
+ * awaited must not be added to the reactor by other means.
+ *
+ * @{
+ ******************************************************************************/
+
+namespace cpc {
+/// @brief Exception thrown when a library call fails, code() holds the errno value.
+class Error : public std::system_error {
+public:
+  Error(int error, const char *what)
+    : std::system_error(error, std::generic_category(), what)
+  {
+  }
+};
+
+namespace detail {
+/// @brief Throw when a library call returned a negative errno value.
+template <typename T>
+inline T check(T ret, const char *what)
+{
+  if (ret < 0) {
+    throw Error(static_cast<int>(-ret), what);
+  }
+  return ret;
+}
+
+inline cpc_timeval_t to_timeval(std::chrono::microseconds timeout)
+{
+  cpc_timeval_t timeval;
+
+  timeval.seconds = static_cast<int>(timeout.count() / 1000000);
+  timeval.microseconds = static_cast<int>(timeout.count() % 1000000);
+
+  return timeval;
+}
+} // namespace detail
+
+class Endpoint;
+class EventHandle;
+
+/***************************************************************************//**
+ * @brief Frames received by one batched read. The arena and the message table
+ *        are allocated once, when the batch is created.
+ ******************************************************************************/
+class FrameBatch {
+public:
+  /// @brief One frame of the batch, pointing into the arena.
+  struct Frame {
+    std::span<const std::byte> data; ///< Frame payload
+    bool truncated;                  ///< The frame did not fit in its slot
+  };
+
+  class iterator {
+  public:
+    iterator(const cpc_read_message_t *message)
+      : message_(message)
+    {
+    }
+
+    Frame operator*() const
+    {
+      return Frame{ std::span(static_cast<const std::byte *>(message_->data), message_->length), message_->truncated };
+    }
+
+    iterator &operator++()
+    {
+      ++message_;
+      return *this;
+    }
+
+    bool operator==(const iterator &other) const = default;
+
+  private:
+    const cpc_read_message_t *message_;
+  };
+
+  /// @param[in] max_frames       Maximum number of frames read at once
+  /// @param[in] frame_capacity   Size of the slot of each frame in the arena
+  explicit FrameBatch(size_t max_frames, size_t frame_capacity = SL_CPC_READ_MINIMUM_SIZE)
+    : arena_(std::make_unique<std::byte[]>(max_frames * frame_capacity)),
+    messages_(std::make_unique<cpc_read_message_t[]>(max_frames)),
+    capacity_(max_frames),
+    frame_capacity_(frame_capacity)
+  {
+  }
+
+  FrameBatch(FrameBatch &&) noexcept = default;
+  FrameBatch &operator=(FrameBatch &&) noexcept = default;
+  FrameBatch(const FrameBatch &) = delete;
+  FrameBatch &operator=(const FrameBatch &) = delete;
+
+  size_t size() const
+  {
+    return size_;
+  }
+
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+
+  size_t capacity() const
+  {
+    return capacity_;
+  }
+
+  Frame operator[](size_t index) const
+  {
+    return *iterator(&messages_[index]);
+  }
+
+  iterator begin() const
+  {
+    return iterator(messages_.get());
+  }
+
+  iterator end() const
+  {
+    return iterator(messages_.get() + size_);
+  }
+
+private:
+  friend class Endpoint;
+
+  std::unique_ptr<std::byte[]> arena_;
+  std::unique_ptr<cpc_read_message_t[]> messages_;
+  size_t capacity_;
+  size_t frame_capacity_;
+  size_t size_ = 0;
+};
+
+/***************************************************************************//**
+ * @brief Reactor dispatching the activity of many endpoints from one thread,
+ *        it also drives the coroutine awaitables.
+ ******************************************************************************/
+class Reactor {
+public:
+  Reactor()
+  {
+    detail::check(cpc_reactor_create(&reactor_), "cpc_reactor_create");
+  }
+
+  ~Reactor()
+  {
+    if (reactor_.ptr != nullptr) {
+      cpc_reactor_destroy(&reactor_);
+    }
+  }
+
+  Reactor(Reactor &&other) noexcept
+    : reactor_(std::exchange(other.reactor_, cpc_reactor_t{}))
+  {
+  }
+
+  Reactor &operator=(Reactor &&other) noexcept
+  {
+    std::swap(reactor_, other.reactor_);
+    return *this;
+  }
+
+  Reactor(const Reactor &) = delete;
+  Reactor &operator=(const Reactor &) = delete;
+
+  /// @brief Dispatch the pending callbacks, waiting up to timeout_ms for one.
+  /// @return The number of sources that were dispatched
+  int poll(int timeout_ms = -1)
+  {
+    return detail::check(cpc_reactor_poll(reactor_, timeout_ms), "cpc_reactor_poll");
+  }
+
+  int fd() const
+  {
+    return detail::check(cpc_reactor_get_fd(reactor_), "cpc_reactor_get_fd");
+  }
+
+  cpc_reactor_t native() const
+  {
+    return reactor_;
+  }
+
+private:
+  cpc_reactor_t reactor_{};
+};
+
+/***************************************************************************//**
+ * @brief Awaitable returned by Endpoint::async_read(), resumes with the size
+ *        of the frame copied to the buffer.
+ ******************************************************************************/
+class ReadAwaiter {
+public:
+  ReadAwaiter(Reactor &reactor, cpc_endpoint_t endpoint, std::span<std::byte> buffer)
+    : reactor_(reactor), endpoint_(endpoint), buffer_(buffer)
+  {
+  }
+
+  // The frame is read right away when one is pending, without going through the reactor
+  bool await_ready()
+  {
+    result_ = read();
+    return result_ != -EAGAIN;
+  }
+
+  bool await_suspend(std::coroutine_handle<> coroutine)
+  {
+    int ret;
+
+    coroutine_ = coroutine;
+
+    ret = cpc_reactor_add_endpoint(reactor_.native(), endpoint_, &ReadAwaiter::on_rx, nullptr, this);
+    if (ret < 0) {
+      result_ = ret;
+      return false;
+    }
+
+    return true;
+  }
+
+  size_t await_resume()
+  {
+    return static_cast<size_t>(detail::check(result_, "cpc_read_endpoint"));
+  }
+
+private:
+  ssize_t read()
+  {
+    return cpc_read_endpoint(endpoint_, buffer_.data(), buffer_.size(), CPC_ENDPOINT_READ_FLAG_NON_BLOCKING);
+  }
+
+  static void on_rx(cpc_endpoint_t endpoint, void *user_data)
+  {
+    ReadAwaiter *self = static_cast<ReadAwaiter *>(user_data);
+
+    self->result_ = self->read();
+    if (self->result_ == -EAGAIN) {
+      return;
+    }
+
+    cpc_reactor_remove_endpoint(self->reactor_.native(), endpoint);
+    self->coroutine_.resume();
+  }
+
+  Reactor &reactor_;
+  cpc_endpoint_t endpoint_;
+  std::span<std::byte> buffer_;
+  ssize_t result_ = 0;
+  std::coroutine_handle<> coroutine_;
+};
+
+/***************************************************************************//**
+ * @brief Coroutine type for fire-and-forget tasks that await on endpoints.
+ *        The coroutine starts right away and frees itself when it returns,
+ *        an exception escaping it terminates the program.
+ ******************************************************************************/
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never final_suspend() noexcept
+    {
+      return {};
+    }
+
+    void return_void() noexcept
+    {
+    }
+
+    void unhandled_exception() noexcept
+    {
+      std::terminate();
+    }
+  };
+};
+
+/***************************************************************************//**
+ * @brief Open endpoint, closed when destroyed.
+ ******************************************************************************/
+class Endpoint {
+public:
+  Endpoint(Endpoint &&other) noexcept
+    : endpoint_(std::exchange(other.endpoint_, cpc_endpoint_t{}))
+  {
+  }
+
+  Endpoint &operator=(Endpoint &&other) noexcept
+  {
+    std::swap(endpoint_, other.endpoint_);
+    return *this;
+  }
+
+  Endpoint(const Endpoint &) = delete;
+  Endpoint &operator=(const Endpoint &) = delete;
+
+  ~Endpoint()
+  {
+    if (endpoint_.ptr != nullptr) {
+      cpc_close_endpoint(&endpoint_);
+    }
+  }
+
+  /// @brief Read one frame, the buffer must hold at least SL_CPC_READ_MINIMUM_SIZE bytes.
+  /// @return The size of the frame, 0 when non-blocking and no frame is pending
+  size_t read(std::span<std::byte> buffer, bool non_blocking = false)
+  {
+    ssize_t ret = cpc_read_endpoint(endpoint_, buffer.data(), buffer.size(),
+                                    non_blocking ? CPC_ENDPOINT_READ_FLAG_NON_BLOCKING : CPC_ENDPOINT_READ_FLAG_NONE);
+    if (ret == -EAGAIN && non_blocking) {
+      return 0;
+    }
+
+    return static_cast<size_t>(detail::check(ret, "cpc_read_endpoint"));
+  }
+
+  /// @brief Read all the pending frames into the batch, up to its capacity.
+  /// @return The number of frames read, 0 when none arrived in time
+  size_t read(FrameBatch &batch,
+              std::optional<std::chrono::microseconds> timeout = std::nullopt,
+              bool non_blocking = false)
+  {
+    cpc_timeval_t timeval;
+    ssize_t ret;
+
+    if (timeout) {
+      timeval = detail::to_timeval(*timeout);
+    }
+
+    batch.size_ = 0;
+    ret = cpc_read_endpoint_batch(endpoint_, batch.arena_.get(), batch.capacity_ * batch.frame_capacity_,
+                                  batch.messages_.get(), batch.capacity_,
+                                  timeout ? &timeval : nullptr,
+                                  non_blocking ? CPC_ENDPOINT_READ_FLAG_NON_BLOCKING : CPC_ENDPOINT_READ_FLAG_NONE);
+    if (ret == -EAGAIN && (non_blocking || timeout)) {
+      return 0;
+    }
+
+    batch.size_ = static_cast<size_t>(detail::check(ret, "cpc_read_endpoint_batch"));
+    return batch.size_;
+  }
+
+  /// @brief Await one frame, see ReadAwaiter.
+  ReadAwaiter async_read(Reactor &reactor, std::span<std::byte> buffer)
+  {
+    return ReadAwaiter(reactor, endpoint_, buffer);
+  }
+
+  /// @return The size of the next frame, 0 when non-blocking and no frame is pending
+  size_t next_frame_size(bool non_blocking = false)
+  {
+    ssize_t ret = cpc_get_endpoint_next_frame_size(endpoint_,
+                                                   non_blocking ? CPC_ENDPOINT_READ_FLAG_NON_BLOCKING : CPC_ENDPOINT_READ_FLAG_NONE);
+    if (ret == -EAGAIN && non_blocking) {
+      return 0;
+    }
+
+    return static_cast<size_t>(detail::check(ret, "cpc_get_endpoint_next_frame_size"));
+  }
+
+  /// @brief Write one frame of at most max_write_size() bytes.
+  /// @return The size of the frame, 0 when non-blocking and the socket is full
+  size_t write(std::span<const std::byte> data, bool non_blocking = false)
+  {
+    ssize_t ret = cpc_write_endpoint(endpoint_, data.data(), data.size(),
+                                     non_blocking ? CPC_ENDPOINT_WRITE_FLAG_NON_BLOCKING : CPC_ENDPOINT_WRITE_FLAG_NONE);
+    if (ret == -EAGAIN && non_blocking) {
+      return 0;
+    }
+
+    return static_cast<size_t>(detail::check(ret, "cpc_write_endpoint"));
+  }
+
+  /// @brief Write several frames with one call.
+  /// @return The number of frames written
+  size_t write(std::span<const cpc_write_message_t> messages, bool non_blocking = false)
+  {
+    ssize_t ret = cpc_write_endpoint_batch(endpoint_, messages.data(), messages.size(),
+                                           non_blocking ? CPC_ENDPOINT_WRITE_FLAG_NON_BLOCKING : CPC_ENDPOINT_WRITE_FLAG_NONE);
+    if (ret == -EAGAIN && non_blocking) {
+      return 0;
+    }
+
+    return static_cast<size_t>(detail::check(ret, "cpc_write_endpoint_batch"));
+  }
+
+  void set_blocking(bool blocking)
+  {
+    detail::check(cpc_set_endpoint_blocking(endpoint_, blocking), "cpc_set_endpoint_blocking");
+  }
+
+  void set_read_timeout(std::chrono::microseconds timeout)
+  {
+    detail::check(cpc_set_endpoint_read_timeout(endpoint_, detail::to_timeval(timeout)), "cpc_set_endpoint_read_timeout");
+  }
+
+  void set_write_timeout(std::chrono::microseconds timeout)
+  {
+    detail::check(cpc_set_endpoint_write_timeout(endpoint_, detail::to_timeval(timeout)), "cpc_set_endpoint_write_timeout");
+  }
+
+  void set_socket_size(uint32_t socket_size)
+  {
+    detail::check(cpc_set_endpoint_socket_size(endpoint_, socket_size), "cpc_set_endpoint_socket_size");
+  }
+
+  size_t max_write_size() const
+  {
+    size_t max_write_size;
+
+    detail::check(cpc_get_endpoint_max_write_size(endpoint_, &max_write_size), "cpc_get_endpoint_max_write_size");
+    return max_write_size;
+  }
+
+  bool encrypted() const
+  {
+    bool is_encrypted;
+
+    detail::check(cpc_get_endpoint_encryption_state(endpoint_, &is_encrypted), "cpc_get_endpoint_encryption_state");
+    return is_encrypted;
+  }
+
+  int fd() const
+  {
+    return detail::check(cpc_get_endpoint_fd(endpoint_), "cpc_get_endpoint_fd");
+  }
+
+  cpc_endpoint_t native() const
+  {
+    return endpoint_;
+  }
+
+private:
+  friend class Handle;
+
+  explicit Endpoint(cpc_endpoint_t endpoint)
+    : endpoint_(endpoint)
+  {
+  }
+
+  cpc_endpoint_t endpoint_{};
+};
+
+/***************************************************************************//**
+ * @brief Listener of the events of one endpoint, de-initialized when destroyed.
+ ******************************************************************************/
+class EventHandle {
+public:
+  EventHandle(EventHandle &&other) noexcept
+    : event_handle_(std::exchange(other.event_handle_, cpc_endpoint_event_handle_t{}))
+  {
+  }
+
+  EventHandle &operator=(EventHandle &&other) noexcept
+  {
+    std::swap(event_handle_, other.event_handle_);
+    return *this;
+  }
+
+  EventHandle(const EventHandle &) = delete;
+  EventHandle &operator=(const EventHandle &) = delete;
+
+  ~EventHandle()
+  {
+    if (event_handle_.ptr != nullptr) {
+      cpc_deinit_endpoint_event(&event_handle_);
+    }
+  }
+
+  /// @return The next event, nothing when non-blocking and no event is pending
+  std::optional<cpc_event_type_t> read(bool non_blocking = false)
+  {
+    cpc_event_type_t event_type;
+    int ret = cpc_read_endpoint_event(event_handle_, &event_type,
+                                      non_blocking ? CPC_ENDPOINT_EVENT_FLAG_NON_BLOCKING : CPC_ENDPOINT_EVENT_FLAG_NONE);
+    if (ret == -EAGAIN && non_blocking) {
+      return std::nullopt;
+    }
+
+    detail::check(ret, "cpc_read_endpoint_event");
+    return event_type;
+  }
+
+  int fd() const
+  {
+    return detail::check(cpc_get_endpoint_event_fd(event_handle_), "cpc_get_endpoint_event_fd");
+  }
+
+  cpc_endpoint_event_handle_t native() const
+  {
+    return event_handle_;
+  }
+
+private:
+  friend class Handle;
+
+  explicit EventHandle(cpc_endpoint_event_handle_t event_handle)
+    : event_handle_(event_handle)
+  {
+  }
+
+  cpc_endpoint_event_handle_t event_handle_{};
+};
+
+/***************************************************************************//**
+ * @brief Connection to a daemon instance, de-initialized when destroyed.
+ *        The endpoints and event handles must be destroyed first.
+ ******************************************************************************/
+class Handle {
+public:
+  /// @param[in] instance_name    Daemon instance, nullptr for the default one
+  /// @param[in] enable_tracing   Print the library traces on stderr
+  /// @param[in] reset_callback   Optional, called from a signal handler when the secondary
+  ///                             resets. Prefer watching reset_fd() instead.
+  explicit Handle(const char *instance_name = nullptr, bool enable_tracing = false,
+                  cpc_reset_callback_t reset_callback = nullptr)
+  {
+    detail::check(cpc_init(&handle_, instance_name, enable_tracing, reset_callback), "cpc_init");
+  }
+
+  Handle(Handle &&other) noexcept
+    : handle_(std::exchange(other.handle_, cpc_handle_t{}))
+  {
+  }
+
+  Handle &operator=(Handle &&other) noexcept
+  {
+    std::swap(handle_, other.handle_);
+    return *this;
+  }
+
+  Handle(const Handle &) = delete;
+  Handle &operator=(const Handle &) = delete;
+
+  ~Handle()
+  {
+    if (handle_.ptr != nullptr) {
+      cpc_deinit(&handle_);
+    }
+  }
+
+  /// @brief Re-connect to the daemon after a reset of the secondary.
+  void restart()
+  {
+    detail::check(cpc_restart(&handle_), "cpc_restart");
+  }
+
+  /// @param[in] id   Endpoint to open, the tx window is always 1
+  Endpoint open_endpoint(uint8_t id)
+  {
+    cpc_endpoint_t endpoint;
+
+    detail::check(cpc_open_endpoint(handle_, &endpoint, id, 1), "cpc_open_endpoint");
+    return Endpoint(endpoint);
+  }
+
+  EventHandle open_endpoint_event(uint8_t id)
+  {
+    cpc_endpoint_event_handle_t event_handle;
+
+    detail::check(cpc_init_endpoint_event(handle_, &event_handle, id), "cpc_init_endpoint_event");
+    return EventHandle(event_handle);
+  }
+
+  cpc_endpoint_state_t endpoint_state(uint8_t id) const
+  {
+    cpc_endpoint_state_t state;
+
+    detail::check(cpc_get_endpoint_state(handle_, id, &state), "cpc_get_endpoint_state");
+    return state;
+  }
+
+  /// @brief File descriptor readable after a reset of the secondary.
+  int reset_fd() const
+  {
+    return detail::check(cpc_get_reset_fd(handle_), "cpc_get_reset_fd");
+  }
+
+  /// @return The number of resets since the last call, 0 when there was none
+  int read_reset_event()
+  {
+    int ret = cpc_read_reset_event(handle_);
+    if (ret == -EAGAIN) {
+      return 0;
+    }
+
+    return detail::check(ret, "cpc_read_reset_event");
+  }
+
+  std::string_view secondary_app_version() const
+  {
+    const char *version = cpc_get_secondary_app_version(handle_);
+
+    return version != nullptr ? std::string_view(version) : std::string_view();
+  }
+
+  static std::string_view library_version()
+  {
+    return cpc_get_library_version();
+  }
+
+  cpc_handle_t native() const
+  {
+    return handle_;
+  }
+
+private:
+  cpc_handle_t handle_{};
+};
+} // namespace cpc
+
+/** @} (end addtogroup cpc_cpp) */
+
+#endif // SL_CPC_HPP
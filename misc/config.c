@@ -81,6 +81,9 @@ config_t config = {
   // UART config
   .uart_baudrate = 115200,
   .uart_hardflow = false,
+  .uart_low_latency = false,
+  .uart_busy_poll_us = 0,
+  .uart_accurate_tx_complete = false,
   .uart_file = NULL,
 
   // SPI config
@@ -92,6 +95,16 @@ config_t config = {
   .spi_cs_pin = 24,
   .spi_irq_chip = "gpiochip0",
   .spi_irq_pin = 23,
+  .spi_cs_setup_us = 20,
+  .spi_inter_frame_gap_us = 20,
+
+  // Virtual secondary config
+  .virtual_link_rate = 115200,
+  .virtual_latency_us = 0,
+  .virtual_bit_error_rate = 0.0,
+  .virtual_processing_delay_us = 0,
+  .virtual_echo_endpoint = 90,
+  .virtual_echo_count = 1,
 
   // Firmware update
   .fu_reset_chip = "gpiochip0",
@@ -115,10 +128,16 @@ config_t config = {
 
   .reset_sequence = true,
 
+  .reset_recovery = false,
+
+  .driver_use_socketpair = false,
+
   .uart_validation_test_option = NULL,
 
   .stats_interval = 0,
 
+  .metrics_socket = true,
+
   .rlimit_nofile = 2000, /* New number of concurrent opened file descriptor */
 };
 
@@ -160,6 +179,8 @@ static const char* config_bus_to_str(bus_t value)
       return "UART";
     case SPI:
       return "SPI";
+    case VIRTUAL:
+      return "VIRTUAL";
     case UNCHOSEN:
       return "UNCHOSEN";
     default:
@@ -243,6 +264,12 @@ static const char* config_operation_mode_to_str(operation_mode_t value)
     run_time_total_size += (uint32_t)sizeof(value);        \
   } while (0)
 
+#define CONFIG_PRINT_DOUBLE(value)                         \
+  do {                                                     \
+    PRINT_INFO("%s = %g", &(#value)[print_offset], value); \
+    run_time_total_size += (uint32_t)sizeof(value);        \
+  } while (0)
+
 static void config_print(void)
 {
   PRINT_INFO("Reading configuration");
@@ -277,6 +304,9 @@ static void config_print(void)
 
   CONFIG_PRINT_DEC(config.uart_baudrate);
   CONFIG_PRINT_BOOL_TO_STR(config.uart_hardflow);
+  CONFIG_PRINT_BOOL_TO_STR(config.uart_low_latency);
+  CONFIG_PRINT_DEC(config.uart_busy_poll_us);
+  CONFIG_PRINT_BOOL_TO_STR(config.uart_accurate_tx_complete);
   CONFIG_PRINT_STR(config.uart_file);
 
   CONFIG_PRINT_STR(config.spi_file);
@@ -287,6 +317,15 @@ static void config_print(void)
   CONFIG_PRINT_DEC(config.spi_cs_pin);
   CONFIG_PRINT_STR(config.spi_irq_chip);
   CONFIG_PRINT_DEC(config.spi_irq_pin);
+  CONFIG_PRINT_DEC(config.spi_cs_setup_us);
+  CONFIG_PRINT_DEC(config.spi_inter_frame_gap_us);
+
+  CONFIG_PRINT_DEC(config.virtual_link_rate);
+  CONFIG_PRINT_DEC(config.virtual_latency_us);
+  CONFIG_PRINT_DOUBLE(config.virtual_bit_error_rate);
+  CONFIG_PRINT_DEC(config.virtual_processing_delay_us);
+  CONFIG_PRINT_DEC(config.virtual_echo_endpoint);
+  CONFIG_PRINT_DEC(config.virtual_echo_count);
 
   CONFIG_PRINT_STR(config.fu_reset_chip);
   CONFIG_PRINT_DEC(config.fu_spi_reset_pin);
@@ -308,10 +347,16 @@ static void config_print(void)
 
   CONFIG_PRINT_BOOL_TO_STR(config.reset_sequence);
 
+  CONFIG_PRINT_BOOL_TO_STR(config.reset_recovery);
+
+  CONFIG_PRINT_BOOL_TO_STR(config.driver_use_socketpair);
+
   CONFIG_PRINT_STR(config.uart_validation_test_option);
 
   CONFIG_PRINT_DEC(config.stats_interval);
 
+  CONFIG_PRINT_BOOL_TO_STR(config.metrics_socket);
+
   CONFIG_PRINT_DEC(config.rlimit_nofile);
 
   if (run_time_total_size != compile_time_total_size) {
@@ -693,6 +738,12 @@ static void config_parse_config_file(void)
         config.bus = UART;
       } else if (0 == strcmp(val, "SPI")) {
         config.bus = SPI;
+      } else if (0 == strcmp(val, "VIRTUAL")) {
+#if defined(ENABLE_VIRTUAL_SECONDARY)
+        config.bus = VIRTUAL;
+#else
+        FATAL("The virtual bus was requested, but the daemon was not compiled with -DENABLE_VIRTUAL_SECONDARY");
+#endif
       } else {
         FATAL("Config file error : bad bus_type value\n");
       }
@@ -718,6 +769,16 @@ static void config_parse_config_file(void)
       if (*endptr != '\0') {
         FATAL("Bad config line \"%s\"", line);
       }
+    } else if (0 == strcmp(name, "spi_cs_setup_us")) {
+      config.spi_cs_setup_us = (unsigned int)strtoul(val, &endptr, 10);
+      if (*endptr != '\0') {
+        FATAL("Bad config line \"%s\"", line);
+      }
+    } else if (0 == strcmp(name, "spi_inter_frame_gap_us")) {
+      config.spi_inter_frame_gap_us = (unsigned int)strtoul(val, &endptr, 10);
+      if (*endptr != '\0') {
+        FATAL("Bad config line \"%s\"", line);
+      }
     } else if (0 == strcmp(name, "spi_device_mode")) {
       if (0 == strcmp(val, "SPI_MODE_0")) {
         config.spi_mode = SPI_MODE_0;
@@ -752,6 +813,36 @@ static void config_parse_config_file(void)
       if (*endptr != '\0') {
         FATAL("Bad config line \"%s\"", line);
       }
+    } else if (0 == strcmp(name, "virtual_link_rate")) {
+      config.virtual_link_rate = (unsigned int)strtoul(val, &endptr, 10);
+      if (*endptr != '\0') {
+        FATAL("Bad config line \"%s\"", line);
+      }
+    } else if (0 == strcmp(name, "virtual_latency_us")) {
+      config.virtual_latency_us = (unsigned int)strtoul(val, &endptr, 10);
+      if (*endptr != '\0') {
+        FATAL("Bad config line \"%s\"", line);
+      }
+    } else if (0 == strcmp(name, "virtual_bit_error_rate")) {
+      config.virtual_bit_error_rate = strtod(val, &endptr);
+      if (*endptr != '\0' || config.virtual_bit_error_rate < 0.0 || config.virtual_bit_error_rate >= 1.0) {
+        FATAL("Config file error : bad virtual_bit_error_rate value");
+      }
+    } else if (0 == strcmp(name, "virtual_processing_delay_us")) {
+      config.virtual_processing_delay_us = (unsigned int)strtoul(val, &endptr, 10);
+      if (*endptr != '\0') {
+        FATAL("Bad config line \"%s\"", line);
+      }
+    } else if (0 == strcmp(name, "virtual_echo_endpoint")) {
+      config.virtual_echo_endpoint = (unsigned int)strtoul(val, &endptr, 10);
+      if (*endptr != '\0' || config.virtual_echo_endpoint < 1 || config.virtual_echo_endpoint > UINT8_MAX) {
+        FATAL("Config file error : bad virtual_echo_endpoint value");
+      }
+    } else if (0 == strcmp(name, "virtual_echo_count")) {
+      config.virtual_echo_count = (unsigned int)strtoul(val, &endptr, 10);
+      if (*endptr != '\0' || config.virtual_echo_count < 1 || config.virtual_echo_count > UINT8_MAX) {
+        FATAL("Config file error : bad virtual_echo_count value");
+      }
     } else if (0 == strcmp(name, "uart_device_file")) {
       config.uart_file = strdup(val);
       FATAL_ON(config.uart_file == NULL);
@@ -768,6 +859,27 @@ static void config_parse_config_file(void)
       } else {
         FATAL("Config file error : bad UART_HARDFLOW value");
       }
+    } else if (0 == strcmp(name, "uart_low_latency")) {
+      if (0 == strcmp(val, "true")) {
+        config.uart_low_latency = true;
+      } else if (0 == strcmp(val, "false")) {
+        config.uart_low_latency = false;
+      } else {
+        FATAL("Config file error : bad uart_low_latency value");
+      }
+    } else if (0 == strcmp(name, "uart_accurate_tx_complete")) {
+      if (0 == strcmp(val, "true")) {
+        config.uart_accurate_tx_complete = true;
+      } else if (0 == strcmp(val, "false")) {
+        config.uart_accurate_tx_complete = false;
+      } else {
+        FATAL("Config file error : bad uart_accurate_tx_complete value");
+      }
+    } else if (0 == strcmp(name, "uart_busy_poll_us")) {
+      config.uart_busy_poll_us = (unsigned int)strtoul(val, &endptr, 10);
+      if (*endptr != '\0') {
+        FATAL("Bad config line \"%s\"", line);
+      }
     } else if (0 == strcmp(name, "noop_keep_alive")) {
       if (0 == strcmp(val, "true")) {
         config.use_noop_keep_alive = true;
@@ -816,6 +928,30 @@ static void config_parse_config_file(void)
       } else {
         FATAL("Config file error : bad reset_sequence value");
       }
+    } else if (0 == strcmp(name, "reset_recovery")) {
+      if (0 == strcmp(val, "true")) {
+        config.reset_recovery = true;
+      } else if (0 == strcmp(val, "false")) {
+        config.reset_recovery = false;
+      } else {
+        FATAL("Config file error : bad reset_recovery value");
+      }
+    } else if (0 == strcmp(name, "driver_use_socketpair")) {
+      if (0 == strcmp(val, "true")) {
+        config.driver_use_socketpair = true;
+      } else if (0 == strcmp(val, "false")) {
+        config.driver_use_socketpair = false;
+      } else {
+        FATAL("Config file error : bad driver_use_socketpair value");
+      }
+    } else if (0 == strcmp(name, "metrics_socket")) {
+      if (0 == strcmp(val, "true")) {
+        config.metrics_socket = true;
+      } else if (0 == strcmp(val, "false")) {
+        config.metrics_socket = false;
+      } else {
+        FATAL("Config file error : bad metrics_socket value");
+      }
     } else if (0 == strcmp(name, "traces_folder")) {
       config.traces_folder = strdup(val);
       FATAL_ON(config.traces_folder == NULL);
@@ -939,6 +1075,16 @@ static void config_validate_configuration(void)
       }
 
       prevent_device_collision(config.uart_file);
+    } else if (config.bus == VIRTUAL) {
+      /* Only the normal mode knows how to drive the virtual secondary */
+      if (config.operation_mode != MODE_NORMAL) {
+        FATAL("The virtual bus is only supported in normal mode");
+      }
+
+      /* The sink and source endpoints follow the echo endpoints */
+      if (config.virtual_echo_endpoint + config.virtual_echo_count + 1 > UINT8_MAX) {
+        FATAL("The virtual echo endpoints leave no room for the sink and source endpoints");
+      }
     } else {
       FATAL("Invalid bus configuration.");
     }
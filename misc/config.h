@@ -28,6 +28,7 @@
 typedef enum {
   UART,
   SPI,
+  VIRTUAL,
   UNCHOSEN
 }bus_t;
 
@@ -68,6 +69,9 @@ typedef struct __attribute__((packed)) {
 
   unsigned int uart_baudrate;
   bool uart_hardflow;
+  bool uart_low_latency;
+  unsigned int uart_busy_poll_us;
+  bool uart_accurate_tx_complete;
   const char *uart_file;
 
   const char *spi_file;
@@ -78,6 +82,15 @@ typedef struct __attribute__((packed)) {
   unsigned int spi_cs_pin;
   const char *spi_irq_chip;
   unsigned int spi_irq_pin;
+  unsigned int spi_cs_setup_us;
+  unsigned int spi_inter_frame_gap_us;
+
+  unsigned int virtual_link_rate;
+  unsigned int virtual_latency_us;
+  double virtual_bit_error_rate;
+  unsigned int virtual_processing_delay_us;
+  unsigned int virtual_echo_endpoint;
+  unsigned int virtual_echo_count;
 
   const char *fu_reset_chip;
   unsigned int fu_spi_reset_pin;
@@ -100,10 +113,16 @@ typedef struct __attribute__((packed)) {
 
   bool reset_sequence;
 
+  bool reset_recovery;
+
+  bool driver_use_socketpair;
+
   const char *uart_validation_test_option;
 
   long stats_interval;
 
+  bool metrics_socket;
+
   rlim_t rlimit_nofile;
 } config_t;
 
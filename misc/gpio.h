@@ -20,7 +20,15 @@
 
 #include "sl_cpc.h"
 
-#ifdef USE_LEGACY_GPIO_SYSFS
+#if defined(USE_GPIO_CDEV)
+#define gpio_t gpio_cdev_t
+typedef struct {
+  unsigned int pin;
+  int line_fd;
+  int irq_fd;
+} gpio_t;
+#define GPIO_EPOLL_EVENT EPOLLIN
+#elif defined(USE_LEGACY_GPIO_SYSFS)
 #define gpio_t gpio_sysfs_t
 typedef struct {
   unsigned int pin;
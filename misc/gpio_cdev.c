@@ -0,0 +1,192 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - GPIO Character Device Interface
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/gpio.h>
+
+#include "gpio.h"
+#include "logging.h"
+
+/*
+ * Lines are requested with the v2 uAPI of the GPIO character device. Reading or
+ * writing a line is a single ioctl on the line request, without the lseek and
+ * text conversion of the sysfs interface nor the libgpiod dependency.
+ */
+
+static const char *consumer = "cpcd";
+
+static int sysfs_unexport(unsigned int gpio_pin)
+{
+  int fd;
+  int ret;
+  char buf[256];
+
+  fd = open("/sys/class/gpio/unexport", O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+
+  snprintf(buf, 256, "%d", gpio_pin);
+
+  ret = (int)write(fd, buf, strlen(buf));
+
+  close(fd);
+
+  return ret;
+}
+
+static int open_chip(const char *gpio_chip)
+{
+  char path[256];
+
+  // Accept both "gpiochip0" and "/dev/gpiochip0"
+  if (gpio_chip[0] == '/') {
+    snprintf(path, sizeof(path), "%s", gpio_chip);
+  } else {
+    snprintf(path, sizeof(path), "/dev/%s", gpio_chip);
+  }
+
+  return open(path, O_RDWR | O_CLOEXEC);
+}
+
+int gpio_init(gpio_cdev_t *gpio, const char *gpio_chip, unsigned int gpio_pin, gpio_direction_t direction, gpio_edge_t edge)
+{
+  struct gpio_v2_line_request request;
+  int chip_fd;
+  int ret;
+
+  if (gpio == NULL) {
+    return -1;
+  }
+
+  // In case we need to clean up after the sysfs interface
+  sysfs_unexport(gpio_pin);
+
+  memset(&request, 0, sizeof(request));
+  request.offsets[0] = gpio_pin;
+  request.num_lines = 1;
+  strncpy(request.consumer, consumer, sizeof(request.consumer) - 1);
+
+  if (direction == IN) {
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+    if (edge == FALLING) {
+      request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    } else if (edge == RISING) {
+      request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+    } else if (edge == BOTH) {
+      request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_EDGE_RISING;
+    }
+  } else {
+    request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    request.config.num_attrs = 1;
+    request.config.attrs[0].mask = 1;
+    request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    request.config.attrs[0].attr.values = (direction == HIGH) ? 1 : 0;
+  }
+
+  chip_fd = open_chip(gpio_chip);
+  FATAL_SYSCALL_ON(chip_fd < 0);
+
+  ret = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  // The line request holds its own reference on the chip
+  close(chip_fd);
+
+  gpio->pin = gpio_pin;
+  gpio->line_fd = request.fd;
+  gpio->irq_fd = (direction == IN && edge != NO_EDGE) ? request.fd : -1;
+
+  return 0;
+}
+
+int gpio_deinit(gpio_cdev_t *gpio)
+{
+  if (gpio == NULL) {
+    return -1;
+  }
+
+  if (gpio->line_fd >= 0) {
+    close(gpio->line_fd);
+  }
+  gpio->line_fd = -1;
+  gpio->irq_fd = -1;
+  gpio->pin = 0;
+
+  return 0;
+}
+
+int gpio_get_fd(gpio_cdev_t *gpio)
+{
+  if (gpio == NULL) {
+    return -1;
+  }
+
+  return gpio->irq_fd;
+}
+
+int gpio_clear_irq(gpio_cdev_t *gpio)
+{
+  // A single read drains every event queued so far
+  struct gpio_v2_line_event events[16];
+  ssize_t ret;
+
+  if (gpio == NULL) {
+    return -1;
+  }
+
+  ret = read(gpio->irq_fd, events, sizeof(events));
+  FATAL_SYSCALL_ON(ret < 0);
+
+  return 0;
+}
+
+int gpio_write(gpio_cdev_t *gpio, int value)
+{
+  struct gpio_v2_line_values values = { .bits = value ? 1 : 0, .mask = 1 };
+  int ret;
+
+  if (gpio == NULL) {
+    return -1;
+  }
+
+  ret = ioctl(gpio->line_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  return ret;
+}
+
+int gpio_read(gpio_cdev_t *gpio)
+{
+  struct gpio_v2_line_values values = { .bits = 0, .mask = 1 };
+  int ret;
+
+  if (gpio == NULL) {
+    return -1;
+  }
+
+  ret = ioctl(gpio->line_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  return (int)(values.bits & 1);
+}
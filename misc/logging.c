@@ -42,6 +42,9 @@
 
 #ifndef UNIT_TESTING
 #include "driver/driver_uart.h"
+#if defined(ENABLE_VIRTUAL_SECONDARY)
+#include "driver/driver_virtual.h"
+#endif
 #endif
 
 #ifdef COMPILE_LTTNG
@@ -420,7 +423,9 @@ static void logging_print_stats(epoll_private_data_t *event_private_data)
         "\nretxd_data_frame %u"
         "\ndriver_packet_dropped %u"
         "\ninvalid_header_checksum %u"
-        "\ninvalid_payload_checksum %u\n",
+        "\ninvalid_payload_checksum %u"
+        "\ndriver_resync %u"
+        "\ndriver_resync_bytes_discarded %u\n",
         primary_core_debug_counters.endpoint_opened,
         primary_core_debug_counters.endpoint_closed,
         primary_core_debug_counters.rxd_frame,
@@ -434,7 +439,9 @@ static void logging_print_stats(epoll_private_data_t *event_private_data)
         primary_core_debug_counters.retxd_data_frame,
         primary_core_debug_counters.driver_packet_dropped,
         primary_core_debug_counters.invalid_header_checksum,
-        primary_core_debug_counters.invalid_payload_checksum);
+        primary_core_debug_counters.invalid_payload_checksum,
+        primary_core_debug_counters.driver_resync,
+        primary_core_debug_counters.driver_resync_bytes_discarded);
 
   TRACE("RCP core debug counters"
         "\nendpoint_opened %u"
@@ -471,7 +478,14 @@ static void logging_print_stats(epoll_private_data_t *event_private_data)
 #ifndef UNIT_TESTING
   if (config.bus == UART) {
     driver_uart_print_overruns();
+    driver_uart_print_rx_deframe_latency();
+    driver_uart_print_tx_complete_error();
   }
+#if defined(ENABLE_VIRTUAL_SECONDARY)
+  if (config.bus == VIRTUAL) {
+    driver_virtual_print_rtt_error();
+  }
+#endif
 #endif
 }
 
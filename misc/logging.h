@@ -41,6 +41,8 @@ typedef struct {
   uint32_t driver_packet_dropped;
   uint32_t invalid_header_checksum;
   uint32_t invalid_payload_checksum;
+  uint32_t driver_resync;
+  uint32_t driver_resync_bytes_discarded;
 } core_debug_counters_t;
 
 void logging_init(void);
@@ -65,6 +67,8 @@ extern core_debug_counters_t secondary_core_debug_counters;
 #define EVENT_COUNTER_INIT()         (memset(&sl_cpc_core_debug_counters, sizeof(sl_cpc_core_debug_counters), 0))
 #define EVENT_COUNTER_INC(counter)   ((primary_core_debug_counters.counter)++)
 
+#define EVENT_COUNTER_ADD(counter, value)   ((primary_core_debug_counters.counter) += (value))
+
 #ifdef COMPILE_LTTNG
 #include <lttng/tracef.h>
 #define LTTNG_TRACE(string, ...)  tracef(string, ##__VA_ARGS__)
@@ -206,6 +210,8 @@ extern core_debug_counters_t secondary_core_debug_counters;
 
 #define TRACE_DRIVER_INVALID_HEADER_CHECKSUM()            do { EVENT_COUNTER_INC(invalid_header_checksum); TRACE_DRIVER("invalid header checksum in driver"); } while (0)
 
+#define TRACE_DRIVER_RESYNC(bytes_discarded)              do { EVENT_COUNTER_INC(driver_resync); TRACE_DRIVER("re-sync : had '%zu' number of bad bytes until we struck a good header", bytes_discarded); } while (0)
+
 #define OUT_FILE stderr
 
 __attribute__((noreturn)) void signal_crash(void);
@@ -0,0 +1,262 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Single producer, single consumer ring
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "misc/logging.h"
+#include "misc/spsc_ring.h"
+
+/*
+ * Every record starts with a header holding its length and is aligned on
+ * RECORD_ALIGNMENT bytes. A record that does not fit before the end of the
+ * buffer is stored at its start, the end of the buffer is then skipped with a
+ * header holding RECORD_WRAP.
+ */
+#define RECORD_ALIGNMENT 8u
+#define RECORD_HEADER_SIZE sizeof(uint32_t)
+#define RECORD_WRAP UINT32_MAX
+
+static size_t record_footprint(size_t length)
+{
+  return (RECORD_HEADER_SIZE + length + RECORD_ALIGNMENT - 1) & ~(size_t)(RECORD_ALIGNMENT - 1);
+}
+
+static void eventfd_signal(int fd)
+{
+  const uint64_t event_value = 1;
+  ssize_t ret;
+
+  ret = write(fd, &event_value, sizeof(event_value));
+  FATAL_SYSCALL_ON(ret != sizeof(event_value));
+}
+
+static void eventfd_clear(int fd)
+{
+  uint64_t event_value;
+  ssize_t ret;
+
+  ret = read(fd, &event_value, sizeof(event_value));
+  FATAL_SYSCALL_ON(ret < 0 && errno != EAGAIN);
+}
+
+void spsc_ring_init(spsc_ring_t *ring, size_t size)
+{
+  FATAL_ON(size < 2 * RECORD_ALIGNMENT || (size & (size - 1)) != 0);
+
+  ring->buffer = aligned_alloc(RECORD_ALIGNMENT, size);
+  FATAL_SYSCALL_ON(ring->buffer == NULL);
+
+  ring->size = size;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->producer_waiting = false;
+  ring->closed = false;
+
+  ring->doorbell_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  FATAL_SYSCALL_ON(ring->doorbell_fd < 0);
+
+  ring->space_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  FATAL_SYSCALL_ON(ring->space_fd < 0);
+}
+
+void spsc_ring_deinit(spsc_ring_t *ring)
+{
+  close(ring->doorbell_fd);
+  close(ring->space_fd);
+  free(ring->buffer);
+  ring->buffer = NULL;
+}
+
+int spsc_ring_get_fd(const spsc_ring_t *ring)
+{
+  return ring->doorbell_fd;
+}
+
+size_t spsc_ring_max_record_size(const spsc_ring_t *ring)
+{
+  // A record must fit even when the end of the buffer has to be skipped
+  return ring->size / 2 - RECORD_HEADER_SIZE;
+}
+
+void spsc_ring_close(spsc_ring_t *ring)
+{
+  __atomic_store_n(&ring->closed, true, __ATOMIC_SEQ_CST);
+
+  // Wake up a consumer polling the doorbell and a producer waiting for room
+  eventfd_signal(ring->doorbell_fd);
+  eventfd_signal(ring->space_fd);
+}
+
+static int wait_for_space(spsc_ring_t *ring, size_t head, size_t needed)
+{
+  struct pollfd space_poll = { .fd = ring->space_fd, .events = POLLIN };
+  size_t tail;
+  int ret;
+
+  for (;;) {
+    if (__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST)) {
+      return -ECONNRESET;
+    }
+
+    __atomic_store_n(&ring->producer_waiting, true, __ATOMIC_SEQ_CST);
+
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+    if (ring->size - (head - tail) >= needed) {
+      __atomic_store_n(&ring->producer_waiting, false, __ATOMIC_RELAXED);
+      return 0;
+    }
+
+    ret = poll(&space_poll, 1, -1);
+    FATAL_SYSCALL_ON(ret < 0 && errno != EINTR);
+
+    eventfd_clear(ring->space_fd);
+  }
+}
+
+int spsc_ring_pushv(spsc_ring_t *ring, const struct iovec *iov, int iovcnt)
+{
+  size_t length = 0;
+  size_t offset;
+  size_t contiguous;
+  size_t footprint;
+  size_t old_head = ring->head;
+  size_t head = old_head;
+  uint8_t *record;
+  int ret;
+
+  for (int i = 0; i < iovcnt; i++) {
+    length += iov[i].iov_len;
+  }
+
+  FATAL_ON(length > spsc_ring_max_record_size(ring));
+
+  offset = head & (ring->size - 1);
+  contiguous = ring->size - offset;
+  footprint = record_footprint(length);
+
+  if (footprint > contiguous) {
+    // Skip the end of the buffer, the record goes at its start
+    ret = wait_for_space(ring, head, contiguous + footprint);
+    if (ret < 0) {
+      return ret;
+    }
+    *(uint32_t *)&ring->buffer[offset] = RECORD_WRAP;
+    head += contiguous;
+    offset = 0;
+  } else {
+    ret = wait_for_space(ring, head, footprint);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+
+  record = &ring->buffer[offset];
+  *(uint32_t *)record = (uint32_t)length;
+  record += RECORD_HEADER_SIZE;
+  for (int i = 0; i < iovcnt; i++) {
+    memcpy(record, iov[i].iov_base, iov[i].iov_len);
+    record += iov[i].iov_len;
+  }
+
+  // Publish the record, then ring the doorbell if the consumer may have found the ring empty
+  __atomic_store_n(&ring->head, head + footprint, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == old_head) {
+    eventfd_signal(ring->doorbell_fd);
+  }
+
+  return 0;
+}
+
+int spsc_ring_push(spsc_ring_t *ring, const void *data, size_t length)
+{
+  struct iovec iov = { .iov_base = (void *)data, .iov_len = length };
+
+  return spsc_ring_pushv(ring, &iov, 1);
+}
+
+ssize_t spsc_ring_peek(spsc_ring_t *ring, const void **data)
+{
+  size_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+  size_t offset;
+  uint32_t length;
+
+  if (head == ring->tail) {
+    bool closed;
+
+    // Clear the doorbell, then look again in case a record was published in between.
+    // The records published before a close are read first, as on a socket
+    eventfd_clear(ring->doorbell_fd);
+    closed = __atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST);
+    head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+    if (head == ring->tail) {
+      return closed ? -ECONNRESET : -EAGAIN;
+    }
+    // The doorbell must stay readable as long as records are pending
+    eventfd_signal(ring->doorbell_fd);
+  }
+
+  offset = ring->tail & (ring->size - 1);
+  length = *(const uint32_t *)&ring->buffer[offset];
+
+  if (length == RECORD_WRAP) {
+    __atomic_store_n(&ring->tail, ring->tail + (ring->size - offset), __ATOMIC_SEQ_CST);
+    offset = 0;
+    length = *(const uint32_t *)ring->buffer;
+  }
+
+  *data = &ring->buffer[offset + RECORD_HEADER_SIZE];
+
+  return (ssize_t)length;
+}
+
+void spsc_ring_release(spsc_ring_t *ring)
+{
+  size_t offset = ring->tail & (ring->size - 1);
+  uint32_t length = *(const uint32_t *)&ring->buffer[offset];
+
+  BUG_ON(length == RECORD_WRAP);
+
+  __atomic_store_n(&ring->tail, ring->tail + record_footprint(length), __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(&ring->producer_waiting, __ATOMIC_SEQ_CST)) {
+    __atomic_store_n(&ring->producer_waiting, false, __ATOMIC_RELAXED);
+    eventfd_signal(ring->space_fd);
+  }
+}
+
+ssize_t spsc_ring_pop(spsc_ring_t *ring, void *buffer, size_t size)
+{
+  const void *data;
+  ssize_t length;
+
+  length = spsc_ring_peek(ring, &data);
+  if (length < 0) {
+    return length;
+  }
+
+  memcpy(buffer, data, (size_t)length < size ? (size_t)length : size);
+  spsc_ring_release(ring);
+
+  return length;
+}
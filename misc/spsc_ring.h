@@ -0,0 +1,98 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Single producer, single consumer ring
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * Lock-free ring of variable size records, between one producer thread and one
+ * consumer thread. Each record is stored contiguously and can be read in place.
+ *
+ * The consumer polls the doorbell, an eventfd that is readable whenever the ring
+ * holds records. The producer only writes to it when the ring goes non-empty,
+ * and the consumer only clears it once it found the ring empty, so a burst of
+ * records costs one wakeup. A producer finding the ring full sleeps on a second
+ * eventfd, written by the consumer once it made room.
+ *
+ * Either side can close the ring, like a socket: the producer then fails with
+ * -ECONNRESET, and the consumer does too once it read the records left.
+ */
+typedef struct {
+  uint8_t *buffer;
+  size_t size;
+  size_t head;            // Written by the producer only
+  size_t tail;            // Written by the consumer only
+  bool producer_waiting;
+  bool closed;
+  int doorbell_fd;
+  int space_fd;
+} spsc_ring_t;
+
+/*
+ * Allocate a ring of size bytes, a power of two. Crashes the app on failure.
+ */
+void spsc_ring_init(spsc_ring_t *ring, size_t size);
+
+void spsc_ring_deinit(spsc_ring_t *ring);
+
+/*
+ * File descriptor to poll for EPOLLIN, readable when the ring holds records.
+ */
+int spsc_ring_get_fd(const spsc_ring_t *ring);
+
+/*
+ * Largest record the ring can hold.
+ */
+size_t spsc_ring_max_record_size(const spsc_ring_t *ring);
+
+/*
+ * Mark the ring closed and wake up both sides. The file descriptors stay open
+ * until the ring is deinitialized.
+ */
+void spsc_ring_close(spsc_ring_t *ring);
+
+/*
+ * Producer side. Append one record made of the concatenation of the vectors,
+ * waiting for room if the ring is full. Returns 0, or -ECONNRESET when the
+ * ring is closed.
+ */
+int spsc_ring_pushv(spsc_ring_t *ring, const struct iovec *iov, int iovcnt);
+
+int spsc_ring_push(spsc_ring_t *ring, const void *data, size_t length);
+
+/*
+ * Consumer side. Get the oldest record without removing it, returns its length,
+ * -EAGAIN when the ring is empty or -ECONNRESET when it is empty and closed.
+ * The record stays valid until released.
+ */
+ssize_t spsc_ring_peek(spsc_ring_t *ring, const void **data);
+
+void spsc_ring_release(spsc_ring_t *ring);
+
+/*
+ * Copy the oldest record to the buffer and remove it, returns its length or the
+ * error of spsc_ring_peek(). A record larger than the buffer is truncated.
+ */
+ssize_t spsc_ring_pop(spsc_ring_t *ring, void *buffer, size_t size);
+
+#endif /* SPSC_RING_H */
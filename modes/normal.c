@@ -21,6 +21,9 @@
 #include "server_core/server_core.h"
 #include "driver/driver_uart.h"
 #include "driver/driver_spi.h"
+#if defined(ENABLE_VIRTUAL_SECONDARY)
+#include "driver/driver_virtual.h"
+#endif
 #include "misc/config.h"
 #include "misc/logging.h"
 #include "security/security.h"
@@ -52,6 +55,10 @@ void run_normal_mode(void)
                                       config.spi_irq_pin,
                                       config.fu_wake_chip,
                                       config.fu_spi_wake_pin);
+#if defined(ENABLE_VIRTUAL_SECONDARY)
+    } else if (config.bus == VIRTUAL) {
+      driver_thread = driver_virtual_init(&fd_socket_driver_core, &fd_socket_driver_core_notify);
+#endif
     } else {
       BUG();
     }
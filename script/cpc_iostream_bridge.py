@@ -32,10 +32,13 @@ def client_read(client, endpoint, event):
 
 def client_write(client, endpoint, event):
     global stop_flag
+    read_buffer = bytearray(libcpc_wrapper.READ_MINIMUM_SIZE)
+    read_view = memoryview(read_buffer)
     while not stop_flag:
         try:
-            buffer = endpoint.read()
-            assert len(buffer) != 0
+            size = endpoint.readinto(read_buffer)
+            assert size != 0
+            buffer = read_view[:size]
             verboseprint(' '.join(format(x, '02x') for x in buffer))
             client.sendall(buffer)
         except:
@@ -1,6 +1,8 @@
 from ctypes import *
 from enum import Enum
+import asyncio
 import signal
+import errno
 
 
 
@@ -46,6 +48,77 @@ class CPCTimeval(Structure):
 
 #end class
 
+# Largest frame returned by a read, see SL_CPC_READ_MINIMUM_SIZE
+READ_MINIMUM_SIZE = 4087
+
+class CPCWriteMessage(Structure):
+    _fields_ = [('data', c_void_p),
+                ('length', c_size_t)]
+#end class
+
+class CPCReadMessage(Structure):
+    _fields_ = [('data', c_void_p),
+                ('length', c_size_t),
+                ('truncated', c_bool)]
+#end class
+
+def _buffer_pointer(data, writable=False):
+    """
+    Return a ctypes object pointing to the memory of a bytes-like object, without
+    copying it when possible. The returned object keeps the memory alive and must
+    be held for as long as the library uses the pointer.
+    """
+    if isinstance(data, bytes) and not writable:
+        return c_char_p(data)
+
+    view = memoryview(data).cast('B')
+    if view.readonly:
+        if writable:
+            raise TypeError("a writable bytes-like object is required")
+        return (c_char * len(view)).from_buffer_copy(view)
+
+    return (c_char * len(view)).from_buffer(view)
+#end def
+
+class ReadBatch:
+    """
+    Frames received by one batched read. The arena is split in max_frames slots
+    of frame_capacity bytes, it is allocated once and reused by every read.
+    """
+
+    def __init__(self, max_frames, frame_capacity=READ_MINIMUM_SIZE):
+        self.arena = bytearray(max_frames * frame_capacity)
+        self.messages = (CPCReadMessage * max_frames)()
+        self.frame_capacity = frame_capacity
+        self.count = 0
+        self._arena_pointer = (c_char * len(self.arena)).from_buffer(self.arena)
+        self._arena_address = addressof(self._arena_pointer)
+    #end def
+
+    def __len__(self):
+        return self.count
+    #end def
+
+    def __getitem__(self, index):
+        """
+        Return a memoryview of one frame in the arena. It is only valid until
+        the batch is read into again.
+        """
+        if index < 0:
+            index += self.count
+        if index < 0 or index >= self.count:
+            raise IndexError("frame index out of range")
+
+        message = self.messages[index]
+        offset = message.data - self._arena_address
+        return memoryview(self.arena)[offset:offset + message.length]
+    #end def
+
+    def truncated(self, index):
+        return self.messages[index].truncated
+    #end def
+#end class
+
 class Endpoint(Structure):
 
     class Id(Enum):
@@ -81,41 +154,121 @@ class Endpoint(Structure):
 
     # ssize_t cpc_read_endpoint(cpc_endpoint_t endpoint, void *buffer, size_t count, cpc_endpoint_read_flags_t flags)
     def read(self, nonblock=False):
-        count = 4087
-        read_buffer = bytearray(count)
+        read_buffer = bytearray(READ_MINIMUM_SIZE)
+
+        ret = self.readinto(read_buffer, nonblock)
+        if ret is None:
+            raise Exception("Failed to read endpoint")
+
+        return bytes(memoryview(read_buffer)[:ret])
+    #end def
 
+    def readinto(self, buffer, nonblock=False):
+        """
+        Read one frame into a writable bytes-like object (bytearray, memoryview,
+        array, ...) of at least READ_MINIMUM_SIZE bytes, without any copy on the
+        Python side. Returns the size of the frame, or None when nonblock is set
+        and no frame is pending.
+        """
         flags = 0
         if nonblock:
             flags = (1 << 0)
 
-        byte_array = bytes(read_buffer)
-        byte_count = c_int(count)
-        read_flag = c_ubyte(flags)
-        ret = self.cpc_handle.lib_cpc.cpc_read_endpoint(self, byte_array, byte_count, read_flag)
+        pointer = _buffer_pointer(buffer, writable=True)
+        ret = self.cpc_handle.lib_cpc.cpc_read_endpoint(self, pointer, c_size_t(len(pointer)), c_ubyte(flags))
+        if ret == -errno.EAGAIN and nonblock:
+            return None
         if ret < 0:
             raise Exception("Failed to read endpoint")
 
-        return byte_array[:ret]
+        return ret
+    #end def
+
+    # ssize_t cpc_read_endpoint_batch(cpc_endpoint_t endpoint, void *arena, size_t arena_size, cpc_read_message_t *messages, size_t max_messages, const cpc_timeval_t *timeout, cpc_endpoint_read_flags_t flags)
+    def read_batch(self, batch, timeout=None, nonblock=False):
+        """
+        Wait for one frame, then read all the pending frames into the ReadBatch,
+        up to its capacity. Once the first frame is received, the call waits up
+        to timeout seconds for more frames. Returns the number of frames read,
+        0 when nonblock is set and no frame is pending.
+        """
+        flags = 0
+        if nonblock:
+            flags = (1 << 0)
+
+        timeval = None
+        if timeout != None:
+            timeval = byref(CPCTimeval(timeout))
+
+        batch.count = 0
+        ret = self.cpc_handle.lib_cpc.cpc_read_endpoint_batch(self, batch._arena_pointer, c_size_t(len(batch.arena)),
+                                                              batch.messages, c_size_t(len(batch.messages)),
+                                                              timeval, c_ubyte(flags))
+        if ret == -errno.EAGAIN and nonblock:
+            return 0
+        if ret < 0:
+            raise Exception("Failed to read endpoint batch")
+
+        batch.count = ret
+        return ret
     #end def
 
     # ssize_t cpc_write_endpoint(cpc_endpoint_t endpoint, const void *data, size_t data_length, cpc_endpoint_write_flags_t flags)
     def write(self, data, nonblock=False):
-        data_length = len(data)
-
+        """
+        Write one frame from a bytes-like object, the data is not copied on the
+        Python side. Returns the size of the frame, or None when nonblock is
+        set and the socket is full.
+        """
         flags = 0
         if nonblock:
             flags = (1 << 0)
 
-        byte_array = bytes(data)
-        length = c_int(data_length)
-        write_flag = c_ubyte(flags)
-        ret = self.cpc_handle.lib_cpc.cpc_write_endpoint(self, byte_array, length, write_flag)
+        pointer = _buffer_pointer(data)
+        data_length = memoryview(data).nbytes
+        ret = self.cpc_handle.lib_cpc.cpc_write_endpoint(self, pointer, c_size_t(data_length), c_ubyte(flags))
+        if ret == -errno.EAGAIN and nonblock:
+            return None
         if ret != data_length:
             raise Exception("Failed to write to endpoint")
 
         return ret
     #end def
 
+    # ssize_t cpc_write_endpoint_batch(cpc_endpoint_t endpoint, const cpc_write_message_t *messages, size_t message_count, cpc_endpoint_write_flags_t flags)
+    def write_batch(self, frames, nonblock=False):
+        """
+        Write a sequence of bytes-like objects, one frame each, with one call.
+        Returns the number of frames written, the remaining frames must be
+        written again. Returns 0 when nonblock is set and the socket is full.
+        """
+        flags = 0
+        if nonblock:
+            flags = (1 << 0)
+
+        pointers = [_buffer_pointer(frame) for frame in frames]
+        messages = (CPCWriteMessage * len(pointers))()
+        for message, pointer, frame in zip(messages, pointers, frames):
+            message.data = cast(pointer, c_void_p)
+            message.length = memoryview(frame).nbytes
+
+        ret = self.cpc_handle.lib_cpc.cpc_write_endpoint_batch(self, messages, c_size_t(len(messages)), c_ubyte(flags))
+        if ret == -errno.EAGAIN and nonblock:
+            return 0
+        if ret < 0:
+            raise Exception("Failed to write endpoint batch")
+
+        return ret
+    #end def
+
+    # int cpc_get_endpoint_fd(cpc_endpoint_t endpoint)
+    def fileno(self):
+        ret = self.cpc_handle.lib_cpc.cpc_get_endpoint_fd(self)
+        if ret < 0:
+            raise Exception("Failed to get endpoint file descriptor")
+        return ret
+    #end def
+
     # int cpc_set_endpoint_option(cpc_endpoint_t endpoint, cpc_option_t option, const void *optval, size_t optlen);
     def set_option(self, option, optval):
         if option == Option.CPC_OPTION_BLOCKING:
@@ -234,6 +387,7 @@ class Event(Enum):
     ENDPOINT_ERROR_DESTINATION_UNREACHABLE  = 4
     ENDPOINT_ERROR_SECURITY_INCIDENT        = 5
     ENDPOINT_ERROR_FAULT                    = 6
+    ENDPOINT_LINK_RESET                     = 7
 #end class
 
 
@@ -349,22 +503,49 @@ class CPC(Structure):
         # populate return type to make sure we return correct values for functions
         # that don't return an int
         self.lib_cpc.cpc_read_endpoint.restype = c_ssize_t
+        self.lib_cpc.cpc_read_endpoint_batch.restype = c_ssize_t
         self.lib_cpc.cpc_write_endpoint.restype = c_ssize_t
+        self.lib_cpc.cpc_write_endpoint_batch.restype = c_ssize_t
 
         trace = c_bool(enable_tracing)
+
+        # The daemon only sends SIGUSR1 to libraries that registered a reset callback,
+        # a no-op one is passed and the Python handler installed over it
+        self.c_reset_callback = CFUNCTYPE(None)(lambda: None)
         if reset_callback != None:
             self.reset_callback = reset_callback
-            signal.signal(signal.SIGUSR1, self.reset_cb)
-
-        ret = self.lib_cpc.cpc_init(byref(self), name, trace, None)
+            ret = self.lib_cpc.cpc_init(byref(self), name, trace, self.c_reset_callback)
+        else:
+            ret = self.lib_cpc.cpc_init(byref(self), name, trace, None)
         if ret != 0:
             raise Exception("Failed to initialize CPC library")
+
+        if reset_callback != None:
+            signal.signal(signal.SIGUSR1, self.reset_cb)
     #end def
 
     def reset_cb(self, signum, frame):
         self.reset_callback()
     #end def
 
+    # int cpc_get_reset_fd(cpc_handle_t handle)
+    def reset_fd(self):
+        ret = self.lib_cpc.cpc_get_reset_fd(self)
+        if ret < 0:
+            raise Exception("Failed to get reset file descriptor")
+        return ret
+    #end def
+
+    # int cpc_read_reset_event(cpc_handle_t handle)
+    def read_reset_event(self):
+        ret = self.lib_cpc.cpc_read_reset_event(self)
+        if ret == -errno.EAGAIN:
+            return 0
+        if ret < 0:
+            raise Exception("Failed to read reset event")
+        return ret
+    #end def
+
     # cpc_restart(cpc_handle_t *handle)
     def restart(self):
         ret = self.lib_cpc.cpc_restart(byref(self))
@@ -429,3 +610,84 @@ class CPC(Structure):
         return self.lib_cpc.cpc_get_secondary_app_version(self).decode("utf-8")
     #end def
 #end class
+
+
+class AsyncEndpoint:
+    """
+    Endpoint driven by an asyncio event loop. The socket of the endpoint is
+    watched with loop.add_reader() and loop.add_writer(), every library call
+    is non-blocking so the loop thread never waits in the library.
+    """
+
+    def __init__(self, endpoint, loop=None):
+        self.endpoint = endpoint
+        self.fd = endpoint.fileno()
+        self.loop = loop if loop != None else asyncio.get_running_loop()
+    #end def
+
+    async def _wait(self, add, remove):
+        future = self.loop.create_future()
+        add(self.fd, lambda: future.done() or future.set_result(None))
+        try:
+            await future
+        finally:
+            remove(self.fd)
+    #end def
+
+    async def _wait_readable(self):
+        await self._wait(self.loop.add_reader, self.loop.remove_reader)
+    #end def
+
+    async def _wait_writable(self):
+        await self._wait(self.loop.add_writer, self.loop.remove_writer)
+    #end def
+
+    async def readinto(self, buffer):
+        while True:
+            ret = self.endpoint.readinto(buffer, nonblock=True)
+            if ret != None:
+                return ret
+            await self._wait_readable()
+        #end while
+    #end def
+
+    async def read(self):
+        read_buffer = bytearray(READ_MINIMUM_SIZE)
+
+        ret = await self.readinto(read_buffer)
+        return bytes(memoryview(read_buffer)[:ret])
+    #end def
+
+    async def read_batch(self, batch):
+        while True:
+            ret = self.endpoint.read_batch(batch, nonblock=True)
+            if ret != 0:
+                return ret
+            await self._wait_readable()
+        #end while
+    #end def
+
+    async def write(self, data):
+        while True:
+            ret = self.endpoint.write(data, nonblock=True)
+            if ret != None:
+                return ret
+            await self._wait_writable()
+        #end while
+    #end def
+
+    async def write_batch(self, frames):
+        written = 0
+        while written < len(frames):
+            ret = self.endpoint.write_batch(frames[written:], nonblock=True)
+            if ret == 0:
+                await self._wait_writable()
+            written += ret
+        #end while
+        return written
+    #end def
+
+    def close(self):
+        self.endpoint.close()
+    #end def
+#end class
@@ -25,6 +25,10 @@
 #include <errno.h>
 #include <sys/time.h>
 
+#include "driver/driver_transport.h"
+#if defined(ENABLE_VIRTUAL_SECONDARY)
+#include "driver/driver_virtual.h"
+#endif
 #include "misc/config.h"
 #include "misc/endianess.h"
 #include "misc/logging.h"
@@ -95,7 +99,7 @@ static void core_process_rx_driver_notification(epoll_private_data_t *event_priv
 static void core_process_rx_driver(epoll_private_data_t *event_private_data);
 static void core_process_ep_timeout(epoll_private_data_t *event_private_data);
 
-static void core_process_rx_i_frame(frame_t *rx_frame);
+static void core_process_rx_i_frame(frame_t *rx_frame, const struct timespec *rx_timestamp);
 static void core_process_rx_s_frame(frame_t *rx_frame);
 static void core_process_rx_u_frame(frame_t *rx_frame);
 
@@ -127,6 +131,8 @@ static void core_on_security_state_change(sl_cpc_security_state_t old, sl_cpc_se
 #endif
 static void core_fetch_secondary_debug_counters(epoll_private_data_t *event_private_data);
 
+static void core_record_latency(core_latency_histogram_t *histogram, const struct timespec *start, const struct timespec *end);
+
 /*******************************************************************************
  **************************   IMPLEMENTATION    ********************************
  ******************************************************************************/
@@ -242,6 +248,12 @@ static void core_compute_re_transmit_timeout(sl_cpc_endpoint_t *endpoint)
     endpoint->smoothed_rtt = 7 * (endpoint->smoothed_rtt / 8) + round_trip_time_ms / 8;
   }
 
+#if defined(ENABLE_VIRTUAL_SECONDARY)
+  if (config.bus == VIRTUAL) {
+    driver_virtual_record_rtt(endpoint->id, round_trip_time_ms, endpoint->smoothed_rtt);
+  }
+#endif
+
   // Impose a lowerbound on the variation, we don't want the RTO to converge too close to the RTT
   if (endpoint->rtt_variation < SL_CPC_MIN_RE_TRANSMIT_TIMEOUT_MINIMUM_VARIATION_MS) {
     endpoint->rtt_variation = SL_CPC_MIN_RE_TRANSMIT_TIMEOUT_MINIMUM_VARIATION_MS;
@@ -398,6 +410,35 @@ bool core_get_endpoint_encryption(uint8_t ep_id)
 #endif
 }
 
+bool core_get_endpoint_metrics(uint8_t endpoint_number, core_endpoint_metrics_t *metrics)
+{
+  sl_cpc_endpoint_t *ep = &core_endpoints[endpoint_number];
+  sl_cpc_transmit_queue_item_t *item;
+
+  if (ep->state == SL_CPC_STATE_CLOSED && ep->counters.tx_frames == 0 && ep->counters.rx_frames == 0) {
+    return false;
+  }
+
+  metrics->state = ep->state;
+  metrics->encrypted = core_get_endpoint_encryption(endpoint_number);
+  metrics->tx_window_size = ep->configured_tx_window_size;
+  metrics->tx_window_space = ep->current_tx_window_space;
+  metrics->holding_list_depth = sl_slist_len(&ep->holding_list);
+  metrics->re_transmit_queue_depth = ep->frames_count_re_transmit_queue;
+  metrics->pending_on_security_depth = 0;
+  SL_SLIST_FOR_EACH_ENTRY(pending_on_security_ready_queue, item, sl_cpc_transmit_queue_item_t, node) {
+    if (item->handle->endpoint == ep) {
+      metrics->pending_on_security_depth++;
+    }
+  }
+  metrics->smoothed_rtt_ms = ep->smoothed_rtt;
+  metrics->rtt_variation_ms = ep->rtt_variation;
+  metrics->re_transmit_timeout_ms = ep->re_transmit_timeout_ms;
+  metrics->counters = ep->counters;
+
+  return true;
+}
+
 static void core_update_secondary_debug_counter(sl_cpc_system_command_handle_t *handle,
                                                 sl_cpc_property_id_t property_id,
                                                 void* property_value,
@@ -412,6 +453,9 @@ static void core_update_secondary_debug_counter(sl_cpc_system_command_handle_t *
   } else if (status == SL_STATUS_ABORT) {
     WARN("Secondary counters query aborted");
     return;
+  } else if (status == SL_STATUS_ALREADY_EXISTS) {
+    TRACE_CORE("Secondary counters query dropped, the previous one is still outstanding");
+    return;
   }
 
   if (status != SL_STATUS_OK && status != SL_STATUS_IN_PROGRESS) {
@@ -441,8 +485,8 @@ static void core_fetch_secondary_debug_counters(epoll_private_data_t *event_priv
     FATAL_ON(ret < 0);
   }
 
-  sl_cpc_system_cmd_property_get(core_update_secondary_debug_counter,
-                                 PROP_CORE_DEBUG_COUNTERS, 0, 0, false);
+  sl_cpc_system_cmd_property_get_background(core_update_secondary_debug_counter,
+                                            PROP_CORE_DEBUG_COUNTERS, 0, 0);
 }
 
 static void core_process_rx_driver_notification(epoll_private_data_t *event_private_data)
@@ -456,19 +500,22 @@ static void core_process_rx_driver_notification(epoll_private_data_t *event_priv
   struct timespec tx_complete_timestamp;
 
   BUG_ON(driver_sock_notify_private_data.file_descriptor < 1);
-  ssize_t ret = recv(driver_sock_notify_private_data.file_descriptor, &tx_complete_timestamp, sizeof(tx_complete_timestamp), MSG_DONTWAIT);
+  ssize_t ret = driver_transport_read_tx_complete(&tx_complete_timestamp);
 
   /* Socket closed */
-  if (ret == 0 || (ret < 0 && errno == ECONNRESET)) {
+  if (ret == -ECONNRESET) {
     TRACE_CORE("Driver closed the notification socket");
     epoll_unregister(&driver_sock_notify_private_data);
-    int ret_close = close(driver_sock_notify_private_data.file_descriptor);
+    int ret_close = driver_transport_close_core_fd(driver_sock_notify_private_data.file_descriptor);
     FATAL_SYSCALL_ON(ret_close != 0);
     driver_sock_notify_private_data.file_descriptor = -1;
     return;
   }
 
-  FATAL_SYSCALL_ON(ret < 0);
+  /* The ring doorbell can be readable after the ring was drained */
+  if (ret == -EAGAIN) {
+    return;
+  }
 
   // Get first queued frame for transmission
   node = sl_slist_pop(&pending_on_tx_complete);
@@ -479,6 +526,11 @@ static void core_process_rx_driver_notification(epoll_private_data_t *event_priv
   frame->pending_tx_complete = false;
   frame_type = hdlc_get_frame_type(frame->control);
 
+  if (frame->write_latency_pending) {
+    core_record_latency(&frame->endpoint->counters.write_to_wire, &frame->write_timestamp, &tx_complete_timestamp);
+    frame->write_latency_pending = false;
+  }
+
   switch (frame_type) {
     case SLI_CPC_HDLC_FRAME_TYPE_INFORMATION:
 
@@ -527,12 +579,15 @@ static void core_process_rx_driver(epoll_private_data_t *event_private_data)
   (void)event_private_data;
   frame_t *rx_frame;
   size_t frame_size;
+  struct timespec rx_timestamp;
 
   /* The driver unblocked, read the frame. Frames from the driver are complete */
   if (core_pull_frame_from_driver(&rx_frame, &frame_size) == false) {
     return;
   }
 
+  clock_gettime(CLOCK_MONOTONIC, &rx_timestamp);
+
   TRACE_CORE_RXD_FRAME(rx_frame, frame_size);
 
   /* Validate header checksum */
@@ -573,7 +628,7 @@ static void core_process_rx_driver(epoll_private_data_t *event_private_data)
 
   switch (type) {
     case SLI_CPC_HDLC_FRAME_TYPE_INFORMATION:
-      core_process_rx_i_frame(rx_frame);
+      core_process_rx_i_frame(rx_frame, &rx_timestamp);
       TRACE_CORE_RXD_VALID_IFRAME();
       break;
     case SLI_CPC_HDLC_FRAME_TYPE_SUPERVISORY:
@@ -623,7 +678,7 @@ bool core_ep_is_busy(uint8_t ep_id)
   return false;
 }
 
-static void core_process_rx_i_frame(frame_t *rx_frame)
+static void core_process_rx_i_frame(frame_t *rx_frame, const struct timespec *rx_timestamp)
 {
   sl_cpc_endpoint_t* endpoint;
 #if defined(ENABLE_ENCRYPTION)
@@ -720,9 +775,17 @@ static void core_process_rx_i_frame(frame_t *rx_frame)
           transmit_reject(endpoint, address, endpoint->ack, HDLC_REJECT_OUT_OF_MEMORY);
           return;
         }
+
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        core_record_latency(&endpoint->counters.wire_to_read, rx_timestamp, &now);
       }
     }
 
+    endpoint->counters.rx_bytes += rx_frame_payload_length;
+    endpoint->counters.rx_frames++;
+
     TRACE_ENDPOINT_RXD_DATA_FRAME_QUEUED(endpoint);
 
 #ifdef UNIT_TESTING
@@ -772,6 +835,7 @@ static void core_process_rx_s_frame(frame_t *rx_frame)
 
       TRACE_ENDPOINT_RXD_SUPERVISORY_PROCESSED(endpoint);
       BUG_ON(data_length != SLI_CPC_HDLC_REJECT_PAYLOAD_SIZE);
+      endpoint->counters.rejects_received++;
 
       switch (*((sl_cpc_reject_reason_t *)rx_frame->payload)) {
         case HDLC_REJECT_SEQUENCE_MISMATCH:
@@ -885,6 +949,8 @@ static void core_process_rx_u_frame(frame_t *rx_frame)
       if (endpoint->on_uframe_data_reception != NULL) {
         endpoint->on_uframe_data_reception(endpoint->id, rx_frame->payload, payload_length);
       }
+      endpoint->counters.rx_bytes += payload_length;
+      endpoint->counters.rx_frames++;
       break;
 
     case SLI_CPC_HDLC_CONTROL_UNNUMBERED_TYPE_POLL_FINAL:
@@ -968,6 +1034,8 @@ void core_write(uint8_t endpoint_number, const void* message, size_t message_len
     buffer_handle->data_length         = (uint16_t)message_len;
     buffer_handle->endpoint            = endpoint;
     buffer_handle->address             = endpoint_number;
+    buffer_handle->write_latency_pending = true;
+    clock_gettime(CLOCK_MONOTONIC, &buffer_handle->write_timestamp);
 
     if (iframe) {
       // Set the SEQ number and ACK number in the control byte
@@ -995,6 +1063,9 @@ void core_write(uint8_t endpoint_number, const void* message, size_t message_len
 
   transmit_queue_item->handle = buffer_handle;
 
+  endpoint->counters.tx_bytes += message_len;
+  endpoint->counters.tx_frames++;
+
   // Deal with transmit window
   {
     // If U-Frame, skip the window and send immediately
@@ -1020,6 +1091,7 @@ void core_open_endpoint(uint8_t endpoint_number, uint8_t flags, uint8_t tx_windo
 {
   sl_cpc_endpoint_t *ep;
   cpc_endpoint_state_t previous_state;
+  core_endpoint_counters_t counters;
 
   FATAL_ON(tx_window_size < TRANSMIT_WINDOW_MIN_SIZE);
   FATAL_ON(tx_window_size > TRANSMIT_WINDOW_MAX_SIZE);
@@ -1032,10 +1104,13 @@ void core_open_endpoint(uint8_t endpoint_number, uint8_t flags, uint8_t tx_windo
     return;
   }
 
-  /* Keep the previous state to log the transition */
+  /* Keep the previous state to log the transition, and the counters that cover
+   * the lifetime of the daemon */
   previous_state = ep->state;
+  counters = ep->counters;
   memset(ep, 0x00, sizeof(sl_cpc_endpoint_t));
   ep->state = previous_state;
+  ep->counters = counters;
   core_set_endpoint_state(endpoint_number, SL_CPC_STATE_OPEN);
 
   ep->id = endpoint_number;
@@ -1209,6 +1284,39 @@ sl_status_t core_close_endpoint(uint8_t endpoint_number, bool notify_secondary,
   return SL_STATUS_OK;
 }
 
+/***************************************************************************//**
+ * Restart the sequence of an open endpoint after the secondary has reset
+ *
+ * Frames in flight are dropped and the transmit window is restored, but the
+ * endpoint is left open so connected clients are not notified of a state change.
+ ******************************************************************************/
+void core_recover_endpoint(uint8_t endpoint_number)
+{
+  sl_cpc_endpoint_t *ep;
+
+  ep = find_endpoint(endpoint_number);
+
+  BUG_ON(ep->state != SL_CPC_STATE_OPEN);
+
+  TRACE_CORE("Restarting sequence of endpoint #%d", endpoint_number);
+
+  stop_re_transmit_timer(ep);
+
+  core_clear_transmit_queue(&ep->re_transmit_queue, -1);
+  core_clear_transmit_queue(&ep->holding_list, -1);
+  core_clear_transmit_queue(&transmit_queue, endpoint_number);
+  core_clear_transmit_queue(&pending_on_security_ready_queue, endpoint_number);
+
+  ep->seq = 0;
+  ep->ack = 0;
+  ep->frames_count_re_transmit_queue = 0;
+  ep->packet_re_transmit_count = 0;
+  ep->current_tx_window_space = ep->configured_tx_window_size;
+  ep->re_transmit_timeout_ms = SL_CPC_MIN_RE_TRANSMIT_TIMEOUT_MS;
+  ep->smoothed_rtt = 0;
+  ep->rtt_variation = 0;
+}
+
 void core_set_endpoint_option(uint8_t endpoint_number,
                               sl_cpc_endpoint_option_t option,
                               void *value)
@@ -1446,6 +1554,7 @@ static void re_transmit_frame(sl_cpc_endpoint_t *endpoint)
 
   endpoint->packet_re_transmit_count++;
   endpoint->frames_count_re_transmit_queue--;
+  endpoint->counters.re_transmits++;
 
   //Put frame in Tx Q so that it can be transmitted by CPC Core later
   sl_slist_push(&transmit_queue, &item->node);
@@ -1495,6 +1604,8 @@ static void transmit_reject(sl_cpc_endpoint_t *endpoint,
 
   sl_slist_push_back(&transmit_queue, &item->node);
 
+  core_endpoints[address].counters.rejects_sent++;
+
   if (endpoint != NULL) {
     switch (reason) {
       case HDLC_REJECT_CHECKSUM_MISMATCH:
@@ -1928,6 +2039,30 @@ static double diff_timespec_ms(const struct timespec *final, const struct timesp
          + (double)(final->tv_nsec - initial->tv_nsec) / 1000000.0;
 }
 
+/***************************************************************************//**
+ * Add the time elapsed between 'start' and 'end' to a latency histogram
+ ******************************************************************************/
+static void core_record_latency(core_latency_histogram_t *histogram, const struct timespec *start, const struct timespec *end)
+{
+  int64_t latency_ns = (int64_t)(end->tv_sec - start->tv_sec) * 1000000000 + (end->tv_nsec - start->tv_nsec);
+  int64_t latency_us;
+  size_t bucket = 0;
+
+  // The driver timestamps can precede the one taken by the core by a few ns
+  if (latency_ns < 0) {
+    latency_ns = 0;
+  }
+
+  latency_us = latency_ns / 1000;
+  while (bucket != CORE_LATENCY_BUCKETS && latency_us >= ((int64_t)1 << bucket)) {
+    bucket++;
+  }
+
+  histogram->buckets[bucket]++;
+  histogram->sum_ns += (uint64_t)latency_ns;
+  histogram->count++;
+}
+
 /***************************************************************************//**
  * Start the re-transmit timer for a given endpoint
  ******************************************************************************/
@@ -2007,20 +2142,18 @@ static void core_push_frame_to_driver(const void *frame, size_t frame_len)
     return;
   }
 
-  ssize_t ret = send(driver_sock_private_data.file_descriptor, frame, frame_len, 0);
+  ssize_t ret = driver_transport_write_tx(frame, frame_len);
 
   /* Socket closed */
-  if (ret < 0 && errno == ECONNRESET) {
+  if (ret == -ECONNRESET) {
     TRACE_CORE("Driver closed the data socket");
     epoll_unregister(&driver_sock_private_data);
-    int ret_close = close(driver_sock_private_data.file_descriptor);
+    int ret_close = driver_transport_close_core_fd(driver_sock_private_data.file_descriptor);
     FATAL_SYSCALL_ON(ret_close != 0);
     driver_sock_private_data.file_descriptor = -1;
     return;
   }
 
-  FATAL_SYSCALL_ON(ret < 0);
-
   FATAL_ON((size_t) ret != frame_len);
 
   TRACE_CORE_TXD_TRANSMIT_COMPLETED();
@@ -2046,22 +2179,23 @@ static bool core_pull_frame_from_driver(frame_t** frame_buf, size_t* frame_buf_l
       return false;
     }
 
-    ssize_t retval = recv(driver_sock_private_data.file_descriptor, NULL, 0, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+    ssize_t retval = driver_transport_peek_rx_size();
 
     /* Socket closed */
-    if (retval == 0 || (retval < 0 && errno == ECONNRESET)) {
+    if (retval == -ECONNRESET) {
       TRACE_CORE("Driver closed the data socket");
       epoll_unregister(&driver_sock_private_data);
-      int ret_close = close(driver_sock_private_data.file_descriptor);
+      int ret_close = driver_transport_close_core_fd(driver_sock_private_data.file_descriptor);
       FATAL_SYSCALL_ON(ret_close != 0);
       driver_sock_private_data.file_descriptor = -1;
       return false;
     }
 
-    FATAL_SYSCALL_ON(retval < 0);
+    /* The ring doorbell can be readable after the ring was drained */
+    if (retval == -EAGAIN) {
+      return false;
+    }
 
-    /* The socket had no data. This function is intended to be called
-     * when we know the socket has data. */
     datagram_length = (size_t)retval;
     BUG_ON(datagram_length == 0);
 
@@ -2077,9 +2211,9 @@ static bool core_pull_frame_from_driver(frame_t** frame_buf, size_t* frame_buf_l
 
   /* Fetch the datagram from the driver socket */
   {
-    ssize_t ret = recv(driver_sock_private_data.file_descriptor, *frame_buf, (size_t)datagram_length, 0);
+    ssize_t ret = driver_transport_read_rx(*frame_buf, (size_t)datagram_length);
 
-    FATAL_SYSCALL_ON(ret < 0);
+    FATAL_ON(ret < 0);
 
     /* The next pending datagram size should be equal to what we just read */
     FATAL_ON((size_t)ret != (size_t)datagram_length);
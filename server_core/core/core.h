@@ -63,6 +63,8 @@ void core_endpoint_set_frame_counter(uint8_t endpoint_number, uint32_t new_value
 
 void core_reset_endpoint_sequence(uint8_t endpoint_number);
 
+void core_recover_endpoint(uint8_t endpoint_number);
+
 bool core_ep_is_busy(uint8_t ep_id);
 
 sl_status_t core_close_endpoint(uint8_t endpoint_number, bool notify_secondary, bool force_close);
@@ -115,6 +117,48 @@ typedef struct {
 
 typedef void (*sl_cpc_on_data_reception_t)(uint8_t endpoint_id, const void* data, size_t data_len);
 
+/* Bucket i of a latency histogram counts the latencies below 2^i us, the last bucket the longer ones */
+#define CORE_LATENCY_BUCKETS 23
+
+typedef struct {
+  uint64_t buckets[CORE_LATENCY_BUCKETS + 1];
+  uint64_t sum_ns;
+  uint64_t count;
+} core_latency_histogram_t;
+
+/*
+ * Per-endpoint counters, kept by the core for the metrics socket.
+ * tx is toward the secondary, rx toward the clients.
+ */
+typedef struct {
+  uint64_t tx_bytes;
+  uint64_t tx_frames;
+  uint64_t rx_bytes;
+  uint64_t rx_frames;
+  uint64_t re_transmits;
+  uint64_t rejects_sent;
+  uint64_t rejects_received;
+  core_latency_histogram_t write_to_wire;   // From core_write() to the tx complete of the first transmission
+  core_latency_histogram_t wire_to_read;    // From the frame read from the driver to the payload sent to the clients
+} core_endpoint_counters_t;
+
+/*
+ * Snapshot of an endpoint, see core_get_endpoint_metrics()
+ */
+typedef struct {
+  cpc_endpoint_state_t state;
+  bool encrypted;
+  uint8_t tx_window_size;
+  uint8_t tx_window_space;
+  size_t holding_list_depth;
+  size_t re_transmit_queue_depth;
+  size_t pending_on_security_depth;
+  long smoothed_rtt_ms;
+  long rtt_variation_ms;
+  long re_transmit_timeout_ms;
+  core_endpoint_counters_t counters;
+} core_endpoint_metrics_t;
+
 /*
  * Internal state for the endpoints. Will be filled by cpc_register_endpoint()
  */
@@ -143,6 +187,7 @@ typedef struct endpoint {
   uint32_t frame_counter_tx;
   uint32_t frame_counter_rx;
 #endif
+  core_endpoint_counters_t counters;
 }sl_cpc_endpoint_t;
 
 typedef struct {
@@ -164,6 +209,8 @@ typedef struct {
   uint8_t pending_ack;
   bool acked;
   bool pending_tx_complete;
+  bool write_latency_pending;         // Set by core_write(), cleared once the first transmission completed
+  struct timespec write_timestamp;
 } sl_cpc_buffer_handle_t;
 
 typedef struct {
@@ -176,4 +223,10 @@ typedef struct {
   uint8_t  payload[];     // last two bytes are little endian 16bits
 }frame_t;
 
+/*
+ * Fill 'metrics' with the counters and the queue depths of an endpoint. Returns
+ * false when the endpoint is closed and never carried a frame.
+ */
+bool core_get_endpoint_metrics(uint8_t endpoint_number, core_endpoint_metrics_t *metrics);
+
 #endif
@@ -35,7 +35,9 @@ SL_ENUM_GENERIC(cpcd_exchange_type_t, uint8_t)
   EXCHANGE_SECONDARY_APP_VERSION_STRING_QUERY,
   EXCHANGE_SECONDARY_APP_VERSION_SIZE_QUERY,
   EXCHANGE_OPEN_ENDPOINT_EVENT_SOCKET_QUERY,
-  EXCHANGE_NORMAL_OPERATION_MODE_QUERY
+  EXCHANGE_NORMAL_OPERATION_MODE_QUERY,
+  EXCHANGE_ALL_ENDPOINT_STATES_QUERY,
+  EXCHANGE_SET_RESET_EVENTFD_QUERY
 };
 
 typedef struct {
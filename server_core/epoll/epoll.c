@@ -63,6 +63,22 @@ void epoll_register(epoll_private_data_t *private_data)
   FATAL_SYSCALL_ON(ret < 0);
 }
 
+void epoll_register_output(epoll_private_data_t *private_data)
+{
+  struct epoll_event event = {};
+  int ret;
+
+  FATAL_ON(private_data == NULL);
+  FATAL_ON(private_data->callback == NULL);
+  FATAL_ON(private_data->file_descriptor < 1);
+
+  event.events = EPOLLOUT; /* Level-triggered write() availability */
+  event.data.ptr = private_data;
+
+  ret = epoll_ctl(fd_epoll, EPOLL_CTL_ADD, private_data->file_descriptor, &event);
+  FATAL_SYSCALL_ON(ret < 0);
+}
+
 void epoll_unregister(epoll_private_data_t *private_data)
 {
   int ret;
@@ -38,6 +38,8 @@ void epoll_init(void);
 
 void epoll_register(epoll_private_data_t *private_data);
 
+void epoll_register_output(epoll_private_data_t *private_data);
+
 void epoll_unregister(epoll_private_data_t *private_data);
 
 void epoll_unwatch(epoll_private_data_t *private_data);
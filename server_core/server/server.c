@@ -59,6 +59,8 @@ typedef struct {
   sl_slist_node_t node;
   epoll_private_data_t data_socket_epoll_private_data;
   pid_t pid;
+  int reset_eventfd;
+  bool reset_signal;
 }ctrl_socket_private_data_list_item_t;
 
 typedef struct {
@@ -86,6 +88,7 @@ typedef struct {
   sl_slist_node_t* event_data_socket_epoll_private_data;
   sl_slist_node_t* data_socket_epoll_private_data;
   sl_slist_node_t* data_ctrl_data_socket_pair;
+  bool recovering;
 #if defined(ENABLE_ENCRYPTION)
   bool encrypted;
 #endif
@@ -133,6 +136,9 @@ static void server_handle_client_closed_event_connection(int fd_data_socket, uin
 static void server_ep_push_close_socket_pair(int fd_data_socket, int fd_ctrl_data_socket, uint8_t endpoint_number);
 static bool server_ep_find_close_socket_pair(int fd_data_socket, int fd_ctrl_data_socket, uint8_t endpoint_number);
 static int server_pull_data_from_data_socket(int fd_data_socket, uint8_t** buffer_ptr, size_t* buffer_len_ptr);
+static int server_pull_data_from_ctrl_data_socket(int fd_ctrl_data_socket, uint8_t** buffer_ptr, size_t* buffer_len_ptr, int* passed_fd_ptr);
+static void server_notify_connected_libs_of_link_reset(uint8_t ep_id);
+static bool server_prepare_reset_eventfd(int fd);
 
 /*******************************************************************************
  **************************   IMPLEMENTATION    ********************************
@@ -346,6 +352,9 @@ static void server_process_epoll_fd_ctrl_connection_socket(epoll_private_data_t
     /* Allocate resources for this new connection */
     new_item = zalloc(sizeof *new_item);
     new_item->pid = -1;
+    new_item->reset_eventfd = -1;
+    // Libraries that do not register a reset eventfd rely on SIGUSR1
+    new_item->reset_signal = true;
 
     /* Register this new data socket to epoll set */
     {
@@ -415,6 +424,7 @@ static void server_process_epoll_fd_ctrl_data_socket(epoll_private_data_t *priva
   uint8_t* buffer;
   size_t buffer_len;
   cpcd_exchange_buffer_t *interface_buffer;
+  int passed_fd;
   int ret;
 
   /* Check if the event is about the client closing the connection */
@@ -431,7 +441,7 @@ static void server_process_epoll_fd_ctrl_data_socket(epoll_private_data_t *priva
   }
 
   /* Retrieve the payload from the endpoint data connection */
-  ret = server_pull_data_from_data_socket(fd_ctrl_data_socket, &buffer, &buffer_len);
+  ret = server_pull_data_from_ctrl_data_socket(fd_ctrl_data_socket, &buffer, &buffer_len, &passed_fd);
   FATAL_ON(ret != 0);
 
   FATAL_ON(buffer_len < sizeof(cpcd_exchange_buffer_t));
@@ -768,6 +778,35 @@ static void server_process_epoll_fd_ctrl_data_socket(epoll_private_data_t *priva
     }
     break;
 
+    case EXCHANGE_ALL_ENDPOINT_STATES_QUERY:
+      /* Client requested the status of every endpoint at once */
+    {
+      cpc_endpoint_state_info_t *states = (cpc_endpoint_state_info_t *)interface_buffer->payload;
+
+      TRACE_SERVER("Received an all endpoint states query");
+
+      BUG_ON(buffer_len != sizeof(cpcd_exchange_buffer_t) + SL_CPC_ENDPOINT_COUNT * sizeof(cpc_endpoint_state_info_t));
+
+      for (size_t i = 0; i < SL_CPC_ENDPOINT_COUNT; i++) {
+        uint8_t ep_id = (uint8_t)i;
+
+        states[i].state = ep_id == SL_CPC_ENDPOINT_SYSTEM ? SL_CPC_STATE_OPEN : core_get_endpoint_state(ep_id);
+        states[i].encrypted = core_get_endpoint_encryption(ep_id);
+        states[i].data_connections = (uint16_t)(endpoints[i].open_data_connections > UINT16_MAX ? UINT16_MAX : endpoints[i].open_data_connections);
+        states[i].event_connections = (uint16_t)(endpoints[i].open_event_connections > UINT16_MAX ? UINT16_MAX : endpoints[i].open_event_connections);
+      }
+
+      ssize_t ret = send(fd_ctrl_data_socket, interface_buffer, buffer_len, 0);
+
+      if (ret < 0 && errno == EPIPE) {
+        server_handle_client_closed_ctrl_connection(fd_ctrl_data_socket);
+      } else {
+        FATAL_SYSCALL_ON(ret < 0 && errno != EPIPE);
+        FATAL_ON((size_t)ret != buffer_len);
+      }
+    }
+    break;
+
     case EXCHANGE_OPEN_ENDPOINT_EVENT_SOCKET_QUERY:
     {
       server_open_endpoint_event_socket(interface_buffer->endpoint_number);
@@ -783,10 +822,59 @@ static void server_process_epoll_fd_ctrl_data_socket(epoll_private_data_t *priva
     }
     break;
 
+    case EXCHANGE_SET_RESET_EVENTFD_QUERY:
+      /* Client passed an eventfd to be signaled when the secondary resets */
+    {
+      ctrl_socket_private_data_list_item_t* item;
+      bool registered = false;
+
+      TRACE_SERVER("Received a set reset eventfd query");
+
+      BUG_ON(buffer_len != sizeof(cpcd_exchange_buffer_t) + sizeof(bool));
+
+      SL_SLIST_FOR_EACH_ENTRY(ctrl_connections,
+                              item,
+                              ctrl_socket_private_data_list_item_t,
+                              node){
+        if (item->data_socket_epoll_private_data.file_descriptor == fd_ctrl_data_socket) {
+          if (item->reset_eventfd >= 0) {
+            close(item->reset_eventfd);
+            item->reset_eventfd = -1;
+          }
+          /* Without an eventfd, SIGUSR1 is still only sent if the library asked for it:
+           * it installs a SIGUSR1 handler only when the application passed a reset callback */
+          item->reset_signal = *(bool *)interface_buffer->payload;
+          if (passed_fd >= 0 && server_prepare_reset_eventfd(passed_fd)) {
+            item->reset_eventfd = passed_fd;
+            registered = true;
+            passed_fd = -1;
+          }
+          break;
+        }
+      }
+
+      memcpy(interface_buffer->payload, &registered, sizeof(bool));
+
+      ssize_t ret = send(fd_ctrl_data_socket, interface_buffer, buffer_len, 0);
+
+      if (ret < 0 && errno == EPIPE) {
+        server_handle_client_closed_ctrl_connection(fd_ctrl_data_socket);
+      } else {
+        FATAL_SYSCALL_ON(ret < 0 && errno != EPIPE);
+        FATAL_ON((size_t)ret != buffer_len);
+      }
+    }
+    break;
+
     default:
       break;
   }
 
+  /* A file descriptor passed along an unrelated query is not kept */
+  if (passed_fd >= 0) {
+    close(passed_fd);
+  }
+
   free(buffer);
 }
 
@@ -895,9 +983,9 @@ static void server_process_epoll_fd_timeout_noop(epoll_private_data_t *private_d
 
   TRACE_SERVER("NOOP keep alive");
 
-  sl_cpc_system_cmd_noop(system_noop_cmd_callback_t,
-                         5,
-                         100000);
+  sl_cpc_system_cmd_noop_background(system_noop_cmd_callback_t,
+                                    5,
+                                    100000);
 }
 #endif
 
@@ -1003,7 +1091,7 @@ static void server_process_epoll_fd_ep_data_socket(epoll_private_data_t *private
   uint8_t endpoint_number = private_data->endpoint_number;
   int ret;
 
-  if (core_ep_is_busy(endpoint_number)) {
+  if (core_ep_is_busy(endpoint_number) || endpoints[endpoint_number].recovering) {
     /* Prevent epoll from unblocking right away on this [still marked as ready-read] file descriptor the next time
      * epoll_wait is called (and thus leading to 100% CPU usage) */
     epoll_unwatch(private_data);
@@ -1092,8 +1180,12 @@ static void server_handle_client_closed_ep_connection(int fd_data_socket, uint8_
       /* Remove the item from the list*/
       sl_slist_remove(&endpoints[endpoint_number].data_socket_epoll_private_data, &item->node);
 
-      /* Notify the client */
-      server_handle_client_closed_ep_notify_close(item->data_socket_epoll_private_data.file_descriptor, endpoint_number);
+      /* Notify the client. A library closing an endpoint with reads or writes in flight
+       * shuts its socket down before sending the close query, keep track of the
+       * closed socket so that the query is acked as soon as it arrives */
+      if (!server_handle_client_closed_ep_notify_close(item->data_socket_epoll_private_data.file_descriptor, endpoint_number)) {
+        server_ep_push_close_socket_pair(item->data_socket_epoll_private_data.file_descriptor, -1, endpoint_number);
+      }
 
       /* Properly shutdown and close this socket on our side (it is on the client's side)*/
       int ret = shutdown(fd_data_socket, SHUT_RDWR);
@@ -1241,6 +1333,11 @@ static void server_handle_client_closed_ctrl_connection(int fd_data_socket)
       ret = close(fd_data_socket);
       FATAL_SYSCALL_ON(ret < 0);
 
+      if (item->reset_eventfd >= 0) {
+        ret = close(item->reset_eventfd);
+        FATAL_SYSCALL_ON(ret < 0);
+      }
+
       PRINT_INFO("Client disconnected");
 
       /* data connections items are malloced */
@@ -1487,6 +1584,11 @@ bool server_is_endpoint_open(uint8_t endpoint_number)
   return endpoints[endpoint_number].connection_socket_epoll_private_data.file_descriptor == -1 ? false : true;
 }
 
+uint32_t server_get_endpoint_client_count(uint8_t endpoint_number)
+{
+  return endpoints[endpoint_number].open_data_connections;
+}
+
 /* Close an endpoint in the server layer
  *
  * Closing an endpoint means to close every active connection (data socket) with client applications,
@@ -1507,6 +1609,8 @@ void server_close_endpoint(uint8_t endpoint_number, bool error)
     }
   }
 
+  endpoints[endpoint_number].recovering = false;
+
   /* Close every open connection on that endpoint (data socket) */
   while (endpoints[endpoint_number].data_socket_epoll_private_data != NULL) {
     data_socket_private_data_list_item_t* item;
@@ -1751,6 +1855,124 @@ static int server_pull_data_from_data_socket(int fd_data_socket, uint8_t** buffe
   return 0;
 }
 
+/* Same as server_pull_data_from_data_socket(), but also accepts one file descriptor passed by the
+ * library as ancillary data. The passed_fd_ptr is set to -1 when no descriptor came along. */
+static int server_pull_data_from_ctrl_data_socket(int fd_ctrl_data_socket, uint8_t** buffer_ptr, size_t* buffer_len_ptr, int* passed_fd_ptr)
+{
+  int datagram_length;
+  uint8_t* buffer;
+  ssize_t rc;
+  int ret;
+  union {
+    struct cmsghdr align;
+    uint8_t buf[CMSG_SPACE(sizeof(int))];
+  } control;
+  struct iovec iov;
+  struct msghdr msg = { 0 };
+  struct cmsghdr *cmsg;
+
+  *passed_fd_ptr = -1;
+
+  /* Poll the socket to get the next pending datagram size */
+  {
+    ret = ioctl(fd_ctrl_data_socket, FIONREAD, &datagram_length);
+
+    FATAL_SYSCALL_ON(ret < 0);
+
+    /* The socket had no data. This function is intended to be called
+     * when we know the socket has data. */
+    BUG_ON(datagram_length == 0);
+  }
+
+  /* Allocate a buffer of the right size */
+  {
+    // Allocate a buffer and pad it to 8 bytes because memcpy reads in chunks of 8.
+    // If we don't pad, Valgrind will complain.
+    buffer = (uint8_t*) zalloc((size_t)PAD_TO_8_BYTES(datagram_length));
+    FATAL_ON(buffer == NULL);
+  }
+
+  /* Fetch the data and the ancillary data from the ctrl data socket */
+  {
+    iov.iov_base = buffer;
+    iov.iov_len = (size_t)datagram_length;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    rc = recvmsg(fd_ctrl_data_socket, &msg, MSG_CMSG_CLOEXEC);
+    if (rc < 0) {
+      TRACE_SERVER("recvmsg() failed with %s", ERRNO_CODENAME[errno]);
+    }
+
+    if (rc == 0 || (rc < 0 && errno == ECONNRESET)) {
+      TRACE_SERVER("Client is closed");
+      free(buffer);
+      return -1;
+    }
+    FATAL_SYSCALL_ON(rc < 0);
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET
+          && cmsg->cmsg_type == SCM_RIGHTS
+          && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+        memcpy(passed_fd_ptr, CMSG_DATA(cmsg), sizeof(int));
+      }
+    }
+
+    /* Only one descriptor is expected per query, any extra one was discarded by the kernel */
+    if (msg.msg_flags & MSG_CTRUNC) {
+      WARN("Ancillary data from ctrl data socket was truncated");
+    }
+  }
+
+  *buffer_ptr = buffer;
+  *buffer_len_ptr = (size_t)rc;
+  return 0;
+}
+
+/* Check that a descriptor passed by a library is an eventfd, and make it non-blocking
+ *
+ * It is written from the server core thread when the secondary resets, anything else
+ * than an eventfd could block the daemon or fail. */
+static bool server_prepare_reset_eventfd(int fd)
+{
+  char proc_path[32];
+  char target[32];
+  struct stat sb;
+  ssize_t length;
+  int flags;
+
+  /* An eventfd is an anonymous inode, not a file, a pipe, a socket or a device */
+  if (fstat(fd, &sb) < 0 || S_ISREG(sb.st_mode) || S_ISDIR(sb.st_mode) || S_ISFIFO(sb.st_mode)
+      || S_ISSOCK(sb.st_mode) || S_ISCHR(sb.st_mode) || S_ISBLK(sb.st_mode)) {
+    WARN("Reset eventfd rejected, the descriptor is not an eventfd");
+    return false;
+  }
+
+  snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", fd);
+  length = readlink(proc_path, target, sizeof(target) - 1);
+  if (length < 0) {
+    WARN("Reset eventfd rejected, readlink(%s) failed: %s", proc_path, ERRNO_CODENAME[errno]);
+    return false;
+  }
+  target[length] = '\0';
+
+  if (strcmp(target, "anon_inode:[eventfd]") != 0) {
+    WARN("Reset eventfd rejected, the descriptor is a %s", target);
+    return false;
+  }
+
+  flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    WARN("Reset eventfd rejected, it cannot be made non-blocking: %s", ERRNO_CODENAME[errno]);
+    return false;
+  }
+
+  return true;
+}
+
 bool server_listener_list_empty(uint8_t endpoint_number)
 {
   return endpoints[endpoint_number].open_data_connections == 0;
@@ -1764,6 +1986,21 @@ void server_notify_connected_libs_of_secondary_reset(void)
                           item,
                           ctrl_socket_private_data_list_item_t,
                           node){
+    if (item->reset_eventfd >= 0) {
+      const uint64_t reset_event = 1;
+      ssize_t ret = write(item->reset_eventfd, &reset_event, sizeof(reset_event));
+      // EAGAIN means the counter is saturated, the library will notice the reset anyway
+      if (ret < 0 && errno != EAGAIN) {
+        WARN("Failed to signal the reset eventfd of pid %d: %s", item->pid, ERRNO_CODENAME[errno]);
+        close(item->reset_eventfd);
+        item->reset_eventfd = -1;
+      }
+    }
+
+    if (!item->reset_signal) {
+      continue;
+    }
+
     if (item->pid != getpid()) {
       if (item->pid > 1) {
         kill(item->pid, SIGUSR1);
@@ -1774,6 +2011,36 @@ void server_notify_connected_libs_of_secondary_reset(void)
   }
 }
 
+/* Hold back client data on an endpoint while its sequence is re-established with the secondary
+ *
+ * The data sockets stay connected, whatever the clients write is kept in the socket buffers
+ * until server_resume_endpoint() is called. */
+void server_suspend_endpoint(uint8_t endpoint_number)
+{
+  BUG_ON(endpoint_number == SL_CPC_ENDPOINT_SYSTEM || endpoint_number == SL_CPC_ENDPOINT_SECURITY);
+
+  TRACE_SERVER("Suspending ep#%u during reset recovery", endpoint_number);
+
+  endpoints[endpoint_number].recovering = true;
+}
+
+/* Resume an endpoint suspended by server_suspend_endpoint() and let its clients know that
+ * frames in flight at the time of the secondary reset were lost */
+void server_resume_endpoint(uint8_t endpoint_number)
+{
+  if (!endpoints[endpoint_number].recovering) {
+    return;
+  }
+
+  TRACE_SERVER("Resuming ep#%u after reset recovery", endpoint_number);
+
+  endpoints[endpoint_number].recovering = false;
+
+  epoll_watch_back(endpoint_number);
+
+  server_notify_connected_libs_of_link_reset(endpoint_number);
+}
+
 static void server_send_event(int socket_fd, cpc_event_type_t event_type, uint8_t ep_id, uint8_t *payload, uint32_t payload_length)
 {
   cpcd_event_buffer_t *event = zalloc(sizeof(cpcd_event_buffer_t) + payload_length);
@@ -1842,6 +2109,21 @@ static void server_notify_connected_libs_of_endpoint_state_change(uint8_t ep_id,
   }
 }
 
+static void server_notify_connected_libs_of_link_reset(uint8_t ep_id)
+{
+  event_socket_private_data_list_item_t* item;
+
+  SL_SLIST_FOR_EACH_ENTRY(endpoints[ep_id].event_data_socket_epoll_private_data, item,
+                          event_socket_private_data_list_item_t,
+                          node){
+    server_send_event(item->event_socket_epoll_private_data.file_descriptor,
+                      SL_CPC_EVENT_ENDPOINT_LINK_RESET,
+                      ep_id,
+                      NULL,
+                      0);
+  }
+}
+
 void server_on_endpoint_state_change(uint8_t ep_id, cpc_endpoint_state_t state)
 {
   if (ep_id != SL_CPC_ENDPOINT_SYSTEM && ep_id != SL_CPC_ENDPOINT_SECURITY ) {
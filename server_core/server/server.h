@@ -33,6 +33,9 @@ void server_set_endpoint_encryption(uint8_t endpoint_id, bool encryption_enabled
 sl_status_t server_push_data_to_endpoint(uint8_t endpoint_number, const uint8_t* data, size_t data_len);
 void server_process_pending_connections(void);
 bool server_is_endpoint_open(uint8_t endpoint_number);
+uint32_t server_get_endpoint_client_count(uint8_t endpoint_number);
+void server_suspend_endpoint(uint8_t endpoint_number);
+void server_resume_endpoint(uint8_t endpoint_number);
 
 bool server_listener_list_empty(uint8_t endpoint_number);
 
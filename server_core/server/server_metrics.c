@@ -0,0 +1,434 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Server Metrics Socket
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+#include "misc/config.h"
+#include "misc/errno_codename.h"
+#include "misc/logging.h"
+#include "misc/sl_slist.h"
+#include "misc/utils.h"
+#include "server_core/core/core.h"
+#include "server_core/epoll/epoll.h"
+#include "server_core/server/server.h"
+#include "server_core/server/server_metrics.h"
+
+/* A client that does not read its metrics within this time is dropped */
+#define METRICS_SEND_TIMEOUT_MS 100
+
+/* A connection whose metrics did not fit in the socket buffer at once. The
+ * remaining text is sent when the socket becomes writable, the private data
+ * must stay the first member, the epoll callback casts it back */
+typedef struct {
+  epoll_private_data_t private_data;
+  sl_slist_node_t node;
+  char *text;
+  size_t text_length;
+  size_t sent;
+  struct timespec deadline;
+  bool expired;
+} metrics_connection_t;
+
+typedef struct {
+  const char *name;
+  const char *help;
+  size_t offset;
+} metrics_family_t;
+
+#define ENDPOINT_COUNTER(name, field, help) { "cpcd_endpoint_" name "_total", help, offsetof(core_endpoint_counters_t, field) }
+
+static const metrics_family_t endpoint_counters[] = {
+  ENDPOINT_COUNTER("tx_bytes", tx_bytes, "Payload bytes written by the clients to the endpoint"),
+  ENDPOINT_COUNTER("tx_frames", tx_frames, "Frames written by the clients to the endpoint"),
+  ENDPOINT_COUNTER("rx_bytes", rx_bytes, "Payload bytes received from the secondary on the endpoint"),
+  ENDPOINT_COUNTER("rx_frames", rx_frames, "Frames received from the secondary on the endpoint"),
+  ENDPOINT_COUNTER("re_transmits", re_transmits, "Frames re-transmitted to the secondary"),
+  ENDPOINT_COUNTER("rejects_sent", rejects_sent, "Reject frames sent to the secondary"),
+  ENDPOINT_COUNTER("rejects_received", rejects_received, "Reject frames received from the secondary"),
+};
+
+#define CORE_COUNTER(field, help) { "cpcd_core_" #field "_total", help, offsetof(core_debug_counters_t, field) }
+
+static const metrics_family_t core_counters[] = {
+  CORE_COUNTER(endpoint_opened, "Endpoints opened"),
+  CORE_COUNTER(endpoint_closed, "Endpoints closed"),
+  CORE_COUNTER(rxd_frame, "Frames received from the driver"),
+  CORE_COUNTER(rxd_valid_iframe, "Information frames received with a valid header"),
+  CORE_COUNTER(rxd_valid_uframe, "Unnumbered frames received with a valid header"),
+  CORE_COUNTER(rxd_valid_sframe, "Supervisory frames received with a valid header"),
+  CORE_COUNTER(rxd_data_frame_dropped, "Data frames dropped"),
+  CORE_COUNTER(txd_reject_destination_unreachable, "Destination unreachable rejects sent"),
+  CORE_COUNTER(txd_reject_error_fault, "Fault rejects sent"),
+  CORE_COUNTER(txd_completed, "Frames pushed to the driver"),
+  CORE_COUNTER(retxd_data_frame, "Data frames re-transmitted"),
+  CORE_COUNTER(driver_error, "Driver errors"),
+  CORE_COUNTER(driver_packet_dropped, "Frames dropped by the driver"),
+  CORE_COUNTER(invalid_header_checksum, "Frames received with an invalid header checksum"),
+  CORE_COUNTER(invalid_payload_checksum, "Frames received with an invalid payload checksum"),
+  CORE_COUNTER(driver_resync, "Driver re-synchronizations on the frame delimiter"),
+  CORE_COUNTER(driver_resync_bytes_discarded, "Bytes discarded by the driver re-synchronizations"),
+};
+
+typedef enum {
+  GAUGE_CLIENTS,
+  GAUGE_HOLDING_LIST_DEPTH,
+  GAUGE_RE_TRANSMIT_QUEUE_DEPTH,
+  GAUGE_PENDING_ON_SECURITY_DEPTH,
+  GAUGE_TX_WINDOW_SPACE,
+  GAUGE_SMOOTHED_RTT,
+  GAUGE_RTT_VARIATION,
+  GAUGE_RE_TRANSMIT_TIMEOUT,
+  GAUGE_COUNT
+} metrics_gauge_t;
+
+static const struct {
+  const char *name;
+  const char *help;
+} endpoint_gauges[GAUGE_COUNT] = {
+  [GAUGE_CLIENTS]                   = { "cpcd_endpoint_clients", "Clients connected to the endpoint" },
+  [GAUGE_HOLDING_LIST_DEPTH]        = { "cpcd_endpoint_holding_list_depth", "Frames waiting for space in the transmit window" },
+  [GAUGE_RE_TRANSMIT_QUEUE_DEPTH]   = { "cpcd_endpoint_re_transmit_queue_depth", "Frames sent and waiting for their acknowledge" },
+  [GAUGE_PENDING_ON_SECURITY_DEPTH] = { "cpcd_endpoint_pending_on_security_depth", "Frames waiting for the security session" },
+  [GAUGE_TX_WINDOW_SPACE]           = { "cpcd_endpoint_tx_window_space", "Free space in the transmit window" },
+  [GAUGE_SMOOTHED_RTT]              = { "cpcd_endpoint_smoothed_rtt_seconds", "Smoothed round trip time" },
+  [GAUGE_RTT_VARIATION]             = { "cpcd_endpoint_rtt_variation_seconds", "Round trip time variation" },
+  [GAUGE_RE_TRANSMIT_TIMEOUT]       = { "cpcd_endpoint_re_transmit_timeout_seconds", "Re-transmit timeout" },
+};
+
+typedef struct {
+  const char *name;
+  const char *help;
+  size_t offset;
+} metrics_histogram_t;
+
+static const metrics_histogram_t endpoint_histograms[] = {
+  { "cpcd_endpoint_write_to_wire_seconds",
+    "Time from a client write to the end of its first transmission",
+    offsetof(core_endpoint_counters_t, write_to_wire) },
+  { "cpcd_endpoint_wire_to_read_seconds",
+    "Time from a frame received by the core to its payload sent to the clients",
+    offsetof(core_endpoint_counters_t, wire_to_read) },
+};
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+static epoll_private_data_t metrics_socket_private_data = { .file_descriptor = -1 };
+static epoll_private_data_t metrics_timer_private_data = { .file_descriptor = -1 };
+
+static sl_slist_node_t *metrics_connections;
+
+/* Endpoint snapshots of the current connection, the metrics are grouped by family */
+static core_endpoint_metrics_t endpoint_metrics[SL_CPC_ENDPOINT_MAX_COUNT];
+static uint32_t endpoint_clients[SL_CPC_ENDPOINT_MAX_COUNT];
+static bool endpoint_present[SL_CPC_ENDPOINT_MAX_COUNT];
+
+static void server_metrics_process_connection(epoll_private_data_t *private_data);
+static void server_metrics_process_writable(epoll_private_data_t *private_data);
+static void server_metrics_process_timeout(epoll_private_data_t *private_data);
+
+static void print_header(FILE *out, const char *name, const char *type, const char *help)
+{
+  fprintf(out, "# HELP %s %s\n", name, help);
+  fprintf(out, "# TYPE %s %s\n", name, type);
+}
+
+static double gauge_value(metrics_gauge_t gauge, size_t ep_id)
+{
+  const core_endpoint_metrics_t *metrics = &endpoint_metrics[ep_id];
+
+  switch (gauge) {
+    case GAUGE_CLIENTS:
+      return (double)endpoint_clients[ep_id];
+    case GAUGE_HOLDING_LIST_DEPTH:
+      return (double)metrics->holding_list_depth;
+    case GAUGE_RE_TRANSMIT_QUEUE_DEPTH:
+      return (double)metrics->re_transmit_queue_depth;
+    case GAUGE_PENDING_ON_SECURITY_DEPTH:
+      return (double)metrics->pending_on_security_depth;
+    case GAUGE_TX_WINDOW_SPACE:
+      return (double)metrics->tx_window_space;
+    case GAUGE_SMOOTHED_RTT:
+      return (double)metrics->smoothed_rtt_ms / 1e3;
+    case GAUGE_RTT_VARIATION:
+      return (double)metrics->rtt_variation_ms / 1e3;
+    case GAUGE_RE_TRANSMIT_TIMEOUT:
+      return (double)metrics->re_transmit_timeout_ms / 1e3;
+    default:
+      BUG("Unknown gauge %d", gauge);
+  }
+}
+
+static void print_histogram(FILE *out, const metrics_histogram_t *family, size_t ep_id)
+{
+  const core_latency_histogram_t *histogram =
+    (const core_latency_histogram_t *)((const uint8_t *)&endpoint_metrics[ep_id].counters + family->offset);
+  uint64_t cumulative = 0;
+
+  for (size_t i = 0; i != CORE_LATENCY_BUCKETS; i++) {
+    cumulative += histogram->buckets[i];
+    fprintf(out, "%s_bucket{endpoint=\"%zu\",le=\"%.6f\"} %llu\n",
+            family->name, ep_id, (double)(1u << i) / 1e6, (unsigned long long)cumulative);
+  }
+  fprintf(out, "%s_bucket{endpoint=\"%zu\",le=\"+Inf\"} %llu\n", family->name, ep_id, (unsigned long long)histogram->count);
+  fprintf(out, "%s_sum{endpoint=\"%zu\"} %.9f\n", family->name, ep_id, (double)histogram->sum_ns / 1e9);
+  fprintf(out, "%s_count{endpoint=\"%zu\"} %llu\n", family->name, ep_id, (unsigned long long)histogram->count);
+}
+
+static void print_metrics(FILE *out)
+{
+  for (size_t ep_id = 0; ep_id != SL_CPC_ENDPOINT_MAX_COUNT; ep_id++) {
+    endpoint_present[ep_id] = core_get_endpoint_metrics((uint8_t)ep_id, &endpoint_metrics[ep_id]);
+    endpoint_clients[ep_id] = ep_id == SL_CPC_ENDPOINT_SYSTEM ? 0 : server_get_endpoint_client_count((uint8_t)ep_id);
+  }
+
+  for (size_t i = 0; i != ARRAY_LENGTH(core_counters); i++) {
+    uint32_t value = *(const uint32_t *)((const uint8_t *)&primary_core_debug_counters + core_counters[i].offset);
+
+    print_header(out, core_counters[i].name, "counter", core_counters[i].help);
+    fprintf(out, "%s %u\n", core_counters[i].name, value);
+  }
+
+  print_header(out, "cpcd_endpoint_info", "gauge", "Endpoint state and encryption, always 1");
+  for (size_t ep_id = 0; ep_id != SL_CPC_ENDPOINT_MAX_COUNT; ep_id++) {
+    if (endpoint_present[ep_id]) {
+      fprintf(out, "cpcd_endpoint_info{endpoint=\"%zu\",state=\"%s\",encrypted=\"%s\"} 1\n",
+              ep_id, core_stringify_state(endpoint_metrics[ep_id].state),
+              endpoint_metrics[ep_id].encrypted ? "true" : "false");
+    }
+  }
+
+  for (size_t i = 0; i != ARRAY_LENGTH(endpoint_counters); i++) {
+    print_header(out, endpoint_counters[i].name, "counter", endpoint_counters[i].help);
+    for (size_t ep_id = 0; ep_id != SL_CPC_ENDPOINT_MAX_COUNT; ep_id++) {
+      if (endpoint_present[ep_id]) {
+        uint64_t value = *(const uint64_t *)((const uint8_t *)&endpoint_metrics[ep_id].counters + endpoint_counters[i].offset);
+
+        fprintf(out, "%s{endpoint=\"%zu\"} %llu\n", endpoint_counters[i].name, ep_id, (unsigned long long)value);
+      }
+    }
+  }
+
+  for (size_t i = 0; i != GAUGE_COUNT; i++) {
+    print_header(out, endpoint_gauges[i].name, "gauge", endpoint_gauges[i].help);
+    for (size_t ep_id = 0; ep_id != SL_CPC_ENDPOINT_MAX_COUNT; ep_id++) {
+      if (endpoint_present[ep_id]) {
+        fprintf(out, "%s{endpoint=\"%zu\"} %g\n", endpoint_gauges[i].name, ep_id, gauge_value((metrics_gauge_t)i, ep_id));
+      }
+    }
+  }
+
+  for (size_t i = 0; i != ARRAY_LENGTH(endpoint_histograms); i++) {
+    print_header(out, endpoint_histograms[i].name, "histogram", endpoint_histograms[i].help);
+    for (size_t ep_id = 0; ep_id != SL_CPC_ENDPOINT_MAX_COUNT; ep_id++) {
+      if (endpoint_present[ep_id]) {
+        print_histogram(out, &endpoint_histograms[i], ep_id);
+      }
+    }
+  }
+}
+
+static bool timespec_before(const struct timespec *a, const struct timespec *b)
+{
+  return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/* Arm the timer on the earliest deadline of the pending connections, or disarm it */
+static void arm_deadline_timer(void)
+{
+  struct itimerspec timeout = { 0 };
+  metrics_connection_t *connection;
+  int ret;
+
+  SL_SLIST_FOR_EACH_ENTRY(metrics_connections, connection, metrics_connection_t, node) {
+    if (!connection->expired
+        && ((timeout.it_value.tv_sec == 0 && timeout.it_value.tv_nsec == 0)
+            || timespec_before(&connection->deadline, &timeout.it_value))) {
+      timeout.it_value = connection->deadline;
+    }
+  }
+
+  ret = timerfd_settime(metrics_timer_private_data.file_descriptor, TFD_TIMER_ABSTIME, &timeout, NULL);
+  FATAL_SYSCALL_ON(ret < 0);
+}
+
+/* Send as much of the remaining text as the socket takes without blocking.
+ * Returns true once the connection is done with, either sent or failed */
+static bool send_pending_text(metrics_connection_t *connection)
+{
+  while (connection->sent < connection->text_length) {
+    ssize_t ret = send(connection->private_data.file_descriptor,
+                       connection->text + connection->sent,
+                       connection->text_length - connection->sent,
+                       MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (ret < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return false;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      TRACE_SERVER("Metrics client dropped: %s", ERRNO_CODENAME[errno]);
+      return true;
+    }
+    connection->sent += (size_t)ret;
+  }
+
+  return true;
+}
+
+void server_metrics_init(void)
+{
+  struct sockaddr_un name = { 0 };
+  int nchars;
+  int fd;
+  int ret;
+
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  FATAL_SYSCALL_ON(fd < 0);
+
+  name.sun_family = AF_UNIX;
+  nchars = snprintf(name.sun_path, sizeof(name.sun_path), "%s/cpcd/%s/metrics.cpcd.sock", config.socket_folder, config.instance_name);
+  FATAL_ON(nchars < 0 || (size_t)nchars >= sizeof(name.sun_path));
+
+  ret = bind(fd, (const struct sockaddr *)&name, sizeof(name));
+  FATAL_SYSCALL_ON(ret < 0);
+
+  ret = listen(fd, 5);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  metrics_socket_private_data.callback = server_metrics_process_connection;
+  metrics_socket_private_data.file_descriptor = fd;
+  metrics_socket_private_data.endpoint_number = 0; /* Irrelevant here */
+
+  epoll_register(&metrics_socket_private_data);
+
+  fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  FATAL_SYSCALL_ON(fd < 0);
+
+  metrics_timer_private_data.callback = server_metrics_process_timeout;
+  metrics_timer_private_data.file_descriptor = fd;
+  metrics_timer_private_data.endpoint_number = 0; /* Irrelevant here */
+
+  epoll_register(&metrics_timer_private_data);
+
+  sl_slist_init(&metrics_connections);
+
+  TRACE_SERVER("Serving metrics on %s", name.sun_path);
+}
+
+static void server_metrics_process_connection(epoll_private_data_t *private_data)
+{
+  metrics_connection_t *connection;
+  FILE *out;
+  int fd;
+  int ret;
+
+  // The connection is served from the server core thread, it must never block on a slow client
+  fd = accept4(private_data->file_descriptor, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+  if (fd < 0) {
+    WARN("Failed to accept a metrics connection: %s", ERRNO_CODENAME[errno]);
+    return;
+  }
+
+  connection = zalloc(sizeof(metrics_connection_t));
+  FATAL_ON(connection == NULL);
+
+  out = open_memstream(&connection->text, &connection->text_length);
+  FATAL_SYSCALL_ON(out == NULL);
+  print_metrics(out);
+  FATAL_ON(fclose(out) != 0);
+
+  connection->private_data.callback = server_metrics_process_writable;
+  connection->private_data.file_descriptor = fd;
+  connection->private_data.endpoint_number = 0; /* Irrelevant here */
+
+  if (send_pending_text(connection)) {
+    free(connection->text);
+    free(connection);
+    close(fd);
+    return;
+  }
+
+  // The rest goes out as the client reads, until an absolute deadline
+  ret = clock_gettime(CLOCK_MONOTONIC, &connection->deadline);
+  FATAL_SYSCALL_ON(ret < 0);
+  connection->deadline.tv_nsec += METRICS_SEND_TIMEOUT_MS * 1000000L;
+  if (connection->deadline.tv_nsec >= 1000000000L) {
+    connection->deadline.tv_sec += 1;
+    connection->deadline.tv_nsec -= 1000000000L;
+  }
+
+  sl_slist_push_back(&metrics_connections, &connection->node);
+  epoll_register_output(&connection->private_data);
+  arm_deadline_timer();
+}
+
+static void server_metrics_process_writable(epoll_private_data_t *private_data)
+{
+  metrics_connection_t *connection = (metrics_connection_t *)private_data;
+
+  if (!send_pending_text(connection)) {
+    return;
+  }
+
+  // Only this callback frees a connection, no other event of the current batch can refer to it
+  sl_slist_remove(&metrics_connections, &connection->node);
+  epoll_unregister(&connection->private_data);
+  close(connection->private_data.file_descriptor);
+  free(connection->text);
+  free(connection);
+  arm_deadline_timer();
+}
+
+static void server_metrics_process_timeout(epoll_private_data_t *private_data)
+{
+  metrics_connection_t *connection;
+  struct timespec now;
+  uint64_t expiration;
+  int ret;
+
+  // The timer may have been re-armed since it fired, there is nothing to read then
+  ret = (int)read(private_data->file_descriptor, &expiration, sizeof(expiration));
+  FATAL_SYSCALL_ON(ret < 0 && errno != EAGAIN);
+
+  ret = clock_gettime(CLOCK_MONOTONIC, &now);
+  FATAL_SYSCALL_ON(ret < 0);
+
+  // Shutting the expired connections down makes their sockets report a hang up,
+  // their own callback then fails to send and frees them
+  SL_SLIST_FOR_EACH_ENTRY(metrics_connections, connection, metrics_connection_t, node) {
+    if (!connection->expired && !timespec_before(&now, &connection->deadline)) {
+      TRACE_SERVER("Metrics client too slow, dropping it");
+      shutdown(connection->private_data.file_descriptor, SHUT_RDWR);
+      connection->expired = true;
+    }
+  }
+
+  arm_deadline_timer();
+}
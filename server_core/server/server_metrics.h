@@ -0,0 +1,30 @@
+/***************************************************************************//**
+ * @file
+ * @brief Co-Processor Communication Protocol(CPC) - Server Metrics Socket
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2022 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+/*
+ * Create the socket {socket_folder}/cpcd/{instance_name}/metrics.cpcd.sock.
+ * Every connection to it receives the core counters and the per-endpoint
+ * metrics in the Prometheus text format, then the socket is closed. The
+ * connections are served by the server core thread, the socket folder must
+ * exist.
+ */
+void server_metrics_init(void);
+
+#endif
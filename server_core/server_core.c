@@ -19,8 +19,10 @@
 #include <pthread.h>
 
 #include <stdio.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <sys/un.h>
 #include <dirent.h>
 #include <unistd.h>
@@ -36,11 +38,15 @@
 #include "server_core.h"
 #include "server_core/epoll/epoll.h"
 #include "server_core/server/server.h"
+#include "server_core/server/server_metrics.h"
 #include "server_core/core/core.h"
 #include "server_core/system_endpoint/system.h"
 #include "security/security.h"
 #include "version.h"
 #include "driver/driver_kill.h"
+#if !defined(UNIT_TESTING)
+#include "driver/driver_spi.h"
+#endif
 
 #define MAX_EPOLL_EVENTS 1
 
@@ -52,6 +58,7 @@ static bool set_reset_mode_ack = false;
 
 static bool reset_ack = false;
 static bool secondary_cpc_version_received = false;
+static bool secondary_cpc_version_available = false;
 static bool secondary_app_version_received_or_not_available = false;
 static bool bootloader_info_received_or_not_available = false;
 static bool secondary_bus_speed_received = false;
@@ -60,11 +67,25 @@ static bool reset_reason_received = false;
 static bool capabilities_received = false;
 static bool rx_capability_received = false;
 static bool protocol_version_received = false;
+static bool security_started = false;
 
 static server_core_mode_t server_core_mode = SERVER_CORE_MODE_NORMAL;
 
 static sl_cpc_system_reboot_mode_t pending_mode;
 
+/* Reset recovery: poll the endpoint states on the secondary every 100ms, for up to 5 seconds */
+#define RESET_RECOVERY_POLL_INTERVAL_NS (100 * 1000000)
+#define RESET_RECOVERY_MAX_POLLS        50
+
+static enum {
+  RECOVERY_IDLE,
+  RECOVERY_WAIT_STATE,
+  RECOVERY_RETRY
+} endpoint_recovery_state[SL_CPC_ENDPOINT_MAX_COUNT];
+
+static uint32_t reset_recovery_polls = 0;
+static epoll_private_data_t reset_recovery_timer_private_data = { .file_descriptor = -1 };
+
 static int kill_eventfd = -1;
 static int security_ready_eventfd = -1;
 
@@ -73,16 +94,53 @@ static enum {
   WAIT_NORMAL_REBOOT_MODE_ACK,
   WAIT_NORMAL_RESET_ACK,
   WAIT_RESET_REASON,
-  WAIT_FOR_CAPABILITIES,
-  WAIT_FOR_RX_CAPABILITY,
-  WAIT_FOR_BOOTLOADER_INFO,
-  WAIT_FOR_SECONDARY_CPC_VERSION,
-  WAIT_FOR_SECONDARY_APP_VERSION,
-  WAIT_FOR_PROTOCOL_VERSION,
-  WAIT_FOR_SECONDARY_BUS_SPEED,
+  WAIT_FOR_PROPERTIES,
   RESET_SEQUENCE_DONE
 } reset_sequence_state = SET_NORMAL_REBOOT_MODE;
 
+/***************************************************************************//**
+ * Startup phases, timestamped to log how long the daemon takes before it
+ * accepts endpoint opens
+ ******************************************************************************/
+typedef enum {
+  STARTUP_PHASE_INIT,
+  STARTUP_PHASE_CONNECTING,
+  STARTUP_PHASE_REBOOT_MODE_ACK,
+  STARTUP_PHASE_RESET_ACK,
+  STARTUP_PHASE_RESET_REASON,
+  STARTUP_PHASE_RX_CAPABILITY,
+  STARTUP_PHASE_PROTOCOL_VERSION,
+  STARTUP_PHASE_CAPABILITIES,
+  STARTUP_PHASE_SECURITY_STARTED,
+  STARTUP_PHASE_BOOTLOADER_INFO,
+  STARTUP_PHASE_SECONDARY_CPC_VERSION,
+  STARTUP_PHASE_SECONDARY_BUS_SPEED,
+  STARTUP_PHASE_SECONDARY_APP_VERSION,
+  STARTUP_PHASE_SERVER_READY,
+  STARTUP_PHASE_COUNT
+} startup_phase_t;
+
+static struct {
+  const char *name;
+  bool reached;
+  struct timespec timestamp;
+} startup_timeline[STARTUP_PHASE_COUNT] = {
+  [STARTUP_PHASE_INIT]                  = { .name = "server core init" },
+  [STARTUP_PHASE_CONNECTING]            = { .name = "connecting" },
+  [STARTUP_PHASE_REBOOT_MODE_ACK]       = { .name = "reboot mode ack" },
+  [STARTUP_PHASE_RESET_ACK]             = { .name = "reset ack" },
+  [STARTUP_PHASE_RESET_REASON]          = { .name = "reset reason" },
+  [STARTUP_PHASE_RX_CAPABILITY]         = { .name = "rx capability" },
+  [STARTUP_PHASE_PROTOCOL_VERSION]      = { .name = "protocol version" },
+  [STARTUP_PHASE_CAPABILITIES]          = { .name = "capabilities" },
+  [STARTUP_PHASE_SECURITY_STARTED]      = { .name = "security started" },
+  [STARTUP_PHASE_BOOTLOADER_INFO]       = { .name = "bootloader info" },
+  [STARTUP_PHASE_SECONDARY_CPC_VERSION] = { .name = "secondary cpc version" },
+  [STARTUP_PHASE_SECONDARY_BUS_SPEED]   = { .name = "secondary bus speed" },
+  [STARTUP_PHASE_SECONDARY_APP_VERSION] = { .name = "secondary app version" },
+  [STARTUP_PHASE_SERVER_READY]          = { .name = "accepting opens" },
+};
+
 static enum {
   SET_BOOTLOADER_REBOOT_MODE,
   WAIT_BOOTLOADER_REBOOT_MODE_ACK,
@@ -127,10 +185,45 @@ static void property_set_reset_mode_callback(sl_cpc_system_command_handle_t *han
 
 static void process_reboot_enter_bootloader(void);
 
+static bool reset_recovery_enabled(void);
+
+static void reset_recovery_start(void);
+
 void reset_callback(sl_cpc_system_command_handle_t *handle,
                     sl_status_t status,
                     sl_cpc_system_status_t reset_status);
 
+static void startup_timeline_mark(startup_phase_t phase)
+{
+  BUG_ON(phase >= STARTUP_PHASE_COUNT);
+
+  clock_gettime(CLOCK_MONOTONIC, &startup_timeline[phase].timestamp);
+  startup_timeline[phase].reached = true;
+}
+
+#if !defined(UNIT_TESTING)
+static long startup_timeline_elapsed_ms(startup_phase_t phase)
+{
+  const struct timespec *origin = &startup_timeline[STARTUP_PHASE_INIT].timestamp;
+  const struct timespec *ts = &startup_timeline[phase].timestamp;
+
+  return (ts->tv_sec - origin->tv_sec) * 1000 + (ts->tv_nsec - origin->tv_nsec) / 1000000;
+}
+
+static void startup_timeline_print(void)
+{
+  PRINT_INFO("Startup timeline:");
+
+  for (size_t i = 0; i < STARTUP_PHASE_COUNT; i++) {
+    if (startup_timeline[i].reached) {
+      PRINT_INFO("  +%6ld ms : %s", startup_timeline_elapsed_ms((startup_phase_t)i), startup_timeline[i].name);
+    }
+  }
+
+  PRINT_INFO("Time to first open: %ld ms", startup_timeline_elapsed_ms(STARTUP_PHASE_SERVER_READY));
+}
+#endif
+
 static void cleanup_socket_folder(const char *folder)
 {
   struct dirent *next_file;
@@ -189,6 +282,8 @@ pthread_t server_core_init(int fd_socket_driver_core, int fd_socket_driver_core_
   pthread_t server_core_thread = { 0 };
   int ret = 0;
 
+  startup_timeline_mark(STARTUP_PHASE_INIT);
+
   core_init(fd_socket_driver_core, fd_socket_driver_core_notify);
 
   sl_cpc_system_init();
@@ -220,6 +315,10 @@ pthread_t server_core_init(int fd_socket_driver_core, int fd_socket_driver_core_
 
   free(socket_folder);
 
+  if (config.metrics_socket) {
+    server_metrics_init();
+  }
+
   /* The server is not initialized immediately because we want to perform a successful reset sequence
    * of the secondary before. That is, unless we explicitly disable the reset sequence in the config file */
   if (config.reset_sequence == false) {
@@ -355,6 +454,7 @@ static void property_set_reset_mode_callback(sl_cpc_system_command_handle_t *han
       }
 
       set_reset_mode_ack = true;
+      startup_timeline_mark(STARTUP_PHASE_REBOOT_MODE_ACK);
       break;
 
     case SL_STATUS_TIMEOUT:
@@ -383,6 +483,7 @@ void reset_callback(sl_cpc_system_command_handle_t *handle,
 
       if (reset_status == SL_STATUS_OK) {
         reset_ack = true;
+        startup_timeline_mark(STARTUP_PHASE_RESET_ACK);
       }
       break;
 
@@ -416,6 +517,10 @@ static void on_unsolicited_status(sl_cpc_system_status_t status)
 
     if (reset_sequence_state == WAIT_RESET_REASON) {
       reset_reason_received = true;
+      startup_timeline_mark(STARTUP_PHASE_RESET_REASON);
+    } else if (reset_recovery_enabled()) {
+      PRINT_INFO("Secondary has reset, recovering the open endpoints.");
+      reset_recovery_start();
     } else {
       int ret;
 
@@ -443,6 +548,193 @@ static void on_unsolicited_status(sl_cpc_system_status_t status)
   }
 }
 
+/***************************************************************************//**
+ * Reset recovery re-establishes the open endpoints with the secondary instead of
+ * restarting the daemon. An encrypted link needs a new security session, which
+ * only the restart path provides.
+ ******************************************************************************/
+static bool reset_recovery_enabled(void)
+{
+  if (!config.reset_recovery || config.operation_mode != MODE_NORMAL) {
+    return false;
+  }
+
+#if defined(ENABLE_ENCRYPTION)
+  if (config.use_encryption) {
+    return false;
+  }
+#endif
+
+  return true;
+}
+
+static void reset_recovery_stop_timer(void)
+{
+  if (reset_recovery_timer_private_data.file_descriptor != -1) {
+    epoll_unregister(&reset_recovery_timer_private_data);
+    close(reset_recovery_timer_private_data.file_descriptor);
+    reset_recovery_timer_private_data.file_descriptor = -1;
+  }
+}
+
+static void reset_recovery_give_up(uint8_t endpoint_id)
+{
+  WARN("Endpoint #%d was not re-opened by the secondary after its reset", endpoint_id);
+
+  endpoint_recovery_state[endpoint_id] = RECOVERY_IDLE;
+  core_set_endpoint_in_error(endpoint_id, SL_CPC_STATE_ERROR_DESTINATION_UNREACHABLE);
+}
+
+static void reset_recovery_property_get_endpoint_state_callback(sl_cpc_system_command_handle_t *handle,
+                                                                sl_cpc_property_id_t property_id,
+                                                                void* property_value,
+                                                                size_t property_length,
+                                                                sl_status_t status)
+{
+  uint8_t endpoint_id = PROPERTY_ID_TO_EP_ID(property_id);
+  cpc_endpoint_state_t remote_endpoint_state;
+
+  (void)handle;
+
+  if (endpoint_recovery_state[endpoint_id] != RECOVERY_WAIT_STATE) {
+    /* The endpoint was closed or a new recovery was started in the meantime */
+    return;
+  }
+
+  switch (status) {
+    case SL_STATUS_OK:
+    case SL_STATUS_IN_PROGRESS:
+      BUG_ON(property_length != sizeof(uint8_t));
+      remote_endpoint_state = core_state_mapper(*(uint8_t*)property_value);
+      break;
+    case SL_STATUS_TIMEOUT:
+      WARN("Property-get::PROP_ENDPOINT_STATE timed out during reset recovery");
+      endpoint_recovery_state[endpoint_id] = RECOVERY_RETRY;
+      return;
+    case SL_STATUS_ABORT:
+      /* The sequence reset was not acknowledged in time, ask again on the next poll */
+      endpoint_recovery_state[endpoint_id] = RECOVERY_RETRY;
+      return;
+    default:
+      FATAL();
+  }
+
+  if (remote_endpoint_state != SL_CPC_STATE_OPEN) {
+    TRACE_RESET("Endpoint #%d is %s on the secondary, waiting for it to re-open", endpoint_id, core_stringify_state(remote_endpoint_state));
+    endpoint_recovery_state[endpoint_id] = RECOVERY_RETRY;
+    return;
+  }
+
+  TRACE_RESET("Endpoint #%d recovered", endpoint_id);
+
+  endpoint_recovery_state[endpoint_id] = RECOVERY_IDLE;
+  server_resume_endpoint(endpoint_id);
+}
+
+static void reset_recovery_on_timer(epoll_private_data_t *private_data)
+{
+  uint64_t expiration;
+  ssize_t retval;
+  bool recovering = false;
+
+  retval = read(private_data->file_descriptor, &expiration, sizeof(expiration));
+  FATAL_SYSCALL_ON(retval < 0);
+  FATAL_ON(retval != sizeof(expiration));
+
+  reset_recovery_polls++;
+
+  for (uint16_t i = 1; i < SL_CPC_ENDPOINT_MAX_COUNT - 1; i++) {
+    uint8_t ep_id = (uint8_t)i;
+
+    if (endpoint_recovery_state[ep_id] == RECOVERY_IDLE) {
+      continue;
+    }
+
+    if (reset_recovery_polls >= RESET_RECOVERY_MAX_POLLS) {
+      reset_recovery_give_up(ep_id);
+      continue;
+    }
+
+    if (endpoint_recovery_state[ep_id] == RECOVERY_RETRY) {
+      endpoint_recovery_state[ep_id] = RECOVERY_WAIT_STATE;
+      sl_cpc_system_cmd_property_get(reset_recovery_property_get_endpoint_state_callback,
+                                     EP_ID_TO_PROPERTY_STATE(ep_id),
+                                     5,
+                                     100000,
+                                     false);
+    }
+
+    recovering = true;
+  }
+
+  if (!recovering) {
+    reset_recovery_stop_timer();
+  }
+}
+
+/***************************************************************************//**
+ * Re-establish the open endpoints after an unexpected reset of the secondary
+ *
+ * The client sockets stay connected. The sequence numbers are reset on both
+ * sides, then each endpoint is resumed as soon as the secondary reports it open
+ * again. Clients are then notified with a single SL_CPC_EVENT_ENDPOINT_LINK_RESET.
+ ******************************************************************************/
+static void reset_recovery_start(void)
+{
+  int ret;
+
+  for (uint16_t i = 1; i < SL_CPC_ENDPOINT_MAX_COUNT - 1; i++) {
+    uint8_t ep_id = (uint8_t)i;
+
+    endpoint_recovery_state[ep_id] = RECOVERY_IDLE;
+
+    if (ep_id == SL_CPC_ENDPOINT_SECURITY) {
+      continue;
+    }
+
+    if (server_is_endpoint_open(ep_id) && core_get_endpoint_state(ep_id) == SL_CPC_STATE_OPEN) {
+      server_suspend_endpoint(ep_id);
+      core_recover_endpoint(ep_id);
+      endpoint_recovery_state[ep_id] = RECOVERY_RETRY;
+    }
+  }
+
+  /* Aborts the outstanding system commands and resets the sequence numbers on the secondary */
+  sl_cpc_system_request_sequence_reset();
+
+  /* Queued until the secondary acknowledges the sequence reset */
+  for (uint16_t i = 1; i < SL_CPC_ENDPOINT_MAX_COUNT - 1; i++) {
+    uint8_t ep_id = (uint8_t)i;
+
+    if (endpoint_recovery_state[ep_id] != RECOVERY_IDLE) {
+      endpoint_recovery_state[ep_id] = RECOVERY_WAIT_STATE;
+      sl_cpc_system_cmd_property_get(reset_recovery_property_get_endpoint_state_callback,
+                                     EP_ID_TO_PROPERTY_STATE(ep_id),
+                                     5,
+                                     100000,
+                                     false);
+    }
+  }
+
+  reset_recovery_polls = 0;
+
+  if (reset_recovery_timer_private_data.file_descriptor == -1) {
+    const struct itimerspec interval = { .it_interval = { .tv_sec = 0, .tv_nsec = RESET_RECOVERY_POLL_INTERVAL_NS },
+                                         .it_value    = { .tv_sec = 0, .tv_nsec = RESET_RECOVERY_POLL_INTERVAL_NS } };
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    FATAL_SYSCALL_ON(timer_fd < 0);
+
+    ret = timerfd_settime(timer_fd, 0, &interval, NULL);
+    FATAL_SYSCALL_ON(ret < 0);
+
+    reset_recovery_timer_private_data.callback = reset_recovery_on_timer;
+    reset_recovery_timer_private_data.file_descriptor = timer_fd;
+    reset_recovery_timer_private_data.endpoint_number = 0; /* Irrelevant here */
+
+    epoll_register(&reset_recovery_timer_private_data);
+  }
+}
+
 char* server_core_get_secondary_app_version(void)
 {
 #if defined(UNIT_TESTING)
@@ -484,7 +776,22 @@ static void property_get_capabilities_callback(sl_cpc_system_command_handle_t *h
     TRACE_RESET("Received capability : UART flow control");
   }
 
+  if (capabilities & CPC_CAPABILITIES_SPI_FAST_TIMING_MASK) {
+    TRACE_RESET("Received capability : SPI fast timing");
+    if (config.bus == SPI) {
+      driver_spi_enable_fast_timing();
+    }
+  }
+
+  if (capabilities & CPC_CAPABILITIES_SPI_FULL_DUPLEX_MASK) {
+    TRACE_RESET("Received capability : SPI full duplex");
+    if (config.bus == SPI) {
+      driver_spi_enable_full_duplex();
+    }
+  }
+
   capabilities_received = true;
+  startup_timeline_mark(STARTUP_PHASE_CAPABILITIES);
 }
 
 static void property_get_rx_capability_callback(sl_cpc_system_command_handle_t *handle,
@@ -502,6 +809,7 @@ static void property_get_rx_capability_callback(sl_cpc_system_command_handle_t *
   TRACE_RESET("Received RX capability of %u bytes", *((uint16_t *)property_value));
   rx_capability = *((uint16_t *)property_value);
   rx_capability_received = true;
+  startup_timeline_mark(STARTUP_PHASE_RX_CAPABILITY);
 }
 
 static void property_get_secondary_bootloader_info(sl_cpc_system_command_handle_t *handle,
@@ -534,6 +842,7 @@ static void property_get_secondary_bootloader_info(sl_cpc_system_command_handle_
   }
 
   bootloader_info_received_or_not_available = true;
+  startup_timeline_mark(STARTUP_PHASE_BOOTLOADER_INFO);
 }
 
 static void property_get_secondary_cpc_version_callback(sl_cpc_system_command_handle_t *handle,
@@ -545,16 +854,19 @@ static void property_get_secondary_cpc_version_callback(sl_cpc_system_command_ha
   (void) handle;
 
   uint32_t version[3];
-  memcpy(version, property_value, 3 * sizeof(uint32_t));
 
-  if ( (property_id != PROP_SECONDARY_CPC_VERSION)
-       || (status != SL_STATUS_OK && status != SL_STATUS_IN_PROGRESS)
-       || (property_value == NULL || property_length != 3 * sizeof(uint32_t))) {
-    FATAL("Cannot get Secondary CPC version (obsolete RCP firmware?)");
+  // The failure is reported once all the properties are received, so that
+  // a protocol version mismatch is reported first
+  if ( (property_id == PROP_SECONDARY_CPC_VERSION)
+       && (status == SL_STATUS_OK || status == SL_STATUS_IN_PROGRESS)
+       && (property_value != NULL && property_length == 3 * sizeof(uint32_t))) {
+    memcpy(version, property_value, 3 * sizeof(uint32_t));
+    PRINT_INFO("Secondary CPC v%d.%d.%d", version[0], version[1], version[2]);
+    secondary_cpc_version_available = true;
   }
 
-  PRINT_INFO("Secondary CPC v%d.%d.%d", version[0], version[1], version[2]);
   secondary_cpc_version_received = true;
+  startup_timeline_mark(STARTUP_PHASE_SECONDARY_CPC_VERSION);
 }
 
 static void property_get_secondary_app_version_callback(sl_cpc_system_command_handle_t *handle,
@@ -584,6 +896,7 @@ static void property_get_secondary_app_version_callback(sl_cpc_system_command_ha
   }
 
   secondary_app_version_received_or_not_available = true;
+  startup_timeline_mark(STARTUP_PHASE_SECONDARY_APP_VERSION);
 }
 
 static void property_get_secondary_bus_speed_callback(sl_cpc_system_command_handle_t *handle,
@@ -613,6 +926,8 @@ static void property_get_secondary_bus_speed_callback(sl_cpc_system_command_hand
     WARN("Could not obtain the secondary's bus speed");
     failed_to_receive_secondary_bus_speed = true;
   }
+
+  startup_timeline_mark(STARTUP_PHASE_SECONDARY_BUS_SPEED);
 }
 
 static void property_get_protocol_version_callback(sl_cpc_system_command_handle_t *handle,
@@ -635,6 +950,7 @@ static void property_get_protocol_version_callback(sl_cpc_system_command_handle_
   PRINT_INFO("Secondary Protocol v%d", server_core_secondary_protocol_version);
 
   protocol_version_received = true;
+  startup_timeline_mark(STARTUP_PHASE_PROTOCOL_VERSION);
 }
 
 static void exit_server_core(void)
@@ -687,6 +1003,7 @@ static void process_reset_sequence(bool firmware_reset_mode)
 
     case SET_NORMAL_REBOOT_MODE:
       PRINT_INFO("Connecting to Secondary...");
+      startup_timeline_mark(STARTUP_PHASE_CONNECTING);
 
       /* Send a request to the secondary to set the reboot mode to 'application' */
       {
@@ -741,97 +1058,50 @@ static void process_reset_sequence(bool firmware_reset_mode)
       TRACE_RESET("Waiting for reset reason");
       if (reset_reason_received) {
         TRACE_RESET("Reset reason received");
-        reset_sequence_state = WAIT_FOR_RX_CAPABILITY;
+        reset_sequence_state = WAIT_FOR_PROPERTIES;
+
+        /* The properties don't depend on each other: issue them all at once
+         * instead of waiting for each reply before sending the next query */
         sl_cpc_system_cmd_property_get(property_get_rx_capability_callback,
                                        PROP_RX_CAPABILITY,
                                        5,       /* 5 retries */
                                        100000,  /* 100ms between retries*/
                                        true);
-      }
-      break;
 
-    case WAIT_FOR_RX_CAPABILITY:
-      if (rx_capability_received) {
-        TRACE_RESET("Obtained RX capability");
-        PRINT_INFO("Connected to Secondary");
-        reset_sequence_state = WAIT_FOR_PROTOCOL_VERSION;
         sl_cpc_system_cmd_property_get(property_get_protocol_version_callback,
                                        PROP_PROTOCOL_VERSION,
                                        5,      /* 5 retries */
                                        100000, /* 100ms between retries*/
                                        true);
-      }
-      break;
 
-    case WAIT_FOR_PROTOCOL_VERSION:
-      if (protocol_version_received) {
-        TRACE_RESET("Obtained Protocol version");
-        if (!firmware_reset_mode) {
-          protocol_version_check();
-        }
-        reset_sequence_state = WAIT_FOR_CAPABILITIES;
         sl_cpc_system_cmd_property_get(property_get_capabilities_callback,
                                        PROP_CAPABILITIES,
                                        5,       /* 5 retries */
                                        100000,  /* 100ms between retries*/
                                        true);
-      }
-      break;
 
-    case WAIT_FOR_CAPABILITIES:
-      if (capabilities_received) {
-        TRACE_RESET("Obtained Capabilites");
-        if (!firmware_reset_mode) {
-          capabilities_checks();
-
-          reset_sequence_state = WAIT_FOR_SECONDARY_CPC_VERSION;
-          sl_cpc_system_cmd_property_get(property_get_secondary_cpc_version_callback,
-                                         PROP_SECONDARY_CPC_VERSION,
-                                         5,       /* 5 retries */
-                                         100000,  /* 100ms between retries*/
-                                         true);
-        } else {
+        if (firmware_reset_mode) {
           // Fetch bootloader information only if in firmware reset mode
-          reset_sequence_state = WAIT_FOR_BOOTLOADER_INFO;
           sl_cpc_system_cmd_property_get(property_get_secondary_bootloader_info,
                                          PROP_BOOTLOADER_INFO,
                                          5,       /* 5 retries */
                                          100000,  /* 100ms between retries*/
                                          true);
+        } else {
+          bootloader_info_received_or_not_available = true;
         }
-      }
-      break;
-
-    case WAIT_FOR_BOOTLOADER_INFO:
-      if (bootloader_info_received_or_not_available) {
-        TRACE_RESET("Obtained secondary bootloader information");
 
-        reset_sequence_state = WAIT_FOR_SECONDARY_CPC_VERSION;
         sl_cpc_system_cmd_property_get(property_get_secondary_cpc_version_callback,
                                        PROP_SECONDARY_CPC_VERSION,
                                        5,       /* 5 retries */
                                        100000,  /* 100ms between retries*/
                                        true);
-      }
-
-      break;
 
-    case WAIT_FOR_SECONDARY_CPC_VERSION:
-      if (secondary_cpc_version_received) {
-        TRACE_RESET("Obtained Secondary CPC version");
-
-        reset_sequence_state = WAIT_FOR_SECONDARY_BUS_SPEED;
         sl_cpc_system_cmd_property_get(property_get_secondary_bus_speed_callback,
                                        PROP_BUS_SPEED_VALUE,
                                        5,       /* 5 retries */
                                        100000,  /* 100ms between retries*/
                                        true);
-      }
-      break;
-
-    case WAIT_FOR_SECONDARY_BUS_SPEED:
-      if (secondary_bus_speed_received || failed_to_receive_secondary_bus_speed) {
-        reset_sequence_state = WAIT_FOR_SECONDARY_APP_VERSION;
 
         sl_cpc_system_cmd_property_get(property_get_secondary_app_version_callback,
                                        PROP_SECONDARY_APP_VERSION,
@@ -841,31 +1111,61 @@ static void process_reset_sequence(bool firmware_reset_mode)
       }
       break;
 
-    case WAIT_FOR_SECONDARY_APP_VERSION:
-      if (secondary_app_version_received_or_not_available) {
-        if (server_core_secondary_app_version) {
-          TRACE_RESET("Obtained Secondary APP version");
+    case WAIT_FOR_PROPERTIES:
+      /* Start the security thread as soon as the capabilities confirm the
+       * secondary agrees on encryption, it loads the binding key and sets up
+       * its context while the remaining properties are fetched. Printing the
+       * secondary versions needs neither, the daemon exits once they are known */
+      if (capabilities_received && protocol_version_received && !firmware_reset_mode && !security_started) {
+        protocol_version_check();
+        capabilities_checks();
+#if defined(ENABLE_ENCRYPTION)
+        if (!config.print_secondary_versions_and_exit) {
+          security_init();
+          startup_timeline_mark(STARTUP_PHASE_SECURITY_STARTED);
         }
+#endif
+        security_started = true;
+      }
 
-        if (config.print_secondary_versions_and_exit) {
-          config_exit_cpcd(EXIT_SUCCESS);
-        }
+      if (!rx_capability_received
+          || !protocol_version_received
+          || !capabilities_received
+          || !bootloader_info_received_or_not_available
+          || !secondary_cpc_version_received
+          || !(secondary_bus_speed_received || failed_to_receive_secondary_bus_speed)
+          || !secondary_app_version_received_or_not_available) {
+        break;
+      }
 
-        if (!firmware_reset_mode) {
-          application_version_check();
-        }
+      PRINT_INFO("Connected to Secondary");
+      TRACE_RESET("Obtained RX capability, Protocol version, Capabilities and Secondary versions");
 
-        reset_sequence_state = RESET_SEQUENCE_DONE;
+      if (!secondary_cpc_version_available) {
+        FATAL("Cannot get Secondary CPC version (obsolete RCP firmware?)");
+      }
 
-        if (firmware_reset_mode) {
-          exit_server_core();
-        } else {
-          server_init();
-#if defined(ENABLE_ENCRYPTION)
-          security_init();
-#endif
-          PRINT_INFO("Daemon startup was successful. Waiting for client connections");
-        }
+      if (server_core_secondary_app_version) {
+        TRACE_RESET("Obtained Secondary APP version");
+      }
+
+      if (config.print_secondary_versions_and_exit) {
+        config_exit_cpcd(EXIT_SUCCESS);
+      }
+
+      if (!firmware_reset_mode) {
+        application_version_check();
+      }
+
+      reset_sequence_state = RESET_SEQUENCE_DONE;
+
+      if (firmware_reset_mode) {
+        exit_server_core();
+      } else {
+        server_init();
+        startup_timeline_mark(STARTUP_PHASE_SERVER_READY);
+        PRINT_INFO("Daemon startup was successful. Waiting for client connections");
+        startup_timeline_print();
       }
       break;
 
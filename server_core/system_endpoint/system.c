@@ -59,6 +59,19 @@ static sl_slist_node_t *pending_commands;
 static sl_slist_node_t *commands;
 static sl_slist_node_t *retries;
 static sl_slist_node_t *commands_in_error;
+static sl_slist_node_t *background_commands;
+
+/***************************************************************************//**
+ * Submitted commands indexed by their command_seq. The secondary echoes the
+ * sequence number in its replies, this avoids walking the commands list.
+ ******************************************************************************/
+static sl_cpc_system_command_handle_t *commands_by_seq[UINT8_MAX + 1];
+
+/***************************************************************************//**
+ * Number of submitted or pending commands that are not background commands.
+ * Background commands are held back until this drops to zero.
+ ******************************************************************************/
+static size_t foreground_commands_count = 0;
 
 static bool received_remote_sequence_numbers_reset_ack = true;
 
@@ -78,6 +91,7 @@ static void on_timer_expired(epoll_private_data_t *private_data);
 static void write_command(sl_cpc_system_command_handle_t *command_handle);
 
 static void sl_cpc_system_cmd_abort(sl_cpc_system_command_handle_t *command_handle, sl_status_t error);
+static void submit_background_commands(void);
 
 static void sl_cpc_system_open_endpoint(void)
 {
@@ -112,8 +126,100 @@ static void sl_cpc_system_init_command_handle(sl_cpc_system_command_handle_t *co
   command_handle->on_final = on_final;
   command_handle->retry_count = retry_count;
   command_handle->retry_timeout_us = retry_timeout_us;
-  command_handle->command_seq = next_command_seq++;
   command_handle->is_uframe = is_uframe;
+
+  // Skip sequence numbers still held by a submitted command (ie: a background
+  // command retrying forever), the reply would be matched with the wrong one
+  for (size_t i = 0; i <= UINT8_MAX; i++) {
+    command_handle->command_seq = next_command_seq++;
+    if (commands_by_seq[command_handle->command_seq] == NULL) {
+      return;
+    }
+  }
+
+  FATAL("All system command sequence numbers are in use");
+}
+
+/***************************************************************************//**
+ * Track a command submitted to the secondary
+ ******************************************************************************/
+static void commands_insert(sl_cpc_system_command_handle_t *command_handle)
+{
+  BUG_ON(commands_by_seq[command_handle->command_seq] != NULL);
+
+  sl_slist_push_back(&commands, &command_handle->node_commands);
+  commands_by_seq[command_handle->command_seq] = command_handle;
+
+  if (!command_handle->is_background) {
+    foreground_commands_count++;
+  }
+}
+
+/***************************************************************************//**
+ * Stop tracking a submitted command
+ ******************************************************************************/
+static void commands_remove(sl_cpc_system_command_handle_t *command_handle)
+{
+  BUG_ON(commands_by_seq[command_handle->command_seq] != command_handle);
+
+  sl_slist_remove(&commands, &command_handle->node_commands);
+  commands_by_seq[command_handle->command_seq] = NULL;
+
+  if (!command_handle->is_background) {
+    BUG_ON(foreground_commands_count == 0);
+    foreground_commands_count--;
+  }
+}
+
+/***************************************************************************//**
+ * Find a submitted command from its sequence number
+ ******************************************************************************/
+static sl_cpc_system_command_handle_t* commands_find(uint8_t command_seq)
+{
+  return commands_by_seq[command_seq];
+}
+
+/***************************************************************************//**
+ * Return true if both commands query the same thing on the secondary
+ ******************************************************************************/
+static bool command_is_same_query(const sl_cpc_system_command_handle_t *a,
+                                  const sl_cpc_system_command_handle_t *b)
+{
+  if (a->command->command_id != b->command->command_id) {
+    return false;
+  }
+
+  if (a->command->command_id == CMD_SYSTEM_PROP_VALUE_GET) {
+    const sl_cpc_system_property_cmd_t *prop_a = (const sl_cpc_system_property_cmd_t *)a->command->payload;
+    const sl_cpc_system_property_cmd_t *prop_b = (const sl_cpc_system_property_cmd_t *)b->command->payload;
+
+    return prop_a->property_id == prop_b->property_id;
+  }
+
+  return true;
+}
+
+/***************************************************************************//**
+ * Return true if an identical background command is already submitted or
+ * waiting to be submitted
+ ******************************************************************************/
+static bool background_command_is_outstanding(const sl_cpc_system_command_handle_t *command_handle)
+{
+  sl_cpc_system_command_handle_t *item;
+
+  SL_SLIST_FOR_EACH_ENTRY(commands, item, sl_cpc_system_command_handle_t, node_commands) {
+    if (item->is_background && command_is_same_query(item, command_handle)) {
+      return true;
+    }
+  }
+
+  SL_SLIST_FOR_EACH_ENTRY(background_commands, item, sl_cpc_system_command_handle_t, node_commands) {
+    if (command_is_same_query(item, command_handle)) {
+      return true;
+    }
+  }
+
+  return false;
 }
 
 const char* sl_cpc_system_bootloader_type_to_str(sl_cpc_bootloader_t bootloader)
@@ -140,8 +246,12 @@ void sl_cpc_system_init(void)
   sl_slist_init(&retries);
   sl_slist_init(&pending_commands);
   sl_slist_init(&commands_in_error);
+  sl_slist_init(&background_commands);
   sl_slist_init(&prop_last_status_callbacks);
 
+  memset(commands_by_seq, 0, sizeof(commands_by_seq));
+  foreground_commands_count = 0;
+
   sl_cpc_system_open_endpoint();
 }
 
@@ -215,19 +325,14 @@ static void sl_cpc_system_cmd_timed_out(const void *frame_data)
 
   timed_out_command = (sl_cpc_system_cmd_t *)frame_data;
 
-  /* Go through the list of pending requests to find the one for which this reply applies */
-  SL_SLIST_FOR_EACH_ENTRY(commands, command_handle, sl_cpc_system_command_handle_t, node_commands) {
-    if (command_handle->command_seq == timed_out_command->command_seq) {
-      break;
-    }
-  }
+  command_handle = commands_find(timed_out_command->command_seq);
 
-  if (command_handle == NULL || command_handle->command_seq != timed_out_command->command_seq) {
+  if (command_handle == NULL) {
     BUG("A command timed out but it could not be found in the submitted commands list. SEQ#%d", timed_out_command->command_seq);
   }
 
   // We won't need this command anymore. It needs to be resubmitted.
-  sl_slist_remove(&commands, &command_handle->node_commands);
+  commands_remove(command_handle);
 
   TRACE_SYSTEM("Command ID #%u SEQ #%u timeout", command_handle->command->command_id, command_handle->command->command_seq);
 
@@ -237,6 +342,8 @@ static void sl_cpc_system_cmd_timed_out(const void *frame_data)
 
   free(command_handle->command);
   free(command_handle);
+
+  submit_background_commands();
 }
 
 /***************************************************************************//**
@@ -249,40 +356,41 @@ void sl_cpc_system_cmd_poll_acknowledged(const void *frame_data)
   FATAL_ON(frame_data == NULL);
   sl_cpc_system_cmd_t *acked_command = (sl_cpc_system_cmd_t *)frame_data;
 
-  // Go through the command list to figure out which command just got acknowledged
-  SL_SLIST_FOR_EACH_ENTRY(commands, command_handle, sl_cpc_system_command_handle_t, node_commands) {
-    if (command_handle->command_seq == acked_command->command_seq) {
-      TRACE_SYSTEM("Secondary acknowledged command_id #%d command_seq #%d", command_handle->command->command_id, command_handle->command_seq);
-      const struct itimerspec timeout = { .it_interval = { .tv_sec = 0, .tv_nsec = 0 },
-                                          .it_value    = { .tv_sec = (long int)command_handle->retry_timeout_us / 1000000, .tv_nsec = ((long int)command_handle->retry_timeout_us * 1000) % 1000000000 } };
-
-      /* Setup timeout timer.*/
-      if (command_handle->error_status == SL_STATUS_OK) {
-        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  // Find which command just got acknowledged
+  command_handle = commands_find(acked_command->command_seq);
+  if (command_handle != NULL) {
+    TRACE_SYSTEM("Secondary acknowledged command_id #%d command_seq #%d", command_handle->command->command_id, command_handle->command_seq);
+    const struct itimerspec timeout = { .it_interval = { .tv_sec = 0, .tv_nsec = 0 },
+                                        .it_value    = { .tv_sec = (long int)command_handle->retry_timeout_us / 1000000, .tv_nsec = ((long int)command_handle->retry_timeout_us * 1000) % 1000000000 } };
+
+    /* Setup timeout timer. A retried command has none if it was deferred */
+    if (command_handle->error_status == SL_STATUS_OK
+        || (command_handle->error_status == SL_STATUS_IN_PROGRESS
+            && command_handle->re_transmit_timer_private_data.file_descriptor == 0)) {
+      timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
 
-        FATAL_SYSCALL_ON(timer_fd < 0);
+      FATAL_SYSCALL_ON(timer_fd < 0);
 
-        ret = timerfd_settime(timer_fd, 0, &timeout, NULL);
-        FATAL_SYSCALL_ON(ret < 0);
+      ret = timerfd_settime(timer_fd, 0, &timeout, NULL);
+      FATAL_SYSCALL_ON(ret < 0);
 
-        /* Setup the timer in the server_core epoll set */
-        command_handle->re_transmit_timer_private_data.endpoint_number = SL_CPC_ENDPOINT_SYSTEM; //Irrelevant in this scenario
-        command_handle->re_transmit_timer_private_data.file_descriptor = timer_fd;
-        command_handle->re_transmit_timer_private_data.callback = on_timer_expired;
+      /* Setup the timer in the server_core epoll set */
+      command_handle->re_transmit_timer_private_data.endpoint_number = SL_CPC_ENDPOINT_SYSTEM; //Irrelevant in this scenario
+      command_handle->re_transmit_timer_private_data.file_descriptor = timer_fd;
+      command_handle->re_transmit_timer_private_data.callback = on_timer_expired;
 
-        epoll_register(&command_handle->re_transmit_timer_private_data);
-      } else if (command_handle->error_status == SL_STATUS_IN_PROGRESS) {
-        // Simply restart the timer
-        ret = timerfd_settime(command_handle->re_transmit_timer_private_data.file_descriptor, 0, &timeout, NULL);
-        FATAL_SYSCALL_ON(ret < 0);
-      } else {
-        WARN("Received ACK on a command that timed out or is processed.. ignoring");
-      }
+      epoll_register(&command_handle->re_transmit_timer_private_data);
+    } else if (command_handle->error_status == SL_STATUS_IN_PROGRESS) {
+      // Simply restart the timer
+      ret = timerfd_settime(command_handle->re_transmit_timer_private_data.file_descriptor, 0, &timeout, NULL);
+      FATAL_SYSCALL_ON(ret < 0);
+    } else {
+      WARN("Received ACK on a command that timed out or is processed.. ignoring");
+    }
 
-      command_handle->acked = true;
+    command_handle->acked = true;
 
-      return; // Found the associated command
-    }
+    return; // Found the associated command
   }
 
   WARN("Received a system poll ack for which no pending poll is registered");
@@ -291,9 +399,10 @@ void sl_cpc_system_cmd_poll_acknowledged(const void *frame_data)
 /***************************************************************************//**
  * Send no-operation command query
  ******************************************************************************/
-void sl_cpc_system_cmd_noop(sl_cpc_system_noop_cmd_callback_t on_noop_reply,
+static void system_cmd_noop(sl_cpc_system_noop_cmd_callback_t on_noop_reply,
                             uint8_t retry_count_max,
-                            uint32_t retry_timeout_us)
+                            uint32_t retry_timeout_us,
+                            bool is_background)
 {
   sl_cpc_system_command_handle_t *command_handle;
 
@@ -308,6 +417,7 @@ void sl_cpc_system_cmd_noop(sl_cpc_system_noop_cmd_callback_t on_noop_reply,
 
   sl_cpc_system_init_command_handle(command_handle, (void*)on_noop_reply, retry_count_max,
                                     retry_timeout_us, false);
+  command_handle->is_background = is_background;
 
   /* Fill the system endpoint command buffer */
   {
@@ -323,6 +433,23 @@ void sl_cpc_system_cmd_noop(sl_cpc_system_noop_cmd_callback_t on_noop_reply,
   TRACE_SYSTEM("NOOP (id #%u) sent", CMD_SYSTEM_NOOP);
 }
 
+void sl_cpc_system_cmd_noop(sl_cpc_system_noop_cmd_callback_t on_noop_reply,
+                            uint8_t retry_count_max,
+                            uint32_t retry_timeout_us)
+{
+  system_cmd_noop(on_noop_reply, retry_count_max, retry_timeout_us, false);
+}
+
+/***************************************************************************//**
+ * Send no-operation command query with background priority
+ ******************************************************************************/
+void sl_cpc_system_cmd_noop_background(sl_cpc_system_noop_cmd_callback_t on_noop_reply,
+                                       uint8_t retry_count_max,
+                                       uint32_t retry_timeout_us)
+{
+  system_cmd_noop(on_noop_reply, retry_count_max, retry_timeout_us, true);
+}
+
 /***************************************************************************//**
  * Send a reboot query
  ******************************************************************************/
@@ -384,6 +511,8 @@ void sl_cpc_system_on_unnumbered_acknowledgement(void)
     write_command(command_handle);
     item = sl_slist_pop(&pending_commands);
   }
+
+  submit_background_commands();
 }
 
 /***************************************************************************//**
@@ -493,6 +622,7 @@ void sl_cpc_system_reset_system_endpoint(void)
   item = sl_slist_pop(&commands);
   while (item != NULL) {
     command_handle = SL_SLIST_ENTRY(item, sl_cpc_system_command_handle_t, node_commands);
+    commands_by_seq[command_handle->command_seq] = NULL;
 
     if (command_handle->command->command_id != CMD_SYSTEM_INVALID) {
       WARN("Dropping system command id #%d seq#%d", command_handle->command->command_id, command_handle->command_seq);
@@ -505,6 +635,19 @@ void sl_cpc_system_reset_system_endpoint(void)
     item = sl_slist_pop(&commands);
   }
 
+  foreground_commands_count = 0;
+
+  // Deferred background commands are not in the submitted commands, abort them too
+  item = sl_slist_pop(&background_commands);
+  while (item != NULL) {
+    command_handle = SL_SLIST_ENTRY(item, sl_cpc_system_command_handle_t, node_commands);
+    TRACE_SYSTEM("Dropping background system command id #%d", command_handle->command->command_id);
+    sl_cpc_system_cmd_abort(command_handle, SL_STATUS_ABORT);
+    free(command_handle->command);
+    free(command_handle);
+    item = sl_slist_pop(&background_commands);
+  }
+
   // Close the system endpoint
   core_close_endpoint(SL_CPC_ENDPOINT_SYSTEM, false, true);
 
@@ -515,11 +658,12 @@ void sl_cpc_system_reset_system_endpoint(void)
 /***************************************************************************//**
  * Send a property-get query
  ******************************************************************************/
-void sl_cpc_system_cmd_property_get(sl_cpc_system_property_get_set_cmd_callback_t on_property_get_reply,
+static void system_cmd_property_get(sl_cpc_system_property_get_set_cmd_callback_t on_property_get_reply,
                                     sl_cpc_property_id_t property_id,
                                     uint8_t retry_count_max,
                                     uint32_t retry_timeout_us,
-                                    bool is_uframe)
+                                    bool is_uframe,
+                                    bool is_background)
 {
   sl_cpc_system_command_handle_t *command_handle;
 
@@ -538,6 +682,7 @@ void sl_cpc_system_cmd_property_get(sl_cpc_system_property_get_set_cmd_callback_
 
   sl_cpc_system_init_command_handle(command_handle, (void*)on_property_get_reply, retry_count_max,
                                     retry_timeout_us, is_uframe);
+  command_handle->is_background = is_background;
 
   /* Fill the system endpoint command buffer */
   {
@@ -555,6 +700,28 @@ void sl_cpc_system_cmd_property_get(sl_cpc_system_property_get_set_cmd_callback_
   TRACE_SYSTEM("property-get (id #%u) sent with property #%u", CMD_SYSTEM_PROP_VALUE_GET, property_id);
 }
 
+void sl_cpc_system_cmd_property_get(sl_cpc_system_property_get_set_cmd_callback_t on_property_get_reply,
+                                    sl_cpc_property_id_t property_id,
+                                    uint8_t retry_count_max,
+                                    uint32_t retry_timeout_us,
+                                    bool is_uframe)
+{
+  system_cmd_property_get(on_property_get_reply, property_id, retry_count_max,
+                          retry_timeout_us, is_uframe, false);
+}
+
+/***************************************************************************//**
+ * Send a property-get query with background priority
+ ******************************************************************************/
+void sl_cpc_system_cmd_property_get_background(sl_cpc_system_property_get_set_cmd_callback_t on_property_get_reply,
+                                               sl_cpc_property_id_t property_id,
+                                               uint8_t retry_count_max,
+                                               uint32_t retry_timeout_us)
+{
+  system_cmd_property_get(on_property_get_reply, property_id, retry_count_max,
+                          retry_timeout_us, false, true);
+}
+
 /***************************************************************************//**
  * Send a property-set query
  ******************************************************************************/
@@ -747,65 +914,66 @@ static void on_reply(uint8_t endpoint_id,
   BUG_ON(endpoint_id != 0);
   FATAL_ON(reply->length != answer_lenght - sizeof(sl_cpc_system_cmd_t));
 
-  /* Go through the list of pending requests to find the one for which this reply applies */
-  SL_SLIST_FOR_EACH_ENTRY(commands, command_handle, sl_cpc_system_command_handle_t, node_commands) {
-    if (command_handle->command_seq == reply->command_seq) {
-      TRACE_SYSTEM("Processing command seq#%d of type %d", reply->command_seq, frame_type);
+  /* Find the pending request for which this reply applies */
+  command_handle = commands_find(reply->command_seq);
+  if (command_handle != NULL) {
+    TRACE_SYSTEM("Processing command seq#%d of type %d", reply->command_seq, frame_type);
 
-      /* Stop and close the retransmit timer */
-      if (frame_type == SLI_CPC_HDLC_FRAME_TYPE_UNNUMBERED
-          || (frame_type == SLI_CPC_HDLC_FRAME_TYPE_INFORMATION && command_handle->acked == true)) {
-        BUG_ON(command_handle->re_transmit_timer_private_data.file_descriptor <= 0);
-        epoll_unregister(&command_handle->re_transmit_timer_private_data);
-        close(command_handle->re_transmit_timer_private_data.file_descriptor);
-        command_handle->re_transmit_timer_private_data.file_descriptor = 0;
-      }
+    /* Stop and close the retransmit timer */
+    if (frame_type == SLI_CPC_HDLC_FRAME_TYPE_UNNUMBERED
+        || (frame_type == SLI_CPC_HDLC_FRAME_TYPE_INFORMATION && command_handle->acked == true)) {
+      BUG_ON(command_handle->re_transmit_timer_private_data.file_descriptor <= 0);
+      epoll_unregister(&command_handle->re_transmit_timer_private_data);
+      close(command_handle->re_transmit_timer_private_data.file_descriptor);
+      command_handle->re_transmit_timer_private_data.file_descriptor = 0;
+    }
 
-      /* Call the appropriate callback */
-      if (frame_type == SLI_CPC_HDLC_FRAME_TYPE_UNNUMBERED) {
-        BUG_ON(command_handle->is_uframe == false);
-        switch (reply->command_id) {
-          case CMD_SYSTEM_RESET:
-            on_final_reset(command_handle, reply);
-            break;
-          case CMD_SYSTEM_PROP_VALUE_IS:
-            on_final_property_is(command_handle, reply, true);
-            break;
-          default:
-            FATAL("system endpoint command id not recognized for u-frame");
-            break;
-        }
-      } else if (frame_type == SLI_CPC_HDLC_FRAME_TYPE_INFORMATION) {
-        BUG_ON(command_handle->is_uframe == true);
-        switch (reply->command_id) {
-          case CMD_SYSTEM_NOOP:
-            on_final_noop(command_handle, reply);
-            break;
-
-          case CMD_SYSTEM_PROP_VALUE_IS:
-            on_final_property_is(command_handle, reply, false);
-            break;
-
-          case CMD_SYSTEM_PROP_VALUE_GET:
-          case CMD_SYSTEM_PROP_VALUE_SET:
-            FATAL("its the primary who sends those");
-            break;
-
-          default:
-            FATAL("system endpoint command id not recognized for i-frame");
-            break;
-        }
-      } else {
-        FATAL("Invalid frame_type");
+    /* Call the appropriate callback */
+    if (frame_type == SLI_CPC_HDLC_FRAME_TYPE_UNNUMBERED) {
+      BUG_ON(command_handle->is_uframe == false);
+      switch (reply->command_id) {
+        case CMD_SYSTEM_RESET:
+          on_final_reset(command_handle, reply);
+          break;
+        case CMD_SYSTEM_PROP_VALUE_IS:
+          on_final_property_is(command_handle, reply, true);
+          break;
+        default:
+          FATAL("system endpoint command id not recognized for u-frame");
+          break;
       }
+    } else if (frame_type == SLI_CPC_HDLC_FRAME_TYPE_INFORMATION) {
+      BUG_ON(command_handle->is_uframe == true);
+      switch (reply->command_id) {
+        case CMD_SYSTEM_NOOP:
+          on_final_noop(command_handle, reply);
+          break;
 
-      /* Cleanup this command now that it's been serviced */
-      sl_slist_remove(&commands, &command_handle->node_commands);
-      free(command_handle->command);
-      free(command_handle);
+        case CMD_SYSTEM_PROP_VALUE_IS:
+          on_final_property_is(command_handle, reply, false);
+          break;
 
-      return;
+        case CMD_SYSTEM_PROP_VALUE_GET:
+        case CMD_SYSTEM_PROP_VALUE_SET:
+          FATAL("its the primary who sends those");
+          break;
+
+        default:
+          FATAL("system endpoint command id not recognized for i-frame");
+          break;
+      }
+    } else {
+      FATAL("Invalid frame_type");
     }
+
+    /* Cleanup this command now that it's been serviced */
+    commands_remove(command_handle);
+    free(command_handle->command);
+    free(command_handle);
+
+    submit_background_commands();
+
+    return;
   }
 
   WARN("Received a system final for which no pending poll is registered");
@@ -921,7 +1089,7 @@ static void on_timer_expired(epoll_private_data_t *private_data)
   }
 
   if (command_handle->retry_count > 0 || command_handle->retry_forever) {
-    sl_slist_remove(&commands, &command_handle->node_commands);
+    commands_remove(command_handle);
 
     command_handle->error_status = SL_STATUS_IN_PROGRESS; //at least one timer retry occurred
 
@@ -955,6 +1123,33 @@ static void write_command(sl_cpc_system_command_handle_t *command_handle)
     flags = SL_CPC_FLAG_UNNUMBERED_POLL;
   }
 
+  // Background commands (keep alive, statistics) must never sit in front of a
+  // foreground command in the system endpoint transmit window. Hold them back
+  // until every foreground command got its reply.
+  if (command_handle->is_background) {
+    if (command_handle->error_status == SL_STATUS_OK
+        && background_command_is_outstanding(command_handle)) {
+      TRACE_SYSTEM("Identical background command_id #%d already outstanding, dropping", command_handle->command->command_id);
+      sl_cpc_system_cmd_abort(command_handle, SL_STATUS_ALREADY_EXISTS);
+      free(command_handle->command);
+      free(command_handle);
+      return;
+    }
+
+    if (foreground_commands_count > 0 || pending_commands != NULL) {
+      TRACE_SYSTEM("Deferring background command_id #%d command_seq #%d", command_handle->command->command_id, command_handle->command_seq);
+      // A retried command still holds its retransmit timer: close it while the
+      // command waits, the acknowledgement of the next submission re-arms one
+      if (command_handle->re_transmit_timer_private_data.file_descriptor != 0) {
+        epoll_unregister(&command_handle->re_transmit_timer_private_data);
+        close(command_handle->re_transmit_timer_private_data.file_descriptor);
+        command_handle->re_transmit_timer_private_data.file_descriptor = 0;
+      }
+      sl_slist_push_back(&background_commands, &command_handle->node_commands);
+      return;
+    }
+  }
+
 #if !defined(UNIT_TESTING)
   // Can't send iframe commands on the system endpoint until the sequence numbers are reset
   if (!command_handle->is_uframe) {
@@ -965,7 +1160,7 @@ static void write_command(sl_cpc_system_command_handle_t *command_handle)
   }
 #endif
 
-  sl_slist_push_back(&commands, &command_handle->node_commands);
+  commands_insert(command_handle);
 
   command_handle->acked = false;
 
@@ -1005,6 +1200,28 @@ static void write_command(sl_cpc_system_command_handle_t *command_handle)
   }
 }
 
+/***************************************************************************//**
+ * Submit the deferred background commands once the system endpoint has no
+ * foreground command outstanding
+ ******************************************************************************/
+static void submit_background_commands(void)
+{
+  sl_slist_node_t *item;
+  sl_cpc_system_command_handle_t *command_handle;
+
+  if (foreground_commands_count > 0 || pending_commands != NULL) {
+    return;
+  }
+
+  item = sl_slist_pop(&background_commands);
+  while (item != NULL) {
+    command_handle = SL_SLIST_ENTRY(item, sl_cpc_system_command_handle_t, node_commands);
+    TRACE_SYSTEM("Submitting deferred background command_id #%d command_seq #%d", command_handle->command->command_id, command_handle->command_seq);
+    write_command(command_handle);
+    item = sl_slist_pop(&background_commands);
+  }
+}
+
 void sl_cpc_system_cleanup(void)
 {
   sl_slist_node_t *item;
@@ -459,6 +459,8 @@ typedef struct {
 #define CPC_CAPABILITIES_PACKED_ENDPOINT_MASK   (1 << 1)
 #define CPC_CAPABILITIES_GPIO_ENDPOINT_MASK     (1 << 2)
 #define CPC_CAPABILITIES_UART_FLOW_CONTROL_MASK (1 << 3)
+#define CPC_CAPABILITIES_SPI_FAST_TIMING_MASK   (1 << 4)
+#define CPC_CAPABILITIES_SPI_FULL_DUPLEX_MASK   (1 << 5)
 
 /***************************************************************************//**
  * System endpoint command type
@@ -492,6 +494,7 @@ typedef struct  {
   sl_status_t error_status;
   uint8_t command_seq;
   bool acked;
+  bool is_background; // held back while foreground commands are outstanding
   epoll_private_data_t re_transmit_timer_private_data; //for epoll for timerfd
 } sl_cpc_system_command_handle_t;
 
@@ -564,6 +567,19 @@ void sl_cpc_system_cmd_noop(sl_cpc_system_noop_cmd_callback_t on_noop_reply,
                             uint8_t retry_count_max,
                             uint32_t retry_timeout_us);
 
+/***************************************************************************//**
+ * Send no-operation command query with background priority
+ *
+ * @brief
+ *   Same as sl_cpc_system_cmd_noop, but the command is only submitted once no
+ *   foreground command is outstanding on the system endpoint, and it is dropped
+ *   if an identical background command is already outstanding: on_noop_reply is
+ *   then called with SL_STATUS_ALREADY_EXISTS.
+ ******************************************************************************/
+void sl_cpc_system_cmd_noop_background(sl_cpc_system_noop_cmd_callback_t on_noop_reply,
+                                       uint8_t retry_count_max,
+                                       uint32_t retry_timeout_us);
+
 /***************************************************************************//**
  * Sends a reset query
  ******************************************************************************/
@@ -580,6 +596,18 @@ void sl_cpc_system_cmd_property_get(sl_cpc_system_property_get_set_cmd_callback_
                                     uint32_t retry_timeout_us,
                                     bool is_uframe);
 
+/***************************************************************************//**
+ * Sends a property-get query with background priority
+ *
+ * @brief
+ *   Same as sl_cpc_system_cmd_property_get on an i-frame, but with the
+ *   priority rules of sl_cpc_system_cmd_noop_background.
+ ******************************************************************************/
+void sl_cpc_system_cmd_property_get_background(sl_cpc_system_property_get_set_cmd_callback_t on_property_get_reply,
+                                               sl_cpc_property_id_t property_id,
+                                               uint8_t retry_count_max,
+                                               uint32_t retry_timeout_us);
+
 /***************************************************************************//**
  * Sends a property-set query
  ******************************************************************************/
@@ -319,6 +319,9 @@ void system_noop_cmd_callback_t(sl_cpc_system_command_handle_t *handle,
       WARN("The noop keep alive was aborted");
       TRACE_SERVER("NOOP failed!");
       break;
+    case SL_STATUS_ALREADY_EXISTS:
+      TRACE_SERVER("NOOP dropped, the previous keep alive is still outstanding");
+      break;
     default:
       FATAL();
       break;